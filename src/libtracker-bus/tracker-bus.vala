@@ -283,6 +283,62 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 		return reply.get_body ().get_child_value (0);
 	}
 
+	public override void update_resources (Resource[] resources, string? graph = null, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		// use separate main context for sync operation
+		var context = new MainContext ();
+		var loop = new MainLoop (context, false);
+		context.push_thread_default ();
+		AsyncResult async_res = null;
+		update_resources_async.begin (resources, graph, priority, cancellable, (o, res) => {
+			async_res = res;
+			loop.quit ();
+		});
+		loop.run ();
+		context.pop_thread_default ();
+		update_resources_async.end (async_res);
+	}
+
+	public async override void update_resources_async (Resource[] resources, string? graph = null, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		// serialize upfront, the store applies the statements as-is
+		var builder = new VariantBuilder (new VariantType ("aa(ysss)"));
+		foreach (unowned Resource resource in resources) {
+			builder.add_value (resource.serialize_statements (null));
+		}
+		var statements = new Variant.tuple ({ new Variant.string (graph ?? ""), builder.end () });
+		var bytes = statements.get_data_as_bytes ();
+
+		UnixInputStream input;
+		UnixOutputStream output;
+		pipe (out input, out output);
+
+		// send D-Bus request
+		AsyncResult dbus_res = null;
+		bool sent_update = false;
+		send_update (priority <= GLib.Priority.DEFAULT ? "UpdateResources" : "BatchUpdateResources", input, cancellable, (o, res) => {
+			dbus_res = res;
+			if (sent_update) {
+				update_resources_async.callback ();
+			}
+		});
+
+		// send serialized statements via fd
+		var data_stream = new DataOutputStream (output);
+		data_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
+		data_stream.put_int32 ((int32) bytes.get_size ());
+		size_t bytes_written;
+		data_stream.write_all (bytes.get_data (), out bytes_written);
+		data_stream = null;
+
+		// wait for D-Bus reply
+		sent_update = true;
+		if (dbus_res == null) {
+			yield;
+		}
+
+		var reply = bus.send_message_with_reply.end (dbus_res);
+		handle_error_reply (reply);
+	}
+
 	public override void load (File file, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
 		var message = new DBusMessage.method_call (dbus_name, Tracker.DBUS_OBJECT_RESOURCES, Tracker.DBUS_INTERFACE_RESOURCES, "Load");
 		message.set_body (new Variant ("(s)", file.get_uri ()));
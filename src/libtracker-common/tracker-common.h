@@ -35,6 +35,7 @@
 #include "tracker-ioprio.h"
 #include "tracker-language.h"
 #include "tracker-log.h"
+#include "tracker-metrics.h"
 #include "tracker-parser.h"
 #include "tracker-sched.h"
 #include "tracker-type-utils.h"
@@ -54,6 +54,7 @@ typedef struct {
 struct _TrackerDBusRequest {
 	guint request_id;
 	ClientData *cd;
+	gint64 start_time;
 };
 
 static gboolean client_lookup_enabled;
@@ -357,6 +358,7 @@ tracker_dbus_request_begin (const gchar *sender,
 	request = g_slice_new (TrackerDBusRequest);
 	request->request_id = get_next_request_id ();
 	request->cd = client_get_for_sender (sender);
+	request->start_time = g_get_monotonic_time ();
 
 	g_debug ("<--- [%d%s%s|%lu] %s",
 	         request->request_id,
@@ -374,18 +376,24 @@ void
 tracker_dbus_request_end (TrackerDBusRequest *request,
                           GError             *error)
 {
+	gdouble elapsed;
+
+	elapsed = (gdouble) (g_get_monotonic_time () - request->start_time) / G_USEC_PER_SEC;
+
 	if (!error) {
-		g_debug ("---> [%d%s%s|%lu] Success, no error given",
+		g_debug ("---> [%d%s%s|%lu] Success, no error given (%.3fs)",
 			 request->request_id,
 			 request->cd ? "|" : "",
 			 request->cd ? request->cd->binary : "",
-			 request->cd ? request->cd->pid : 0);
+			 request->cd ? request->cd->pid : 0,
+			 elapsed);
 	} else {
-		g_message ("---> [%d%s%s|%lu] Failed, %s",
+		g_message ("---> [%d%s%s|%lu] Failed after %.3fs, %s",
 			   request->request_id,
 			   request->cd ? "|" : "",
 			   request->cd ? request->cd->binary : "",
 			   request->cd ? request->cd->pid : 0,
+			   elapsed,
 			   error->message);
 	}
 
@@ -0,0 +1,440 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "tracker-metrics.h"
+
+/* A small in-process registry of counters, gauges and histograms,
+ * dumped in the Prometheus text exposition format.
+ */
+
+typedef enum {
+	METRIC_TYPE_COUNTER,
+	METRIC_TYPE_GAUGE,
+	METRIC_TYPE_HISTOGRAM,
+} MetricType;
+
+typedef struct {
+	gchar *name;
+	gchar *help;
+	MetricType type;
+	GPtrArray *metrics;
+} MetricFamily;
+
+struct _TrackerMetric {
+	MetricFamily *family;
+	gchar *labels;
+	GMutex mutex;
+	gdouble value;
+	/* Histograms only */
+	gdouble *buckets;
+	guint64 *bucket_counts;
+	guint n_buckets;
+	guint64 count;
+};
+
+/* Latencies, in seconds */
+static const gdouble default_buckets[] = {
+	0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10
+};
+
+static GMutex metrics_mutex;
+static GPtrArray *families;
+static GHashTable *metrics;
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='org.freedesktop.Tracker1.Metrics'>"
+  "    <method name='GetMetrics'>"
+  "      <arg type='s' name='metrics' direction='out' />"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+static GDBusNodeInfo *introspection_data;
+
+static TrackerMetric *
+metrics_register (MetricType     type,
+                  const gchar   *name,
+                  const gchar   *labels,
+                  const gchar   *help,
+                  const gdouble *buckets,
+                  guint          n_buckets)
+{
+	TrackerMetric *metric;
+	MetricFamily *family = NULL;
+	gchar *key;
+	guint i;
+
+	g_return_val_if_fail (name != NULL, NULL);
+
+	key = g_strdup_printf ("%s{%s}", name, labels ? labels : "");
+
+	g_mutex_lock (&metrics_mutex);
+
+	if (!metrics) {
+		metrics = g_hash_table_new (g_str_hash, g_str_equal);
+		families = g_ptr_array_new ();
+	}
+
+	metric = g_hash_table_lookup (metrics, key);
+
+	if (metric) {
+		g_mutex_unlock (&metrics_mutex);
+		g_free (key);
+		return metric;
+	}
+
+	for (i = 0; i < families->len; i++) {
+		MetricFamily *f = g_ptr_array_index (families, i);
+
+		if (strcmp (f->name, name) == 0) {
+			family = f;
+			break;
+		}
+	}
+
+	if (!family) {
+		family = g_new0 (MetricFamily, 1);
+		family->name = g_strdup (name);
+		family->help = g_strdup (help);
+		family->type = type;
+		family->metrics = g_ptr_array_new ();
+		g_ptr_array_add (families, family);
+	} else if (family->type != type) {
+		g_warning ("Metric '%s' registered with different types", name);
+	}
+
+	metric = g_new0 (TrackerMetric, 1);
+	metric->family = family;
+	metric->labels = labels ? g_strdup (labels) : NULL;
+	g_mutex_init (&metric->mutex);
+
+	if (type == METRIC_TYPE_HISTOGRAM) {
+		if (!buckets) {
+			buckets = default_buckets;
+			n_buckets = G_N_ELEMENTS (default_buckets);
+		}
+
+		metric->buckets = g_memdup (buckets, n_buckets * sizeof (gdouble));
+		metric->bucket_counts = g_new0 (guint64, n_buckets);
+		metric->n_buckets = n_buckets;
+	}
+
+	g_ptr_array_add (family->metrics, metric);
+	g_hash_table_insert (metrics, key, metric);
+
+	g_mutex_unlock (&metrics_mutex);
+
+	return metric;
+}
+
+/**
+ * tracker_metrics_counter:
+ * @name: metric name, e.g. "tracker_data_transactions_total"
+ * @labels: (nullable): preformatted labels
+ * @help: one line description
+ *
+ * Returns the counter for @name and @labels, registering it on
+ * first use. Callers on hot paths are expected to keep the
+ * returned pointer around.
+ *
+ * Returns: (transfer none): the counter
+ **/
+TrackerMetric *
+tracker_metrics_counter (const gchar *name,
+                         const gchar *labels,
+                         const gchar *help)
+{
+	return metrics_register (METRIC_TYPE_COUNTER, name, labels, help, NULL, 0);
+}
+
+TrackerMetric *
+tracker_metrics_gauge (const gchar *name,
+                       const gchar *labels,
+                       const gchar *help)
+{
+	return metrics_register (METRIC_TYPE_GAUGE, name, labels, help, NULL, 0);
+}
+
+/**
+ * tracker_metrics_histogram:
+ * @name: metric name
+ * @labels: (nullable): preformatted labels
+ * @help: one line description
+ * @buckets: (nullable): sorted upper bounds of the buckets
+ * @n_buckets: number of elements in @buckets
+ *
+ * Returns the histogram for @name and @labels, registering it
+ * on first use. If @buckets is %NULL, buckets suitable for
+ * latencies in seconds are used.
+ *
+ * Returns: (transfer none): the histogram
+ **/
+TrackerMetric *
+tracker_metrics_histogram (const gchar   *name,
+                           const gchar   *labels,
+                           const gchar   *help,
+                           const gdouble *buckets,
+                           guint          n_buckets)
+{
+	return metrics_register (METRIC_TYPE_HISTOGRAM, name, labels, help,
+	                         buckets, n_buckets);
+}
+
+void
+tracker_metric_add (TrackerMetric *metric,
+                    gdouble        value)
+{
+	g_return_if_fail (metric != NULL);
+
+	g_mutex_lock (&metric->mutex);
+	metric->value += value;
+	g_mutex_unlock (&metric->mutex);
+}
+
+void
+tracker_metric_set (TrackerMetric *metric,
+                    gdouble        value)
+{
+	g_return_if_fail (metric != NULL);
+	g_return_if_fail (metric->family->type == METRIC_TYPE_GAUGE);
+
+	g_mutex_lock (&metric->mutex);
+	metric->value = value;
+	g_mutex_unlock (&metric->mutex);
+}
+
+void
+tracker_metric_observe (TrackerMetric *metric,
+                        gdouble        value)
+{
+	guint i;
+
+	g_return_if_fail (metric != NULL);
+	g_return_if_fail (metric->family->type == METRIC_TYPE_HISTOGRAM);
+
+	g_mutex_lock (&metric->mutex);
+
+	for (i = 0; i < metric->n_buckets; i++) {
+		if (value <= metric->buckets[i]) {
+			metric->bucket_counts[i]++;
+			break;
+		}
+	}
+
+	metric->value += value;
+	metric->count++;
+
+	g_mutex_unlock (&metric->mutex);
+}
+
+static void
+append_value (GString *str,
+              gdouble  value)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+	if (value == floor (value) && fabs (value) < 1e15)
+		g_string_append_printf (str, "%" G_GINT64_FORMAT, (gint64) value);
+	else
+		g_string_append (str, g_ascii_formatd (buf, sizeof (buf), "%.9g", value));
+}
+
+static void
+append_sample (GString     *str,
+               const gchar *name,
+               const gchar *suffix,
+               const gchar *labels,
+               const gchar *extra_labels,
+               gdouble      value)
+{
+	g_string_append (str, name);
+	g_string_append (str, suffix);
+
+	if (labels || extra_labels) {
+		g_string_append_c (str, '{');
+
+		if (labels)
+			g_string_append (str, labels);
+		if (labels && extra_labels)
+			g_string_append_c (str, ',');
+		if (extra_labels)
+			g_string_append (str, extra_labels);
+
+		g_string_append_c (str, '}');
+	}
+
+	g_string_append_c (str, ' ');
+	append_value (str, value);
+	g_string_append_c (str, '\n');
+}
+
+static void
+append_metric (GString       *str,
+               TrackerMetric *metric)
+{
+	MetricFamily *family = metric->family;
+	guint64 cumulative = 0;
+	guint i;
+
+	g_mutex_lock (&metric->mutex);
+
+	if (family->type != METRIC_TYPE_HISTOGRAM) {
+		append_sample (str, family->name, "", metric->labels, NULL,
+		               metric->value);
+		g_mutex_unlock (&metric->mutex);
+		return;
+	}
+
+	for (i = 0; i < metric->n_buckets; i++) {
+		gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+		gchar *le;
+
+		cumulative += metric->bucket_counts[i];
+		le = g_strdup_printf ("le=\"%s\"",
+		                      g_ascii_formatd (buf, sizeof (buf), "%g",
+		                                       metric->buckets[i]));
+		append_sample (str, family->name, "_bucket", metric->labels, le,
+		               cumulative);
+		g_free (le);
+	}
+
+	append_sample (str, family->name, "_bucket", metric->labels,
+	               "le=\"+Inf\"", metric->count);
+	append_sample (str, family->name, "_sum", metric->labels, NULL,
+	               metric->value);
+	append_sample (str, family->name, "_count", metric->labels, NULL,
+	               metric->count);
+
+	g_mutex_unlock (&metric->mutex);
+}
+
+/**
+ * tracker_metrics_dump:
+ *
+ * Returns all metrics registered in this process, in the
+ * Prometheus text exposition format.
+ *
+ * Returns: (transfer full): the metrics
+ **/
+gchar *
+tracker_metrics_dump (void)
+{
+	const gchar *type_names[] = { "counter", "gauge", "histogram" };
+	GString *str;
+	guint i, j;
+
+	str = g_string_new (NULL);
+
+	g_mutex_lock (&metrics_mutex);
+
+	for (i = 0; families && i < families->len; i++) {
+		MetricFamily *family = g_ptr_array_index (families, i);
+
+		if (family->help)
+			g_string_append_printf (str, "# HELP %s %s\n", family->name, family->help);
+		g_string_append_printf (str, "# TYPE %s %s\n", family->name,
+		                        type_names[family->type]);
+
+		for (j = 0; j < family->metrics->len; j++)
+			append_metric (str, g_ptr_array_index (family->metrics, j));
+	}
+
+	g_mutex_unlock (&metrics_mutex);
+
+	return g_string_free (str, FALSE);
+}
+
+static void
+handle_method_call (GDBusConnection       *connection,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+	gchar *dump;
+
+	if (g_strcmp0 (method_name, "GetMetrics") != 0) {
+		g_dbus_method_invocation_return_error (invocation,
+		                                       G_DBUS_ERROR,
+		                                       G_DBUS_ERROR_UNKNOWN_METHOD,
+		                                       "Unknown method '%s'",
+		                                       method_name);
+		return;
+	}
+
+	dump = tracker_metrics_dump ();
+	g_dbus_method_invocation_return_value (invocation,
+	                                       g_variant_new ("(s)", dump));
+	g_free (dump);
+}
+
+/**
+ * tracker_metrics_dbus_register:
+ * @connection: a #GDBusConnection
+ * @object_path: object path to export the metrics on
+ * @error: return location for errors
+ *
+ * Exports the org.freedesktop.Tracker1.Metrics interface at
+ * @object_path. Unregister with g_dbus_connection_unregister_object().
+ *
+ * Returns: the registration ID, or 0 on error
+ **/
+guint
+tracker_metrics_dbus_register (GDBusConnection  *connection,
+                               const gchar      *object_path,
+                               GError          **error)
+{
+	static const GDBusInterfaceVTable interface_vtable = {
+		handle_method_call,
+		NULL,
+		NULL
+	};
+
+	g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), 0);
+	g_return_val_if_fail (object_path != NULL, 0);
+
+	g_mutex_lock (&metrics_mutex);
+
+	if (!introspection_data) {
+		introspection_data = g_dbus_node_info_new_for_xml (introspection_xml, error);
+
+		if (!introspection_data) {
+			g_mutex_unlock (&metrics_mutex);
+			return 0;
+		}
+	}
+
+	g_mutex_unlock (&metrics_mutex);
+
+	return g_dbus_connection_register_object (connection,
+	                                          object_path,
+	                                          introspection_data->interfaces[0],
+	                                          &interface_vtable,
+	                                          NULL, NULL,
+	                                          error);
+}
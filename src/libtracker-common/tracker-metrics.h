@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_COMMON_METRICS_H__
+#define __LIBTRACKER_COMMON_METRICS_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#if !defined (__LIBTRACKER_COMMON_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "only <libtracker-common/tracker-common.h> must be included directly."
+#endif
+
+typedef struct _TrackerMetric TrackerMetric;
+
+/* Metrics are registered once and live as long as the process,
+ * @labels is an optional preformatted label set, e.g. 'op="query"'.
+ */
+TrackerMetric * tracker_metrics_counter   (const gchar   *name,
+                                           const gchar   *labels,
+                                           const gchar   *help);
+TrackerMetric * tracker_metrics_gauge     (const gchar   *name,
+                                           const gchar   *labels,
+                                           const gchar   *help);
+TrackerMetric * tracker_metrics_histogram (const gchar   *name,
+                                           const gchar   *labels,
+                                           const gchar   *help,
+                                           const gdouble *buckets,
+                                           guint          n_buckets);
+
+void            tracker_metric_add        (TrackerMetric *metric,
+                                           gdouble        value);
+void            tracker_metric_set        (TrackerMetric *metric,
+                                           gdouble        value);
+void            tracker_metric_observe    (TrackerMetric *metric,
+                                           gdouble        value);
+
+gchar *         tracker_metrics_dump      (void);
+
+guint           tracker_metrics_dbus_register (GDBusConnection  *connection,
+                                               const gchar      *object_path,
+                                               GError          **error);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_COMMON_METRICS_H__ */
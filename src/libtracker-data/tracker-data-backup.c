@@ -407,10 +407,14 @@ restore_from_temp (GFile *cache_location,
 	g_free (data_dir);
 }
 
+/* Incremental backups only make a difference without the journal,
+ * the journal is always archived whole.
+ */
 void
 tracker_data_backup_save (TrackerDataManager        *data_manager,
                           GFile                     *destination,
                           GFile                     *data_location,
+                          gboolean                   incremental,
                           TrackerDataBackupFinished  callback,
                           gpointer                   user_data,
                           GDestroyNotify             destroy)
@@ -540,10 +544,13 @@ tracker_data_backup_save (TrackerDataManager        *data_manager,
 	db_manager = tracker_data_manager_get_db_manager (data_manager);
 	db_file = g_file_new_for_path (tracker_db_manager_get_file (db_manager));
 
-	tracker_db_backup_save (destination, db_file,
-	                        on_backup_finished,
-	                        info,
-	                        NULL);
+	tracker_db_backup_save_full (destination, db_file, incremental,
+	                             TRACKER_DB_BACKUP_PAGES_PER_STEP,
+	                             TRACKER_DB_BACKUP_STEP_INTERVAL,
+	                             NULL,
+	                             on_backup_finished,
+	                             info,
+	                             NULL);
 
 	g_object_unref (db_file);
 #endif /* DISABLE_JOURNAL */
@@ -656,10 +663,9 @@ tracker_data_backup_restore (TrackerDataManager   *manager,
 		/* Turn off force-reindex here, no journal to replay so it wouldn't work */
 		flags &= ~TRACKER_DB_MANAGER_FORCE_REINDEX;
 
-		g_file_copy (info->journal, info->destination,
-		             G_FILE_COPY_OVERWRITE, 
-		             NULL, NULL, NULL,
-		             &info->error);
+		/* Also applies the incremental backups made on top */
+		tracker_db_backup_restore (info->journal, info->destination,
+		                           &info->error);
 #endif /* DISABLE_JOURNAL */
 
 		tracker_db_manager_ensure_locations (db_manager, cache_location, data_location);
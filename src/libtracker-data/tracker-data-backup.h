@@ -46,6 +46,7 @@ GQuark tracker_data_backup_error_quark (void);
 void   tracker_data_backup_save        (TrackerDataManager        *manager,
                                         GFile                     *destination,
                                         GFile                     *data_location,
+                                        gboolean                   incremental,
                                         TrackerDataBackupFinished  callback,
                                         gpointer                   user_data,
                                         GDestroyNotify             destroy);
@@ -0,0 +1,686 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <libtracker-common/tracker-common.h>
+#include <libtracker-sparql/tracker-sparql.h>
+
+#include "tracker-data-compaction.h"
+#include "tracker-data-manager.h"
+#include "tracker-data-query.h"
+#include "tracker-db-interface-sqlite.h"
+#include "tracker-db-journal.h"
+#include "tracker-db-manager.h"
+#include "tracker-ontologies.h"
+#include "tracker-property.h"
+
+/* Journal compaction writes the live statements of the database as a
+ * snapshot in the journal format, which then supersedes all rotated
+ * chunks up to the point it was taken at. Replay cost is thus bound by
+ * the live data plus the chunks written after the last compaction.
+ *
+ * tracker_data_compaction_begin() must be called where no updates
+ * happen meanwhile (e.g. the update thread), it pins the state of the
+ * database on a connection of its own, and rotates the journal so the
+ * snapshot ends exactly where the next chunk starts. The expensive
+ * part, tracker_data_compaction_run(), may then run in any thread
+ * while updates go on.
+ *
+ * The snapshot is a single read transaction, so the WAL can't be reset
+ * past its start until the dump is over, and it grows with every update
+ * done meanwhile. Splitting the dump over several transactions would
+ * lose its consistency with the rotation point, so the dump is instead
+ * bounded in time: past COMPACTION_MAX_DURATION it gives up, and the
+ * chunks are left in place for the next attempt.
+ */
+
+struct _TrackerDataCompaction {
+	TrackerDataManager *manager;
+	TrackerDBInterface *iface;
+	guint chunk;
+	time_t time;
+	gint64 start_time;
+};
+
+#ifndef DISABLE_JOURNAL
+
+#define ENTRIES_PER_TRANSACTION 10000
+#define COMPACTION_MAX_DURATION (5 * 60 * G_USEC_PER_SEC)
+
+typedef struct {
+	TrackerDataCompaction *compaction;
+	TrackerDBJournal *writer;
+	GCancellable *cancellable;
+	GHashTable *ontology_ids;
+	GHashTable *damaged;
+	gint own_graph_id;
+	gboolean in_transaction;
+	time_t time;
+	guint n_entries;
+	guint64 n_total;
+} SnapshotDump;
+
+static TrackerMetric *
+compaction_duration_metric (void)
+{
+	static TrackerMetric *metric = NULL;
+
+	if (g_once_init_enter (&metric)) {
+		g_once_init_leave (&metric,
+		                   tracker_metrics_histogram ("tracker_data_journal_compaction_duration_seconds",
+		                                              NULL,
+		                                              "Time spent writing journal snapshots",
+		                                              NULL, 0));
+	}
+
+	return metric;
+}
+
+static TrackerDBCursor *
+start_cursor (TrackerDBInterface  *iface,
+              GError             **error,
+              const gchar         *query,
+              ...)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	gchar *sql;
+	va_list args;
+
+	va_start (args, query);
+	sql = g_strdup_vprintf (query, args);
+	va_end (args);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              error, "%s", sql);
+	g_free (sql);
+
+	if (!stmt)
+		return NULL;
+
+	cursor = tracker_db_statement_start_cursor (stmt, error);
+	g_object_unref (stmt);
+
+	return cursor;
+}
+
+/* Starts a new transaction every ENTRIES_PER_TRANSACTION entries, or
+ * whenever the time changes, it becomes tracker:added of the
+ * resources created in the transaction on replay. Cancellation and
+ * the time limit are checked in between.
+ */
+static gboolean
+dump_next_entry (SnapshotDump  *dump,
+                 time_t         time,
+                 GError       **error)
+{
+	if (dump->in_transaction &&
+	    (dump->n_entries >= ENTRIES_PER_TRANSACTION || time != dump->time)) {
+		dump->in_transaction = FALSE;
+
+		if (!tracker_db_journal_commit_db_transaction (dump->writer, error))
+			return FALSE;
+
+		if (g_cancellable_set_error_if_cancelled (dump->cancellable, error))
+			return FALSE;
+
+		if (g_get_monotonic_time () - dump->compaction->start_time > COMPACTION_MAX_DURATION) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+			             "Journal snapshot took too long, giving up "
+			             "so the database WAL can be reset");
+			return FALSE;
+		}
+	}
+
+	if (!dump->in_transaction) {
+		tracker_db_journal_start_transaction (dump->writer, time);
+		dump->in_transaction = TRUE;
+		dump->time = time;
+		dump->n_entries = 0;
+	}
+
+	dump->n_entries++;
+	dump->n_total++;
+
+	return TRUE;
+}
+
+/* The ontology journal holds the IDs of ontology resources, replays
+ * recreate them, and their statements, from the ontology files before
+ * reading the data journal.
+ */
+static GHashTable *
+load_ontology_ids (TrackerDataManager  *manager,
+                   GError             **error)
+{
+	TrackerDBJournalReader *reader;
+	GError *inner_error = NULL;
+	GHashTable *ids;
+	GFile *data_location;
+
+	data_location = tracker_data_manager_get_data_location (manager);
+	reader = tracker_db_journal_reader_ontology_new (data_location, &inner_error);
+	g_object_unref (data_location);
+
+	if (!reader) {
+		if (!inner_error) {
+			inner_error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+			                                   "Ontology journal not found");
+		}
+
+		g_propagate_error (error, inner_error);
+		return NULL;
+	}
+
+	ids = g_hash_table_new (NULL, NULL);
+
+	while (tracker_db_journal_reader_next (reader, NULL)) {
+		const gchar *uri;
+		gint id;
+
+		if (tracker_db_journal_reader_get_entry_type (reader) == TRACKER_DB_JOURNAL_RESOURCE) {
+			tracker_db_journal_reader_get_resource (reader, &id, &uri);
+			g_hash_table_add (ids, GINT_TO_POINTER (id));
+		}
+	}
+
+	tracker_db_journal_reader_free (reader);
+
+	return ids;
+}
+
+static gboolean
+dump_resources (SnapshotDump  *dump,
+                GError       **error)
+{
+	TrackerDataCompaction *compaction = dump->compaction;
+	TrackerDBCursor *cursor;
+	GError *inner_error = NULL;
+
+	cursor = start_cursor (compaction->iface, error, "SELECT ID, Uri FROM Resource");
+	if (!cursor)
+		return FALSE;
+
+	while (tracker_db_cursor_iter_next (cursor, dump->cancellable, &inner_error)) {
+		gint id = tracker_db_cursor_get_int (cursor, 0);
+
+		if (g_hash_table_contains (dump->ontology_ids, GINT_TO_POINTER (id)))
+			continue;
+
+		if (!dump_next_entry (dump, compaction->time, &inner_error))
+			break;
+
+		tracker_db_journal_append_resource (dump->writer, id,
+		                                    tracker_db_cursor_get_string (cursor, 1, NULL));
+	}
+
+	g_object_unref (cursor);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Types go first and in their original order, the first one of each
+ * resource creates it with the right tracker:added.
+ */
+static gboolean
+dump_types (SnapshotDump  *dump,
+            GError       **error)
+{
+	TrackerDataCompaction *compaction = dump->compaction;
+	TrackerOntologies *ontologies;
+	TrackerProperty *rdf_type;
+	TrackerDBCursor *cursor;
+	GError *inner_error = NULL;
+	gint type_id;
+
+	ontologies = tracker_data_manager_get_ontologies (compaction->manager);
+	rdf_type = tracker_ontologies_get_rdf_type (ontologies);
+	type_id = tracker_property_get_id (rdf_type);
+
+	cursor = start_cursor (compaction->iface, error,
+	                       "SELECT T.ID, T.\"rdf:type\", T.\"rdf:type:graph\", R.\"tracker:added\" "
+	                       "FROM \"%s\" AS T JOIN \"rdfs:Resource\" AS R ON R.ID = T.ID "
+	                       "ORDER BY R.\"tracker:added\", T.ID, T.rowid",
+	                       tracker_property_get_table_name (rdf_type));
+	if (!cursor)
+		return FALSE;
+
+	while (tracker_db_cursor_iter_next (cursor, dump->cancellable, &inner_error)) {
+		if (g_hash_table_contains (dump->ontology_ids,
+		                           GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 0))))
+			continue;
+
+		if (!dump_next_entry (dump, (time_t) tracker_db_cursor_get_int (cursor, 3), &inner_error))
+			break;
+
+		tracker_db_journal_append_insert_statement_id (dump->writer,
+		                                               tracker_db_cursor_get_int (cursor, 2),
+		                                               tracker_db_cursor_get_int (cursor, 0),
+		                                               type_id,
+		                                               tracker_db_cursor_get_int (cursor, 1));
+	}
+
+	g_object_unref (cursor);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Keeps the local time offset, which the database stores apart */
+static gchar *
+date_time_to_string (gdouble time,
+                     gint64  local_date,
+                     gint64  local_time)
+{
+	gint64 offset;
+	gchar *str, *local;
+
+	offset = local_date * 24 * 3600 + local_time - (gint64) time;
+
+	if (offset == 0)
+		return tracker_date_to_string (time);
+
+	/* Drop the trailing 'Z', the offset is appended instead */
+	local = tracker_date_to_string (time + offset);
+	local[strlen (local) - 1] = '\0';
+
+	str = g_strdup_printf ("%s%c%02d:%02d", local,
+	                       offset < 0 ? '-' : '+',
+	                       (gint) (ABS (offset) / 3600),
+	                       (gint) (ABS (offset) % 3600 / 60));
+	g_free (local);
+
+	return str;
+}
+
+static gchar *
+column_to_string (TrackerDBCursor     *cursor,
+                  TrackerPropertyType  type)
+{
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+	gchar *str;
+
+	switch (type) {
+	case TRACKER_PROPERTY_TYPE_STRING:
+		return g_strdup (tracker_db_cursor_get_string (cursor, 1, NULL));
+	case TRACKER_PROPERTY_TYPE_INTEGER:
+		return g_strdup_printf ("%" G_GINT64_FORMAT, tracker_db_cursor_get_int (cursor, 1));
+	case TRACKER_PROPERTY_TYPE_BOOLEAN:
+		return g_strdup (tracker_db_cursor_get_int (cursor, 1) ? "true" : "false");
+	case TRACKER_PROPERTY_TYPE_DOUBLE:
+		return g_strdup (g_ascii_dtostr (buffer, sizeof (buffer),
+		                                 tracker_db_cursor_get_double (cursor, 1)));
+	case TRACKER_PROPERTY_TYPE_DATE:
+		str = tracker_date_to_string (tracker_db_cursor_get_int (cursor, 1));
+		/* it's a date-only, cut off the time */
+		str[10] = '\0';
+		return str;
+	case TRACKER_PROPERTY_TYPE_DATETIME:
+		return date_time_to_string (tracker_db_cursor_get_double (cursor, 1),
+		                            tracker_db_cursor_get_int (cursor, 3),
+		                            tracker_db_cursor_get_int (cursor, 4));
+	default:
+		g_warn_if_reached ();
+		return NULL;
+	}
+}
+
+static gboolean
+dump_property (SnapshotDump     *dump,
+               TrackerProperty  *property,
+               GError          **error)
+{
+	TrackerDataCompaction *compaction = dump->compaction;
+	TrackerPropertyType type;
+	TrackerDBCursor *cursor;
+	GError *inner_error = NULL;
+	const gchar *name;
+	gboolean journaled;
+	gint property_id;
+
+	type = tracker_property_get_data_type (property);
+	name = tracker_property_get_name (property);
+	property_id = tracker_property_get_id (property);
+
+	/* Literals in the graph of data extracted from the filesystem
+	 * are not journaled, just as updates flag them as damaged.
+	 */
+	journaled = (type == TRACKER_PROPERTY_TYPE_RESOURCE ||
+	             tracker_property_get_force_journal (property));
+
+	if (type == TRACKER_PROPERTY_TYPE_DATETIME) {
+		cursor = start_cursor (compaction->iface, error,
+		                       "SELECT ID, \"%s\", \"%s:graph\", \"%s:localDate\", \"%s:localTime\" "
+		                       "FROM \"%s\" WHERE \"%s\" IS NOT NULL",
+		                       name, name, name, name,
+		                       tracker_property_get_table_name (property), name);
+	} else {
+		cursor = start_cursor (compaction->iface, error,
+		                       "SELECT ID, \"%s\", \"%s:graph\" FROM \"%s\" WHERE \"%s\" IS NOT NULL",
+		                       name, name,
+		                       tracker_property_get_table_name (property), name);
+	}
+
+	if (!cursor)
+		return FALSE;
+
+	while (tracker_db_cursor_iter_next (cursor, dump->cancellable, &inner_error)) {
+		gint subject_id = tracker_db_cursor_get_int (cursor, 0);
+		gint graph_id = tracker_db_cursor_get_int (cursor, 2);
+		gchar *object;
+
+		if (g_hash_table_contains (dump->ontology_ids, GINT_TO_POINTER (subject_id)))
+			continue;
+
+		if (!journaled && graph_id == dump->own_graph_id && graph_id != 0) {
+			g_hash_table_insert (dump->damaged,
+			                     GINT_TO_POINTER (subject_id),
+			                     GINT_TO_POINTER (graph_id));
+			continue;
+		}
+
+		if (!dump_next_entry (dump, compaction->time, &inner_error))
+			break;
+
+		if (type == TRACKER_PROPERTY_TYPE_RESOURCE) {
+			tracker_db_journal_append_insert_statement_id (dump->writer,
+			                                               graph_id,
+			                                               subject_id,
+			                                               property_id,
+			                                               tracker_db_cursor_get_int (cursor, 1));
+		} else {
+			object = column_to_string (cursor, type);
+			if (object) {
+				tracker_db_journal_append_insert_statement (dump->writer,
+				                                            graph_id,
+				                                            subject_id,
+				                                            property_id,
+				                                            object);
+			}
+			g_free (object);
+		}
+	}
+
+	g_object_unref (cursor);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+dump_damaged (SnapshotDump     *dump,
+              TrackerProperty  *damaged,
+              GError          **error)
+{
+	TrackerDataCompaction *compaction = dump->compaction;
+	TrackerDBCursor *cursor;
+	GError *inner_error = NULL;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	/* Resources flagged before are kept as such */
+	cursor = start_cursor (compaction->iface, error,
+	                       "SELECT ID, \"%s:graph\" FROM \"%s\" WHERE \"%s\" = 1",
+	                       tracker_property_get_name (damaged),
+	                       tracker_property_get_table_name (damaged),
+	                       tracker_property_get_name (damaged));
+	if (!cursor)
+		return FALSE;
+
+	while (tracker_db_cursor_iter_next (cursor, dump->cancellable, &inner_error)) {
+		if (g_hash_table_contains (dump->ontology_ids,
+		                           GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 0))))
+			continue;
+
+		g_hash_table_insert (dump->damaged,
+		                     GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 0)),
+		                     GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 1)));
+	}
+
+	g_object_unref (cursor);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
+	g_hash_table_iter_init (&iter, dump->damaged);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (!dump_next_entry (dump, compaction->time, error))
+			return FALSE;
+
+		tracker_db_journal_append_insert_statement (dump->writer,
+		                                            GPOINTER_TO_INT (value),
+		                                            GPOINTER_TO_INT (key),
+		                                            tracker_property_get_id (damaged),
+		                                            "true");
+	}
+
+	return TRUE;
+}
+
+static gboolean
+dump_properties (SnapshotDump  *dump,
+                 GError       **error)
+{
+	TrackerOntologies *ontologies;
+	TrackerProperty **properties;
+	TrackerProperty *rdf_type, *damaged, *added, *modified;
+	guint i, n_properties;
+
+	ontologies = tracker_data_manager_get_ontologies (dump->compaction->manager);
+	properties = tracker_ontologies_get_properties (ontologies, &n_properties);
+	rdf_type = tracker_ontologies_get_rdf_type (ontologies);
+	damaged = tracker_ontologies_get_property_by_uri (ontologies, TRACKER_PREFIX_TRACKER "damaged");
+	added = tracker_ontologies_get_property_by_uri (ontologies, TRACKER_PREFIX_TRACKER "added");
+	modified = tracker_ontologies_get_property_by_uri (ontologies, TRACKER_PREFIX_TRACKER "modified");
+
+	for (i = 0; i < n_properties; i++) {
+		TrackerProperty *property = properties[i];
+
+		/* Transient data is never journaled, and tracker:added
+		 * and tracker:modified are filled in by the replay.
+		 */
+		if (property == rdf_type || property == damaged ||
+		    property == added || property == modified ||
+		    tracker_property_get_transient (property))
+			continue;
+
+		if (!dump_property (dump, property, error))
+			return FALSE;
+	}
+
+	if (damaged)
+		return dump_damaged (dump, damaged, error);
+
+	return TRUE;
+}
+
+TrackerDataCompaction *
+tracker_data_compaction_begin (TrackerDataManager  *manager,
+                               gsize                min_tail_size,
+                               GError             **error)
+{
+	TrackerDataCompaction *compaction;
+	TrackerDBJournal *writer;
+	TrackerDBInterface *iface;
+	TrackerDBCursor *cursor;
+	GError *inner_error = NULL;
+	gsize tail_size, snapshot_size;
+	guint chunk;
+
+	writer = tracker_data_manager_get_journal_writer (manager);
+	if (!writer)
+		return NULL;
+
+	/* Not worth it until the tail costs more to replay than
+	 * the snapshot would.
+	 */
+	tail_size = tracker_db_journal_get_tail_size (writer, &snapshot_size);
+	if (tail_size < MAX (min_tail_size, snapshot_size))
+		return NULL;
+
+	iface = tracker_db_manager_create_reader_db_interface (tracker_data_manager_get_db_manager (manager),
+	                                                       error);
+	if (!iface)
+		return NULL;
+
+	/* The first read in the transaction pins what it sees,
+	 * updates done after this point are left for the tail.
+	 */
+	tracker_db_interface_execute_query (iface, &inner_error, "BEGIN");
+
+	if (!inner_error) {
+		cursor = start_cursor (iface, &inner_error, "SELECT MAX(ID) FROM Resource");
+
+		if (cursor) {
+			while (tracker_db_cursor_iter_next (cursor, NULL, &inner_error))
+				;
+			g_object_unref (cursor);
+		}
+	}
+
+	if (!inner_error)
+		tracker_db_journal_rotate_now (writer, &chunk, &inner_error);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		g_object_unref (iface);
+		return NULL;
+	}
+
+	compaction = g_new0 (TrackerDataCompaction, 1);
+	compaction->manager = g_object_ref (manager);
+	compaction->iface = iface;
+	compaction->chunk = chunk;
+	compaction->time = time (NULL);
+	compaction->start_time = g_get_monotonic_time ();
+
+	return compaction;
+}
+
+gboolean
+tracker_data_compaction_run (TrackerDataCompaction  *compaction,
+                             GCancellable           *cancellable,
+                             GError                **error)
+{
+	SnapshotDump dump = { 0 };
+	GError *inner_error = NULL;
+	GFile *data_location;
+	gint64 start_time;
+
+	g_return_val_if_fail (compaction->iface != NULL, FALSE);
+
+	start_time = g_get_monotonic_time ();
+
+	data_location = tracker_data_manager_get_data_location (compaction->manager);
+	dump.writer = tracker_db_journal_snapshot_new (data_location, compaction->chunk, error);
+	g_object_unref (data_location);
+
+	if (!dump.writer)
+		return FALSE;
+
+	dump.compaction = compaction;
+	dump.cancellable = cancellable;
+	dump.damaged = g_hash_table_new (NULL, NULL);
+	dump.own_graph_id = tracker_data_query_resource_id (compaction->manager,
+	                                                    compaction->iface,
+	                                                    TRACKER_OWN_GRAPH_URN);
+	dump.ontology_ids = load_ontology_ids (compaction->manager, &inner_error);
+
+	if (dump.ontology_ids &&
+	    dump_resources (&dump, &inner_error) &&
+	    dump_types (&dump, &inner_error) &&
+	    dump_properties (&dump, &inner_error) &&
+	    dump.in_transaction) {
+		dump.in_transaction = FALSE;
+		tracker_db_journal_commit_db_transaction (dump.writer, &inner_error);
+	}
+
+	g_clear_pointer (&dump.ontology_ids, g_hash_table_unref);
+	g_hash_table_unref (dump.damaged);
+
+	/* Let go of the snapshot of the database */
+	g_clear_object (&compaction->iface);
+
+	if (inner_error) {
+		if (dump.in_transaction)
+			tracker_db_journal_rollback_transaction (dump.writer);
+		tracker_db_journal_snapshot_discard (dump.writer);
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
+	if (!tracker_db_journal_snapshot_install (dump.writer, error))
+		return FALSE;
+
+	tracker_metric_observe (compaction_duration_metric (),
+	                        (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC);
+	g_info ("Journal compacted up to chunk %u, %" G_GUINT64_FORMAT " entries",
+	        compaction->chunk, dump.n_total);
+
+	return TRUE;
+}
+
+#else /* DISABLE_JOURNAL */
+
+TrackerDataCompaction *
+tracker_data_compaction_begin (TrackerDataManager  *manager,
+                               gsize                min_tail_size,
+                               GError             **error)
+{
+	/* Nothing to compact */
+	return NULL;
+}
+
+gboolean
+tracker_data_compaction_run (TrackerDataCompaction  *compaction,
+                             GCancellable           *cancellable,
+                             GError                **error)
+{
+	g_return_val_if_reached (FALSE);
+}
+
+#endif /* DISABLE_JOURNAL */
+
+void
+tracker_data_compaction_free (TrackerDataCompaction *compaction)
+{
+	g_clear_object (&compaction->iface);
+	g_object_unref (compaction->manager);
+	g_free (compaction);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_DATA_COMPACTION_H__
+#define __LIBTRACKER_DATA_COMPACTION_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data-manager.h>
+
+G_BEGIN_DECLS
+
+#if !defined (__LIBTRACKER_DATA_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "only <libtracker-data/tracker-data.h> must be included directly."
+#endif
+
+typedef struct _TrackerDataCompaction TrackerDataCompaction;
+
+TrackerDataCompaction *
+         tracker_data_compaction_begin (TrackerDataManager     *manager,
+                                        gsize                   min_tail_size,
+                                        GError                **error);
+gboolean tracker_data_compaction_run   (TrackerDataCompaction  *compaction,
+                                        GCancellable           *cancellable,
+                                        GError                **error);
+void     tracker_data_compaction_free  (TrackerDataCompaction  *compaction);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_DATA_COMPACTION_H__ */
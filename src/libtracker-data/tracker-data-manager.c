@@ -35,6 +35,7 @@
 #endif
 
 #include <libtracker-common/tracker-locale.h>
+#include <libtracker-common/tracker-metrics.h>
 
 #include "tracker-class.h"
 #include "tracker-data-manager.h"
@@ -65,6 +66,11 @@
 
 #define ZLIBBUFSIZ 8192
 
+/* Read-only managers don't run ANALYZE themselves, they pick up
+ * the estimates refreshed by the writer this often.
+ */
+#define TABLE_STATS_MAX_AGE (10 * 60 * G_USEC_PER_SEC)
+
 struct _TrackerDataManager {
 	GObject parent_instance;
 
@@ -90,6 +96,24 @@ struct _TrackerDataManager {
 	TrackerOntologies *ontologies;
 	TrackerData *data_update;
 
+	/* Incremental garbage collection state */
+	gint gc_last_id;
+	gint gc_max_id;
+	gboolean gc_analyzed;
+	gboolean gc_vacuum_checked;
+	gboolean incremental_vacuum;
+
+	/* Row estimates read from sqlite_stat1, keyed by "table" for
+	 * the row count and "table.column" for the rows per value of
+	 * indexed columns.
+	 */
+	GMutex stats_mutex;
+	GHashTable *table_stats;
+	gint64 table_stats_time;
+
+	/* Whether the ClassCount table holds the instance counts */
+	gboolean has_class_counts;
+
 	gchar *status;
 };
 
@@ -143,6 +167,7 @@ G_DEFINE_TYPE_WITH_CODE (TrackerDataManager, tracker_data_manager, G_TYPE_OBJECT
 static void
 tracker_data_manager_init (TrackerDataManager *manager)
 {
+	g_mutex_init (&manager->stats_mutex);
 }
 
 GQuark
@@ -2898,6 +2923,12 @@ schedule_copy (GPtrArray *schedule,
 	g_ptr_array_add (schedule, sched);
 }
 
+/* Triggers don't touch the Resource table themselves, SparqlRefcount()
+ * accumulates the deltas in memory, which are applied in a single
+ * batch by tracker_data_commit_transaction(). The function only exists
+ * in our own connections, so the triggers are TEMP ones, living in the
+ * writable connection only, and never stored in the database.
+ */
 static void
 create_insert_delete_triggers (TrackerDBInterface  *iface,
                                const gchar         *table_name,
@@ -2911,7 +2942,7 @@ create_insert_delete_triggers (TrackerDBInterface  *iface,
 
 	/* Insert trigger */
 	tracker_db_interface_execute_query (iface, &internal_error,
-	                                    "DROP TRIGGER IF EXISTS \"trigger_insert_%s\" ",
+	                                    "DROP TRIGGER IF EXISTS temp.\"trigger_insert_%s\" ",
 	                                    table_name);
 	if (internal_error) {
 		g_propagate_error (error, internal_error);
@@ -2920,15 +2951,13 @@ create_insert_delete_triggers (TrackerDBInterface  *iface,
 
 	trigger_query = g_string_new (NULL);
 	g_string_append_printf (trigger_query,
-	                        "CREATE TRIGGER \"trigger_insert_%s\" "
+	                        "CREATE TEMP TRIGGER \"trigger_insert_%s\" "
 	                        "AFTER INSERT ON \"%s\" "
 	                        "FOR EACH ROW BEGIN ",
 	                        table_name, table_name);
 	for (i = 0; i < n_properties; i++) {
 		g_string_append_printf (trigger_query,
-		                        "UPDATE Resource "
-		                        "SET Refcount = Refcount + 1 "
-		                        "WHERE Resource.rowid = NEW.\"%s\"; ",
+		                        "SELECT SparqlRefcount (NEW.\"%s\", 1); ",
 		                        properties[i]);
 	}
 
@@ -2944,7 +2973,7 @@ create_insert_delete_triggers (TrackerDBInterface  *iface,
 
 	/* Delete trigger */
 	tracker_db_interface_execute_query (iface, &internal_error,
-	                                    "DROP TRIGGER IF EXISTS \"trigger_delete_%s\" ",
+	                                    "DROP TRIGGER IF EXISTS temp.\"trigger_delete_%s\" ",
 	                                    table_name);
 	if (internal_error) {
 		g_propagate_error (error, internal_error);
@@ -2953,15 +2982,13 @@ create_insert_delete_triggers (TrackerDBInterface  *iface,
 
 	trigger_query = g_string_new (NULL);
 	g_string_append_printf (trigger_query,
-	                        "CREATE TRIGGER \"trigger_delete_%s\" "
+	                        "CREATE TEMP TRIGGER \"trigger_delete_%s\" "
 	                        "AFTER DELETE ON \"%s\" "
 	                        "FOR EACH ROW BEGIN ",
 	                        table_name, table_name);
 	for (i = 0; i < n_properties; i++) {
 		g_string_append_printf (trigger_query,
-		                        "UPDATE Resource "
-		                        "SET Refcount = Refcount - 1 "
-		                        "WHERE Resource.rowid = OLD.\"%s\"; ",
+		                        "SELECT SparqlRefcount (OLD.\"%s\", -1); ",
 		                        properties[i]);
 	}
 
@@ -3028,7 +3055,7 @@ create_table_triggers (TrackerDataManager  *manager,
 		}
 
 		tracker_db_interface_execute_query (iface, &internal_error,
-		                                    "DROP TRIGGER IF EXISTS \"trigger_update_%s_%s\"",
+		                                    "DROP TRIGGER IF EXISTS temp.\"trigger_update_%s_%s\"",
 		                                    tracker_class_get_name (klass),
 		                                    property_name);
 		if (internal_error) {
@@ -3039,11 +3066,11 @@ create_table_triggers (TrackerDataManager  *manager,
 		}
 
 		tracker_db_interface_execute_query (iface, &internal_error,
-		                                    "CREATE TRIGGER \"trigger_update_%s_%s\" "
+		                                    "CREATE TEMP TRIGGER \"trigger_update_%s_%s\" "
 		                                    "AFTER UPDATE OF \"%s\" ON \"%s\" "
 		                                    "FOR EACH ROW BEGIN "
-		                                    "UPDATE Resource SET Refcount = Refcount + 1 WHERE Resource.rowid = NEW.\"%s\";"
-		                                    "UPDATE Resource SET Refcount = Refcount - 1 WHERE Resource.rowid = OLD.\"%s\";"
+		                                    "SELECT SparqlRefcount (NEW.\"%s\", 1);"
+		                                    "SELECT SparqlRefcount (OLD.\"%s\", -1);"
 		                                    "END",
 		                                    tracker_class_get_name (klass),
 		                                    property_name,
@@ -3071,6 +3098,79 @@ create_table_triggers (TrackerDataManager  *manager,
 	}
 }
 
+/* Creates the refcount triggers for all classes on the writable
+ * connection. Databases from older versions store triggers updating
+ * the Resource table on every row, those are dropped first.
+ */
+static void
+create_refcount_triggers (TrackerDataManager  *manager,
+                          TrackerDBInterface  *iface,
+                          GError             **error)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor = NULL;
+	TrackerClass **classes;
+	GError *internal_error = NULL;
+	GPtrArray *stored_triggers;
+	guint i, n_classes;
+
+	stored_triggers = g_ptr_array_new_with_free_func (g_free);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              &internal_error,
+	                                              "SELECT name FROM main.sqlite_master "
+	                                              "WHERE type = 'trigger' AND sql LIKE '%%Refcount%%'");
+	if (stmt) {
+		cursor = tracker_db_statement_start_cursor (stmt, &internal_error);
+		g_object_unref (stmt);
+	}
+
+	if (cursor) {
+		while (tracker_db_cursor_iter_next (cursor, NULL, &internal_error)) {
+			g_ptr_array_add (stored_triggers,
+			                 g_strdup (tracker_db_cursor_get_string (cursor, 0, NULL)));
+		}
+
+		g_object_unref (cursor);
+	}
+
+	if (internal_error) {
+		g_ptr_array_unref (stored_triggers);
+		g_propagate_error (error, internal_error);
+		return;
+	}
+
+	tracker_db_interface_start_transaction (iface);
+
+	if (stored_triggers->len > 0) {
+		g_info ("Dropping stored Resource refcount triggers");
+	}
+
+	for (i = 0; i < stored_triggers->len; i++) {
+		tracker_db_interface_execute_query (iface, &internal_error,
+		                                    "DROP TRIGGER main.\"%s\"",
+		                                    (gchar *) g_ptr_array_index (stored_triggers, i));
+		if (internal_error)
+			break;
+	}
+
+	g_ptr_array_unref (stored_triggers);
+
+	classes = tracker_ontologies_get_classes (manager->ontologies, &n_classes);
+
+	for (i = 0; !internal_error && i < n_classes; i++) {
+		create_table_triggers (manager, iface, classes[i], &internal_error);
+	}
+
+	if (internal_error) {
+		tracker_db_interface_execute_query (iface, NULL, "ROLLBACK");
+		g_propagate_error (error, internal_error);
+		return;
+	}
+
+	tracker_db_interface_end_db_transaction (iface, error);
+}
+
 static void
 create_decomposed_metadata_tables (TrackerDataManager  *manager,
                                    TrackerDBInterface  *iface,
@@ -3670,6 +3770,139 @@ create_base_tables (TrackerDataManager  *manager,
 	return TRUE;
 }
 
+static gboolean
+create_class_count_table (TrackerDataManager  *manager,
+                          TrackerDBInterface  *iface,
+                          GError             **error)
+{
+	TrackerClass **classes;
+	GError *internal_error = NULL;
+	guint i, n_classes;
+
+	g_info ("Creating class count table");
+
+	tracker_db_interface_start_transaction (iface);
+
+	tracker_db_interface_execute_query (iface, &internal_error,
+	                                    "CREATE TABLE ClassCount (ID INTEGER NOT NULL PRIMARY KEY,"
+	                                    " Count INTEGER NOT NULL)");
+
+	classes = tracker_ontologies_get_classes (manager->ontologies, &n_classes);
+
+	for (i = 0; i < n_classes && !internal_error; i++) {
+		const gchar *name = tracker_class_get_name (classes[i]);
+
+		/* xsd classes do not derive from rdfs:Resource and do not use separate tables */
+		if (g_str_has_prefix (name, "xsd:"))
+			continue;
+
+		tracker_db_interface_execute_query (iface, &internal_error,
+		                                    "INSERT INTO ClassCount (ID, Count) "
+		                                    "SELECT %d, COUNT(1) FROM \"%s\"",
+		                                    tracker_class_get_id (classes[i]),
+		                                    name);
+	}
+
+	if (internal_error) {
+		tracker_db_interface_execute_query (iface, NULL, "ROLLBACK");
+		g_propagate_error (error, internal_error);
+		return FALSE;
+	}
+
+	return tracker_db_interface_end_db_transaction (iface, error);
+}
+
+/* Loads the instance counts of every class, these are kept up to date
+ * by tracker_data_commit_transaction() afterwards.
+ */
+static gboolean
+load_class_counts (TrackerDataManager  *manager,
+                   TrackerDBInterface  *iface,
+                   gboolean             read_only,
+                   GError             **error)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor = NULL;
+	TrackerClass **classes;
+	GHashTable *counts;
+	GError *internal_error = NULL;
+	guint i, n_classes;
+
+	if (!query_table_exists (iface, "ClassCount", &internal_error)) {
+		if (internal_error) {
+			g_propagate_error (error, internal_error);
+			return FALSE;
+		}
+
+		/* Databases from older versions are counted once by
+		 * the first writer opening them.
+		 */
+		if (read_only)
+			return TRUE;
+
+		if (!create_class_count_table (manager, iface, error))
+			return FALSE;
+	}
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              &internal_error,
+	                                              "SELECT ID, Count FROM ClassCount");
+	if (stmt) {
+		cursor = tracker_db_statement_start_cursor (stmt, &internal_error);
+		g_object_unref (stmt);
+	}
+
+	if (internal_error) {
+		g_propagate_error (error, internal_error);
+		return FALSE;
+	}
+
+	counts = g_hash_table_new (NULL, NULL);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &internal_error)) {
+		g_hash_table_insert (counts,
+		                     GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 0)),
+		                     GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 1)));
+	}
+
+	g_object_unref (cursor);
+
+	if (internal_error) {
+		g_hash_table_unref (counts);
+		g_propagate_error (error, internal_error);
+		return FALSE;
+	}
+
+	classes = tracker_ontologies_get_classes (manager->ontologies, &n_classes);
+
+	for (i = 0; i < n_classes; i++) {
+		gint id = tracker_class_get_id (classes[i]);
+
+		tracker_class_set_count (classes[i],
+		                         GPOINTER_TO_INT (g_hash_table_lookup (counts, GINT_TO_POINTER (id))));
+	}
+
+	g_hash_table_unref (counts);
+	manager->has_class_counts = TRUE;
+
+	return TRUE;
+}
+
+/**
+ * tracker_data_manager_has_class_counts:
+ * @manager: a #TrackerDataManager
+ *
+ * Returns: %TRUE if the database keeps the instance count of every
+ *   class in the ClassCount table.
+ **/
+gboolean
+tracker_data_manager_has_class_counts (TrackerDataManager *manager)
+{
+	g_return_val_if_fail (TRACKER_IS_DATA_MANAGER (manager), FALSE);
+
+	return manager->has_class_counts;
+}
+
 static void
 tracker_data_ontology_import_into_db (TrackerDataManager  *manager,
                                       gboolean             in_update,
@@ -3998,8 +4231,9 @@ rebuild_fts_tokens (TrackerDataManager *manager,
 	tracker_db_interface_sqlite_fts_rebuild_tokens (iface);
 	g_debug ("FTS tokens rebuilt");
 
-	/* Update the stamp file */
+	/* Update the stamp files */
 	tracker_db_manager_tokenizer_update (manager->db_manager);
+	tracker_db_manager_set_fts_rebuild_pending (manager->db_manager, FALSE);
 }
 #endif
 
@@ -4346,6 +4580,22 @@ tracker_data_manager_initable_init (GInitable     *initable,
 				return FALSE;
 			}
 
+			/* Everything below may update the database */
+			create_refcount_triggers (manager, iface, &internal_error);
+
+			if (internal_error) {
+				g_propagate_error (error, internal_error);
+				return FALSE;
+			}
+
+			/* Ontology changes below insert classes and properties,
+			 * their counts must be up to date before those commit.
+			 */
+			if (!load_class_counts (manager, iface, FALSE, &internal_error)) {
+				g_propagate_error (error, internal_error);
+				return FALSE;
+			}
+
 			write_ontologies_gvdb (manager, FALSE /* overwrite */, NULL);
 
 			/* Skipped in the read-only case as it can't work with direct access and
@@ -4815,7 +5065,10 @@ skip_ontology_check:
 
 #if HAVE_TRACKER_FTS
 		rebuild_fts_tokens (manager, iface);
-	} else if (!read_only && tracker_db_manager_get_tokenizer_changed (manager->db_manager)) {
+	} else if (!read_only &&
+	           (tracker_db_manager_get_tokenizer_changed (manager->db_manager) ||
+	            tracker_db_manager_get_fts_rebuild_pending (manager->db_manager))) {
+		/* The latter if stopped during a bulk import deferring FTS */
 		rebuild_fts_tokens (manager, iface);
 #endif
 	}
@@ -4827,6 +5080,13 @@ skip_ontology_check:
 	}
 #endif /* DISABLE_JOURNAL */
 
+	/* New databases are counted once populated */
+	if (!manager->has_class_counts &&
+	    !load_class_counts (manager, iface, read_only, &internal_error)) {
+		g_propagate_error (error, internal_error);
+		return FALSE;
+	}
+
 	if (!read_only) {
 		tracker_ontologies_sort (manager->ontologies);
 	}
@@ -4839,8 +5099,9 @@ skip_ontology_check:
 	return TRUE;
 }
 
-static gboolean
-data_manager_check_perform_cleanup (TrackerDataManager *manager)
+static guint
+data_manager_get_count (TrackerDataManager *manager,
+                        const gchar        *query)
 {
 	TrackerDBStatement *stmt;
 	TrackerDBInterface *iface;
@@ -4849,7 +5110,7 @@ data_manager_check_perform_cleanup (TrackerDataManager *manager)
 
 	iface = tracker_db_manager_get_writable_db_interface (manager->db_manager);
 	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
-	                                              NULL, "SELECT COUNT(*) FROM Graph");
+	                                              NULL, "%s", query);
 	if (stmt) {
 		cursor = tracker_db_statement_start_cursor (stmt, NULL);
 		g_object_unref (stmt);
@@ -4860,74 +5121,364 @@ data_manager_check_perform_cleanup (TrackerDataManager *manager)
 
 	g_clear_object (&cursor);
 
-	/* We need to be sure the data is coherent, so we'll refrain from
-	 * doing any clean ups till there are elements in the Graph table.
-	 *
-	 * A database that's been freshly updated to the refcounted
-	 * resources will have an empty Graph table, so we might
-	 * unintentionally delete graph URNs if we clean up in this state.
+	return count;
+}
+
+static gboolean
+data_manager_collect_garbage (TrackerDataManager  *manager,
+                              guint                n_ids,
+                              GError             **error)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBInterface *iface;
+	gint first_id, last_id;
+
+	if (manager->gc_max_id == 0) {
+		/* Starting a new pass. We need to be sure the data is
+		 * coherent, so we'll refrain from doing any clean ups till
+		 * there are elements in the Graph table.
+		 *
+		 * A database that's been freshly updated to the refcounted
+		 * resources will have an empty Graph table, so we might
+		 * unintentionally delete graph URNs if we clean up in this
+		 * state.
+		 */
+		if (data_manager_get_count (manager, "SELECT COUNT(*) FROM Graph") == 0)
+			return FALSE;
+
+		manager->gc_max_id = data_manager_get_count (manager, "SELECT MAX(ID) FROM Resource");
+		manager->gc_last_id = TRACKER_ONTOLOGIES_MAX_ID;
+		manager->gc_analyzed = FALSE;
+		manager->gc_vacuum_checked = FALSE;
+	}
+
+	if (manager->gc_last_id >= manager->gc_max_id)
+		return FALSE;
+
+	first_id = manager->gc_last_id + 1;
+	last_id = MIN (manager->gc_max_id, manager->gc_last_id + (gint) n_ids);
+
+	iface = tracker_db_manager_get_writable_db_interface (manager->db_manager);
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                              error,
+	                                              "DELETE FROM Resource WHERE ID >= ? AND ID <= ? "
+	                                              "AND Refcount <= 0 AND ID NOT IN (SELECT ID FROM Graph)");
+	if (!stmt)
+		return FALSE;
+
+	tracker_db_statement_bind_int (stmt, 0, first_id);
+	tracker_db_statement_bind_int (stmt, 1, last_id);
+	tracker_db_statement_execute (stmt, error);
+	g_object_unref (stmt);
+
+	if (error && *error)
+		return FALSE;
+
+	tracker_metric_add (tracker_metrics_counter ("tracker_data_gc_resources_deleted_total", NULL,
+	                                             "Unreferenced resources deleted by maintenance"),
+	                    tracker_db_interface_sqlite_get_n_changes (iface));
+
+	manager->gc_last_id = last_id;
+
+	return TRUE;
+}
+
+static gboolean
+data_manager_analyze (TrackerDataManager  *manager,
+                      GError             **error)
+{
+	TrackerDBInterface *iface;
+	GError *inner_error = NULL;
+
+	iface = tracker_db_manager_get_writable_db_interface (manager->db_manager);
+
+	/* Sample big indexes instead of reading them whole, this is
+	 * ignored by SQLite versions without the pragma.
 	 */
-	if (count == 0)
+	tracker_db_interface_execute_query (iface, NULL, "PRAGMA analysis_limit = 1000");
+	tracker_db_interface_execute_query (iface, &inner_error, "ANALYZE");
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
 		return FALSE;
+	}
+
+	/* Reload on next use */
+	g_mutex_lock (&manager->stats_mutex);
+	g_clear_pointer (&manager->table_stats, g_hash_table_unref);
+	g_mutex_unlock (&manager->stats_mutex);
+
+	return TRUE;
+}
+
+static gchar *
+data_manager_get_index_column (TrackerDBInterface *iface,
+                               const gchar        *index)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor = NULL;
+	gchar *column = NULL;
 
-	count = 0;
-	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, NULL,
-	                                              "SELECT COUNT(*) FROM Resource WHERE Refcount <= 0 "
-	                                              "AND Resource.ID > %d AND Resource.ID NOT IN (SELECT ID FROM Graph)",
-	                                              TRACKER_ONTOLOGIES_MAX_ID);
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              NULL, "PRAGMA index_info (\"%s\")", index);
 	if (stmt) {
 		cursor = tracker_db_statement_start_cursor (stmt, NULL);
 		g_object_unref (stmt);
 	}
 
-	if (cursor && tracker_db_cursor_iter_next (cursor, NULL, NULL))
-		count = tracker_db_cursor_get_int (cursor, 0);
+	while (cursor && tracker_db_cursor_iter_next (cursor, NULL, NULL)) {
+		if (tracker_db_cursor_get_int (cursor, 0) == 0) {
+			column = g_strdup (tracker_db_cursor_get_string (cursor, 2, NULL));
+			break;
+		}
+	}
 
 	g_clear_object (&cursor);
 
-	return count > 0;
+	return column;
 }
 
-void
-tracker_data_manager_dispose (GObject *object)
+static GHashTable *
+data_manager_load_table_stats (TrackerDataManager *manager)
 {
-	TrackerDataManager *manager = TRACKER_DATA_MANAGER (object);
 	TrackerDBStatement *stmt;
 	TrackerDBInterface *iface;
-	GError *error = NULL;
-	gboolean readonly = TRUE;
+	TrackerDBCursor *cursor = NULL;
+	GHashTable *stats;
+
+	stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	/* The table only exists once ANALYZE ran */
+	iface = tracker_data_manager_get_db_interface (manager);
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              NULL, "SELECT tbl, idx, stat FROM sqlite_stat1");
+	if (stmt) {
+		cursor = tracker_db_statement_start_cursor (stmt, NULL);
+		g_object_unref (stmt);
+	}
 
-	if (manager->db_manager) {
-		readonly = (tracker_db_manager_get_flags (manager->db_manager, NULL, NULL) & TRACKER_DB_MANAGER_READONLY) != 0;
+	while (cursor && tracker_db_cursor_iter_next (cursor, NULL, NULL)) {
+		const gchar *table, *index, *stat;
+		gdouble *value;
+		gchar **values;
+		gchar *column;
 
-		if (!readonly && data_manager_check_perform_cleanup (manager)) {
-			/* Delete stale URIs in the Resource table */
-			g_debug ("Cleaning up stale resource URIs");
+		table = tracker_db_cursor_get_string (cursor, 0, NULL);
+		index = tracker_db_cursor_get_string (cursor, 1, NULL);
+		stat = tracker_db_cursor_get_string (cursor, 2, NULL);
 
-			iface = tracker_db_manager_get_writable_db_interface (manager->db_manager);
-			stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
-			                                              &error,
-			                                              "DELETE FROM Resource WHERE Refcount <= 0 "
-			                                              "AND Resource.ID > %d AND Resource.ID NOT IN (SELECT ID FROM Graph)",
-			                                              TRACKER_ONTOLOGIES_MAX_ID);
+		if (!table || !stat)
+			continue;
 
-			if (stmt) {
-				tracker_db_statement_execute (stmt, &error);
-				g_object_unref (stmt);
-			}
+		/* "rows rows-per-first-column ..." */
+		values = g_strsplit (stat, " ", -1);
 
-			if (error) {
-				g_warning ("Could not clean up stale resource URIs: %s\n",
-				           error->message);
-				g_clear_error (&error);
+		if (!g_hash_table_contains (stats, table)) {
+			value = g_new (gdouble, 1);
+			*value = g_ascii_strtod (values[0], NULL);
+			g_hash_table_insert (stats, g_strdup (table), value);
+		}
+
+		if (index && values[0] && values[1]) {
+			column = data_manager_get_index_column (iface, index);
+
+			if (column) {
+				value = g_new (gdouble, 1);
+				*value = g_ascii_strtod (values[1], NULL);
+				g_hash_table_insert (stats,
+				                     g_strdup_printf ("%s.%s", table, column),
+				                     value);
+				g_free (column);
 			}
+		}
+
+		g_strfreev (values);
+	}
+
+	g_clear_object (&cursor);
+
+	return stats;
+}
+
+/**
+ * tracker_data_manager_get_table_estimate:
+ * @manager: a #TrackerDataManager
+ * @table: name of a database table
+ * @column: (nullable): name of a column in @table
+ * @n_rows: (out): number of rows in @table
+ * @rows_per_value: (out): average number of rows sharing a value in
+ *   @column, or -1 if @column is not the first column of an index
+ *
+ * Looks up the row estimates gathered by the last ANALYZE, which
+ * runs at the end of every maintenance pass. Read-only managers
+ * reload them periodically.
+ *
+ * Returns: %TRUE if there are estimates for @table.
+ **/
+gboolean
+tracker_data_manager_get_table_estimate (TrackerDataManager *manager,
+                                         const gchar        *table,
+                                         const gchar        *column,
+                                         gdouble            *n_rows,
+                                         gdouble            *rows_per_value)
+{
+	gdouble *value;
+	gboolean found = FALSE;
+
+	g_return_val_if_fail (TRACKER_IS_DATA_MANAGER (manager), FALSE);
+	g_return_val_if_fail (table != NULL, FALSE);
+
+	*n_rows = -1;
+	*rows_per_value = -1;
+
+	g_mutex_lock (&manager->stats_mutex);
+
+	if (manager->table_stats &&
+	    (manager->flags & TRACKER_DB_MANAGER_READONLY) != 0 &&
+	    g_get_monotonic_time () - manager->table_stats_time > TABLE_STATS_MAX_AGE)
+		g_clear_pointer (&manager->table_stats, g_hash_table_unref);
+
+	if (!manager->table_stats) {
+		manager->table_stats = data_manager_load_table_stats (manager);
+		manager->table_stats_time = g_get_monotonic_time ();
+	}
+
+	value = g_hash_table_lookup (manager->table_stats, table);
+
+	if (value) {
+		*n_rows = *value;
+		found = TRUE;
+
+		if (column) {
+			gchar *key = g_strdup_printf ("%s.%s", table, column);
+
+			value = g_hash_table_lookup (manager->table_stats, key);
+			if (value)
+				*rows_per_value = *value;
+			g_free (key);
+		}
+	}
+
+	g_mutex_unlock (&manager->stats_mutex);
+
+	return found;
+}
+
+/**
+ * tracker_data_manager_maintenance_step:
+ * @manager: a #TrackerDataManager
+ * @n_ids: number of resource IDs to check for references
+ * @n_pages: number of free pages to give back to the filesystem
+ * @progress: (out) (optional): progress of the current pass, from 0 to 1
+ * @error: return location for a #GError
+ *
+ * Performs one bounded step of database maintenance, deleting
+ * unreferenced resources in the next ID range, or once a whole pass
+ * over the Resource table is done, reclaiming free pages and then
+ * refreshing the query planner statistics. Databases created by older
+ * versions are converted to incremental vacuuming in a step of their
+ * own before any space is reclaimed. This must not be called while an
+ * update transaction is ongoing.
+ *
+ * Returns: %TRUE if there is more work left for this pass.
+ **/
+gboolean
+tracker_data_manager_maintenance_step (TrackerDataManager  *manager,
+                                       guint                n_ids,
+                                       guint                n_pages,
+                                       gdouble             *progress,
+                                       GError             **error)
+{
+	GError *inner_error = NULL;
+	gboolean more_work;
+	gint n_free = 0;
+
+	g_return_val_if_fail (TRACKER_IS_DATA_MANAGER (manager), FALSE);
+
+	if (progress)
+		*progress = 1;
+
+	if ((manager->flags & TRACKER_DB_MANAGER_READONLY) != 0)
+		return FALSE;
+
+	more_work = data_manager_collect_garbage (manager, n_ids, &inner_error);
+
+	if (inner_error) {
+		manager->gc_max_id = 0;
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
+	if (more_work) {
+		if (progress)
+			*progress = 0.5 * (manager->gc_last_id - TRACKER_ONTOLOGIES_MAX_ID) /
+				MAX (1, manager->gc_max_id - TRACKER_ONTOLOGIES_MAX_ID);
+		return TRUE;
+	}
+
+	/* Checked once per pass until converted, as the filesystem
+	 * may not have had room for it the last time.
+	 */
+	if (!manager->incremental_vacuum && !manager->gc_vacuum_checked) {
+		manager->gc_vacuum_checked = TRUE;
 
-			tracker_db_manager_check_perform_vacuum (manager->db_manager);
+		if (!tracker_db_manager_check_perform_vacuum (manager->db_manager,
+		                                              &manager->incremental_vacuum,
+		                                              error)) {
+			manager->gc_max_id = 0;
+			return FALSE;
 		}
+	}
+
+	/* Free pages can't be given back without incremental vacuuming */
+	if (manager->incremental_vacuum) {
+		n_free = tracker_db_manager_incremental_vacuum (manager->db_manager,
+		                                                n_pages, error);
+		if (n_free < 0) {
+			manager->gc_max_id = 0;
+			return FALSE;
+		}
+
+		tracker_metric_set (tracker_metrics_gauge ("tracker_data_free_pages", NULL,
+		                                           "Free pages left in the database file"),
+		                    n_free);
+	}
+
+	if (n_free > 0 && progress) {
+		/* The second half is spent reclaiming space, total pages
+		 * are unknown upfront so approach completion gradually.
+		 */
+		*progress = 1 - 0.5 * n_free / (n_free + n_pages);
+	}
+
+	if (n_free == 0 && !manager->gc_analyzed) {
+		manager->gc_analyzed = TRUE;
 
-		g_clear_pointer (&manager->db_manager, tracker_db_manager_free);
+		if (!data_manager_analyze (manager, error)) {
+			manager->gc_max_id = 0;
+			return FALSE;
+		}
 	}
 
+	if (n_free > 0)
+		return TRUE;
+
+	/* Pass done, the next step starts over */
+	manager->gc_max_id = 0;
+
+	return FALSE;
+}
+
+void
+tracker_data_manager_dispose (GObject *object)
+{
+	TrackerDataManager *manager = TRACKER_DATA_MANAGER (object);
+
+	/* Stale resources and free pages are dealt with by
+	 * tracker_data_manager_maintenance_step() while idle.
+	 */
+	g_clear_pointer (&manager->db_manager, tracker_db_manager_free);
+
 	G_OBJECT_CLASS (tracker_data_manager_parent_class)->finalize (object);
 }
 
@@ -4960,6 +5511,8 @@ tracker_data_manager_finalize (GObject *object)
 
 	g_clear_object (&manager->ontologies);
 	g_clear_object (&manager->data_update);
+	g_clear_pointer (&manager->table_stats, g_hash_table_unref);
+	g_mutex_clear (&manager->stats_mutex);
 
 	G_OBJECT_CLASS (tracker_data_manager_parent_class)->finalize (object);
 }
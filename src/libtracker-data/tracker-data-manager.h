@@ -88,6 +88,18 @@ gboolean tracker_data_manager_init_fts               (TrackerDBInterface     *in
 
 GHashTable *         tracker_data_manager_get_namespaces      (TrackerDataManager *manager);
 
+gboolean             tracker_data_manager_maintenance_step    (TrackerDataManager  *manager,
+                                                               guint                n_ids,
+                                                               guint                n_pages,
+                                                               gdouble             *progress,
+                                                               GError             **error);
+gboolean             tracker_data_manager_has_class_counts    (TrackerDataManager  *manager);
+gboolean             tracker_data_manager_get_table_estimate  (TrackerDataManager  *manager,
+                                                               const gchar         *table,
+                                                               const gchar         *column,
+                                                               gdouble             *n_rows,
+                                                               gdouble             *rows_per_value);
+
 G_END_DECLS
 
 #endif /* __LIBTRACKER_DATA_MANAGER_H__ */
@@ -159,6 +159,10 @@ struct _TrackerData {
 	gint max_ontology_id;
 
 	TrackerDBJournal *journal_writer;
+
+	/* FTS is rebuilt as a whole when leaving this mode */
+	gboolean fts_deferred;
+	gboolean fts_pending;
 };
 
 struct _TrackerDataClass {
@@ -1057,7 +1061,10 @@ tracker_data_resource_buffer_flush (TrackerData  *data,
 	}
 
 #if HAVE_TRACKER_FTS
-	if (data->resource_buffer->fts_updated) {
+	if (data->fts_deferred) {
+		if (data->resource_buffer->fts_updated)
+			data->fts_pending = TRUE;
+	} else if (data->resource_buffer->fts_updated) {
 		TrackerProperty *prop;
 		GArray *values;
 		GPtrArray *properties, *text;
@@ -1475,6 +1482,36 @@ check_property_domain (TrackerData     *data,
 	return FALSE;
 }
 
+static void
+append_cursor_values (TrackerProperty *property,
+                      TrackerDBCursor *cursor,
+                      GArray          *values)
+{
+	while (tracker_db_cursor_iter_next (cursor, NULL, NULL)) {
+		GValue gvalue = { 0 };
+
+		tracker_db_cursor_get_value (cursor, 0, &gvalue);
+
+		if (G_VALUE_TYPE (&gvalue)) {
+			if (tracker_property_get_data_type (property) == TRACKER_PROPERTY_TYPE_DATETIME) {
+				gdouble time;
+
+				if (G_VALUE_TYPE (&gvalue) == G_TYPE_INT64) {
+					time = g_value_get_int64 (&gvalue);
+				} else {
+					time = g_value_get_double (&gvalue);
+				}
+				g_value_unset (&gvalue);
+				g_value_init (&gvalue, TRACKER_TYPE_DATE_TIME);
+				/* UTC offset is irrelevant for comparison */
+				tracker_date_time_set (&gvalue, time, 0);
+			}
+
+			g_array_append_val (values, gvalue);
+		}
+	}
+}
+
 static GArray *
 get_property_values (TrackerData     *data,
                      TrackerProperty *property)
@@ -1517,34 +1554,54 @@ get_property_values (TrackerData     *data,
 		}
 
 		if (cursor) {
-			while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
-				GValue gvalue = { 0 };
+			append_cursor_values (property, cursor, old_values);
+			g_object_unref (cursor);
+		}
+	}
 
-				tracker_db_cursor_get_value (cursor, 0, &gvalue);
+	return old_values;
+}
 
-				if (G_VALUE_TYPE (&gvalue)) {
-					if (tracker_property_get_data_type (property) == TRACKER_PROPERTY_TYPE_DATETIME) {
-						gdouble time;
+static GArray *
+get_property_values_in_graph (TrackerData     *data,
+                              TrackerProperty *property,
+                              gint             graph_id)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor    *cursor = NULL;
+	GArray             *values;
+	GError             *error = NULL;
 
-						if (G_VALUE_TYPE (&gvalue) == G_TYPE_INT64) {
-							time = g_value_get_int64 (&gvalue);
-						} else {
-							time = g_value_get_double (&gvalue);
-						}
-						g_value_unset (&gvalue);
-						g_value_init (&gvalue, TRACKER_TYPE_DATE_TIME);
-						/* UTC offset is irrelevant for comparison */
-						tracker_date_time_set (&gvalue, time, 0);
-					}
+	values = g_array_new (FALSE, TRUE, sizeof (GValue));
+	g_array_set_clear_func (values, (GDestroyNotify) g_value_unset);
 
-					g_array_append_val (old_values, gvalue);
-				}
-			}
-			g_object_unref (cursor);
-		}
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT, &error,
+	                                              "SELECT \"%s\" FROM \"%s\" WHERE ID = ? AND \"%s:graph\" = ?",
+	                                              tracker_property_get_name (property),
+	                                              tracker_property_get_table_name (property),
+	                                              tracker_property_get_name (property));
+
+	if (stmt) {
+		tracker_db_statement_bind_int (stmt, 0, data->resource_buffer->id);
+		tracker_db_statement_bind_int (stmt, 1, graph_id);
+		cursor = tracker_db_statement_start_cursor (stmt, &error);
+		g_object_unref (stmt);
 	}
 
-	return old_values;
+	if (error) {
+		g_warning ("Could not get property values: %s\n", error->message);
+		g_error_free (error);
+	}
+
+	if (cursor) {
+		append_cursor_values (property, cursor, values);
+		g_object_unref (cursor);
+	}
+
+	return values;
 }
 
 static GArray *
@@ -1567,7 +1624,10 @@ get_old_property_values (TrackerData      *data,
 		}
 
 #if HAVE_TRACKER_FTS
-		if (tracker_property_get_fulltext_indexed (property)) {
+		if (tracker_property_get_fulltext_indexed (property) && data->fts_deferred) {
+			old_values = get_property_values (data, property);
+			data->resource_buffer->fts_updated = TRUE;
+		} else if (tracker_property_get_fulltext_indexed (property)) {
 			TrackerDBInterface *iface;
 
 			iface = tracker_data_manager_get_writable_db_interface (data->manager);
@@ -2228,7 +2288,10 @@ cache_delete_resource_type_full (TrackerData  *data,
 		if (strcmp (tracker_class_get_uri (class), TRACKER_PREFIX_RDFS "Resource") == 0 &&
 		    g_hash_table_size (data->resource_buffer->tables) == 0) {
 #if HAVE_TRACKER_FTS
-			tracker_db_interface_sqlite_fts_delete_id (iface, data->resource_buffer->id);
+			if (data->fts_deferred)
+				data->fts_pending = TRUE;
+			else
+				tracker_db_interface_sqlite_fts_delete_id (iface, data->resource_buffer->id);
 #endif
 			/* skip subclass query when deleting whole resource
 			   to improve performance */
@@ -3511,8 +3574,6 @@ tracker_data_begin_transaction (TrackerData  *data,
 
 	iface = tracker_data_manager_get_writable_db_interface (data->manager);
 
-	tracker_db_interface_execute_query (iface, NULL, "PRAGMA cache_size = %d", TRACKER_DB_CACHE_SIZE_UPDATE);
-
 	tracker_db_interface_start_transaction (iface);
 
 #ifndef DISABLE_JOURNAL
@@ -3548,15 +3609,91 @@ tracker_data_begin_transaction_for_replay (TrackerData  *data,
 	data->resource_time = time;
 }
 
+static void
+update_transaction_metrics (gboolean committed,
+                            gint64   start_time)
+{
+	static TrackerMetric *commits = NULL, *rollbacks = NULL, *commit_time = NULL;
+
+	if (g_once_init_enter (&commits)) {
+		rollbacks = tracker_metrics_counter ("tracker_data_transactions_total",
+		                                     "result=\"rollback\"",
+		                                     "Update transactions");
+		commit_time = tracker_metrics_histogram ("tracker_data_commit_duration_seconds",
+		                                         NULL,
+		                                         "Time spent committing update transactions",
+		                                         NULL, 0);
+		g_once_init_leave (&commits,
+		                   tracker_metrics_counter ("tracker_data_transactions_total",
+		                                            "result=\"commit\"",
+		                                            "Update transactions"));
+	}
+
+	if (committed) {
+		tracker_metric_add (commits, 1);
+		tracker_metric_observe (commit_time,
+		                        (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC);
+	} else {
+		tracker_metric_add (rollbacks, 1);
+	}
+}
+
+/* Persists the instance counts of the classes changed by this
+ * transaction, so they are available at startup without counting.
+ */
+static void
+tracker_data_flush_class_counts (TrackerData         *data,
+                                 TrackerDBInterface  *iface,
+                                 GError             **error)
+{
+	TrackerDBStatement *stmt;
+	GHashTableIter iter;
+	TrackerClass *class;
+	gpointer count_ptr;
+	GError *inner_error = NULL;
+
+	if (!data->update_buffer.class_counts ||
+	    g_hash_table_size (data->update_buffer.class_counts) == 0 ||
+	    !tracker_data_manager_has_class_counts (data->manager))
+		return;
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &inner_error,
+	                                              "INSERT OR REPLACE INTO ClassCount (ID, Count) VALUES (?, ?)");
+	if (!stmt) {
+		g_propagate_error (error, inner_error);
+		return;
+	}
+
+	g_hash_table_iter_init (&iter, data->update_buffer.class_counts);
+	while (g_hash_table_iter_next (&iter, (gpointer*) &class, &count_ptr)) {
+		if (GPOINTER_TO_INT (count_ptr) == 0)
+			continue;
+
+		tracker_db_statement_bind_int (stmt, 0, tracker_class_get_id (class));
+		tracker_db_statement_bind_int (stmt, 1, tracker_class_get_count (class));
+		tracker_db_statement_execute (stmt, &inner_error);
+
+		if (inner_error) {
+			g_propagate_error (error, inner_error);
+			break;
+		}
+	}
+
+	g_object_unref (stmt);
+}
+
 void
 tracker_data_commit_transaction (TrackerData  *data,
                                  GError      **error)
 {
 	TrackerDBInterface *iface;
 	GError *actual_error = NULL;
+	gint64 start_time;
 
 	g_return_if_fail (data->in_transaction);
 
+	start_time = g_get_monotonic_time ();
+
 	iface = tracker_data_manager_get_writable_db_interface (data->manager);
 
 	tracker_data_update_buffer_flush (data, &actual_error);
@@ -3566,6 +3703,20 @@ tracker_data_commit_transaction (TrackerData  *data,
 		return;
 	}
 
+	tracker_db_interface_sqlite_flush_refcounts (iface, &actual_error);
+	if (actual_error) {
+		tracker_data_rollback_transaction (data);
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
+	tracker_data_flush_class_counts (data, iface, &actual_error);
+	if (actual_error) {
+		tracker_data_rollback_transaction (data);
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
 	tracker_db_interface_end_db_transaction (iface,
 	                                         &actual_error);
 
@@ -3597,6 +3748,8 @@ tracker_data_commit_transaction (TrackerData  *data,
 	}
 #endif /* DISABLE_JOURNAL */
 
+	update_transaction_metrics (TRUE, start_time);
+
 	get_transaction_modseq (data);
 	if (data->has_persistent && !data->in_ontology_transaction) {
 		data->transaction_modseq++;
@@ -3618,8 +3771,6 @@ tracker_data_commit_transaction (TrackerData  *data,
 	}
 #endif
 
-	tracker_db_interface_execute_query (iface, NULL, "PRAGMA cache_size = %d", TRACKER_DB_CACHE_SIZE_DEFAULT);
-
 	g_hash_table_remove_all (data->update_buffer.resources);
 	g_hash_table_remove_all (data->update_buffer.resources_by_id);
 	g_hash_table_remove_all (data->update_buffer.resource_cache);
@@ -3644,12 +3795,15 @@ tracker_data_rollback_transaction (TrackerData *data)
 
 	g_return_if_fail (data->in_transaction);
 
+	update_transaction_metrics (FALSE, 0);
+
 	data->in_transaction = FALSE;
 	data->in_ontology_transaction = FALSE;
 
 	iface = tracker_data_manager_get_writable_db_interface (data->manager);
 
 	tracker_data_update_buffer_clear (data);
+	tracker_db_interface_sqlite_discard_refcounts (iface);
 
 	tracker_db_interface_execute_query (iface, &ignorable, "ROLLBACK");
 
@@ -3658,8 +3812,6 @@ tracker_data_rollback_transaction (TrackerData *data)
 		g_clear_error (&ignorable);
 	}
 
-	tracker_db_interface_execute_query (iface, NULL, "PRAGMA cache_size = %d", TRACKER_DB_CACHE_SIZE_DEFAULT);
-
 	/* Runtime false in case of DISABLE_JOURNAL */
 	if (!data->in_journal_replay) {
 
@@ -3733,6 +3885,236 @@ tracker_data_update_sparql_blank (TrackerData  *data,
 	return update_sparql (data, update, TRUE, error);
 }
 
+static void
+delete_all_types (TrackerData  *data,
+                  const gchar  *graph,
+                  const gchar  *subject,
+                  GError      **error)
+{
+	GPtrArray *classes;
+	GPtrArray *class_uris;
+	gint subject_id;
+	guint i;
+
+	subject_id = query_resource_id (data, subject);
+	if (subject_id == 0)
+		return;
+
+	classes = tracker_data_query_rdf_type (data->manager, subject_id);
+	if (!classes)
+		return;
+
+	/* Deleting a class may cascade, so take the URIs upfront */
+	class_uris = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < classes->len; i++) {
+		g_ptr_array_add (class_uris,
+		                 g_strdup (tracker_class_get_uri (g_ptr_array_index (classes, i))));
+	}
+	g_ptr_array_free (classes, TRUE);
+
+	for (i = 0; i < class_uris->len; i++) {
+		GError *inner_error = NULL;
+
+		tracker_data_delete_statement (data, graph, subject,
+		                               TRACKER_PREFIX_RDF "type",
+		                               g_ptr_array_index (class_uris, i),
+		                               &inner_error);
+		if (inner_error) {
+			g_propagate_error (error, inner_error);
+			break;
+		}
+	}
+
+	g_ptr_array_unref (class_uris);
+}
+
+/* Same effect as DELETE WHERE { [GRAPH <graph> {] <subject> <predicate> ?o [}] },
+ * which is what the SPARQL form of a resource uses to overwrite a property.
+ */
+static void
+delete_all_values (TrackerData  *data,
+                   const gchar  *graph,
+                   const gchar  *subject,
+                   const gchar  *predicate,
+                   GError      **error)
+{
+	TrackerOntologies *ontologies;
+	TrackerProperty *property;
+	GError *inner_error = NULL;
+	gint subject_id, graph_id;
+
+	ontologies = tracker_data_manager_get_ontologies (data->manager);
+	property = tracker_ontologies_get_property_by_uri (ontologies, predicate);
+
+	if (property == NULL) {
+		g_set_error (error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_UNKNOWN_PROPERTY,
+		             "Property '%s' not found in the ontology", predicate);
+		return;
+	}
+
+	/* The pattern is matched against prior statements, flush them */
+	tracker_data_update_buffer_flush (data, &inner_error);
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return;
+	}
+
+	subject_id = query_resource_id (data, subject);
+	if (subject_id == 0)
+		return;
+
+	resource_buffer_switch (data, graph, subject, subject_id);
+
+	/* The pattern has no solutions outside the property domain */
+	if (!check_property_domain (data, property))
+		return;
+
+	if (graph == NULL) {
+		delete_all_objects (data, NULL, subject, predicate, &inner_error);
+	} else {
+		GArray *values;
+
+		graph_id = query_resource_id (data, graph);
+		if (graph_id == 0)
+			return;
+
+		if (!tracker_property_get_transient (property))
+			data->has_persistent = TRUE;
+
+		values = get_property_values_in_graph (data, property, graph_id);
+
+		while (values->len > 0 && !inner_error) {
+			delete_first_object (data, property, values, graph, &inner_error);
+			g_array_remove_index (values, 0);
+		}
+
+		g_array_unref (values);
+	}
+
+	if (!inner_error)
+		tracker_data_update_buffer_flush (data, &inner_error);
+
+	if (inner_error)
+		g_propagate_error (error, inner_error);
+}
+
+static const gchar *
+map_blank_node (GHashTable  *blank_nodes,
+                const gchar *uri)
+{
+	gchar *urn;
+
+	if (strncmp (uri, "_:", 2) != 0)
+		return uri;
+
+	urn = g_hash_table_lookup (blank_nodes, uri);
+	if (!urn) {
+		urn = tracker_sparql_get_uuid_urn ();
+		g_hash_table_insert (blank_nodes, g_strdup (uri), urn);
+	}
+
+	return urn;
+}
+
+static void
+update_statements (TrackerData  *data,
+                   const gchar  *graph,
+                   GVariant     *statements,
+                   GHashTable   *blank_nodes,
+                   GError      **error)
+{
+	GVariantIter iter;
+	const gchar *subject, *predicate, *object;
+	guchar op;
+
+	g_variant_iter_init (&iter, statements);
+
+	while (g_variant_iter_next (&iter, "(y&s&s&s)", &op, &subject, &predicate, &object)) {
+		GError *inner_error = NULL;
+
+		subject = map_blank_node (blank_nodes, subject);
+
+		switch (op) {
+		case TRACKER_RESOURCE_STATEMENT_DELETE_ALL:
+			if (g_strcmp0 (predicate, TRACKER_PREFIX_RDF "type") == 0) {
+				delete_all_types (data, graph, subject, &inner_error);
+			} else {
+				delete_all_values (data, graph, subject, predicate, &inner_error);
+			}
+			break;
+		case TRACKER_RESOURCE_STATEMENT_INSERT_URI:
+			object = map_blank_node (blank_nodes, object);
+			tracker_data_insert_statement_with_uri (data, graph, subject, predicate,
+			                                        object, &inner_error);
+			break;
+		case TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL:
+			tracker_data_insert_statement_with_string (data, graph, subject, predicate,
+			                                           object, &inner_error);
+			break;
+		default:
+			g_set_error (&inner_error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_PARSE,
+			             "Unknown statement operation '%c'", op);
+			break;
+		}
+
+		if (!inner_error)
+			tracker_data_update_buffer_might_flush (data, &inner_error);
+
+		if (inner_error) {
+			g_propagate_error (error, inner_error);
+			return;
+		}
+	}
+}
+
+/*
+ * tracker_data_update_statements:
+ * @statements: a #GVariant of type aa(ysss), as produced by
+ *     tracker_resource_serialize_statements() for each resource
+ *
+ * Applies the statements in a single transaction, without going
+ * through the SPARQL parser. Blank node labels are scoped to each
+ * of the inner arrays, like they are to a single SPARQL update.
+ */
+void
+tracker_data_update_statements (TrackerData  *data,
+                                const gchar  *graph,
+                                GVariant     *statements,
+                                GError      **error)
+{
+	GError *actual_error = NULL;
+	GVariantIter iter;
+	GVariant *child;
+
+	g_return_if_fail (statements != NULL);
+	g_return_if_fail (g_variant_is_of_type (statements, G_VARIANT_TYPE ("aa(ysss)")));
+
+	tracker_data_begin_transaction (data, &actual_error);
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
+	g_variant_iter_init (&iter, statements);
+
+	while (!actual_error && (child = g_variant_iter_next_value (&iter)) != NULL) {
+		GHashTable *blank_nodes;
+
+		blank_nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		update_statements (data, graph, child, blank_nodes, &actual_error);
+		g_hash_table_unref (blank_nodes);
+		g_variant_unref (child);
+	}
+
+	if (actual_error) {
+		tracker_data_rollback_transaction (data);
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
+	tracker_data_commit_transaction (data, error);
+}
+
 void
 tracker_data_load_turtle_file (TrackerData  *data,
                                GFile        *file,
@@ -3743,6 +4125,78 @@ tracker_data_load_turtle_file (TrackerData  *data,
 	tracker_turtle_reader_load (file, data, error);
 }
 
+/*
+ * tracker_data_import_turtle_file:
+ *
+ * Like tracker_data_load_turtle_file(), but meant for large dumps:
+ * the data is committed every @commit_statements statements or
+ * @commit_bytes bytes of input (0 disables either), so it is not
+ * imported atomically. Progress is reported through @busy_callback.
+ */
+void
+tracker_data_import_turtle_file (TrackerData          *data,
+                                 GFile                *file,
+                                 gsize                 commit_statements,
+                                 gsize                 commit_bytes,
+                                 gboolean              defer_fts,
+                                 GCancellable         *cancellable,
+                                 TrackerBusyCallback   busy_callback,
+                                 gpointer              busy_user_data,
+                                 GError              **error)
+{
+	g_return_if_fail (G_IS_FILE (file));
+
+	tracker_turtle_reader_load_bulk (file, data,
+	                                 commit_statements, commit_bytes,
+	                                 defer_fts, cancellable,
+	                                 busy_callback, busy_user_data,
+	                                 error);
+}
+
+/*
+ * tracker_data_set_fts_deferred:
+ *
+ * While deferred, full text search is not kept up to date on each
+ * update. Leaving this mode rebuilds the FTS index from the stored
+ * data if anything changed meanwhile, so it must happen outside a
+ * transaction. The pending rebuild is recorded on disk before any
+ * deferred commit, and done on startup if it didn't happen here.
+ */
+void
+tracker_data_set_fts_deferred (TrackerData *data,
+                               gboolean     deferred)
+{
+#if HAVE_TRACKER_FTS
+	TrackerDBManager *db_manager;
+#endif
+
+	g_return_if_fail (!data->in_transaction);
+
+	if (data->fts_deferred == deferred)
+		return;
+
+	data->fts_deferred = deferred;
+
+#if HAVE_TRACKER_FTS
+	db_manager = tracker_data_manager_get_db_manager (data->manager);
+
+	if (deferred) {
+		tracker_db_manager_set_fts_rebuild_pending (db_manager, TRUE);
+	} else {
+		if (data->fts_pending) {
+			TrackerDBInterface *iface;
+
+			iface = tracker_data_manager_get_writable_db_interface (data->manager);
+			tracker_db_interface_sqlite_fts_rebuild_tokens (iface);
+		}
+
+		tracker_db_manager_set_fts_rebuild_pending (db_manager, FALSE);
+	}
+#endif
+
+	data->fts_pending = FALSE;
+}
+
 void
 tracker_data_sync (TrackerData *data)
 {
@@ -111,6 +111,10 @@ GVariant *
          tracker_data_update_sparql_blank           (TrackerData               *data,
                                                      const gchar               *update,
                                                      GError                   **error);
+void     tracker_data_update_statements             (TrackerData               *data,
+                                                     const gchar               *graph,
+                                                     GVariant                  *statements,
+                                                     GError                   **error);
 void     tracker_data_update_buffer_flush           (TrackerData               *data,
                                                      GError                   **error);
 void     tracker_data_update_buffer_might_flush     (TrackerData               *data,
@@ -118,6 +122,17 @@ void     tracker_data_update_buffer_might_flush     (TrackerData               *
 void     tracker_data_load_turtle_file              (TrackerData               *data,
                                                      GFile                     *file,
                                                      GError                   **error);
+void     tracker_data_import_turtle_file            (TrackerData               *data,
+                                                     GFile                     *file,
+                                                     gsize                      commit_statements,
+                                                     gsize                      commit_bytes,
+                                                     gboolean                   defer_fts,
+                                                     GCancellable              *cancellable,
+                                                     TrackerBusyCallback        busy_callback,
+                                                     gpointer                   busy_user_data,
+                                                     GError                   **error);
+void     tracker_data_set_fts_deferred              (TrackerData               *data,
+                                                     gboolean                   deferred);
 
 void     tracker_data_sync                          (TrackerData               *data);
 void     tracker_data_replay_journal                (TrackerData               *data,
@@ -28,6 +28,7 @@
 
 #include "tracker-class.h"
 #include "tracker-data-backup.h"
+#include "tracker-data-compaction.h"
 #include "tracker-data-manager.h"
 #include "tracker-data-query.h"
 #include "tracker-data-update.h"
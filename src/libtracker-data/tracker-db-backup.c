@@ -21,7 +21,10 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 
@@ -36,15 +39,49 @@
 
 #define TRACKER_DB_BACKUP_META_FILENAME_T	"meta-backup.db.tmp"
 
+/* Restarts caused by concurrent writes before the source snapshot is
+ * held for the rest of the backup.
+ */
+#define MAX_BACKUP_RESTARTS 3
+
+#define MANIFEST_MAGIC "TRKPGS02"
+#define DELTA_MAGIC    "TRKDLT02"
+#define MAGIC_SIZE     8
+
+/* Bytes of the page MD5 kept in the manifest */
+#define PAGE_DIGEST_SIZE 8
+
+/* MD5 of the whole base backup, deltas only apply on top of it */
+#define BASE_DIGEST_SIZE 16
+
+/* Inode, size and mtime of the base backup, so a base replaced
+ * by something else isn't taken for the manifest's.
+ */
+#define BASE_STAT_SIZE (3 * sizeof (guint64))
+
 typedef struct {
 	GFile *destination;
 	GFile *file;
+	gboolean incremental;
+	gint pages_per_step;
+	guint step_interval;
+	TrackerDBBackupProgress progress_callback;
+	gdouble progress;
+	gint progress_pending;
 	TrackerDBBackupFinished callback;
 	gpointer user_data;
 	GDestroyNotify destroy;
 	GError *error;
 } BackupInfo;
 
+typedef struct {
+	guint8 base_digest[BASE_DIGEST_SIZE];
+	guint64 base_stat[3];
+	guint32 page_size;
+	guint32 n_pages;
+	guint8 *digests;
+} PageManifest;
+
 GQuark
 tracker_db_backup_error_quark (void)
 {
@@ -56,6 +93,11 @@ perform_callback (gpointer user_data)
 {
 	BackupInfo *info = user_data;
 
+	/* Let the last progress notification go first */
+	if (g_atomic_int_get (&info->progress_pending)) {
+		return TRUE;
+	}
+
 	if (info->callback) {
 		info->callback (info->error, info->user_data);
 	}
@@ -63,6 +105,34 @@ perform_callback (gpointer user_data)
 	return FALSE;
 }
 
+static gboolean
+perform_progress (gpointer user_data)
+{
+	BackupInfo *info = user_data;
+
+	info->progress_callback (info->progress, info->user_data);
+	g_atomic_int_set (&info->progress_pending, FALSE);
+
+	return FALSE;
+}
+
+static void
+report_progress (BackupInfo *info,
+                 gdouble     progress)
+{
+	if (!info->progress_callback) {
+		return;
+	}
+
+	/* Drop notifications while the previous one is pending */
+	if (!g_atomic_int_compare_and_exchange (&info->progress_pending, FALSE, TRUE)) {
+		return;
+	}
+
+	info->progress = progress;
+	g_idle_add (perform_progress, info);
+}
+
 static void
 backup_info_free (gpointer user_data)
 {
@@ -85,22 +155,445 @@ backup_info_free (gpointer user_data)
 	g_slice_free (BackupInfo, info);
 }
 
+static GFile *
+get_sibling_file (GFile       *file,
+                  const gchar *suffix)
+{
+	GFile *parent, *sibling;
+	gchar *basename, *name;
+
+	parent = g_file_get_parent (file);
+	basename = g_file_get_basename (file);
+	name = g_strconcat (basename, suffix, NULL);
+	sibling = g_file_get_child (parent, name);
+
+	g_object_unref (parent);
+	g_free (basename);
+	g_free (name);
+
+	return sibling;
+}
+
+static GFile *
+get_delta_file (GFile *destination,
+                guint  n)
+{
+	GFile *delta;
+	gchar *suffix;
+
+	suffix = g_strdup_printf (".%u.delta", n);
+	delta = get_sibling_file (destination, suffix);
+	g_free (suffix);
+
+	return delta;
+}
+
 static void
-backup_job (GTask        *task,
-            gpointer      source_object,
-            gpointer      task_data,
-            GCancellable *cancellable)
+page_manifest_clear (PageManifest *manifest)
 {
-	BackupInfo *info = task_data;
+	g_clear_pointer (&manifest->digests, g_free);
+	manifest->n_pages = 0;
+}
 
-	GFile *parent_file, *temp_file;
-	gchar *temp_path, *src_path;
+static gboolean
+page_manifest_load (PageManifest *manifest,
+                    GFile        *destination)
+{
+	GFile *file;
+	gchar *path, *contents = NULL;
+	gsize len, header_size;
+	guint32 page_size, n_pages;
+	gboolean valid = FALSE;
+
+	file = get_sibling_file (destination, ".pages");
+	path = g_file_get_path (file);
+	g_object_unref (file);
+
+	header_size = MAGIC_SIZE + BASE_DIGEST_SIZE + BASE_STAT_SIZE + 2 * sizeof (guint32);
+
+	if (g_file_get_contents (path, &contents, &len, NULL) &&
+	    len >= header_size &&
+	    memcmp (contents, MANIFEST_MAGIC, MAGIC_SIZE) == 0) {
+		memcpy (&page_size, contents + header_size - 2 * sizeof (guint32), sizeof (guint32));
+		memcpy (&n_pages, contents + header_size - sizeof (guint32), sizeof (guint32));
+		page_size = GUINT32_FROM_LE (page_size);
+		n_pages = GUINT32_FROM_LE (n_pages);
+
+		if (len == header_size + (gsize) n_pages * PAGE_DIGEST_SIZE) {
+			memcpy (manifest->base_digest, contents + MAGIC_SIZE, BASE_DIGEST_SIZE);
+			memcpy (manifest->base_stat, contents + MAGIC_SIZE + BASE_DIGEST_SIZE, BASE_STAT_SIZE);
+			manifest->page_size = page_size;
+			manifest->n_pages = n_pages;
+			manifest->digests = g_memdup (contents + header_size,
+			                              n_pages * PAGE_DIGEST_SIZE);
+			valid = TRUE;
+		}
+	}
+
+	g_free (contents);
+	g_free (path);
+
+	return valid;
+}
+
+static gboolean
+page_manifest_save (PageManifest  *manifest,
+                    GFile         *destination,
+                    GError       **error)
+{
+	GByteArray *data;
+	GFile *file;
+	gchar *path;
+	guint32 value;
+	gboolean retval;
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data, (const guint8 *) MANIFEST_MAGIC, MAGIC_SIZE);
+	g_byte_array_append (data, manifest->base_digest, BASE_DIGEST_SIZE);
+	g_byte_array_append (data, (const guint8 *) manifest->base_stat, BASE_STAT_SIZE);
+	value = GUINT32_TO_LE (manifest->page_size);
+	g_byte_array_append (data, (const guint8 *) &value, sizeof (value));
+	value = GUINT32_TO_LE (manifest->n_pages);
+	g_byte_array_append (data, (const guint8 *) &value, sizeof (value));
+	g_byte_array_append (data, manifest->digests, manifest->n_pages * PAGE_DIGEST_SIZE);
+
+	file = get_sibling_file (destination, ".pages");
+	path = g_file_get_path (file);
+	retval = g_file_set_contents (path, (const gchar *) data->data, data->len, error);
+
+	g_byte_array_unref (data);
+	g_object_unref (file);
+	g_free (path);
+
+	return retval;
+}
+
+/* Only meant to tell files apart on this machine, hence no byte swapping */
+static gboolean
+get_base_stat (GFile   *base,
+               guint64  base_stat[3])
+{
+	GStatBuf st;
+	gchar *path;
+	gint retval;
+
+	path = g_file_get_path (base);
+	retval = g_stat (path, &st);
+	g_free (path);
+
+	if (retval != 0)
+		return FALSE;
+
+	base_stat[0] = st.st_ino;
+	base_stat[1] = st.st_size;
+	base_stat[2] = st.st_mtime;
+
+	return TRUE;
+}
+
+static void
+page_digest (GChecksum    *checksum,
+             const guint8 *page,
+             gsize         page_size,
+             guint8       *digest)
+{
+	guint8 buffer[16];
+	gsize len = sizeof (buffer);
+
+	g_checksum_reset (checksum);
+	g_checksum_update (checksum, page, page_size);
+	g_checksum_get_digest (checksum, buffer, &len);
+	memcpy (digest, buffer, PAGE_DIGEST_SIZE);
+}
+
+static void
+backup_io_error (GError      **error,
+                 const gchar  *path)
+{
+	g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+	             "Could not access '%s': %s", path, g_strerror (errno));
+}
+
+static void
+backup_throttle (BackupInfo *info)
+{
+	if (info->step_interval > 0)
+		g_usleep (info->step_interval * 1000);
+	else
+		g_thread_yield ();
+}
+
+/* Reads the database at path page by page, updating the manifest to
+ * match it. Without a base yet, every page is written to out, which
+ * becomes the new base. Otherwise out is a delta, and only gets the
+ * pages that differ from the manifest.
+ */
+static gboolean
+backup_diff_pages (BackupInfo    *info,
+                   const gchar   *path,
+                   guint32        page_size,
+                   PageManifest  *manifest,
+                   gboolean       has_base,
+                   FILE          *out,
+                   GError       **error)
+{
+	GChecksum *checksum, *base_checksum = NULL;
+	guint8 *page, digest[PAGE_DIGEST_SIZE];
+	guint32 i, n_pages, n_changed = 0, value;
+	gboolean success = TRUE;
+	gsize len;
+	GStatBuf st;
+	FILE *f;
+
+	f = g_fopen (path, "rb");
+
+	if (!f || g_stat (path, &st) != 0) {
+		backup_io_error (error, path);
+		if (f)
+			fclose (f);
+		return FALSE;
+	}
+
+	n_pages = st.st_size / page_size;
+
+	manifest->page_size = page_size;
+	manifest->digests = g_realloc (manifest->digests, (gsize) n_pages * PAGE_DIGEST_SIZE);
+
+	if (has_base) {
+		/* Header, n_changed is filled in at the end */
+		fwrite (DELTA_MAGIC, 1, MAGIC_SIZE, out);
+		fwrite (manifest->base_digest, 1, BASE_DIGEST_SIZE, out);
+		value = GUINT32_TO_LE (page_size);
+		fwrite (&value, sizeof (value), 1, out);
+		value = GUINT32_TO_LE (n_pages);
+		fwrite (&value, sizeof (value), 1, out);
+		fwrite (&n_changed, sizeof (n_changed), 1, out);
+	} else {
+		manifest->n_pages = 0;
+		base_checksum = g_checksum_new (G_CHECKSUM_MD5);
+	}
+
+	checksum = g_checksum_new (G_CHECKSUM_MD5);
+	page = g_malloc (page_size);
+
+	for (i = 0; i < n_pages; i++) {
+		guint8 *old_digest = &manifest->digests[(gsize) i * PAGE_DIGEST_SIZE];
+
+		if (fread (page, page_size, 1, f) != 1) {
+			backup_io_error (error, path);
+			success = FALSE;
+			break;
+		}
+
+		if (i % 1024 == 0) {
+			report_progress (info, (gdouble) i / n_pages);
+		}
+
+		if (info->pages_per_step > 0 && i > 0 &&
+		    i % info->pages_per_step == 0) {
+			backup_throttle (info);
+		}
+
+		page_digest (checksum, page, page_size, digest);
+
+		if (base_checksum) {
+			g_checksum_update (base_checksum, page, page_size);
+			fwrite (page, page_size, 1, out);
+		} else if (i < manifest->n_pages &&
+		           memcmp (digest, old_digest, PAGE_DIGEST_SIZE) == 0) {
+			continue;
+		} else {
+			value = GUINT32_TO_LE (i);
+			fwrite (&value, sizeof (value), 1, out);
+			fwrite (page, page_size, 1, out);
+			n_changed++;
+		}
+
+		memcpy (old_digest, digest, PAGE_DIGEST_SIZE);
+	}
+
+	manifest->n_pages = n_pages;
+
+	if (success && has_base) {
+		value = GUINT32_TO_LE (n_changed);
+
+		if (fseek (out, MAGIC_SIZE + BASE_DIGEST_SIZE + 2 * sizeof (guint32), SEEK_SET) != 0 ||
+		    fwrite (&value, sizeof (value), 1, out) != 1) {
+			success = FALSE;
+		}
+
+		g_debug ("Incremental backup: %u of %u pages changed", n_changed, n_pages);
+	}
+
+	if (success && (fflush (out) != 0 || ferror (out))) {
+		success = FALSE;
+	}
+
+	if (!success && error && !*error) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Could not write backup: %s", g_strerror (errno));
+	}
+
+	if (base_checksum) {
+		len = BASE_DIGEST_SIZE;
+		g_checksum_get_digest (base_checksum, manifest->base_digest, &len);
+		g_checksum_free (base_checksum);
+	}
+
+	g_checksum_free (checksum);
+	g_free (page);
+	fclose (f);
+
+	return success;
+}
+
+/* Copies the database in chunks of info->pages_per_step, so the
+ * source is only locked for short periods of time.
+ */
+static gboolean
+backup_copy (BackupInfo   *info,
+             sqlite3      *src_db,
+             sqlite3      *temp_db,
+             GError      **error)
+{
+	sqlite3_backup *backup;
+	gint rc, remaining, prev_remaining = G_MAXINT, n_restarts = 0;
+	gboolean pinned = FALSE;
+
+	backup = sqlite3_backup_init (temp_db, "main", src_db, "main");
+
+	if (!backup) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Unable to initialize sqlite3 backup: %s",
+		             sqlite3_errmsg (temp_db));
+		return FALSE;
+	}
+
+	do {
+		rc = sqlite3_backup_step (backup, info->pages_per_step);
+
+		if (rc != SQLITE_OK && rc != SQLITE_DONE &&
+		    rc != SQLITE_BUSY && rc != SQLITE_LOCKED) {
+			break;
+		}
+
+		remaining = sqlite3_backup_remaining (backup);
+
+		/* Writes on the source restart the backup from scratch,
+		 * hold a read snapshot if that keeps happening.
+		 */
+		if (remaining > prev_remaining && !pinned &&
+		    ++n_restarts >= MAX_BACKUP_RESTARTS) {
+			g_debug ("Backup restarted %d times, holding the source snapshot",
+			         n_restarts);
+			pinned = sqlite3_exec (src_db,
+			                       "BEGIN; SELECT COUNT(*) FROM sqlite_master;",
+			                       NULL, NULL, NULL) == SQLITE_OK;
+		}
+
+		prev_remaining = remaining;
+
+		if (sqlite3_backup_pagecount (backup) > 0) {
+			report_progress (info,
+			                 1.0 - (gdouble) remaining / sqlite3_backup_pagecount (backup));
+		}
+
+		if (rc != SQLITE_DONE) {
+			backup_throttle (info);
+		}
+	} while (rc != SQLITE_DONE);
+
+	if (pinned) {
+		sqlite3_exec (src_db, "COMMIT", NULL, NULL, NULL);
+	}
+
+	if (sqlite3_backup_finish (backup) != SQLITE_OK || rc != SQLITE_DONE) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Unable to complete sqlite3 backup: %s",
+		             sqlite3_errmsg (temp_db));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Incremental backups read the pages straight from the database file,
+ * which is only consistent while there's nothing left in the WAL. This
+ * empties the WAL and opens a read transaction on the empty WAL, that
+ * keeps later commits from being checkpointed into the file until the
+ * backup is done.
+ */
+static gboolean
+backup_pin_source (BackupInfo   *info,
+                   sqlite3      *src_db,
+                   const gchar  *src_path,
+                   guint32      *page_size,
+                   GError      **error)
+{
+	sqlite3_stmt *stmt;
+	gchar *wal_path;
+	gboolean pinned = FALSE;
+	GStatBuf st;
+	gint n;
+
+	wal_path = g_strconcat (src_path, "-wal", NULL);
+	sqlite3_busy_timeout (src_db, 100);
+
+	for (n = 0; n < MAX_BACKUP_RESTARTS && !pinned; n++) {
+		if (n > 0)
+			backup_throttle (info);
+
+		if (sqlite3_wal_checkpoint_v2 (src_db, NULL, SQLITE_CHECKPOINT_TRUNCATE,
+		                               NULL, NULL) != SQLITE_OK ||
+		    sqlite3_exec (src_db, "BEGIN; SELECT COUNT(*) FROM sqlite_master;",
+		                  NULL, NULL, NULL) != SQLITE_OK) {
+			continue;
+		}
 
+		/* Commits after the checkpoint make the WAL grow again */
+		if (g_stat (wal_path, &st) != 0 || st.st_size == 0)
+			pinned = TRUE;
+		else
+			sqlite3_exec (src_db, "COMMIT", NULL, NULL, NULL);
+	}
+
+	g_free (wal_path);
+
+	if (!pinned) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Database kept being written to, could not take a snapshot: %s",
+		             sqlite3_errmsg (src_db));
+		return FALSE;
+	}
+
+	*page_size = 0;
+
+	if (sqlite3_prepare_v2 (src_db, "PRAGMA page_size", -1, &stmt, NULL) == SQLITE_OK) {
+		if (sqlite3_step (stmt) == SQLITE_ROW)
+			*page_size = sqlite3_column_int (stmt, 0);
+		sqlite3_finalize (stmt);
+	}
+
+	if (*page_size == 0) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Unable to get the page size of the database: %s",
+		             sqlite3_errmsg (src_db));
+		sqlite3_exec (src_db, "COMMIT", NULL, NULL, NULL);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+backup_plain (BackupInfo  *info,
+              const gchar *src_path)
+{
+	GFile *parent_file, *temp_file;
+	gchar *temp_path;
 	sqlite3 *src_db = NULL;
 	sqlite3 *temp_db = NULL;
-	sqlite3_backup *backup = NULL;
 
-	src_path = g_file_get_path (info->file);
 	parent_file = g_file_get_parent (info->destination);
 	temp_file = g_file_get_child (parent_file, TRACKER_DB_BACKUP_META_FILENAME_T);
 	g_file_delete (temp_file, NULL, NULL);
@@ -117,55 +610,147 @@ backup_job (GTask        *task,
 	}
 
 	if (!info->error) {
-		backup = sqlite3_backup_init (temp_db, "main", src_db, "main");
+		backup_copy (info, src_db, temp_db, &info->error);
+	}
 
-		if (!backup) {
-			g_set_error (&info->error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
-				     "Unable to initialize sqlite3 backup from '%s' to '%s'", src_path, temp_path);
-		}
+	if (temp_db) {
+		sqlite3_close (temp_db);
+	}
+
+	if (src_db) {
+		sqlite3_close (src_db);
+	}
+
+	if (!info->error) {
+		g_file_move (temp_file, info->destination,
+		             G_FILE_COPY_OVERWRITE,
+		             NULL, NULL, NULL,
+		             &info->error);
 	}
 
-	if (!info->error && sqlite3_backup_step (backup, -1) != SQLITE_DONE) {
+	if (info->error) {
+		g_file_delete (temp_file, NULL, NULL);
+	}
+
+	g_free (temp_path);
+	g_object_unref (temp_file);
+	g_object_unref (parent_file);
+}
+
+/* A new base is written over the destination when there's none to
+ * compare against, or a numbered delta next to it otherwise. Deltas
+ * of previous bases are left alone, they don't apply to the new one.
+ */
+static void
+backup_incremental (BackupInfo  *info,
+                    const gchar *src_path)
+{
+	PageManifest manifest = { 0, };
+	GFile *out_file = NULL;
+	gchar *out_path = NULL, *temp_path = NULL;
+	gboolean has_base, pinned = FALSE;
+	guint64 base_stat[3];
+	guint32 page_size = 0;
+	sqlite3 *src_db = NULL;
+	FILE *out;
+	guint n;
+
+	/* Without a base this manifest is about, start a new one */
+	has_base = (get_base_stat (info->destination, base_stat) &&
+	            page_manifest_load (&manifest, info->destination) &&
+	            memcmp (base_stat, manifest.base_stat, BASE_STAT_SIZE) == 0);
+
+	/* Read-write, so the WAL can be checkpointed */
+	if (sqlite3_open_v2 (src_path, &src_db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
 		g_set_error (&info->error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
-		             "Unable to complete sqlite3 backup");
+		             "Could not open sqlite3 database:'%s'", src_path);
 	}
 
-	if (backup) {
-		if (sqlite3_backup_finish (backup) != SQLITE_OK) {
+	if (!info->error) {
+		pinned = backup_pin_source (info, src_db, src_path, &page_size, &info->error);
+	}
+
+	if (!info->error) {
+		if (has_base && manifest.page_size != page_size) {
+			g_debug ("Page size changed, starting a new base backup");
+			has_base = FALSE;
+		}
+
+		if (has_base) {
+			for (n = 1; ; n++) {
+				out_file = get_delta_file (info->destination, n);
+				if (!g_file_query_exists (out_file, NULL))
+					break;
+				g_object_unref (out_file);
+			}
+		} else {
+			out_file = g_object_ref (info->destination);
+		}
+
+		/* Only complete files get their final name */
+		out_path = g_file_get_path (out_file);
+		temp_path = g_strconcat (out_path, ".tmp", NULL);
+		out = g_fopen (temp_path, "wb");
+
+		if (!out) {
+			backup_io_error (&info->error, temp_path);
+		} else {
+			backup_diff_pages (info, src_path, page_size, &manifest,
+			                   has_base, out, &info->error);
+
+			if (fclose (out) != 0 && !info->error) {
+				backup_io_error (&info->error, temp_path);
+			}
+
+			if (!info->error && g_rename (temp_path, out_path) != 0) {
+				backup_io_error (&info->error, out_path);
+			}
+
 			if (info->error) {
-				/* sqlite3_backup_finish can provide more detailed error message */
-				g_clear_error (&info->error);
+				g_unlink (temp_path);
+			} else if (!has_base &&
+			           !get_base_stat (info->destination, manifest.base_stat)) {
+				backup_io_error (&info->error, out_path);
 			}
-			g_set_error (&info->error,
-			             TRACKER_DB_BACKUP_ERROR,
-			             TRACKER_DB_BACKUP_ERROR_UNKNOWN,
-				     "Unable to finish sqlite3 backup: %s",
-				     sqlite3_errmsg (temp_db));
 		}
-		backup = NULL;
 	}
 
-	if (temp_db) {
-		sqlite3_close (temp_db);
-		temp_db = NULL;
+	if (pinned) {
+		sqlite3_exec (src_db, "COMMIT", NULL, NULL, NULL);
 	}
 
 	if (src_db) {
 		sqlite3_close (src_db);
-		src_db = NULL;
 	}
 
 	if (!info->error) {
-		g_file_move (temp_file, info->destination,
-		             G_FILE_COPY_OVERWRITE,
-		             NULL, NULL, NULL,
-		             &info->error);
+		page_manifest_save (&manifest, info->destination, &info->error);
 	}
 
-	g_free (src_path);
+	page_manifest_clear (&manifest);
+	g_clear_object (&out_file);
+	g_free (out_path);
 	g_free (temp_path);
-	g_object_unref (temp_file);
-	g_object_unref (parent_file);
+}
+
+static void
+backup_job (GTask        *task,
+            gpointer      source_object,
+            gpointer      task_data,
+            GCancellable *cancellable)
+{
+	BackupInfo *info = task_data;
+	gchar *src_path;
+
+	src_path = g_file_get_path (info->file);
+
+	if (info->incremental) {
+		backup_incremental (info, src_path);
+	} else {
+		backup_plain (info, src_path);
+	}
+
+	g_free (src_path);
 
 	g_idle_add_full (G_PRIORITY_DEFAULT, perform_callback, info,
 	                 backup_info_free);
@@ -177,6 +762,42 @@ tracker_db_backup_save (GFile                   *destination,
                         TrackerDBBackupFinished  callback,
                         gpointer                 user_data,
                         GDestroyNotify           destroy)
+{
+	tracker_db_backup_save_full (destination, file, FALSE,
+	                             TRACKER_DB_BACKUP_PAGES_PER_STEP,
+	                             TRACKER_DB_BACKUP_STEP_INTERVAL,
+	                             NULL, callback, user_data, destroy);
+}
+
+/**
+ * tracker_db_backup_save_full:
+ * @destination: the base backup file
+ * @file: the database file
+ * @incremental: whether to only store the pages changed since the
+ *    last incremental backup to @destination
+ * @pages_per_step: pages copied at once, -1 copies everything at once
+ * @step_interval: milliseconds to sleep between steps
+ * @progress_callback: (allow-none): called in the main thread
+ * @callback: called in the main thread when done
+ * @user_data: data for @progress_callback and @callback
+ * @destroy: destroy notify for @user_data
+ *
+ * Plain backups only write @destination. Incremental backups read
+ * the database file directly rather than copying it, and keep a page
+ * manifest next to @destination, the first one writes @destination
+ * itself and later ones numbered .delta files that
+ * tracker_db_backup_restore() applies in order.
+ **/
+void
+tracker_db_backup_save_full (GFile                   *destination,
+                             GFile                   *file,
+                             gboolean                 incremental,
+                             gint                     pages_per_step,
+                             guint                    step_interval,
+                             TrackerDBBackupProgress  progress_callback,
+                             TrackerDBBackupFinished  callback,
+                             gpointer                 user_data,
+                             GDestroyNotify           destroy)
 {
 	GTask *task;
 	BackupInfo *info;
@@ -185,7 +806,11 @@ tracker_db_backup_save (GFile                   *destination,
 
 	info->destination = g_object_ref (destination);
 	info->file = g_object_ref (file);
+	info->incremental = incremental;
+	info->pages_per_step = pages_per_step != 0 ? pages_per_step : -1;
+	info->step_interval = step_interval;
 
+	info->progress_callback = progress_callback;
 	info->callback = callback;
 	info->user_data = user_data;
 	info->destroy = destroy;
@@ -197,3 +822,193 @@ tracker_db_backup_save (GFile                   *destination,
 	g_object_unref (task);
 }
 
+/* Applies the delta at delta_path on target, unless it was made on
+ * top of another base backup. Returns FALSE on errors only.
+ */
+static gboolean
+apply_delta (const gchar   *delta_path,
+             const guint8  *base_digest,
+             FILE          *target,
+             GError       **error)
+{
+	guint32 page_size, n_pages, n_changed, page_no, i;
+	guint8 delta_base_digest[BASE_DIGEST_SIZE];
+	gchar magic[MAGIC_SIZE];
+	gboolean success = TRUE;
+	guint8 *page;
+	FILE *delta;
+
+	delta = g_fopen (delta_path, "rb");
+
+	if (!delta) {
+		backup_io_error (error, delta_path);
+		return FALSE;
+	}
+
+	if (fread (magic, MAGIC_SIZE, 1, delta) != 1 ||
+	    memcmp (magic, DELTA_MAGIC, MAGIC_SIZE) != 0 ||
+	    fread (delta_base_digest, BASE_DIGEST_SIZE, 1, delta) != 1 ||
+	    fread (&page_size, sizeof (guint32), 1, delta) != 1 ||
+	    fread (&n_pages, sizeof (guint32), 1, delta) != 1 ||
+	    fread (&n_changed, sizeof (guint32), 1, delta) != 1) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Invalid backup delta '%s'", delta_path);
+		fclose (delta);
+		return FALSE;
+	}
+
+	if (memcmp (delta_base_digest, base_digest, BASE_DIGEST_SIZE) != 0) {
+		g_debug ("Skipping backup delta '%s' of another base backup", delta_path);
+		fclose (delta);
+		return TRUE;
+	}
+
+	page_size = GUINT32_FROM_LE (page_size);
+	n_pages = GUINT32_FROM_LE (n_pages);
+	n_changed = GUINT32_FROM_LE (n_changed);
+	page = g_malloc (page_size);
+
+	for (i = 0; i < n_changed; i++) {
+		if (fread (&page_no, sizeof (guint32), 1, delta) != 1 ||
+		    fread (page, page_size, 1, delta) != 1) {
+			g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+			             "Truncated backup delta '%s'", delta_path);
+			success = FALSE;
+			break;
+		}
+
+		page_no = GUINT32_FROM_LE (page_no);
+
+		if (fseeko (target, (off_t) page_no * page_size, SEEK_SET) != 0 ||
+		    fwrite (page, page_size, 1, target) != 1) {
+			g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+			             "Could not apply backup delta '%s': %s",
+			             delta_path, g_strerror (errno));
+			success = FALSE;
+			break;
+		}
+	}
+
+	/* The database might have shrunk */
+	if (success &&
+	    (fflush (target) != 0 ||
+	     ftruncate (fileno (target), (off_t) n_pages * page_size) != 0)) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Could not apply backup delta '%s': %s",
+		             delta_path, g_strerror (errno));
+		success = FALSE;
+	}
+
+	g_free (page);
+	fclose (delta);
+
+	return success;
+}
+
+/* Copies backup_path over target, taking the MD5 of its contents */
+static gboolean
+restore_copy (const gchar  *backup_path,
+              FILE         *target,
+              guint8       *base_digest,
+              GError      **error)
+{
+	GChecksum *checksum;
+	gchar buffer[65536];
+	gsize len;
+	FILE *f;
+
+	f = g_fopen (backup_path, "rb");
+
+	if (!f) {
+		backup_io_error (error, backup_path);
+		return FALSE;
+	}
+
+	checksum = g_checksum_new (G_CHECKSUM_MD5);
+
+	while ((len = fread (buffer, 1, sizeof (buffer), f)) > 0) {
+		g_checksum_update (checksum, (const guchar *) buffer, len);
+
+		if (fwrite (buffer, 1, len, target) != len)
+			break;
+	}
+
+	if (ferror (f) || ferror (target) || fflush (target) != 0) {
+		backup_io_error (error, backup_path);
+		g_checksum_free (checksum);
+		fclose (f);
+		return FALSE;
+	}
+
+	len = BASE_DIGEST_SIZE;
+	g_checksum_get_digest (checksum, base_digest, &len);
+	g_checksum_free (checksum);
+	fclose (f);
+
+	return TRUE;
+}
+
+/**
+ * tracker_db_backup_restore:
+ * @backup: the base backup file
+ * @destination: the database file to restore to
+ * @error: location for errors
+ *
+ * Copies @backup over @destination, and applies the incremental
+ * backups made on top of it. Deltas left from a previous base are
+ * skipped.
+ *
+ * Returns: %TRUE if the database was fully restored
+ **/
+gboolean
+tracker_db_backup_restore (GFile   *backup,
+                           GFile   *destination,
+                           GError **error)
+{
+	guint8 base_digest[BASE_DIGEST_SIZE];
+	gchar *backup_path, *dest_path;
+	gboolean success;
+	FILE *target;
+	guint n;
+
+	backup_path = g_file_get_path (backup);
+	dest_path = g_file_get_path (destination);
+	target = g_fopen (dest_path, "w+b");
+
+	if (!target) {
+		backup_io_error (error, dest_path);
+		g_free (backup_path);
+		g_free (dest_path);
+		return FALSE;
+	}
+
+	success = restore_copy (backup_path, target, base_digest, error);
+
+	for (n = 1; success; n++) {
+		GFile *delta;
+		gchar *delta_path;
+
+		delta = get_delta_file (backup, n);
+
+		if (!g_file_query_exists (delta, NULL)) {
+			g_object_unref (delta);
+			break;
+		}
+
+		delta_path = g_file_get_path (delta);
+		success = apply_delta (delta_path, base_digest, target, error);
+
+		g_object_unref (delta);
+		g_free (delta_path);
+	}
+
+	if (fclose (target) != 0 && success) {
+		backup_io_error (error, dest_path);
+		success = FALSE;
+	}
+
+	g_free (backup_path);
+	g_free (dest_path);
+
+	return success;
+}
@@ -27,6 +27,10 @@
 
 #define TRACKER_DB_BACKUP_META_FILENAME		"meta-backup.db"
 
+/* Default throttling, 2MB at a time with 8K pages */
+#define TRACKER_DB_BACKUP_PAGES_PER_STEP	256
+#define TRACKER_DB_BACKUP_STEP_INTERVAL		5
+
 G_BEGIN_DECLS
 
 #define TRACKER_DB_BACKUP_ERROR	    (tracker_db_backup_error_quark ())
@@ -36,6 +40,7 @@ typedef enum {
 } TrackerDBBackupError;
 
 typedef void (*TrackerDBBackupFinished)   (GError *error, gpointer user_data);
+typedef void (*TrackerDBBackupProgress)   (gdouble progress, gpointer user_data);
 
 GQuark    tracker_db_backup_error_quark (void);
 
@@ -44,6 +49,18 @@ void      tracker_db_backup_save        (GFile                   *destination,
                                          TrackerDBBackupFinished  callback,
                                          gpointer                 user_data,
                                          GDestroyNotify           destroy);
+void      tracker_db_backup_save_full   (GFile                   *destination,
+                                         GFile                   *file,
+                                         gboolean                 incremental,
+                                         gint                     pages_per_step,
+                                         guint                    step_interval,
+                                         TrackerDBBackupProgress  progress_callback,
+                                         TrackerDBBackupFinished  callback,
+                                         gpointer                 user_data,
+                                         GDestroyNotify           destroy);
+gboolean  tracker_db_backup_restore     (GFile                   *backup,
+                                         GFile                   *destination,
+                                         GError                 **error);
 
 G_END_DECLS
 
@@ -39,6 +39,10 @@
 /* Default values */
 #define DEFAULT_JOURNAL_CHUNK_SIZE           50
 #define DEFAULT_JOURNAL_ROTATE_DESTINATION   ""
+#define DEFAULT_WRITER_CACHE_SIZE            2000
+#define DEFAULT_READER_CACHE_SIZE            250
+#define DEFAULT_READER_MMAP_SIZE             256
+#define DEFAULT_CHECKPOINT_CACHE_SIZE        100
 
 static void config_set_property (GObject      *object,
                                  guint         param_id,
@@ -56,7 +60,13 @@ enum {
 
 	/* Journal */
 	PROP_JOURNAL_CHUNK_SIZE,
-	PROP_JOURNAL_ROTATE_DESTINATION
+	PROP_JOURNAL_ROTATE_DESTINATION,
+
+	/* Connection tuning */
+	PROP_WRITER_CACHE_SIZE,
+	PROP_READER_CACHE_SIZE,
+	PROP_READER_MMAP_SIZE,
+	PROP_CHECKPOINT_CACHE_SIZE
 };
 
 G_DEFINE_TYPE (TrackerDBConfig, tracker_db_config, G_TYPE_SETTINGS);
@@ -89,6 +99,45 @@ tracker_db_config_class_init (TrackerDBConfigClass *klass)
 	                                                      DEFAULT_JOURNAL_ROTATE_DESTINATION,
 	                                                      G_PARAM_READWRITE));
 
+	g_object_class_install_property (object_class,
+	                                 PROP_WRITER_CACHE_SIZE,
+	                                 g_param_spec_int ("writer-cache-size",
+	                                                   "Writer cache size",
+	                                                   " Number of pages cached by the writer connection",
+	                                                   1,
+	                                                   1000000,
+	                                                   DEFAULT_WRITER_CACHE_SIZE,
+	                                                   G_PARAM_READWRITE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_READER_CACHE_SIZE,
+	                                 g_param_spec_int ("reader-cache-size",
+	                                                   "Reader cache size",
+	                                                   " Number of pages cached by each reader connection",
+	                                                   1,
+	                                                   1000000,
+	                                                   DEFAULT_READER_CACHE_SIZE,
+	                                                   G_PARAM_READWRITE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_READER_MMAP_SIZE,
+	                                 g_param_spec_int ("reader-mmap-size",
+	                                                   "Reader mmap size",
+	                                                   " Memory mapped I/O size of reader connections in MB, 0 to disable",
+	                                                   0,
+	                                                   65536,
+	                                                   DEFAULT_READER_MMAP_SIZE,
+	                                                   G_PARAM_READWRITE));
+
+	g_object_class_install_property (object_class,
+	                                 PROP_CHECKPOINT_CACHE_SIZE,
+	                                 g_param_spec_int ("checkpoint-cache-size",
+	                                                   "Checkpoint cache size",
+	                                                   " Number of pages cached by the WAL checkpoint connection",
+	                                                   1,
+	                                                   1000000,
+	                                                   DEFAULT_CHECKPOINT_CACHE_SIZE,
+	                                                   G_PARAM_READWRITE));
 }
 
 static void
@@ -112,6 +161,24 @@ config_set_property (GObject      *object,
 		tracker_db_config_set_journal_rotate_destination (TRACKER_DB_CONFIG (object),
 		                                                  g_value_get_string(value));
 		break;
+
+		/* Connection tuning */
+	case PROP_WRITER_CACHE_SIZE:
+		tracker_db_config_set_writer_cache_size (TRACKER_DB_CONFIG (object),
+		                                         g_value_get_int (value));
+		break;
+	case PROP_READER_CACHE_SIZE:
+		tracker_db_config_set_reader_cache_size (TRACKER_DB_CONFIG (object),
+		                                         g_value_get_int (value));
+		break;
+	case PROP_READER_MMAP_SIZE:
+		tracker_db_config_set_reader_mmap_size (TRACKER_DB_CONFIG (object),
+		                                        g_value_get_int (value));
+		break;
+	case PROP_CHECKPOINT_CACHE_SIZE:
+		tracker_db_config_set_checkpoint_cache_size (TRACKER_DB_CONFIG (object),
+		                                             g_value_get_int (value));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
 		break;
@@ -133,6 +200,18 @@ config_get_property (GObject    *object,
 	case PROP_JOURNAL_ROTATE_DESTINATION:
 		g_value_take_string (value, tracker_db_config_get_journal_rotate_destination (config));
 		break;
+	case PROP_WRITER_CACHE_SIZE:
+		g_value_set_int (value, tracker_db_config_get_writer_cache_size (config));
+		break;
+	case PROP_READER_CACHE_SIZE:
+		g_value_set_int (value, tracker_db_config_get_reader_cache_size (config));
+		break;
+	case PROP_READER_MMAP_SIZE:
+		g_value_set_int (value, tracker_db_config_get_reader_mmap_size (config));
+		break;
+	case PROP_CHECKPOINT_CACHE_SIZE:
+		g_value_set_int (value, tracker_db_config_get_checkpoint_cache_size (config));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
 		break;
@@ -160,6 +239,10 @@ config_constructed (GObject *object)
 
 	g_settings_bind (settings, "journal-chunk-size", object, "journal-chunk-size", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
 	g_settings_bind (settings, "journal-rotate-destination", object, "journal-rotate-destination", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
+	g_settings_bind (settings, "writer-cache-size", object, "writer-cache-size", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
+	g_settings_bind (settings, "reader-cache-size", object, "reader-cache-size", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
+	g_settings_bind (settings, "reader-mmap-size", object, "reader-mmap-size", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
+	g_settings_bind (settings, "checkpoint-cache-size", object, "checkpoint-cache-size", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
 }
 
 TrackerDBConfig *
@@ -229,6 +312,38 @@ tracker_db_config_get_journal_rotate_destination (TrackerDBConfig *config)
 	return g_settings_get_string (G_SETTINGS (config), "journal-rotate-destination");
 }
 
+gint
+tracker_db_config_get_writer_cache_size (TrackerDBConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_DB_CONFIG (config), DEFAULT_WRITER_CACHE_SIZE);
+
+	return g_settings_get_int (G_SETTINGS (config), "writer-cache-size");
+}
+
+gint
+tracker_db_config_get_reader_cache_size (TrackerDBConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_DB_CONFIG (config), DEFAULT_READER_CACHE_SIZE);
+
+	return g_settings_get_int (G_SETTINGS (config), "reader-cache-size");
+}
+
+gint
+tracker_db_config_get_reader_mmap_size (TrackerDBConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_DB_CONFIG (config), DEFAULT_READER_MMAP_SIZE);
+
+	return g_settings_get_int (G_SETTINGS (config), "reader-mmap-size");
+}
+
+gint
+tracker_db_config_get_checkpoint_cache_size (TrackerDBConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_DB_CONFIG (config), DEFAULT_CHECKPOINT_CACHE_SIZE);
+
+	return g_settings_get_int (G_SETTINGS (config), "checkpoint-cache-size");
+}
+
 void
 tracker_db_config_set_journal_chunk_size (TrackerDBConfig *config,
                                           gint             value)
@@ -248,3 +363,43 @@ tracker_db_config_set_journal_rotate_destination (TrackerDBConfig *config,
 	g_settings_set_string (G_SETTINGS (config), "journal-rotate-destination", value);
 	g_object_notify (G_OBJECT (config), "journal-rotate-destination");
 }
+
+void
+tracker_db_config_set_writer_cache_size (TrackerDBConfig *config,
+                                        gint             value)
+{
+	g_return_if_fail (TRACKER_IS_DB_CONFIG (config));
+
+	g_settings_set_int (G_SETTINGS (config), "writer-cache-size", value);
+	g_object_notify (G_OBJECT (config), "writer-cache-size");
+}
+
+void
+tracker_db_config_set_reader_cache_size (TrackerDBConfig *config,
+                                        gint             value)
+{
+	g_return_if_fail (TRACKER_IS_DB_CONFIG (config));
+
+	g_settings_set_int (G_SETTINGS (config), "reader-cache-size", value);
+	g_object_notify (G_OBJECT (config), "reader-cache-size");
+}
+
+void
+tracker_db_config_set_reader_mmap_size (TrackerDBConfig *config,
+                                       gint             value)
+{
+	g_return_if_fail (TRACKER_IS_DB_CONFIG (config));
+
+	g_settings_set_int (G_SETTINGS (config), "reader-mmap-size", value);
+	g_object_notify (G_OBJECT (config), "reader-mmap-size");
+}
+
+void
+tracker_db_config_set_checkpoint_cache_size (TrackerDBConfig *config,
+                                            gint             value)
+{
+	g_return_if_fail (TRACKER_IS_DB_CONFIG (config));
+
+	g_settings_set_int (G_SETTINGS (config), "checkpoint-cache-size", value);
+	g_object_notify (G_OBJECT (config), "checkpoint-cache-size");
+}
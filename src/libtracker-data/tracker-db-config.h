@@ -56,11 +56,23 @@ gboolean         tracker_db_config_save                           (TrackerDBConf
 
 gint             tracker_db_config_get_journal_chunk_size         (TrackerDBConfig *config);
 gchar *          tracker_db_config_get_journal_rotate_destination (TrackerDBConfig *config);
+gint             tracker_db_config_get_writer_cache_size          (TrackerDBConfig *config);
+gint             tracker_db_config_get_reader_cache_size          (TrackerDBConfig *config);
+gint             tracker_db_config_get_reader_mmap_size           (TrackerDBConfig *config);
+gint             tracker_db_config_get_checkpoint_cache_size      (TrackerDBConfig *config);
 
 void             tracker_db_config_set_journal_chunk_size         (TrackerDBConfig *config,
                                                                    gint             value);
 void             tracker_db_config_set_journal_rotate_destination (TrackerDBConfig *config,
                                                                    const gchar     *value);
+void             tracker_db_config_set_writer_cache_size          (TrackerDBConfig *config,
+                                                                   gint             value);
+void             tracker_db_config_set_reader_cache_size          (TrackerDBConfig *config,
+                                                                   gint             value);
+void             tracker_db_config_set_reader_mmap_size           (TrackerDBConfig *config,
+                                                                   gint             value);
+void             tracker_db_config_set_checkpoint_cache_size      (TrackerDBConfig *config,
+                                                                   gint             value);
 
 G_END_DECLS
 
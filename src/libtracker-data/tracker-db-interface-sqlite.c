@@ -28,6 +28,7 @@
 
 #include <libtracker-common/tracker-date-time.h>
 #include <libtracker-common/tracker-locale.h>
+#include <libtracker-common/tracker-metrics.h>
 #include <libtracker-common/tracker-parser.h>
 
 #include <libtracker-sparql/tracker-sparql.h>
@@ -55,11 +56,28 @@
 #include "tracker-db-manager.h"
 #include "tracker-data-enum-types.h"
 
+/* Statement caches may grow up to this many times their configured size */
+#define STMT_CACHE_MAX_GROWTH 4
+
+/* Cached SELECT lookups counted locally before calling the statement hook */
+#define STATEMENT_USES_BATCH 64
+
 typedef struct {
 	TrackerDBStatement *head;
 	TrackerDBStatement *tail;
 	guint size;
 	guint max;
+	guint base_max;
+
+	/* Totals, see tracker_db_interface_get_stmt_cache_stats() */
+	guint hits;
+	guint misses;
+	guint evictions;
+
+	/* Recent activity, used to detect a thrashing cache */
+	guint window_lookups;
+	guint window_hits;
+	guint window_evictions;
 } TrackerDBStatementLru;
 
 typedef struct {
@@ -96,6 +114,16 @@ struct TrackerDBInterface {
 	/* Wal */
 	TrackerDBWalCallback wal_hook;
 
+	/* Cached SELECT statement usage */
+	TrackerDBStatementCallback statement_hook;
+	gpointer statement_hook_data;
+	/* Query -> lookups since the hook was last called */
+	GHashTable *statement_uses;
+	guint n_statement_uses;
+
+	/* Resource ID -> pending Refcount delta, see SparqlRefcount() */
+	GHashTable *refcount_deltas;
+
 	/* User data */
 	gpointer user_data;
 	GDestroyNotify user_data_destroy_notify;
@@ -1325,6 +1353,38 @@ function_sparql_checksum (sqlite3_context *context,
 	sqlite3_result_text (context, result, -1, g_free);
 }
 
+static void
+function_sparql_refcount (sqlite3_context *context,
+                          int              argc,
+                          sqlite3_value   *argv[])
+{
+	TrackerDBInterface *db_interface = sqlite3_user_data (context);
+	gpointer key;
+	gint delta;
+
+	if (argc != 2) {
+		sqlite3_result_error (context, "Invalid argument count", -1);
+		return;
+	}
+
+	/* Same as the UPDATE matching no row for NULL references */
+	if (sqlite3_value_type (argv[0]) == SQLITE_NULL) {
+		sqlite3_result_null (context);
+		return;
+	}
+
+	key = GINT_TO_POINTER (sqlite3_value_int (argv[0]));
+	delta = GPOINTER_TO_INT (g_hash_table_lookup (db_interface->refcount_deltas, key));
+	delta += sqlite3_value_int (argv[1]);
+
+	if (delta == 0)
+		g_hash_table_remove (db_interface->refcount_deltas, key);
+	else
+		g_hash_table_insert (db_interface->refcount_deltas, key, GINT_TO_POINTER (delta));
+
+	sqlite3_result_null (context);
+}
+
 static inline int
 stmt_step (sqlite3_stmt *stmt)
 {
@@ -1415,6 +1475,8 @@ initialize_functions (TrackerDBInterface *db_interface)
 		{ "SparqlFloor", 1, SQLITE_ANY | SQLITE_DETERMINISTIC,
 		  function_sparql_floor },
 		{ "SparqlRand", 0, SQLITE_ANY, function_sparql_rand },
+		/* Resource refcounting, called from triggers */
+		{ "SparqlRefcount", 2, SQLITE_ANY, function_sparql_refcount },
 	};
 
 	for (i = 0; i < G_N_ELEMENTS (functions); i++) {
@@ -1866,8 +1928,18 @@ wal_hook (gpointer     user_data,
           const gchar *db_name,
           gint         n_pages)
 {
+	static TrackerMetric *wal_pages = NULL;
 	TrackerDBInterface *iface = user_data;
 
+	if (g_once_init_enter (&wal_pages)) {
+		g_once_init_leave (&wal_pages,
+		                   tracker_metrics_gauge ("tracker_data_wal_pages",
+		                                          NULL,
+		                                          "Pages in the WAL file after the last commit"));
+	}
+
+	tracker_metric_set (wal_pages, n_pages);
+
 	iface->wal_hook (iface, n_pages);
 	return SQLITE_OK;
 }
@@ -1880,19 +1952,79 @@ tracker_db_interface_sqlite_wal_hook (TrackerDBInterface   *interface,
 	sqlite3_wal_hook (interface->db, wal_hook, interface);
 }
 
+void
+tracker_db_interface_sqlite_statement_hook (TrackerDBInterface         *interface,
+                                            TrackerDBStatementCallback  callback,
+                                            gpointer                    user_data)
+{
+	interface->statement_hook = callback;
+	interface->statement_hook_data = user_data;
+
+	if (!interface->statement_uses) {
+		interface->statement_uses = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                                   g_free, g_free);
+	}
+}
+
+/* Called with the interface lock held, so counting needs no further
+ * locking, the hook is only called once per batch of lookups.
+ */
+static void
+tracker_db_interface_add_statement_use (TrackerDBInterface *db_interface,
+                                        const gchar        *query)
+{
+	guint *count;
+
+	count = g_hash_table_lookup (db_interface->statement_uses, query);
+
+	if (!count) {
+		count = g_new0 (guint, 1);
+		g_hash_table_insert (db_interface->statement_uses, g_strdup (query), count);
+	}
+
+	(*count)++;
+
+	if (++db_interface->n_statement_uses < STATEMENT_USES_BATCH)
+		return;
+
+	db_interface->statement_hook (db_interface, db_interface->statement_uses,
+	                              db_interface->statement_hook_data);
+	g_hash_table_remove_all (db_interface->statement_uses);
+	db_interface->n_statement_uses = 0;
+}
+
 gboolean
 tracker_db_interface_sqlite_wal_checkpoint (TrackerDBInterface  *interface,
                                             gboolean             blocking,
                                             GError             **error)
 {
+	static TrackerMetric *checkpoint_time[2] = { NULL, NULL };
+	gint64 start_time;
 	int return_val;
 
+	if (g_once_init_enter (&checkpoint_time[0])) {
+		checkpoint_time[1] = tracker_metrics_histogram ("tracker_data_wal_checkpoint_duration_seconds",
+		                                                "mode=\"full\"",
+		                                                "Time spent in WAL checkpoints",
+		                                                NULL, 0);
+		g_once_init_leave (&checkpoint_time[0],
+		                   tracker_metrics_histogram ("tracker_data_wal_checkpoint_duration_seconds",
+		                                              "mode=\"passive\"",
+		                                              "Time spent in WAL checkpoints",
+		                                              NULL, 0));
+	}
+
+	start_time = g_get_monotonic_time ();
+
 	tracker_db_interface_lock (interface);
 	return_val = sqlite3_wal_checkpoint_v2 (interface->db, NULL,
 	                                        blocking ? SQLITE_CHECKPOINT_FULL : SQLITE_CHECKPOINT_PASSIVE,
 	                                        NULL, NULL);
 	tracker_db_interface_unlock (interface);
 
+	tracker_metric_observe (checkpoint_time[blocking ? 1 : 0],
+	                        (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC);
+
 	if (return_val != SQLITE_OK) {
 		g_set_error (error,
 		             TRACKER_DB_INTERFACE_ERROR,
@@ -1913,6 +2045,10 @@ tracker_db_interface_sqlite_finalize (GObject *object)
 
 	close_database (db_interface);
 	g_free (db_interface->fts_properties);
+	g_hash_table_unref (db_interface->refcount_deltas);
+
+	if (db_interface->statement_uses)
+		g_hash_table_unref (db_interface->statement_uses);
 
 	g_info ("Closed sqlite3 database:'%s'", db_interface->filename);
 
@@ -1956,6 +2092,7 @@ tracker_db_interface_init (TrackerDBInterface *db_interface)
 	db_interface->dynamic_statements = g_hash_table_new_full (g_str_hash, g_str_equal,
 	                                                          NULL,
 	                                                          (GDestroyNotify) g_object_unref);
+	db_interface->refcount_deltas = g_hash_table_new (NULL, NULL);
 }
 
 void
@@ -1975,10 +2112,39 @@ tracker_db_interface_set_max_stmt_cache_size (TrackerDBInterface         *db_int
 
 	/* Must be larger than 2 to make sense (to have a tail and head) */
 	if (max_size > 2) {
-		stmt_lru->max = max_size;
+		stmt_lru->base_max = max_size;
 	} else {
-		stmt_lru->max = 3;
+		stmt_lru->base_max = 3;
 	}
+
+	/* The cache might have grown past the new size already, it
+	 * will shrink back as statements get evicted.
+	 */
+	stmt_lru->max = stmt_lru->base_max;
+}
+
+void
+tracker_db_interface_get_stmt_cache_stats (TrackerDBInterface           *db_interface,
+                                           TrackerDBStatementCacheType   cache_type,
+                                           TrackerDBStatementCacheStats *stats)
+{
+	TrackerDBStatementLru *stmt_lru;
+
+	g_return_if_fail (TRACKER_IS_DB_INTERFACE (db_interface));
+	g_return_if_fail (cache_type == TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE ||
+	                  cache_type == TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT);
+	g_return_if_fail (stats != NULL);
+
+	stmt_lru = cache_type == TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE ?
+		&db_interface->update_stmt_lru : &db_interface->select_stmt_lru;
+
+	tracker_db_interface_lock (db_interface);
+	stats->hits = stmt_lru->hits;
+	stats->misses = stmt_lru->misses;
+	stats->evictions = stmt_lru->evictions;
+	stats->size = stmt_lru->size;
+	stats->max_size = stmt_lru->max;
+	tracker_db_interface_unlock (db_interface);
 }
 
 static sqlite3_stmt *
@@ -2012,6 +2178,94 @@ tracker_db_interface_prepare_stmt (TrackerDBInterface  *db_interface,
 	return sqlite_stmt;
 }
 
+static void
+statement_cache_metrics_add (TrackerDBStatementCacheType cache_type,
+                             gboolean                    hit)
+{
+	/* Indexed by [cache_type == UPDATE][hit] */
+	static TrackerMetric *metrics[2][2] = { { NULL, NULL }, { NULL, NULL } };
+
+	if (g_once_init_enter (&metrics[0][0])) {
+		metrics[0][1] = tracker_metrics_counter ("tracker_data_statement_cache_hits_total",
+		                                         "cache=\"select\"",
+		                                         "Prepared statements found in the statement cache");
+		metrics[1][0] = tracker_metrics_counter ("tracker_data_statement_cache_misses_total",
+		                                         "cache=\"update\"",
+		                                         "Prepared statements missing from the statement cache");
+		metrics[1][1] = tracker_metrics_counter ("tracker_data_statement_cache_hits_total",
+		                                         "cache=\"update\"",
+		                                         "Prepared statements found in the statement cache");
+		g_once_init_leave (&metrics[0][0],
+		                   tracker_metrics_counter ("tracker_data_statement_cache_misses_total",
+		                                            "cache=\"select\"",
+		                                            "Prepared statements missing from the statement cache"));
+	}
+
+	tracker_metric_add (metrics[cache_type == TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE][hit ? 1 : 0], 1);
+}
+
+static void
+statement_cache_metrics_evict (TrackerDBStatementCacheType cache_type)
+{
+	static TrackerMetric *metrics[2] = { NULL, NULL };
+
+	if (g_once_init_enter (&metrics[0])) {
+		metrics[1] = tracker_metrics_counter ("tracker_data_statement_cache_evictions_total",
+		                                      "cache=\"update\"",
+		                                      "Prepared statements evicted from a full statement cache");
+		g_once_init_leave (&metrics[0],
+		                   tracker_metrics_counter ("tracker_data_statement_cache_evictions_total",
+		                                            "cache=\"select\"",
+		                                            "Prepared statements evicted from a full statement cache"));
+	}
+
+	tracker_metric_add (metrics[cache_type == TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE ? 1 : 0], 1);
+}
+
+static void
+tracker_db_statement_lru_account (TrackerDBStatementLru *stmt_lru,
+                                  gboolean               hit)
+{
+	if (hit) {
+		stmt_lru->hits++;
+		stmt_lru->window_hits++;
+	} else {
+		stmt_lru->misses++;
+	}
+
+	/* Forget about older activity every few cache turnovers */
+	if (++stmt_lru->window_lookups >= 8 * stmt_lru->max) {
+		stmt_lru->window_lookups = 0;
+		stmt_lru->window_hits = 0;
+		stmt_lru->window_evictions = 0;
+	}
+}
+
+/* The working set doesn't fit if half the cache got evicted recently
+ * while most lookups missed. Grow then, up to STMT_CACHE_MAX_GROWTH
+ * times the configured size.
+ */
+static gboolean
+tracker_db_statement_lru_maybe_grow (TrackerDBStatementLru *stmt_lru)
+{
+	if (stmt_lru->max >= stmt_lru->base_max * STMT_CACHE_MAX_GROWTH)
+		return FALSE;
+	if (stmt_lru->window_evictions < stmt_lru->max / 2 ||
+	    stmt_lru->window_hits * 2 >= stmt_lru->window_lookups)
+		return FALSE;
+
+	stmt_lru->max = MIN (stmt_lru->max * 2,
+	                     stmt_lru->base_max * STMT_CACHE_MAX_GROWTH);
+	stmt_lru->window_lookups = 0;
+	stmt_lru->window_hits = 0;
+	stmt_lru->window_evictions = 0;
+
+	g_debug ("Statement cache thrashing, growing it to %d statements",
+	         stmt_lru->max);
+
+	return TRUE;
+}
+
 static TrackerDBStatement *
 tracker_db_interface_lru_lookup (TrackerDBInterface          *db_interface,
                                  TrackerDBStatementCacheType *cache_type,
@@ -2085,19 +2339,29 @@ tracker_db_interface_lru_insert_unchecked (TrackerDBInterface          *db_inter
 	 *    `- [n-p] <- [n-p] <--------'    *
 	 *                                    */
 
-	if (stmt_lru->size >= stmt_lru->max) {
+	if (stmt_lru->size >= stmt_lru->max &&
+	    !tracker_db_statement_lru_maybe_grow (stmt_lru)) {
 		TrackerDBStatement *new_head;
 
 		/* We reached max-size of the LRU stmt cache. Destroy current
 		 * least recently used (stmt_lru.head) and fix the ring. For
 		 * that we take out the current head, and close the ring.
-		 * Then we assign head->next as new head.
+		 * Then we assign head->next as new head. After the max size
+		 * was lowered, evict until the cache fits again.
 		 */
-		new_head = stmt_lru->head->next;
-		g_hash_table_remove (db_interface->dynamic_statements,
-		                     (gpointer) sqlite3_sql (stmt_lru->head->stmt));
-		stmt_lru->size--;
-		stmt_lru->head = new_head;
+		do {
+			new_head = stmt_lru->head->next;
+			g_hash_table_remove (db_interface->dynamic_statements,
+			                     (gpointer) sqlite3_sql (stmt_lru->head->stmt));
+			stmt_lru->size--;
+			stmt_lru->head = new_head;
+			stmt_lru->tail->next = new_head;
+			new_head->prev = stmt_lru->tail;
+
+			stmt_lru->evictions++;
+			stmt_lru->window_evictions++;
+			statement_cache_metrics_evict (cache_type);
+		} while (stmt_lru->size >= stmt_lru->max);
 	} else {
 		if (stmt_lru->size == 0) {
 			stmt_lru->head = stmt;
@@ -2180,8 +2444,20 @@ tracker_db_interface_create_statement (TrackerDBInterface           *db_interfac
 	tracker_db_interface_lock (db_interface);
 
 	if (cache_type != TRACKER_DB_STATEMENT_CACHE_TYPE_NONE) {
+		TrackerDBStatementCacheType requested_type = cache_type;
+
 		stmt = tracker_db_interface_lru_lookup (db_interface, &cache_type,
 		                                        full_query);
+		statement_cache_metrics_add (requested_type, stmt != NULL);
+		tracker_db_statement_lru_account (requested_type == TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE ?
+		                                  &db_interface->update_stmt_lru :
+		                                  &db_interface->select_stmt_lru,
+		                                  stmt != NULL);
+
+		if (requested_type == TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT &&
+		    db_interface->statement_hook) {
+			tracker_db_interface_add_statement_use (db_interface, full_query);
+		}
 	}
 
 	if (!stmt) {
@@ -2215,6 +2491,57 @@ tracker_db_interface_create_statement (TrackerDBInterface           *db_interfac
 	return g_object_ref_sink (stmt);
 }
 
+/* Prepares a statement into the SELECT statement cache, without it
+ * counting as a use.
+ */
+gboolean
+tracker_db_interface_sqlite_prepare_cached (TrackerDBInterface  *db_interface,
+                                            const gchar         *query,
+                                            GError             **error)
+{
+	TrackerDBStatement *stmt;
+	sqlite3_stmt *sqlite_stmt;
+
+	g_return_val_if_fail (TRACKER_IS_DB_INTERFACE (db_interface), FALSE);
+	g_return_val_if_fail (query != NULL, FALSE);
+
+	tracker_db_interface_lock (db_interface);
+
+	if (g_hash_table_contains (db_interface->dynamic_statements, query)) {
+		tracker_db_interface_unlock (db_interface);
+		return TRUE;
+	}
+
+	sqlite_stmt = tracker_db_interface_prepare_stmt (db_interface, query, error);
+
+	if (sqlite_stmt) {
+		stmt = tracker_db_statement_sqlite_new (db_interface, sqlite_stmt);
+		tracker_db_interface_lru_insert_unchecked (db_interface,
+		                                           TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+		                                           stmt);
+	}
+
+	tracker_db_interface_unlock (db_interface);
+
+	return sqlite_stmt != NULL;
+}
+
+gboolean
+tracker_db_interface_has_cached_statement (TrackerDBInterface *db_interface,
+                                           const gchar        *query)
+{
+	gboolean cached;
+
+	g_return_val_if_fail (TRACKER_IS_DB_INTERFACE (db_interface), FALSE);
+	g_return_val_if_fail (query != NULL, FALSE);
+
+	tracker_db_interface_lock (db_interface);
+	cached = g_hash_table_contains (db_interface->dynamic_statements, query);
+	tracker_db_interface_unlock (db_interface);
+
+	return cached;
+}
+
 static void
 execute_stmt (TrackerDBInterface  *interface,
               sqlite3_stmt        *stmt,
@@ -2358,6 +2685,87 @@ tracker_db_interface_sqlite_get_last_insert_id (TrackerDBInterface *interface)
 	return (gint64) sqlite3_last_insert_rowid (interface->db);
 }
 
+gint
+tracker_db_interface_sqlite_get_n_changes (TrackerDBInterface *interface)
+{
+	g_return_val_if_fail (TRACKER_IS_DB_INTERFACE (interface), 0);
+
+	return sqlite3_changes (interface->db);
+}
+
+static gint
+compare_ids (gconstpointer a,
+             gconstpointer b)
+{
+	return *((const gint *) a) - *((const gint *) b);
+}
+
+/* Applies the Refcount changes accumulated by the triggers since the
+ * last call, in ID order so the Resource B-tree is walked forward once.
+ */
+gboolean
+tracker_db_interface_sqlite_flush_refcounts (TrackerDBInterface  *interface,
+                                             GError             **error)
+{
+	TrackerDBStatement *stmt;
+	GHashTableIter iter;
+	gpointer key, value;
+	GArray *ids;
+	GError *inner_error = NULL;
+	guint i;
+
+	g_return_val_if_fail (TRACKER_IS_DB_INTERFACE (interface), FALSE);
+
+	if (g_hash_table_size (interface->refcount_deltas) == 0)
+		return TRUE;
+
+	ids = g_array_sized_new (FALSE, FALSE, sizeof (gint),
+	                         g_hash_table_size (interface->refcount_deltas));
+
+	g_hash_table_iter_init (&iter, interface->refcount_deltas);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		gint id = GPOINTER_TO_INT (key);
+		g_array_append_val (ids, id);
+	}
+
+	g_array_sort (ids, compare_ids);
+
+	stmt = tracker_db_interface_create_statement (interface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                              &inner_error,
+	                                              "UPDATE Resource SET Refcount = Refcount + ? WHERE ID = ?");
+
+	for (i = 0; stmt && i < ids->len; i++) {
+		gint id = g_array_index (ids, gint, i);
+
+		value = g_hash_table_lookup (interface->refcount_deltas, GINT_TO_POINTER (id));
+		tracker_db_statement_bind_int (stmt, 0, GPOINTER_TO_INT (value));
+		tracker_db_statement_bind_int (stmt, 1, id);
+		tracker_db_statement_execute (stmt, &inner_error);
+
+		if (inner_error)
+			break;
+	}
+
+	g_clear_object (&stmt);
+	g_array_unref (ids);
+	g_hash_table_remove_all (interface->refcount_deltas);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void
+tracker_db_interface_sqlite_discard_refcounts (TrackerDBInterface *interface)
+{
+	g_return_if_fail (TRACKER_IS_DB_INTERFACE (interface));
+
+	g_hash_table_remove_all (interface->refcount_deltas);
+}
+
 static void
 tracker_db_statement_finalize (GObject *object)
 {
@@ -35,6 +35,9 @@ G_BEGIN_DECLS
 
 typedef void (*TrackerDBWalCallback) (TrackerDBInterface *iface,
                                       gint                n_pages);
+typedef void (*TrackerDBStatementCallback) (TrackerDBInterface *iface,
+                                            GHashTable         *uses,
+                                            gpointer            user_data);
 
 typedef enum {
 	TRACKER_DB_INTERFACE_READONLY  = 1 << 0,
@@ -45,6 +48,10 @@ TrackerDBInterface *tracker_db_interface_sqlite_new                    (const gc
                                                                         TrackerDBInterfaceFlags   flags,
                                                                         GError                  **error);
 gint64              tracker_db_interface_sqlite_get_last_insert_id     (TrackerDBInterface       *interface);
+gint                tracker_db_interface_sqlite_get_n_changes          (TrackerDBInterface       *interface);
+gboolean            tracker_db_interface_sqlite_flush_refcounts        (TrackerDBInterface       *interface,
+                                                                        GError                  **error);
+void                tracker_db_interface_sqlite_discard_refcounts      (TrackerDBInterface       *interface);
 void                tracker_db_interface_sqlite_enable_shared_cache    (void);
 void                tracker_db_interface_sqlite_fts_init               (TrackerDBInterface       *interface,
                                                                         GHashTable               *properties,
@@ -56,6 +63,12 @@ void                tracker_db_interface_sqlite_wal_hook               (TrackerD
 gboolean            tracker_db_interface_sqlite_wal_checkpoint         (TrackerDBInterface       *interface,
                                                                         gboolean                  blocking,
                                                                         GError                  **error);
+void                tracker_db_interface_sqlite_statement_hook         (TrackerDBInterface       *interface,
+                                                                        TrackerDBStatementCallback callback,
+                                                                        gpointer                  user_data);
+gboolean            tracker_db_interface_sqlite_prepare_cached         (TrackerDBInterface       *interface,
+                                                                        const gchar              *query,
+                                                                        GError                  **error);
 
 
 #if HAVE_TRACKER_FTS
@@ -74,6 +74,14 @@ typedef enum {
 	TRACKER_DB_STATEMENT_CACHE_TYPE_NONE
 } TrackerDBStatementCacheType;
 
+typedef struct {
+	guint hits;
+	guint misses;
+	guint evictions;
+	guint size;
+	guint max_size;
+} TrackerDBStatementCacheStats;
+
 typedef struct TrackerDBInterface      TrackerDBInterface;
 typedef struct TrackerDBInterfaceClass TrackerDBInterfaceClass;
 typedef struct TrackerDBStatement      TrackerDBStatement;
@@ -90,6 +98,9 @@ GType                   tracker_db_cursor_get_type                   (void);
 void                    tracker_db_interface_set_max_stmt_cache_size (TrackerDBInterface         *db_interface,
                                                                       TrackerDBStatementCacheType cache_type,
                                                                       guint                       max_size);
+void                    tracker_db_interface_get_stmt_cache_stats    (TrackerDBInterface           *db_interface,
+                                                                      TrackerDBStatementCacheType   cache_type,
+                                                                      TrackerDBStatementCacheStats *stats);
 
 /* User data functions, mainly to attach the data manager */
 void                    tracker_db_interface_set_user_data           (TrackerDBInterface         *interface,
@@ -111,6 +122,8 @@ void                    tracker_db_interface_execute_query           (TrackerDBI
                                                                       GError                     **error,
                                                                       const gchar                 *query,
                                                                        ...) G_GNUC_PRINTF (3, 4);
+gboolean                tracker_db_interface_has_cached_statement    (TrackerDBInterface          *interface,
+                                                                      const gchar                 *query);
 
 gboolean                tracker_db_interface_start_transaction       (TrackerDBInterface         *interface);
 gboolean                tracker_db_interface_end_db_transaction      (TrackerDBInterface         *interface,
@@ -32,6 +32,9 @@
 #include <stdlib.h>
 
 #include <glib/gstdio.h>
+#include <gio/gfiledescriptorbased.h>
+
+#include <libtracker-common/tracker-common.h>
 
 #ifndef O_LARGEFILE
 # define O_LARGEFILE 0
@@ -44,6 +47,10 @@
 
 #define MIN_BLOCK_SIZE    1024
 
+/* Snapshots of the live data replace all chunks up to their number */
+#define SNAPSHOT_SUFFIX     ".snapshot.gz"
+#define SNAPSHOT_TMP_SUFFIX ".snapshot.tmp"
+
 /*
  * data_format:
  * #... 0000 0000 (total size is 4 bytes)
@@ -91,6 +98,7 @@ struct _TrackerDBJournalReader {
 	gint o_id;
 	gchar *object;
 	guint current_file;
+	guint first_chunk;
 	guint total_chunks;
 };
 
@@ -108,6 +116,7 @@ struct _TrackerDBJournal {
 	TransactionFormat transaction_format;
 	gboolean in_transaction;
 	gint cur_journal_file;
+	gboolean is_snapshot;
 };
 
 static struct {
@@ -118,6 +127,7 @@ static struct {
 } rotating_settings = {0};
 
 static gboolean tracker_db_journal_rotate (TrackerDBJournal  *jwriter,
+                                           gboolean           compress,
                                            GError           **error);
 
 #ifndef HAVE_STRNLEN
@@ -347,6 +357,36 @@ tracker_db_journal_set_rotating (gboolean     do_rotating,
 	}
 }
 
+/* Parses rotated chunk and snapshot file names, e.g.
+ * "tracker-store.journal.3.gz" or "tracker-store.journal.5.snapshot.gz".
+ * Returns the suffix after the chunk number, or NULL if @filename
+ * is not one of these.
+ */
+static const gchar *
+parse_chunk_filename (const gchar *filename,
+                      const gchar *journal_basename,
+                      guint       *chunk)
+{
+	const gchar *ptr;
+	gchar *end;
+	guint64 num;
+
+	if (!g_str_has_prefix (filename, journal_basename))
+		return NULL;
+
+	ptr = filename + strlen (journal_basename);
+	if (ptr[0] != '.' || !g_ascii_isdigit (ptr[1]))
+		return NULL;
+
+	num = g_ascii_strtoull (ptr + 1, &end, 10);
+	if (num == 0 || num > G_MAXINT)
+		return NULL;
+
+	*chunk = (guint) num;
+
+	return end;
+}
+
 static gint
 nearest_pow (gint num)
 {
@@ -404,6 +444,37 @@ cur_setstr (gchar       *dest,
 	memset (dest + (*pos)++, 0 & 0xff, 1);
 }
 
+static TrackerMetric *
+journal_bytes_metric (void)
+{
+	static TrackerMetric *metric = NULL;
+
+	if (g_once_init_enter (&metric)) {
+		g_once_init_leave (&metric,
+		                   tracker_metrics_counter ("tracker_data_journal_written_bytes_total",
+		                                            NULL,
+		                                            "Bytes written to the journal"));
+	}
+
+	return metric;
+}
+
+static TrackerMetric *
+journal_fsync_metric (void)
+{
+	static TrackerMetric *metric = NULL;
+
+	if (g_once_init_enter (&metric)) {
+		g_once_init_leave (&metric,
+		                   tracker_metrics_histogram ("tracker_data_journal_fsync_duration_seconds",
+		                                              NULL,
+		                                              "Time spent in fsync() on the journal",
+		                                              NULL, 0));
+	}
+
+	return metric;
+}
+
 static gboolean
 write_all_data (int      fd,
                 gchar   *data,
@@ -412,6 +483,8 @@ write_all_data (int      fd,
 {
 	gssize written;
 
+	tracker_metric_add (journal_bytes_metric (), len);
+
 	while (len > 0) {
 		written = write (fd, data, len);
 
@@ -1095,9 +1168,9 @@ tracker_db_journal_commit_db_transaction (TrackerDBJournal  *writer,
 
 	ret = db_journal_writer_commit_db_transaction (writer, &n_error);
 
-	if (ret && writer->transaction_format == TRANSACTION_FORMAT_DATA) {
+	if (ret && writer->transaction_format == TRANSACTION_FORMAT_DATA && !writer->is_snapshot) {
 		if (rotating_settings.do_rotating && (writer->cur_size > rotating_settings.chunk_size)) {
-			ret = tracker_db_journal_rotate (writer, &n_error);
+			ret = tracker_db_journal_rotate (writer, TRUE, &n_error);
 		}
 	}
 
@@ -1113,9 +1186,17 @@ tracker_db_journal_commit_db_transaction (TrackerDBJournal  *writer,
 gboolean
 tracker_db_journal_fsync (TrackerDBJournal *writer)
 {
+	gint64 start_time;
+	gboolean retval;
+
 	g_return_val_if_fail (writer->journal > 0, FALSE);
 
-	return fsync (writer->journal) == 0;
+	start_time = g_get_monotonic_time ();
+	retval = (fsync (writer->journal) == 0);
+	tracker_metric_observe (journal_fsync_metric (),
+	                        (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC);
+
+	return retval;
 }
 
 /*
@@ -1231,6 +1312,48 @@ db_journal_reader_init_file (TrackerDBJournalReader  *jreader,
 	return TRUE;
 }
 
+/* Looks for the most recent snapshot next to @filename, replay
+ * starts there instead of at the first rotated chunk.
+ */
+static gchar *
+reader_find_snapshot (const gchar *filename,
+                      guint       *chunk)
+{
+	gchar *directory, *basename, *path = NULL;
+	const gchar *f_name, *suffix;
+	guint cur, last = 0;
+	GDir *journal_dir;
+
+	directory = g_path_get_dirname (filename);
+	basename = g_path_get_basename (filename);
+	journal_dir = g_dir_open (directory, 0, NULL);
+
+	if (journal_dir) {
+		while ((f_name = g_dir_read_name (journal_dir)) != NULL) {
+			suffix = parse_chunk_filename (f_name, basename, &cur);
+
+			if (suffix && strcmp (suffix, SNAPSHOT_SUFFIX) == 0)
+				last = MAX (last, cur);
+		}
+
+		g_dir_close (journal_dir);
+	}
+
+	if (last > 0) {
+		gchar *name;
+
+		name = g_strdup_printf ("%s.%u" SNAPSHOT_SUFFIX, basename, last);
+		path = g_build_filename (directory, name, NULL);
+		g_free (name);
+		*chunk = last;
+	}
+
+	g_free (basename);
+	g_free (directory);
+
+	return path;
+}
+
 static gboolean
 db_journal_reader_init (TrackerDBJournalReader  *jreader,
                         gboolean                 global_reader,
@@ -1247,8 +1370,14 @@ db_journal_reader_init (TrackerDBJournalReader  *jreader,
 	g_set_object (&jreader->journal_location, data_location);
 
 	jreader->current_file = 0;
+	jreader->first_chunk = 0;
 	if (global_reader) {
-		filename_open = reader_get_next_filepath (jreader);
+		filename_open = reader_find_snapshot (filename, &jreader->first_chunk);
+
+		if (filename_open)
+			jreader->current_file = jreader->first_chunk;
+		else
+			filename_open = reader_get_next_filepath (jreader);
 	} else {
 		filename_open = g_strdup (filename);
 	}
@@ -1865,17 +1994,19 @@ gdouble
 tracker_db_journal_reader_get_progress (TrackerDBJournalReader *reader)
 {
 	gdouble chunk = 0, total = 0, ret = 0;
-	guint current_file;
+	guint current_file, offset;
 	guint total_chunks = reader->total_chunks;
 
-	current_file = reader->current_file == 0 ? reader->total_chunks -1 : reader->current_file -1;
+	/* A snapshot counts as the first chunk */
+	offset = reader->first_chunk > 0 ? reader->first_chunk - 1 : 0;
+	current_file = reader->current_file == 0 ? reader->total_chunks -1 : reader->current_file - 1 - offset;
 
 	if (reader->total_chunks == 0) {
 		gchar *test;
 		GFile *dest_dir;
 		gboolean cont = TRUE;
 
-		total_chunks = 0;
+		total_chunks = reader->first_chunk > 0 ? 1 : 0;
 
 		test = g_path_get_basename (reader->filename);
 
@@ -1896,7 +2027,7 @@ tracker_db_journal_reader_get_progress (TrackerDBJournalReader *reader)
 			gchar *filename;
 			GFile *possible;
 
-			test = g_strdup_printf ("%s.%d", reader->filename, total_chunks + 1);
+			test = g_strdup_printf ("%s.%d", reader->filename, offset + total_chunks + 1);
 			filename = g_path_get_basename (test);
 			g_free (test);
 			test = filename;
@@ -1961,6 +2092,10 @@ on_chunk_copied_delete (GObject      *source_object,
 	g_output_stream_splice_finish (ostream, res, &error);
 	if (!error) {
 		g_file_delete (G_FILE (source), NULL, &error);
+
+		/* A snapshot might have superseded the chunk meanwhile */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+			g_clear_error (&error);
 	}
 
 	g_object_unref (source);
@@ -1973,6 +2108,7 @@ on_chunk_copied_delete (GObject      *source_object,
 
 static gboolean
 tracker_db_journal_rotate (TrackerDBJournal  *writer,
+                           gboolean           compress,
                            GError           **error)
 {
 	GFile *source, *destination;
@@ -2046,6 +2182,14 @@ tracker_db_journal_rotate (TrackerDBJournal  *writer,
 	/* Recalculate progress next time */
 	rotating_settings.rotate_progress_flag = FALSE;
 
+	if (!compress) {
+		/* The chunk is left for the caller, readers handle
+		 * uncompressed chunks just as well.
+		 */
+		g_free (fullpath);
+		goto reopen;
+	}
+
 	source = g_file_new_for_path (fullpath);
 	if (rotating_settings.rotate_to) {
 		dest_dir = g_file_new_for_path (rotating_settings.rotate_to);
@@ -2074,6 +2218,7 @@ tracker_db_journal_rotate (TrackerDBJournal  *writer,
 
 	g_free (fullpath);
 
+reopen:
 	ret = db_journal_init_file (writer, TRUE, &n_error);
 
 	if (n_error) {
@@ -2153,6 +2298,329 @@ tracker_db_journal_remove (TrackerDBJournal *writer)
 	g_free (path);
 }
 
+/* Rotates the journal right away, regardless of its size. The chunk
+ * is left uncompressed, its number is returned in @chunk. Entries
+ * written afterwards go to later chunks.
+ */
+gboolean
+tracker_db_journal_rotate_now (TrackerDBJournal  *writer,
+                               guint             *chunk,
+                               GError           **error)
+{
+	g_return_val_if_fail (writer->journal > 0, FALSE);
+	g_return_val_if_fail (writer->in_transaction == FALSE, FALSE);
+	g_return_val_if_fail (writer->transaction_format == TRANSACTION_FORMAT_DATA, FALSE);
+
+	if (!tracker_db_journal_rotate (writer, FALSE, error))
+		return FALSE;
+
+	if (chunk)
+		*chunk = writer->cur_journal_file;
+
+	return TRUE;
+}
+
+static gsize
+get_chunks_size (const gchar *directory,
+                 guint        after_chunk)
+{
+	const gchar *f_name, *suffix;
+	GDir *journal_dir;
+	gsize size = 0;
+	guint cur;
+
+	journal_dir = g_dir_open (directory, 0, NULL);
+	if (!journal_dir)
+		return 0;
+
+	while ((f_name = g_dir_read_name (journal_dir)) != NULL) {
+		struct stat st;
+		gchar *fullpath;
+
+		suffix = parse_chunk_filename (f_name, TRACKER_DB_JOURNAL_FILENAME, &cur);
+
+		if (!suffix || cur <= after_chunk)
+			continue;
+		if (*suffix != '\0' && strcmp (suffix, ".gz") != 0)
+			continue;
+
+		fullpath = g_build_filename (directory, f_name, NULL);
+		if (g_stat (fullpath, &st) == 0)
+			size += st.st_size;
+		g_free (fullpath);
+	}
+
+	g_dir_close (journal_dir);
+
+	return size;
+}
+
+/* Returns the bytes on disk that a replay reads after the most recent
+ * snapshot: the rotated chunks that follow it, plus the active journal.
+ * The size of the snapshot itself is returned in @snapshot_size.
+ */
+gsize
+tracker_db_journal_get_tail_size (TrackerDBJournal *writer,
+                                  gsize            *snapshot_size)
+{
+	gchar *directory, *snapshot;
+	guint snapshot_chunk = 0;
+	gsize tail;
+
+	g_return_val_if_fail (writer->journal > 0, 0);
+
+	if (snapshot_size)
+		*snapshot_size = 0;
+
+	snapshot = reader_find_snapshot (writer->journal_filename, &snapshot_chunk);
+	if (snapshot) {
+		struct stat st;
+
+		if (snapshot_size && g_stat (snapshot, &st) == 0)
+			*snapshot_size = st.st_size;
+		g_free (snapshot);
+	}
+
+	directory = g_path_get_dirname (writer->journal_filename);
+	tail = writer->cur_size + get_chunks_size (directory, snapshot_chunk);
+
+	if (rotating_settings.rotate_to &&
+	    g_strcmp0 (rotating_settings.rotate_to, directory) != 0) {
+		tail += get_chunks_size (rotating_settings.rotate_to, snapshot_chunk);
+	}
+
+	g_free (directory);
+
+	return tail;
+}
+
+/* Snapshots are written as a regular journal next to the active one,
+ * holding the live data at the end of rotated chunk @chunk. They are
+ * put in place by tracker_db_journal_snapshot_install().
+ */
+TrackerDBJournal *
+tracker_db_journal_snapshot_new (GFile   *data_location,
+                                 guint    chunk,
+                                 GError **error)
+{
+	TrackerDBJournal *writer;
+	gchar *name, *filename;
+	GError *n_error = NULL;
+	GFile *child;
+	gboolean ret;
+
+	g_return_val_if_fail (chunk > 0, NULL);
+
+	writer = g_new0 (TrackerDBJournal, 1);
+	writer->transaction_format = TRANSACTION_FORMAT_DATA;
+	writer->is_snapshot = TRUE;
+	writer->cur_journal_file = chunk;
+
+	name = g_strdup_printf (TRACKER_DB_JOURNAL_FILENAME ".%u" SNAPSHOT_TMP_SUFFIX, chunk);
+	child = g_file_get_child (data_location, name);
+	filename = g_file_get_path (child);
+	g_object_unref (child);
+	g_free (name);
+
+	ret = db_journal_writer_init (writer, TRUE, FALSE, filename, data_location, &n_error);
+	g_free (filename);
+
+	if (!ret) {
+		g_propagate_error (error, n_error);
+		g_clear_pointer (&writer, g_free);
+	}
+
+	return writer;
+}
+
+static void
+remove_superseded_chunks (const gchar *directory,
+                          guint        chunk)
+{
+	const gchar *f_name, *suffix;
+	GDir *journal_dir;
+	guint cur;
+
+	journal_dir = g_dir_open (directory, 0, NULL);
+	if (!journal_dir)
+		return;
+
+	while ((f_name = g_dir_read_name (journal_dir)) != NULL) {
+		gchar *fullpath;
+
+		suffix = parse_chunk_filename (f_name, TRACKER_DB_JOURNAL_FILENAME, &cur);
+
+		/* Leftovers of interrupted compressions are older, too */
+		if (!suffix || cur > chunk)
+			continue;
+		if (cur == chunk && strcmp (suffix, SNAPSHOT_SUFFIX) == 0)
+			continue;
+
+		fullpath = g_build_filename (directory, f_name, NULL);
+		if (g_unlink (fullpath) == -1) {
+			g_info ("Could not unlink superseded journal chunk: %m");
+		}
+		g_free (fullpath);
+	}
+
+	g_dir_close (journal_dir);
+}
+
+/* Makes a rename within @directory durable */
+static gboolean
+fsync_directory (const gchar  *directory,
+                 GError      **error)
+{
+	gint fd;
+
+	fd = g_open (directory, O_RDONLY | O_DIRECTORY, 0);
+
+	if (fd < 0 || fsync (fd) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+		             "Could not sync directory '%s': %m", directory);
+		if (fd >= 0)
+			close (fd);
+		return FALSE;
+	}
+
+	close (fd);
+	return TRUE;
+}
+
+/* Compresses the snapshot and makes it the starting point of replays,
+ * the rotated chunks it supersedes are removed. @snapshot is freed.
+ *
+ * The superseded chunks are only removed once the snapshot and its
+ * rename are on disk, a crash at any point leaves either the chunks or
+ * a complete snapshot to replay from.
+ */
+gboolean
+tracker_db_journal_snapshot_install (TrackerDBJournal  *snapshot,
+                                     GError           **error)
+{
+	GFile *source, *destination, *tmp_destination;
+	GConverter *converter;
+	GInputStream *istream;
+	GOutputStream *ostream, *cstream;
+	gchar *directory, *name, *path;
+	guint chunk;
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (snapshot->is_snapshot, FALSE);
+	g_return_val_if_fail (snapshot->in_transaction == FALSE, FALSE);
+
+	chunk = snapshot->cur_journal_file;
+	path = g_strdup (snapshot->journal_filename);
+	directory = g_path_get_dirname (path);
+	source = g_file_new_for_path (path);
+
+	tracker_db_journal_fsync (snapshot);
+
+	if (!tracker_db_journal_free (snapshot, error)) {
+		g_file_delete (source, NULL, NULL);
+		g_object_unref (source);
+		g_free (directory);
+		g_free (path);
+		return FALSE;
+	}
+
+	/* Compress into a temporary file first, so a snapshot is
+	 * either complete or missing.
+	 */
+	name = g_strconcat (path, ".gz", NULL);
+	tmp_destination = g_file_new_for_path (name);
+	g_free (name);
+
+	name = g_strdup_printf ("%s" G_DIR_SEPARATOR_S TRACKER_DB_JOURNAL_FILENAME ".%u" SNAPSHOT_SUFFIX,
+	                        directory, chunk);
+	destination = g_file_new_for_path (name);
+	g_free (name);
+
+	istream = G_INPUT_STREAM (g_file_read (source, NULL, error));
+	ostream = istream ? G_OUTPUT_STREAM (g_file_replace (tmp_destination, NULL, FALSE,
+	                                                     G_FILE_CREATE_NONE, NULL, error)) : NULL;
+
+	if (ostream) {
+		converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+		cstream = g_converter_output_stream_new (ostream, converter);
+		g_filter_output_stream_set_close_base_stream (G_FILTER_OUTPUT_STREAM (cstream), FALSE);
+		g_object_unref (converter);
+
+		/* Closing the converter writes the gzip trailer, the
+		 * file itself is synced before being closed.
+		 */
+		ret = g_output_stream_splice (cstream, istream,
+		                              G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+		                              G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+		                              NULL, error) >= 0;
+		g_object_unref (cstream);
+
+		if (ret && fsync (g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (ostream))) != 0) {
+			g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			             "Could not sync journal snapshot: %m");
+			ret = FALSE;
+		}
+
+		if (!g_output_stream_close (ostream, NULL, ret ? error : NULL))
+			ret = FALSE;
+
+		g_object_unref (ostream);
+	}
+
+	g_clear_object (&istream);
+
+	if (ret) {
+		ret = g_file_move (tmp_destination, destination,
+		                   G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, error);
+	}
+
+	if (ret) {
+		/* The rename must hit the disk before anything
+		 * it supersedes is removed.
+		 */
+		ret = fsync_directory (directory, error);
+	}
+
+	if (!ret)
+		g_file_delete (tmp_destination, NULL, NULL);
+
+	g_file_delete (source, NULL, NULL);
+
+	if (ret) {
+		remove_superseded_chunks (directory, chunk);
+
+		if (rotating_settings.rotate_to &&
+		    g_strcmp0 (rotating_settings.rotate_to, directory) != 0) {
+			remove_superseded_chunks (rotating_settings.rotate_to, chunk);
+		}
+	}
+
+	g_object_unref (tmp_destination);
+	g_object_unref (destination);
+	g_object_unref (source);
+	g_free (directory);
+	g_free (path);
+
+	return ret;
+}
+
+/* Drops an unfinished snapshot, @snapshot is freed. */
+void
+tracker_db_journal_snapshot_discard (TrackerDBJournal *snapshot)
+{
+	gchar *path;
+
+	g_return_if_fail (snapshot->is_snapshot);
+
+	path = g_strdup (snapshot->journal_filename);
+	tracker_db_journal_free (snapshot, NULL);
+
+	if (path)
+		g_unlink (path);
+
+	g_free (path);
+}
+
 #else /* DISABLE_JOURNAL */
 void
 tracker_db_journal_set_rotating (gboolean     do_rotating,
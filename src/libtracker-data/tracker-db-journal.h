@@ -129,6 +129,23 @@ gboolean     tracker_db_journal_truncate                     (TrackerDBJournal
 
 void         tracker_db_journal_remove                       (TrackerDBJournal *writer);
 
+gboolean     tracker_db_journal_rotate_now                   (TrackerDBJournal   *writer,
+                                                              guint              *chunk,
+                                                              GError            **error);
+gsize        tracker_db_journal_get_tail_size                (TrackerDBJournal   *writer,
+                                                              gsize              *snapshot_size);
+
+/*
+ * Snapshot API
+ */
+TrackerDBJournal *
+             tracker_db_journal_snapshot_new                 (GFile        *data_location,
+                                                              guint         chunk,
+                                                              GError      **error);
+gboolean     tracker_db_journal_snapshot_install             (TrackerDBJournal  *snapshot,
+                                                              GError           **error);
+void         tracker_db_journal_snapshot_discard             (TrackerDBJournal  *snapshot);
+
 /*
  * Reader API
  */
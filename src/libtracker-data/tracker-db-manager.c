@@ -54,9 +54,16 @@
 #define MAX_INTERFACES_PER_CPU        16
 #define MAX_INTERFACES                (MAX_INTERFACES_PER_CPU * g_get_num_processors ())
 
+/* Hottest SELECT statements prepared on new pooled interfaces */
+#define MAX_WARM_STATEMENTS           32
+/* Tracked statements before usage counts decay */
+#define MAX_HOT_STATEMENTS            512
+
 /* Required minimum space needed to create databases (5Mb) */
 #define TRACKER_DB_MIN_REQUIRED_SPACE 5242880
 
+#define TRACKER_DB_AUTO_VACUUM_INCREMENTAL 2
+
 /* Default memory settings for databases */
 #define TRACKER_DB_PAGE_SIZE_DONT_SET -1
 
@@ -65,12 +72,12 @@
 #define TRACKER_DB_VERSION_FILE       "db-version.txt"
 #define TRACKER_DB_LOCALE_FILE        "db-locale.txt"
 
-#define TRACKER_VACUUM_CHECK_SIZE     ((goffset) 4 * 1024 * 1024 * 1024) /* 4GB */
-
 #define IN_USE_FILENAME               ".meta.isrunning"
 
 #define PARSER_VERSION_FILENAME       "parser-version.txt"
 
+#define FTS_REBUILD_PENDING_FILENAME  "fts-rebuild-pending"
+
 #define TOSTR(x) #x
 #define TRACKER_PARSER_VERSION_STRING TOSTR(TRACKER_PARSER_VERSION)
 
@@ -108,7 +115,6 @@ typedef struct {
 	const gchar        *file;
 	const gchar        *name;
 	gchar              *abs_filename;
-	gint                cache_size;
 	gint                page_size;
 	gboolean            attached;
 	gboolean            is_index;
@@ -120,7 +126,6 @@ static TrackerDBDefinition db_base = {
 	"meta.db",
 	"meta",
 	NULL,
-	TRACKER_DB_CACHE_SIZE_DEFAULT,
 	8192,
 	FALSE,
 	FALSE,
@@ -142,6 +147,28 @@ struct _TrackerDBManager {
 	GWeakRef iface_data;
 
 	GAsyncQueue *interfaces;
+	GThreadPool *interface_grower;
+	gint growing;
+
+	/* SQL string -> use count of pooled SELECT statements */
+	GMutex hot_statements_mutex;
+	GHashTable *hot_statements;
+};
+
+typedef struct {
+	gint cache_size;
+	gint64 mmap_size;
+	const gchar *temp_store;
+} TrackerDBRoleParams;
+
+/* Writers want a large page cache for index updates, pooled readers
+ * get memory mapped I/O instead, and the WAL checkpointer hardly
+ * needs any cache at all.
+ */
+static TrackerDBRoleParams role_params[TRACKER_DB_N_ROLES] = {
+	{ TRACKER_DB_CACHE_SIZE_UPDATE, 0, "FILE" },
+	{ TRACKER_DB_CACHE_SIZE_DEFAULT, TRACKER_DB_MMAP_SIZE_DEFAULT, "MEMORY" },
+	{ TRACKER_DB_CACHE_SIZE_CHECKPOINT, 0, "FILE" },
 };
 
 static gboolean            db_exec_no_reply                        (TrackerDBInterface   *iface,
@@ -149,8 +176,11 @@ static gboolean            db_exec_no_reply                        (TrackerDBInt
                                                                     ...);
 static TrackerDBInterface *tracker_db_manager_create_db_interface   (TrackerDBManager    *db_manager,
                                                                      gboolean             readonly,
+                                                                     TrackerDBRole        role,
                                                                      GError             **error);
 static void                db_remove_locale_file                    (TrackerDBManager    *db_manager);
+static void                grow_interface_pool                      (gpointer             data,
+                                                                     gpointer             user_data);
 
 static gboolean
 db_exec_no_reply (TrackerDBInterface *iface,
@@ -182,11 +212,11 @@ tracker_db_manager_get_flags (TrackerDBManager *db_manager,
 
 static void
 db_set_params (TrackerDBInterface   *iface,
-               gint                  cache_size,
                gint                  page_size,
-               gboolean              readonly,
+               TrackerDBRole         role,
                GError              **error)
 {
+	const TrackerDBRoleParams *params = &role_params[role];
 	GError *internal_error = NULL;
 	TrackerDBStatement *stmt;
 
@@ -196,13 +226,13 @@ db_set_params (TrackerDBInterface   *iface,
 	tracker_db_interface_execute_query (iface, NULL, "PRAGMA synchronous = OFF;");
 #endif /* DISABLE_JOURNAL */
 	tracker_db_interface_execute_query (iface, NULL, "PRAGMA encoding = \"UTF-8\"");
-	tracker_db_interface_execute_query (iface, NULL, "PRAGMA auto_vacuum = 0;");
+	/* Only effective on databases being created, existing ones
+	 * are converted by tracker_db_manager_check_perform_vacuum() during
+	 * background maintenance.
+	 */
+	tracker_db_interface_execute_query (iface, NULL, "PRAGMA auto_vacuum = INCREMENTAL;");
 
-	if (readonly) {
-		tracker_db_interface_execute_query (iface, NULL, "PRAGMA temp_store = MEMORY;");
-	} else {
-		tracker_db_interface_execute_query (iface, NULL, "PRAGMA temp_store = FILE;");
-	}
+	tracker_db_interface_execute_query (iface, NULL, "PRAGMA temp_store = %s;", params->temp_store);
 
 	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
 	                                              &internal_error,
@@ -241,8 +271,12 @@ db_set_params (TrackerDBInterface   *iface,
 		tracker_db_interface_execute_query (iface, NULL, "PRAGMA page_size = %d", page_size);
 	}
 
-	tracker_db_interface_execute_query (iface, NULL, "PRAGMA cache_size = %d", cache_size);
-	g_info ("  Setting cache size to %d", cache_size);
+	tracker_db_interface_execute_query (iface, NULL, "PRAGMA cache_size = %d", params->cache_size);
+	g_info ("  Setting cache size to %d", params->cache_size);
+
+	tracker_db_interface_execute_query (iface, NULL, "PRAGMA mmap_size = %" G_GINT64_FORMAT,
+	                                    params->mmap_size);
+	g_info ("  Setting mmap size to %" G_GINT64_FORMAT, params->mmap_size);
 }
 
 void
@@ -498,7 +532,9 @@ db_recreate_all (TrackerDBManager  *db_manager,
 	/* Now create the databases and close them */
 	g_info ("Creating database files, this may take a few moments...");
 
-	db_manager->db.iface = tracker_db_manager_create_db_interface (db_manager, FALSE, &internal_error);
+	db_manager->db.iface = tracker_db_manager_create_db_interface (db_manager, FALSE,
+	                                                               TRACKER_DB_ROLE_WRITER,
+	                                                               &internal_error);
 	if (internal_error) {
 		g_propagate_error (error, internal_error);
 		return;
@@ -612,6 +648,11 @@ tracker_db_manager_new (TrackerDBManagerFlags   flags,
 	db_manager->s_cache_size = select_cache_size;
 	db_manager->u_cache_size = update_cache_size;
 	db_manager->interfaces = g_async_queue_new_full (g_object_unref);
+	db_manager->interface_grower = g_thread_pool_new (grow_interface_pool, db_manager,
+	                                                  1, FALSE, NULL);
+	db_manager->hot_statements = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                                    g_free, g_free);
+	g_mutex_init (&db_manager->hot_statements_mutex);
 
 	g_set_object (&db_manager->cache_location, cache_location);
 	g_set_object (&db_manager->data_location, data_location);
@@ -760,7 +801,9 @@ tracker_db_manager_new (TrackerDBManagerFlags   flags,
 			}
 
 			if (!must_recreate) {
-				db_manager->db.iface = tracker_db_manager_create_db_interface (db_manager, FALSE, &internal_error);
+				db_manager->db.iface = tracker_db_manager_create_db_interface (db_manager, FALSE,
+				                                                               TRACKER_DB_ROLE_WRITER,
+				                                                               &internal_error);
 
 				if (internal_error) {
 					/* If this already doesn't succeed, then surely the file is
@@ -880,8 +923,9 @@ tracker_db_manager_new (TrackerDBManagerFlags   flags,
 		}
 	}
 
-	resources_iface = tracker_db_manager_create_db_interface (db_manager,
-	                                                          TRUE, &internal_error);
+	resources_iface = tracker_db_manager_create_db_interface (db_manager, TRUE,
+	                                                          TRACKER_DB_ROLE_READER,
+	                                                          &internal_error);
 
 	if (internal_error) {
 		if ((!restoring_backup) && (flags & TRACKER_DB_MANAGER_READONLY) == 0) {
@@ -890,6 +934,7 @@ tracker_db_manager_new (TrackerDBManagerFlags   flags,
 			perform_recreate (db_manager, first_time, &new_error);
 			if (!new_error) {
 				resources_iface = tracker_db_manager_create_db_interface (db_manager, TRUE,
+				                                                          TRACKER_DB_ROLE_READER,
 				                                                          &internal_error);
 			} else {
 				/* Most serious error is the recreate one here */
@@ -913,7 +958,11 @@ tracker_db_manager_new (TrackerDBManagerFlags   flags,
 void
 tracker_db_manager_free (TrackerDBManager *db_manager)
 {
+	/* Wait for a pending pool growth to finish */
+	g_thread_pool_free (db_manager->interface_grower, TRUE, TRUE);
 	g_async_queue_unref (db_manager->interfaces);
+	g_hash_table_unref (db_manager->hot_statements);
+	g_mutex_clear (&db_manager->hot_statements_mutex);
 	g_free (db_manager->db.abs_filename);
 	g_clear_object (&db_manager->db.iface);
 	g_weak_ref_clear (&db_manager->iface_data);
@@ -968,6 +1017,7 @@ tracker_db_manager_get_file (TrackerDBManager *db_manager)
 static TrackerDBInterface *
 tracker_db_manager_create_db_interface (TrackerDBManager  *db_manager,
                                         gboolean           readonly,
+                                        TrackerDBRole      role,
                                         GError           **error)
 {
 	TrackerDBInterface *connection;
@@ -992,9 +1042,8 @@ tracker_db_manager_create_db_interface (TrackerDBManager  *db_manager,
 	                                    g_object_unref);
 
 	db_set_params (connection,
-	               db_manager->db.cache_size,
 	               db_manager->db.page_size,
-	               readonly,
+	               role,
 	               &internal_error);
 
 	if (internal_error) {
@@ -1016,6 +1065,197 @@ tracker_db_manager_create_db_interface (TrackerDBManager  *db_manager,
 	return connection;
 }
 
+static void
+update_interface_pool_metrics (guint    pool_size,
+                               gboolean shared)
+{
+	static TrackerMetric *size = NULL, *shared_count = NULL;
+
+	if (g_once_init_enter (&size)) {
+		shared_count = tracker_metrics_counter ("tracker_data_interface_pool_shared_total",
+		                                        NULL,
+		                                        "Times a read-only interface was handed out while in use by another cursor");
+		g_once_init_leave (&size,
+		                   tracker_metrics_gauge ("tracker_data_interface_pool_size",
+		                                          NULL,
+		                                          "Read-only database interfaces in the pool"));
+	}
+
+	tracker_metric_set (size, pool_size);
+
+	if (shared)
+		tracker_metric_add (shared_count, 1);
+}
+
+/* Interfaces count their own cached SELECT lookups, and only report
+ * them here in batches, so the shared counts are rarely locked.
+ */
+static void
+statements_used_cb (TrackerDBInterface *iface,
+                    GHashTable         *uses,
+                    gpointer            user_data)
+{
+	TrackerDBManager *db_manager = user_data;
+	GHashTableIter iter, uses_iter;
+	gpointer key, value, n_uses;
+	guint *count;
+
+	g_mutex_lock (&db_manager->hot_statements_mutex);
+
+	g_hash_table_iter_init (&uses_iter, uses);
+
+	while (g_hash_table_iter_next (&uses_iter, &key, &n_uses)) {
+		count = g_hash_table_lookup (db_manager->hot_statements, key);
+
+		if (!count &&
+		    g_hash_table_size (db_manager->hot_statements) >= MAX_HOT_STATEMENTS) {
+			/* Halve all counts, so statements that are no longer
+			 * used eventually make room for new ones.
+			 */
+			g_hash_table_iter_init (&iter, db_manager->hot_statements);
+
+			while (g_hash_table_iter_next (&iter, NULL, &value)) {
+				guint *c = value;
+
+				*c /= 2;
+				if (*c == 0)
+					g_hash_table_iter_remove (&iter);
+			}
+		}
+
+		if (!count && g_hash_table_size (db_manager->hot_statements) < MAX_HOT_STATEMENTS) {
+			count = g_new0 (guint, 1);
+			g_hash_table_insert (db_manager->hot_statements, g_strdup (key), count);
+		}
+
+		if (count)
+			*count += *(guint *) n_uses;
+	}
+
+	g_mutex_unlock (&db_manager->hot_statements_mutex);
+}
+
+static gint
+compare_hot_statements (gconstpointer a,
+                        gconstpointer b,
+                        gpointer      user_data)
+{
+	GHashTable *hot_statements = user_data;
+	guint *count_a, *count_b;
+
+	count_a = g_hash_table_lookup (hot_statements, *(const gchar **) a);
+	count_b = g_hash_table_lookup (hot_statements, *(const gchar **) b);
+
+	/* Ascending, so the hottest statement ends up most recently used */
+	return (*count_a > *count_b) - (*count_a < *count_b);
+}
+
+static void
+warm_interface (TrackerDBManager   *db_manager,
+                TrackerDBInterface *iface)
+{
+	GPtrArray *hot, *queries;
+	GHashTableIter iter;
+	gpointer key;
+	guint i, n_warm;
+
+	g_mutex_lock (&db_manager->hot_statements_mutex);
+
+	hot = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, db_manager->hot_statements);
+
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_ptr_array_add (hot, key);
+
+	g_ptr_array_sort_with_data (hot, compare_hot_statements,
+	                            db_manager->hot_statements);
+
+	/* Copy the hottest ones, so they outlive the lock */
+	n_warm = MIN (hot->len, MIN (MAX_WARM_STATEMENTS, db_manager->s_cache_size));
+	queries = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = hot->len - n_warm; i < hot->len; i++)
+		g_ptr_array_add (queries, g_strdup (g_ptr_array_index (hot, i)));
+
+	g_mutex_unlock (&db_manager->hot_statements_mutex);
+	g_ptr_array_unref (hot);
+
+	for (i = 0; i < queries->len; i++) {
+		GError *error = NULL;
+
+		/* The query might refer to a table no longer in the ontology */
+		if (!tracker_db_interface_sqlite_prepare_cached (iface,
+		                                                 g_ptr_array_index (queries, i),
+		                                                 &error)) {
+			g_debug ("Could not prepare statement for warming up: %s",
+			         error->message);
+			g_error_free (error);
+		}
+	}
+
+	g_ptr_array_unref (queries);
+}
+
+static TrackerDBInterface *
+create_pooled_interface (TrackerDBManager  *db_manager,
+                         GError           **error)
+{
+	TrackerDBInterface *interface;
+
+	interface = tracker_db_manager_create_db_interface (db_manager, TRUE,
+	                                                    TRACKER_DB_ROLE_READER,
+	                                                    error);
+	if (!interface)
+		return NULL;
+
+	tracker_data_manager_init_fts (interface, FALSE);
+	tracker_db_interface_sqlite_statement_hook (interface, statements_used_cb, db_manager);
+	warm_interface (db_manager, interface);
+
+	return interface;
+}
+
+/* Runs in the interface_grower thread, adds a spare interface to the
+ * pool so the next burst of queries doesn't have to wait on one.
+ */
+static void
+grow_interface_pool (gpointer data,
+                     gpointer user_data)
+{
+	TrackerDBManager *db_manager = user_data;
+	TrackerDBInterface *interface;
+	GError *error = NULL;
+	GObject *iface_data;
+
+	/* The data manager might be going away */
+	iface_data = g_weak_ref_get (&db_manager->iface_data);
+
+	if (iface_data) {
+		interface = create_pooled_interface (db_manager, &error);
+		g_object_unref (iface_data);
+	} else {
+		interface = NULL;
+	}
+
+	if (interface) {
+		g_async_queue_lock (db_manager->interfaces);
+
+		if (g_async_queue_length_unlocked (db_manager->interfaces) < MAX_INTERFACES) {
+			/* Put it first in line */
+			g_async_queue_push_front_unlocked (db_manager->interfaces, interface);
+			interface = NULL;
+		}
+
+		g_async_queue_unlock (db_manager->interfaces);
+		g_clear_object (&interface);
+	} else if (error) {
+		g_debug ("Could not grow the interface pool: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_atomic_int_set (&db_manager->growing, FALSE);
+}
+
 /**
  * tracker_db_manager_get_db_interface:
  *
@@ -1030,6 +1270,7 @@ tracker_db_manager_get_db_interface (TrackerDBManager *db_manager)
 {
 	GError *internal_error = NULL;
 	TrackerDBInterface *interface;
+	gboolean busy = FALSE;
 
 	/* The interfaces never actually leave the async queue,
 	 * we use it as a thread synchronized LRU, which doesn't
@@ -1047,15 +1288,20 @@ tracker_db_manager_get_db_interface (TrackerDBManager *db_manager)
 		/* Put it back and go at creating a new one */
 		g_async_queue_push_front_unlocked (db_manager->interfaces, interface);
 		interface = NULL;
+		busy = TRUE;
 	}
 
 	if (!interface) {
 		/* Create a new one to satisfy the request */
-		interface = tracker_db_manager_create_db_interface (db_manager,
-		                                                    TRUE, &internal_error);
+		interface = create_pooled_interface (db_manager, &internal_error);
 
 		if (interface) {
-			tracker_data_manager_init_fts (interface, FALSE);
+			/* Demand outgrew the pool, have a spare one ready */
+			if (busy &&
+			    g_async_queue_length_unlocked (db_manager->interfaces) + 1 < MAX_INTERFACES &&
+			    g_atomic_int_compare_and_exchange (&db_manager->growing, FALSE, TRUE)) {
+				g_thread_pool_push (db_manager->interface_grower, db_manager, NULL);
+			}
 		} else {
 			if (g_async_queue_length_unlocked (db_manager->interfaces) == 0) {
 				g_critical ("Error opening database: %s", internal_error->message);
@@ -1070,6 +1316,12 @@ tracker_db_manager_get_db_interface (TrackerDBManager *db_manager)
 		}
 	}
 
+	/* An interface still in use here means the pool is exhausted,
+	 * and the caller will contend with other threads for its lock.
+	 */
+	update_interface_pool_metrics (g_async_queue_length_unlocked (db_manager->interfaces) + 1,
+	                               tracker_db_interface_get_is_used (interface));
+
 	g_async_queue_push_unlocked (db_manager->interfaces, interface);
 	g_async_queue_unlock (db_manager->interfaces);
 
@@ -1077,7 +1329,8 @@ tracker_db_manager_get_db_interface (TrackerDBManager *db_manager)
 }
 
 static TrackerDBInterface *
-init_writable_db_interface (TrackerDBManager *db_manager)
+init_writable_db_interface (TrackerDBManager *db_manager,
+                            TrackerDBRole     role)
 {
 	TrackerDBInterface *iface;
 	GError *error = NULL;
@@ -1085,7 +1338,7 @@ init_writable_db_interface (TrackerDBManager *db_manager)
 
 	/* Honor anyway the DBManager readonly flag */
 	readonly = (db_manager->flags & TRACKER_DB_MANAGER_READONLY) != 0;
-	iface = tracker_db_manager_create_db_interface (db_manager, readonly, &error);
+	iface = tracker_db_manager_create_db_interface (db_manager, readonly, role, &error);
 	if (error) {
 		g_critical ("Error opening readwrite database: %s", error->message);
 		g_error_free (error);
@@ -1098,7 +1351,7 @@ TrackerDBInterface *
 tracker_db_manager_get_writable_db_interface (TrackerDBManager *db_manager)
 {
 	if (db_manager->db.iface == NULL) {
-		db_manager->db.iface = init_writable_db_interface (db_manager);
+		db_manager->db.iface = init_writable_db_interface (db_manager, TRACKER_DB_ROLE_WRITER);
 	}
 
 	return db_manager->db.iface;
@@ -1109,12 +1362,25 @@ tracker_db_manager_get_wal_db_interface (TrackerDBManager *db_manager)
 {
 	if (db_manager->db.wal_iface == NULL &&
 	    (db_manager->flags & TRACKER_DB_MANAGER_READONLY) == 0) {
-		db_manager->db.wal_iface = init_writable_db_interface (db_manager);
+		db_manager->db.wal_iface = init_writable_db_interface (db_manager, TRACKER_DB_ROLE_CHECKPOINT);
 	}
 
 	return db_manager->db.wal_iface;
 }
 
+/* Returns a connection of its own to the caller, for long running
+ * reads that should neither hold a pooled interface nor see later
+ * updates.
+ */
+TrackerDBInterface *
+tracker_db_manager_create_reader_db_interface (TrackerDBManager  *db_manager,
+                                               GError           **error)
+{
+	return tracker_db_manager_create_db_interface (db_manager, TRUE,
+	                                               TRACKER_DB_ROLE_READER,
+	                                               error);
+}
+
 /**
  * tracker_db_manager_has_enough_space:
  *
@@ -1175,14 +1441,182 @@ tracker_db_manager_tokenizer_update (TrackerDBManager *db_manager)
 	g_free (filename);
 }
 
+/*
+ * tracker_db_manager_set_fts_rebuild_pending:
+ *
+ * Persists whether the FTS index may lack rows for committed data,
+ * as happens while its maintenance is deferred. If the process dies
+ * meanwhile, the index is rebuilt on the next startup.
+ */
 void
-tracker_db_manager_check_perform_vacuum (TrackerDBManager *db_manager)
+tracker_db_manager_set_fts_rebuild_pending (TrackerDBManager *db_manager,
+                                            gboolean          pending)
+{
+	GError *error = NULL;
+	gchar *filename;
+
+	filename = g_build_filename (db_manager->data_dir,
+	                             FTS_REBUILD_PENDING_FILENAME,
+	                             NULL);
+
+	if (pending) {
+		if (!g_file_set_contents (filename, "", -1, &error)) {
+			g_warning ("Could not write '%s', the full text index won't "
+			           "be rebuilt if Tracker stops before it's done: %s",
+			           filename, error->message);
+			g_error_free (error);
+		}
+	} else if (g_unlink (filename) < 0 && errno != ENOENT) {
+		g_warning ("Could not remove '%s', the full text index will be "
+		           "rebuilt again on next startup: %s",
+		           filename, g_strerror (errno));
+	}
+
+	g_free (filename);
+}
+
+gboolean
+tracker_db_manager_get_fts_rebuild_pending (TrackerDBManager *db_manager)
+{
+	gchar *filename;
+	gboolean pending;
+
+	filename = g_build_filename (db_manager->data_dir,
+	                             FTS_REBUILD_PENDING_FILENAME,
+	                             NULL);
+	pending = g_file_test (filename, G_FILE_TEST_EXISTS);
+	g_free (filename);
+
+	return pending;
+}
+
+static gint
+db_get_pragma_int (TrackerDBInterface  *iface,
+                   const gchar         *pragma,
+                   GError             **error)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	gint value = -1;
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              error, "PRAGMA %s", pragma);
+	if (!stmt)
+		return -1;
+
+	cursor = tracker_db_statement_start_cursor (stmt, error);
+	g_object_unref (stmt);
+
+	if (!cursor)
+		return -1;
+
+	if (tracker_db_cursor_iter_next (cursor, NULL, error))
+		value = tracker_db_cursor_get_int (cursor, 0);
+
+	g_object_unref (cursor);
+
+	return value;
+}
+
+/* Applies to connections opened afterwards, a cache_size <= 0 or a
+ * negative mmap_size leave the current value untouched.
+ */
+void
+tracker_db_manager_set_role_params (TrackerDBRole role,
+                                    gint          cache_size,
+                                    gint64        mmap_size)
+{
+	g_return_if_fail (role < TRACKER_DB_N_ROLES);
+
+	if (cache_size > 0)
+		role_params[role].cache_size = cache_size;
+	if (mmap_size >= 0)
+		role_params[role].mmap_size = mmap_size;
+}
+
+/* Databases created by older versions don't use incremental
+ * auto_vacuum, and need a full VACUUM for the mode change to apply.
+ * That rewrites the whole file, so it is left for a later call while
+ * the filesystem lacks room for the copy. @incremental is set to
+ * whether space can be reclaimed with
+ * tracker_db_manager_incremental_vacuum() afterwards.
+ */
+gboolean
+tracker_db_manager_check_perform_vacuum (TrackerDBManager  *db_manager,
+                                         gboolean          *incremental,
+                                         GError           **error)
 {
 	TrackerDBInterface *iface;
+	GError *inner_error = NULL;
+	GStatBuf st;
+	guint64 remaining;
+	gint auto_vacuum;
 
-	if (tracker_file_get_size (db_manager->db.abs_filename) < TRACKER_VACUUM_CHECK_SIZE)
-		return;
+	*incremental = FALSE;
+
+	iface = tracker_db_manager_get_writable_db_interface (db_manager);
+	auto_vacuum = db_get_pragma_int (iface, "auto_vacuum", &inner_error);
+
+	if (inner_error) {
+		g_propagate_prefixed_error (error, inner_error,
+		                            "Could not get auto_vacuum mode: ");
+		return FALSE;
+	}
+
+	if (auto_vacuum == TRACKER_DB_AUTO_VACUUM_INCREMENTAL) {
+		*incremental = TRUE;
+		return TRUE;
+	}
+
+	/* The copy is made in a temporary file, and goes through the WAL */
+	if (g_stat (db_manager->db.abs_filename, &st) != 0)
+		st.st_size = 0;
+
+	remaining = tracker_file_system_get_remaining_space (db_manager->data_dir);
+
+	if (remaining < 2 * (guint64) st.st_size) {
+		g_info ("Not converting database to incremental vacuuming, "
+		        "%" G_GUINT64_FORMAT " bytes free but %" G_GUINT64_FORMAT " needed",
+		        remaining, 2 * (guint64) st.st_size);
+		return TRUE;
+	}
+
+	g_info ("Converting database to incremental vacuuming, rewriting %" G_GUINT64_FORMAT " bytes",
+	        (guint64) st.st_size);
+	tracker_db_interface_execute_query (iface, &inner_error, "PRAGMA auto_vacuum = INCREMENTAL");
+
+	if (!inner_error)
+		tracker_db_interface_execute_query (iface, &inner_error, "VACUUM");
+
+	if (inner_error) {
+		g_propagate_prefixed_error (error, inner_error,
+		                            "Could not convert database to incremental vacuuming: ");
+		return FALSE;
+	}
+
+	*incremental = TRUE;
+
+	return TRUE;
+}
+
+/* Returns the number of free pages left, or -1 on error */
+gint
+tracker_db_manager_incremental_vacuum (TrackerDBManager  *db_manager,
+                                       guint              n_pages,
+                                       GError           **error)
+{
+	TrackerDBInterface *iface;
+	GError *inner_error = NULL;
 
 	iface = tracker_db_manager_get_writable_db_interface (db_manager);
-	tracker_db_interface_execute_query (iface, NULL, "VACUUM");
+
+	/* A no-op on databases not converted yet */
+	tracker_db_interface_execute_query (iface, &inner_error,
+	                                    "PRAGMA incremental_vacuum(%u)", n_pages);
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return -1;
+	}
+
+	return db_get_pragma_int (iface, "freelist_count", error);
 }
@@ -32,6 +32,16 @@ G_BEGIN_DECLS
 
 #define TRACKER_DB_CACHE_SIZE_DEFAULT 250
 #define TRACKER_DB_CACHE_SIZE_UPDATE 2000
+#define TRACKER_DB_CACHE_SIZE_CHECKPOINT 100
+#define TRACKER_DB_MMAP_SIZE_DEFAULT ((gint64) 256 * 1024 * 1024)
+
+/* Connections are tuned after the work they do */
+typedef enum {
+	TRACKER_DB_ROLE_WRITER,
+	TRACKER_DB_ROLE_READER,
+	TRACKER_DB_ROLE_CHECKPOINT,
+	TRACKER_DB_N_ROLES
+} TrackerDBRole;
 
 typedef enum {
 	TRACKER_DB_MANAGER_FORCE_REINDEX         = 1 << 1,
@@ -63,6 +73,8 @@ const gchar *       tracker_db_manager_get_file               (TrackerDBManager
 TrackerDBInterface *tracker_db_manager_get_db_interface       (TrackerDBManager      *db_manager);
 TrackerDBInterface *tracker_db_manager_get_writable_db_interface (TrackerDBManager   *db_manager);
 TrackerDBInterface *tracker_db_manager_get_wal_db_interface   (TrackerDBManager      *db_manager);
+TrackerDBInterface *tracker_db_manager_create_reader_db_interface (TrackerDBManager  *db_manager,
+                                                                 GError           **error);
 
 void                tracker_db_manager_ensure_locations       (TrackerDBManager      *db_manager,
 							       GFile                 *cache_location,
@@ -93,8 +105,20 @@ void                tracker_db_manager_set_current_locale     (TrackerDBManager
 
 gboolean            tracker_db_manager_get_tokenizer_changed  (TrackerDBManager      *db_manager);
 void                tracker_db_manager_tokenizer_update       (TrackerDBManager      *db_manager);
+void                tracker_db_manager_set_fts_rebuild_pending (TrackerDBManager     *db_manager,
+                                                                gboolean              pending);
+gboolean            tracker_db_manager_get_fts_rebuild_pending (TrackerDBManager     *db_manager);
+
+gboolean            tracker_db_manager_check_perform_vacuum   (TrackerDBManager      *db_manager,
+                                                               gboolean              *incremental,
+                                                               GError               **error);
+gint                tracker_db_manager_incremental_vacuum     (TrackerDBManager      *db_manager,
+                                                               guint                  n_pages,
+                                                               GError               **error);
 
-void                tracker_db_manager_check_perform_vacuum   (TrackerDBManager      *db_manager);
+void                tracker_db_manager_set_role_params        (TrackerDBRole          role,
+                                                               gint                   cache_size,
+                                                               gint64                 mmap_size);
 
 G_END_DECLS
 
@@ -858,6 +858,7 @@ class Tracker.Sparql.Expression : Object {
 			if (prop == null) {
 				throw get_error ("Unknown function");
 			}
+			query.reference_class (prop.domain);
 
 			var expr = new StringBuilder ();
 			translate_expression (expr);
@@ -162,6 +162,11 @@ namespace Tracker.Sparql {
 }
 
 class Tracker.Sparql.Pattern : Object {
+	// Join order estimates used until ANALYZE gathered statistics
+	const double DEFAULT_VALUES_PER_SUBJECT = 4;
+	const double DEFAULT_SELECTIVITY = 0.1;
+	const double FTS_MATCH_SELECTIVITY = 0.001;
+
 	weak Query query;
 	weak Expression expression;
 
@@ -254,8 +259,84 @@ class Tracker.Sparql.Pattern : Object {
 
 	TripleContext? triple_context;
 
+	private string? accept_iri () throws Sparql.Error {
+		if (accept (SparqlTokenType.IRI_REF)) {
+			return get_last_string (1);
+		} else if (accept (SparqlTokenType.PN_PREFIX)) {
+			string ns = get_last_string ();
+			expect (SparqlTokenType.COLON);
+			return query.resolve_prefixed_name (ns, get_last_string ().substring (1));
+		} else if (accept (SparqlTokenType.COLON)) {
+			return query.resolve_prefixed_name ("", get_last_string ().substring (1));
+		}
+
+		return null;
+	}
+
+	// Checks whether the whole query is
+	//   SELECT COUNT (?x) { ?x a class }
+	// which can be answered from the instance counts of the class
+	private Class? get_counted_class () {
+		var select_start = get_location ();
+		try {
+			expect (SparqlTokenType.SELECT);
+
+			bool parens = accept (SparqlTokenType.OPEN_PARENS);
+			expect (SparqlTokenType.COUNT);
+			expect (SparqlTokenType.OPEN_PARENS);
+			accept (SparqlTokenType.DISTINCT);
+			expect (SparqlTokenType.VAR);
+			var counted_variable = get_last_string ();
+			expect (SparqlTokenType.CLOSE_PARENS);
+			if (accept (SparqlTokenType.AS)) {
+				expect (SparqlTokenType.VAR);
+			}
+			if (parens) {
+				expect (SparqlTokenType.CLOSE_PARENS);
+			}
+
+			optional (SparqlTokenType.WHERE);
+			expect (SparqlTokenType.OPEN_BRACE);
+
+			expect (SparqlTokenType.VAR);
+			if (get_last_string () != counted_variable) {
+				return null;
+			}
+
+			if (!accept (SparqlTokenType.A) &&
+			    accept_iri () != "http://www.w3.org/1999/02/22-rdf-syntax-ns#type") {
+				return null;
+			}
+
+			var class_uri = accept_iri ();
+			if (class_uri == null) {
+				return null;
+			}
+
+			optional (SparqlTokenType.DOT);
+			expect (SparqlTokenType.CLOSE_BRACE);
+			expect (SparqlTokenType.EOF);
+
+			var cl = manager.get_ontologies ().get_class_by_uri (class_uri);
+			if (cl == null || cl.name.has_prefix ("xsd:")) {
+				return null;
+			}
+
+			return cl;
+		} catch (Sparql.Error e) {
+			return null;
+		} finally {
+			set_location (select_start);
+		}
+	}
+
 	internal SelectContext translate_select (StringBuilder sql, bool subquery = false, bool scalar_subquery = false) throws Sparql.Error {
 		SelectContext result;
+		Class? counted_class = null;
+
+		if (!subquery && !scalar_subquery && manager.has_class_counts ()) {
+			counted_class = get_counted_class ();
+		}
 
 		if (scalar_subquery) {
 			result = new SelectContext.subquery (query, context);
@@ -477,6 +558,14 @@ class Tracker.Sparql.Pattern : Object {
 			sql.append_printf (") AS ranks ON fts5.rowid=rowid WHERE fts5 %s".printf (match_str.str));
 		}
 
+		if (counted_class != null && query.bindings == null) {
+			// the query is still translated to check it and set up
+			// the result columns, but the count is kept on commit
+			sql.truncate (0);
+			sql.append_printf ("SELECT COALESCE ((SELECT Count FROM ClassCount WHERE ID = %d), 0)",
+			                   counted_class.id);
+		}
+
 		context = context.parent_context;
 
 		result.type = type;
@@ -697,9 +786,11 @@ class Tracker.Sparql.Pattern : Object {
 
 		sql.append (" FROM ");
 		bool first = true;
-		foreach (DataTable table in triple_context.tables) {
+		bool anchored;
+		foreach (DataTable table in order_tables (out anchored)) {
 			if (!first) {
-				sql.append (", ");
+				// force the join order if it starts from a restricted table
+				sql.append (anchored ? " CROSS JOIN " : ", ");
 			} else {
 				first = false;
 			}
@@ -808,6 +899,177 @@ class Tracker.Sparql.Pattern : Object {
 		context = context.parent_context;
 	}
 
+	private double get_resource_count () {
+		var ontologies = manager.get_ontologies ();
+		return ontologies.get_class_by_uri ("http://www.w3.org/2000/01/rdf-schema#Resource").count;
+	}
+
+	private void estimate_table_rows (DataTable table, Class? table_class, bool multiple_values) {
+		double n_rows, rows_per_value;
+
+		if (table_class != null) {
+			table.n_rows = table_class.count;
+		} else {
+			// fts and predicate variables
+			table.n_rows = get_resource_count ();
+		}
+
+		if (multiple_values) {
+			table.n_rows *= DEFAULT_VALUES_PER_SUBJECT;
+			table.rows_per_subject = DEFAULT_VALUES_PER_SUBJECT;
+		}
+
+		if (table.sql_db_tablename != null &&
+		    manager.get_table_estimate (table.sql_db_tablename, "ID", out n_rows, out rows_per_value)) {
+			table.n_rows = n_rows;
+			if (rows_per_value >= 0) {
+				table.rows_per_subject = rows_per_value;
+			}
+		}
+	}
+
+	// Rows of a table sharing a single value in the given column
+	private double get_rows_per_value (DataTable table, string column) {
+		double n_rows, rows_per_value;
+
+		if (column == "ID" || column == "rowid") {
+			return table.rows_per_subject;
+		}
+
+		if (table.sql_db_tablename != null &&
+		    manager.get_table_estimate (table.sql_db_tablename, column, out n_rows, out rows_per_value) &&
+		    rows_per_value >= 0) {
+			return rows_per_value;
+		}
+
+		return double.max (table.n_rows, 1) * DEFAULT_SELECTIVITY;
+	}
+
+	// Rows a table yields on its own, after applying literal restrictions
+	private double estimate_table_output (DataTable table, out bool restricted) {
+		double rows = double.max (table.n_rows, 1);
+
+		restricted = false;
+
+		if (table.predicate_variable != null && table.predicate_variable.subject != null) {
+			rows = double.min (rows, table.rows_per_subject);
+			restricted = true;
+		}
+
+		foreach (LiteralBinding binding in triple_context.bindings) {
+			if (binding.table != table) {
+				continue;
+			}
+
+			if (binding.is_fts_match) {
+				rows *= FTS_MATCH_SELECTIVITY;
+			} else {
+				rows = double.min (rows, get_rows_per_value (table, binding.sql_db_column_name));
+			}
+			restricted = true;
+		}
+
+		return rows;
+	}
+
+	// Rows of a table matching each row of the already placed tables,
+	// or -1 if the table does not share a variable with them
+	private double get_join_estimate (DataTable table, List<unowned DataTable> placed) {
+		double rows = -1;
+
+		foreach (var variable in triple_context.variables) {
+			unowned List<VariableBinding> list = triple_context.var_bindings.lookup (variable).list;
+			bool joined = false;
+
+			foreach (VariableBinding binding in list) {
+				if (binding.table != null && binding.table != table && placed.find (binding.table) != null) {
+					joined = true;
+					break;
+				}
+			}
+
+			if (!joined) {
+				continue;
+			}
+
+			foreach (VariableBinding binding in list) {
+				if (binding.table == table) {
+					double probe = get_rows_per_value (table, binding.sql_db_column_name);
+					if (rows < 0 || probe < rows) {
+						rows = probe;
+					}
+				}
+			}
+		}
+
+		return rows;
+	}
+
+	// Orders the tables of the current triples block so the most
+	// selective one comes first, followed by the cheapest table joining
+	// on the ones already placed. Ties keep the order of the query.
+	private List<unowned DataTable> order_tables (out bool anchored) {
+		var placed = new List<unowned DataTable> ();
+		var remaining = new List<unowned DataTable> ();
+
+		anchored = false;
+
+		foreach (unowned DataTable table in triple_context.tables) {
+			remaining.append (table);
+		}
+
+		if (remaining.length () < 2) {
+			return (owned) remaining;
+		}
+
+		unowned DataTable? first = null;
+		double first_rows = 0;
+
+		foreach (unowned DataTable table in remaining) {
+			bool restricted;
+			double rows = estimate_table_output (table, out restricted);
+
+			if (first == null || rows < first_rows) {
+				first = table;
+				first_rows = rows;
+				anchored = restricted;
+			}
+		}
+
+		placed.append (first);
+		remaining.remove (first);
+
+		while (remaining != null) {
+			unowned DataTable? best = null;
+			double best_rows = 0;
+			bool best_joined = false;
+
+			foreach (unowned DataTable table in remaining) {
+				bool restricted;
+				double rows = estimate_table_output (table, out restricted);
+				double probe = get_join_estimate (table, placed);
+				bool joined = probe >= 0;
+
+				if (joined) {
+					rows = double.min (rows, probe);
+				}
+
+				// avoid cartesian products while a join is possible
+				if (best == null || (joined && !best_joined) ||
+				    (joined == best_joined && rows < best_rows)) {
+					best = table;
+					best_rows = rows;
+					best_joined = joined;
+				}
+			}
+
+			placed.append (best);
+			remaining.remove (best);
+		}
+
+		return (owned) placed;
+	}
+
 	private void parse_triples (StringBuilder sql, long group_graph_pattern_start, ref bool in_triples_block, ref bool first_where, ref bool in_group_graph_pattern, bool found_simple_optional) throws Sparql.Error {
 		while (true) {
 			if (current () != SparqlTokenType.VAR &&
@@ -896,6 +1158,7 @@ class Tracker.Sparql.Pattern : Object {
 			if (prop == null) {
 				return false;
 			}
+			query.reference_class (prop.domain);
 
 			// check object
 			if (!accept (SparqlTokenType.VAR)) {
@@ -1347,6 +1610,25 @@ class Tracker.Sparql.Pattern : Object {
 		}
 	}
 
+	// Earlier triples in the same group may restrict the subject to a
+	// class more specific than the property domain, prefer one whose
+	// changes are signalled
+	private Class get_subject_class (Class domain) {
+		if (!current_subject_is_var || Query.has_notify_class (domain))
+			return domain;
+
+		var list = triple_context.var_bindings.lookup (context.get_variable (current_subject));
+
+		if (list != null) {
+			foreach (VariableBinding binding in list.list) {
+				if (binding.type != null && Query.has_notify_class (binding.type))
+					return binding.type;
+			}
+		}
+
+		return domain;
+	}
+
 	private void parse_object (StringBuilder sql, bool in_simple_optional = false) throws Sparql.Error {
 		long begin_sql_len = sql.len;
 
@@ -1363,6 +1645,7 @@ class Tracker.Sparql.Pattern : Object {
 		Property prop = null;
 
 		Class subject_type = null;
+		Class table_class = null;
 
 		var ontologies = manager.get_ontologies ();
 
@@ -1379,10 +1662,13 @@ class Tracker.Sparql.Pattern : Object {
 					throw new Sparql.Error.UNKNOWN_CLASS ("Unknown class `%s'".printf (object));
 				}
 				db_table = cl.name;
+				table_class = cl;
 				subject_type = cl;
+				query.reference_class (cl);
 			} else if (prop == null) {
 				if (current_predicate == "http://www.tracker-project.org/ontologies/fts#match") {
 					// fts:match
+					query.reference_class (null);
 					db_table = "fts5";
 					share_table = false;
 					is_fts_match = true;
@@ -1418,6 +1704,7 @@ class Tracker.Sparql.Pattern : Object {
 							foreach (VariableBinding b in list.list) {
 								if (b.type == cl) {
 									db_table = cl.name;
+									table_class = cl;
 									stop = true;
 									break;
 								}
@@ -1431,6 +1718,8 @@ class Tracker.Sparql.Pattern : Object {
 
 				if (db_table == null)
 					db_table = prop.table_name;
+				if (table_class == null)
+					table_class = prop.domain;
 
 				if (prop.multiple_values) {
 					// we can never share the table with multiple triples
@@ -1438,6 +1727,7 @@ class Tracker.Sparql.Pattern : Object {
 					share_table = false;
 				}
 				subject_type = prop.domain;
+				query.reference_class (get_subject_class (prop.domain));
 
 				if (in_simple_optional && context.var_set.lookup (context.get_variable (current_subject)) == 0) {
 					// use subselect instead of join in simple optional where the subject is the unbound variable
@@ -1470,8 +1760,16 @@ class Tracker.Sparql.Pattern : Object {
 				}
 			}
 			table = get_table (current_subject, db_table, share_table, out newtable);
+			if (newtable) {
+				if (is_fts_match) {
+					estimate_table_rows (table, null, false);
+				} else {
+					estimate_table_rows (table, table_class, !rdftype && prop.multiple_values);
+				}
+			}
 		} else {
 			// variable in predicate
+			query.reference_class (null);
 			newtable = true;
 			table = new DataTable ();
 			table.predicate_variable = context.predicate_variable_map.lookup (context.get_variable (current_predicate));
@@ -1491,6 +1789,7 @@ class Tracker.Sparql.Pattern : Object {
 				table.predicate_variable.return_graph = true;
 			}
 			table.sql_query_tablename = current_predicate + (++counter).to_string ();
+			estimate_table_rows (table, null, true);
 			triple_context.tables.append (table);
 
 			// add to variable list
@@ -35,6 +35,9 @@ namespace Tracker.Sparql {
 		public string sql_db_tablename; // as in db schema
 		public string sql_query_tablename; // temp. name, generated
 		public PredicateVariable predicate_variable;
+		// estimates used to order joins
+		public double n_rows;
+		public double rows_per_subject = 1;
 	}
 
 	abstract class DataBinding : Object {
@@ -249,6 +252,23 @@ public class Tracker.Sparql.Query : Object {
 
 	public bool no_cache { get; set; }
 
+	// Classes whose instances the translated query reads, set to
+	// null on references that can not be tied to a class (variable
+	// predicates, fts:match)
+	internal GenericArray<Class>? referenced_classes = new GenericArray<Class> ();
+
+	internal void reference_class (Class? cl) {
+		if (referenced_classes == null)
+			return;
+
+		if (cl == null) {
+			referenced_classes = null;
+			return;
+		}
+
+		referenced_classes.add (cl);
+	}
+
 	public Query (Data.Manager manager, string query) {
 		no_cache = false; /* Start with false, expression sets it */
 		tokens = new TokenInfo[BUFFER_SIZE];
@@ -449,6 +469,152 @@ public class Tracker.Sparql.Query : Object {
 		}
 	}
 
+	// Returns an a{sv} dictionary describing how the query is executed:
+	// the generated SQL, SQLite's query plan and the time spent parsing
+	// and translating. If profile is true, the query is also run, and
+	// the prepare/step timings, statement cache usage and the number
+	// of rows are added.
+	public Variant explain (bool profile) throws GLib.Error {
+		var builder = new VariantBuilder (VariantType.VARDICT);
+		var timer = new Timer ();
+		PropertyType[] types;
+		string[] variable_names;
+		string sql;
+
+		prepare_execute ();
+		double parse_time = timer.elapsed ();
+
+		timer.start ();
+
+		switch (current ()) {
+		case SparqlTokenType.SELECT:
+			SelectContext select_context;
+			sql = get_select_query (out select_context);
+			types = select_context.types;
+			variable_names = select_context.variable_names;
+			break;
+		case SparqlTokenType.ASK:
+			sql = get_ask_query ();
+			types = new PropertyType[] { PropertyType.BOOLEAN };
+			variable_names = new string[] { "result" };
+			break;
+		default:
+			throw get_error ("expected SELECT or ASK");
+		}
+
+		double translate_time = timer.elapsed ();
+
+		var iface = manager.get_db_interface ();
+		var plan = new VariantBuilder ((VariantType) "as");
+		var plan_stmt = iface.create_statement (DBStatementCacheType.NONE, "EXPLAIN QUERY PLAN %s", sql);
+		var plan_cursor = plan_stmt.start_cursor ();
+
+		// the last column holds the human readable plan step
+		while (plan_cursor.next ()) {
+			plan.add ("s", plan_cursor.get_string (plan_cursor.n_columns - 1));
+		}
+
+		builder.add ("{sv}", "sql", new Variant.string (sql));
+		builder.add ("{sv}", "plan", plan.end ());
+		builder.add ("{sv}", "parse-time", new Variant.double (parse_time));
+		builder.add ("{sv}", "translate-time", new Variant.double (translate_time));
+
+		if (!profile) {
+			return builder.end ();
+		}
+
+		timer.start ();
+		bool cache_hit = !no_cache && iface.has_cached_statement (sql);
+		var stmt = prepare_for_exec (iface, sql);
+		double prepare_time = timer.elapsed ();
+
+		timer.start ();
+		var cursor = stmt.start_sparql_cursor (types, variable_names);
+		uint64 n_rows = 0;
+
+		while (cursor.next ()) {
+			n_rows++;
+		}
+
+		double step_time = timer.elapsed ();
+
+		builder.add ("{sv}", "prepare-time", new Variant.double (prepare_time));
+		builder.add ("{sv}", "statement-cache-hit", new Variant.boolean (cache_hit));
+		builder.add ("{sv}", "step-time", new Variant.double (step_time));
+		builder.add ("{sv}", "rows", new Variant.uint64 (n_rows));
+
+		return builder.end ();
+	}
+
+	internal static bool has_notify_class (Class cl) {
+		if (cl.notify)
+			return true;
+
+		foreach (unowned Class super_class in cl.get_super_classes ()) {
+			if (has_notify_class (super_class))
+				return true;
+		}
+
+		return false;
+	}
+
+	static void add_notify_classes (Class cl, HashTable<string,string> set) {
+		if (cl.notify)
+			set.insert (cl.uri, cl.uri);
+
+		foreach (unowned Class super_class in cl.get_super_classes ()) {
+			add_notify_classes (super_class, set);
+		}
+	}
+
+	// Returns the notify classes whose GraphUpdated events cover
+	// every change that may alter the results of the query, or null
+	// if there is no such set. Any resource of a referenced class
+	// is also an instance of its notify superclasses, so changes to
+	// it are signalled for those.
+	public string[]? get_notify_dependencies () throws GLib.Error {
+		prepare_execute ();
+
+		switch (current ()) {
+		case SparqlTokenType.SELECT:
+			SelectContext select_context;
+			get_select_query (out select_context);
+			break;
+		case SparqlTokenType.ASK:
+			get_ask_query ();
+			break;
+		default:
+			throw get_error ("expected SELECT or ASK");
+		}
+
+		if (referenced_classes == null || referenced_classes.length == 0)
+			return null;
+
+		var set = new HashTable<string,string> (str_hash, str_equal);
+
+		foreach (unowned Class cl in referenced_classes.data) {
+			var class_set = new HashTable<string,string> (str_hash, str_equal);
+
+			add_notify_classes (cl, class_set);
+
+			// Changes to instances of this class are not signalled
+			if (class_set.size () == 0)
+				return null;
+
+			class_set.foreach ((uri, value) => {
+				set.insert (uri, uri);
+			});
+		}
+
+		string[] dependencies = {};
+
+		foreach (unowned string uri in set.get_keys ()) {
+			dependencies += uri;
+		}
+
+		return dependencies;
+	}
+
 	public Variant? execute_update (bool blank) throws GLib.Error {
 		Variant result = null;
 		assert (update_extensions);
@@ -28,7 +28,11 @@ public class Tracker.TurtleReader : Object {
 	int size;
 
 	const int BUFFER_SIZE = 32;
-	const int MAX_ONTOLOGY_SIZE = 2 * 1024 * 1024;
+
+	// statements handed from the parser thread to the inserting one at once
+	const int BATCH_SIZE = 1000;
+	// batches in flight, bounds how far parsing can go ahead of inserts
+	const int N_BATCHES = 4;
 
 	struct TokenInfo {
 		public SparqlTokenType type;
@@ -36,6 +40,28 @@ public class Tracker.TurtleReader : Object {
 		public SourceLocation end;
 	}
 
+	struct Statement {
+		public string? graph;
+		public string subject;
+		public string predicate;
+		public string object;
+		public bool object_is_uri;
+	}
+
+	[Compact]
+	class StatementBatch {
+		public Statement[] statements;
+		public int n_statements;
+		// input consumed when the batch was filled
+		public size_t offset;
+		public bool last;
+		public Error? error;
+
+		public StatementBatch () {
+			statements = new Statement[BATCH_SIZE];
+		}
+	}
+
 	enum State {
 		INITIAL,
 		BOS,
@@ -64,25 +90,50 @@ public class Tracker.TurtleReader : Object {
 	uchar[] base_uuid;
 
 	MappedFile? mapped_file;
-	uchar[]? buffer;
+
+	AsyncQueue<StatementBatch> full_batches;
+	AsyncQueue<StatementBatch> free_batches;
+	int stopped;
+
+	// size of the input in bytes
+	public size_t length {
+		get { return mapped_file.get_length (); }
+	}
+
+	// bytes of input consumed so far
+	public size_t offset {
+		get {
+			if (state == State.INITIAL)
+				return 0;
+			return (size_t) (tokens[index].end.pos - mapped_file.get_contents ());
+		}
+	}
 
 	public TurtleReader (File file) throws Error, FileError {
 		if (file.is_native ()) {
 			mapped_file = new MappedFile (file.get_path(), false);
-			scanner = new SparqlScanner (mapped_file.get_contents (), mapped_file.get_length ());
 		} else {
-			size_t len;
-			var istream = file.read (null);
-			buffer = new uchar[MAX_ONTOLOGY_SIZE];
-			istream.read_all (buffer, out len, null);
-
-			// Not good if we read a portion of the ontology
-			if (len == MAX_ONTOLOGY_SIZE)
-				throw new IOError.FAILED ("Ontology file too large");
-
-			scanner = new SparqlScanner (buffer, len);
+			// Spool other files locally, so they can be mapped
+			// whatever their size
+			FileIOStream iostream;
+			var spool_file = File.new_tmp ("tracker-turtle-XXXXXX", out iostream);
+
+			try {
+				iostream.output_stream.splice (file.read (null),
+				                               OutputStreamSpliceFlags.CLOSE_SOURCE |
+				                               OutputStreamSpliceFlags.CLOSE_TARGET,
+				                               null);
+				mapped_file = new MappedFile (spool_file.get_path (), false);
+			} finally {
+				try {
+					spool_file.delete (null);
+				} catch (Error e) {
+				}
+			}
 		}
 
+		scanner = new SparqlScanner (mapped_file.get_contents (), mapped_file.get_length ());
+
 		base_uuid = new uchar[16];
 		uuid_generate (base_uuid);
 
@@ -380,27 +431,136 @@ public class Tracker.TurtleReader : Object {
 		}
 	}
 
+	// Runs in the parser thread, fills batches until the input is
+	// exhausted or the inserting side gives up
+	bool parse_batches () {
+		StatementBatch batch = free_batches.pop ();
+
+		try {
+			while (AtomicInt.get (ref stopped) == 0) {
+				bool more = next ();
+
+				if (more) {
+					batch.statements[batch.n_statements] = Statement () {
+						graph = this.graph,
+						subject = this.subject,
+						predicate = this.predicate,
+						object = this.object,
+						object_is_uri = this.object_is_uri
+					};
+					batch.n_statements++;
+
+					if (batch.n_statements < BATCH_SIZE)
+						continue;
+				}
+
+				batch.offset = offset;
+				batch.last = !more;
+				full_batches.push ((owned) batch);
+
+				if (!more)
+					return true;
+
+				batch = free_batches.pop ();
+			}
+		} catch (Sparql.Error e) {
+			batch.error = e.copy ();
+			batch.last = true;
+			full_batches.push ((owned) batch);
+		}
+
+		return false;
+	}
+
 	public static void load (File file, Data.Update data) throws Error, FileError, Sparql.Error, DateError, DBInterfaceError {
+		load_bulk (file, data, 0, 0, false, null, null);
+	}
+
+	// Parses in a thread of its own while statements are inserted in
+	// the calling one. With @commit_statements or @commit_bytes set,
+	// the transaction is committed each time as many statements or
+	// bytes of input were processed, so huge files don't end up in a
+	// single transaction; on errors, prior commits stay in place. With
+	// @defer_fts, the full text index is rebuilt once at the end.
+	public static void load_bulk (File file, Data.Update data, size_t commit_statements, size_t commit_bytes, bool defer_fts, Cancellable? cancellable, BusyCallback? busy_callback) throws Error, FileError, Sparql.Error, DateError, DBInterfaceError {
+		var reader = new TurtleReader (file);
+		size_t n_statements = 0, last_commit_statements = 0, last_commit_offset = 0;
+
+		reader.full_batches = new AsyncQueue<StatementBatch> ();
+		reader.free_batches = new AsyncQueue<StatementBatch> ();
+
+		for (int i = 0; i < N_BATCHES; i++) {
+			reader.free_batches.push (new StatementBatch ());
+		}
+
+		var parser = new Thread<bool> ("tracker-turtle-parser", reader.parse_batches);
+
+		if (defer_fts)
+			data.set_fts_deferred (true);
+
 		try {
 			data.begin_transaction ();
 
-			var reader = new TurtleReader (file);
-			while (reader.next ()) {
-				if (reader.object_is_uri) {
-					data.insert_statement_with_uri (reader.graph, reader.subject, reader.predicate, reader.object);
-				} else {
-					data.insert_statement_with_string (reader.graph, reader.subject, reader.predicate, reader.object);
+			while (true) {
+				StatementBatch batch = reader.full_batches.pop ();
+
+				if (batch.error != null) {
+					throw batch.error.copy ();
+				}
+
+				for (int i = 0; i < batch.n_statements; i++) {
+					if (batch.statements[i].object_is_uri) {
+						data.insert_statement_with_uri (batch.statements[i].graph, batch.statements[i].subject, batch.statements[i].predicate, batch.statements[i].object);
+					} else {
+						data.insert_statement_with_string (batch.statements[i].graph, batch.statements[i].subject, batch.statements[i].predicate, batch.statements[i].object);
+					}
+					data.update_buffer_might_flush ();
+				}
+
+				bool last = batch.last;
+				size_t offset = batch.offset;
+
+				n_statements += batch.n_statements;
+				batch.n_statements = 0;
+				reader.free_batches.push ((owned) batch);
+
+				if (last)
+					break;
+
+				if (cancellable != null) {
+					cancellable.set_error_if_cancelled ();
+				}
+
+				if ((commit_statements > 0 && n_statements - last_commit_statements >= commit_statements) ||
+				    (commit_bytes > 0 && offset - last_commit_offset >= commit_bytes)) {
+					data.commit_transaction ();
+					last_commit_statements = n_statements;
+					last_commit_offset = offset;
+
+					if (busy_callback != null && reader.length > 0) {
+						busy_callback ("Importing", (double) offset / reader.length);
+					}
+
+					data.begin_transaction ();
 				}
-				data.update_buffer_might_flush ();
 			}
 
 			data.commit_transaction ();
-		} catch (Sparql.Error e) {
-			data.rollback_transaction ();
-			throw e;
-		} catch (DBInterfaceError e) {
+		} catch (Error e) {
 			data.rollback_transaction ();
 			throw e;
+		} finally {
+			// Unblock the parser thread if it is waiting for a batch
+			AtomicInt.set (ref reader.stopped, 1);
+			reader.free_batches.push (new StatementBatch ());
+			parser.join ();
+
+			if (defer_fts)
+				data.set_fts_deferred (false);
+		}
+
+		if (busy_callback != null) {
+			busy_callback ("Idle", 1);
 		}
 	}
 
@@ -59,19 +59,58 @@ typedef enum {
 	TASK_TYPE_QUERY,
 	TASK_TYPE_UPDATE,
 	TASK_TYPE_UPDATE_BLANK,
-	TASK_TYPE_TURTLE
+	TASK_TYPE_UPDATE_ARRAY,
+	TASK_TYPE_UPDATE_STATEMENTS,
+	TASK_TYPE_TURTLE,
+	TASK_TYPE_MAINTENANCE,
+	TASK_TYPE_COMPACT_JOURNAL,
+	TASK_TYPE_IMPORT
 } TaskType;
 
 typedef struct {
 	TaskType type;
 	union {
 		gchar *query;
+		gchar **updates;
 		GFile *turtle_file;
+		struct {
+			gchar *graph;
+			GVariant *statements;
+		} update_statements;
+		struct {
+			guint n_ids;
+			guint n_pages;
+		} maintenance;
+		struct {
+			gsize min_tail_size;
+			TrackerDataCompaction *compaction;
+		} compact_journal;
+		struct {
+			GFile *file;
+			gsize commit_statements;
+			gsize commit_bytes;
+			gboolean defer_fts;
+			TrackerBusyCallback busy_callback;
+			gpointer busy_user_data;
+		} import;
 	} data;
 } TaskData;
 
+typedef struct {
+	TrackerBusyCallback callback;
+	gpointer user_data;
+	gchar *status;
+	gdouble progress;
+} ImportProgress;
+
+typedef struct {
+	gboolean more_work;
+	gdouble progress;
+} MaintenanceResult;
+
 static void tracker_direct_connection_initable_iface_init (GInitableIface *iface);
 static void tracker_direct_connection_async_initable_iface_init (GAsyncInitableIface *iface);
+static void tracker_direct_connection_query_introspection_iface_init (TrackerSparqlQueryIntrospectionIface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (TrackerDirectConnection, tracker_direct_connection,
                          TRACKER_SPARQL_TYPE_CONNECTION,
@@ -79,7 +118,9 @@ G_DEFINE_TYPE_WITH_CODE (TrackerDirectConnection, tracker_direct_connection,
                          G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
                                                 tracker_direct_connection_initable_iface_init)
                          G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
-                                                tracker_direct_connection_async_initable_iface_init))
+                                                tracker_direct_connection_async_initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (TRACKER_SPARQL_TYPE_QUERY_INTROSPECTION,
+                                                tracker_direct_connection_query_introspection_iface_init))
 
 static TaskData *
 task_data_query_new (TaskType     type,
@@ -87,7 +128,10 @@ task_data_query_new (TaskType     type,
 {
 	TaskData *data;
 
-	g_assert (type != TASK_TYPE_TURTLE);
+	g_assert (type != TASK_TYPE_TURTLE && type != TASK_TYPE_UPDATE_ARRAY &&
+	          type != TASK_TYPE_UPDATE_STATEMENTS &&
+	          type != TASK_TYPE_MAINTENANCE && type != TASK_TYPE_COMPACT_JOURNAL &&
+	          type != TASK_TYPE_IMPORT);
 	data = g_new0 (TaskData, 1);
 	data->type = type;
 	data->data.query = g_strdup (sparql);
@@ -107,17 +151,243 @@ task_data_turtle_new (GFile *file)
 	return data;
 }
 
+static TaskData *
+task_data_update_array_new (gchar **updates)
+{
+	TaskData *data;
+
+	data = g_new0 (TaskData, 1);
+	data->type = TASK_TYPE_UPDATE_ARRAY;
+	data->data.updates = updates;
+
+	return data;
+}
+
+static TaskData *
+task_data_update_statements_new (const gchar *graph,
+                                 GVariant    *statements)
+{
+	TaskData *data;
+
+	data = g_new0 (TaskData, 1);
+	data->type = TASK_TYPE_UPDATE_STATEMENTS;
+	data->data.update_statements.graph = g_strdup (graph);
+	data->data.update_statements.statements = g_variant_ref_sink (statements);
+
+	return data;
+}
+
+static TaskData *
+task_data_maintenance_new (guint n_ids,
+                           guint n_pages)
+{
+	TaskData *data;
+
+	data = g_new0 (TaskData, 1);
+	data->type = TASK_TYPE_MAINTENANCE;
+	data->data.maintenance.n_ids = n_ids;
+	data->data.maintenance.n_pages = n_pages;
+
+	return data;
+}
+
+static TaskData *
+task_data_compact_journal_new (gsize min_tail_size)
+{
+	TaskData *data;
+
+	data = g_new0 (TaskData, 1);
+	data->type = TASK_TYPE_COMPACT_JOURNAL;
+	data->data.compact_journal.min_tail_size = min_tail_size;
+
+	return data;
+}
+
+static TaskData *
+task_data_import_new (GFile               *file,
+                      gsize                commit_statements,
+                      gsize                commit_bytes,
+                      gboolean             defer_fts,
+                      TrackerBusyCallback  busy_callback,
+                      gpointer             busy_user_data)
+{
+	TaskData *data;
+
+	data = g_new0 (TaskData, 1);
+	data->type = TASK_TYPE_IMPORT;
+	g_set_object (&data->data.import.file, file);
+	data->data.import.commit_statements = commit_statements;
+	data->data.import.commit_bytes = commit_bytes;
+	data->data.import.defer_fts = defer_fts;
+	data->data.import.busy_callback = busy_callback;
+	data->data.import.busy_user_data = busy_user_data;
+
+	return data;
+}
+
 static void
 task_data_free (TaskData *task)
 {
 	if (task->type == TASK_TYPE_TURTLE)
 		g_object_unref (task->data.turtle_file);
-	else
+	else if (task->type == TASK_TYPE_IMPORT)
+		g_object_unref (task->data.import.file);
+	else if (task->type == TASK_TYPE_UPDATE_ARRAY)
+		g_strfreev (task->data.updates);
+	else if (task->type == TASK_TYPE_UPDATE_STATEMENTS) {
+		g_free (task->data.update_statements.graph);
+		g_variant_unref (task->data.update_statements.statements);
+	}
+	else if (task->type == TASK_TYPE_COMPACT_JOURNAL)
+		g_clear_pointer (&task->data.compact_journal.compaction,
+		                 tracker_data_compaction_free);
+	else if (task->type != TASK_TYPE_MAINTENANCE)
 		g_free (task->data.query);
 
 	g_free (task);
 }
 
+static void
+error_free (GError *error)
+{
+	if (error)
+		g_error_free (error);
+}
+
+static gboolean
+update_array_range (TrackerData  *data,
+                    gchar       **updates,
+                    gint          start,
+                    gint          end,
+                    gboolean      known_to_fail,
+                    GPtrArray    *errors)
+{
+	GString *combined;
+	GError *error = NULL;
+	gint i, middle;
+
+	if (end - start == 1) {
+		GError **err;
+
+		err = (GError **) &g_ptr_array_index (errors, start);
+		tracker_data_update_sparql (data, updates[start], err);
+		return *err == NULL;
+	}
+
+	if (!known_to_fail) {
+		combined = g_string_new (NULL);
+
+		for (i = start; i < end; i++) {
+			if (i != start)
+				g_string_append (combined, "; ");
+			g_string_append (combined, updates[i]);
+		}
+
+		tracker_data_update_sparql (data, combined->str, &error);
+		g_string_free (combined, TRUE);
+
+		if (!error)
+			return TRUE;
+
+		g_clear_error (&error);
+	}
+
+	/* Bisect the failing range, so good statements are still
+	 * committed in bulk, and each bad one is isolated in
+	 * O(log n) transactions. If the first half goes through as
+	 * a whole, the failure must be in the second half, there is
+	 * no need to try it again as a whole.
+	 */
+	middle = start + (end - start) / 2;
+
+	if (update_array_range (data, updates, start, middle, FALSE, errors))
+		update_array_range (data, updates, middle, end, TRUE, errors);
+	else
+		update_array_range (data, updates, middle, end, FALSE, errors);
+
+	return FALSE;
+}
+
+static GPtrArray *
+update_array (TrackerData  *data,
+              gchar       **updates)
+{
+	GPtrArray *errors;
+	guint n_updates;
+
+	n_updates = g_strv_length (updates);
+	errors = g_ptr_array_new_with_free_func ((GDestroyNotify) error_free);
+	g_ptr_array_set_size (errors, n_updates);
+
+	if (n_updates > 0)
+		update_array_range (data, updates, 0, n_updates, FALSE, errors);
+
+	return errors;
+}
+
+static void
+compact_journal_thread_func (GTask        *task,
+                             gpointer      source_object,
+                             gpointer      task_data,
+                             GCancellable *cancellable)
+{
+	TaskData *data = task_data;
+	GError *error = NULL;
+
+	if (tracker_data_compaction_run (data->data.compact_journal.compaction,
+	                                 cancellable, &error))
+		g_task_return_boolean (task, TRUE);
+	else
+		g_task_return_error (task, error);
+}
+
+static gboolean
+import_progress_dispatch (gpointer user_data)
+{
+	ImportProgress *progress = user_data;
+
+	progress->callback (progress->status, progress->progress,
+	                    progress->user_data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+import_progress_free (gpointer user_data)
+{
+	ImportProgress *progress = user_data;
+
+	g_free (progress->status);
+	g_free (progress);
+}
+
+/* Called in the update thread, progress is reported in the
+ * context the import was started from.
+ */
+static void
+import_busy_cb (const gchar *status,
+                gdouble      progress,
+                gpointer     user_data)
+{
+	GTask *task = user_data;
+	TaskData *task_data = g_task_get_task_data (task);
+	ImportProgress *data;
+
+	if (!task_data->data.import.busy_callback)
+		return;
+
+	data = g_new0 (ImportProgress, 1);
+	data->callback = task_data->data.import.busy_callback;
+	data->user_data = task_data->data.import.busy_user_data;
+	data->status = g_strdup (status);
+	data->progress = progress;
+
+	g_main_context_invoke_full (g_task_get_context (task),
+	                            G_PRIORITY_DEFAULT,
+	                            import_progress_dispatch,
+	                            data, import_progress_free);
+}
+
 static void
 update_thread_func (gpointer data,
                     gpointer user_data)
@@ -148,9 +418,60 @@ update_thread_func (gpointer data,
 		retval = tracker_data_update_sparql_blank (tracker_data, task_data->data.query, &error);
 		destroy_notify = (GDestroyNotify) g_variant_unref;
 		break;
+	case TASK_TYPE_UPDATE_ARRAY:
+		retval = update_array (tracker_data, task_data->data.updates);
+		destroy_notify = (GDestroyNotify) g_ptr_array_unref;
+		break;
+	case TASK_TYPE_UPDATE_STATEMENTS:
+		tracker_data_update_statements (tracker_data,
+		                                task_data->data.update_statements.graph,
+		                                task_data->data.update_statements.statements,
+		                                &error);
+		break;
 	case TASK_TYPE_TURTLE:
 		tracker_data_load_turtle_file (tracker_data, task_data->data.turtle_file, &error);
 		break;
+	case TASK_TYPE_IMPORT:
+		tracker_data_import_turtle_file (tracker_data,
+		                                 task_data->data.import.file,
+		                                 task_data->data.import.commit_statements,
+		                                 task_data->data.import.commit_bytes,
+		                                 task_data->data.import.defer_fts,
+		                                 g_task_get_cancellable (task),
+		                                 import_busy_cb, task,
+		                                 &error);
+		break;
+	case TASK_TYPE_MAINTENANCE: {
+		MaintenanceResult *result = g_new0 (MaintenanceResult, 1);
+
+		result->more_work =
+			tracker_data_manager_maintenance_step (priv->data_manager,
+			                                       task_data->data.maintenance.n_ids,
+			                                       task_data->data.maintenance.n_pages,
+			                                       &result->progress,
+			                                       &error);
+		if (error) {
+			g_free (result);
+		} else {
+			retval = result;
+			destroy_notify = g_free;
+		}
+		break;
+	}
+	case TASK_TYPE_COMPACT_JOURNAL:
+		task_data->data.compact_journal.compaction =
+			tracker_data_compaction_begin (priv->data_manager,
+			                               task_data->data.compact_journal.min_tail_size,
+			                               &error);
+
+		if (task_data->data.compact_journal.compaction) {
+			/* The snapshot is written while updates go on */
+			g_task_run_in_thread (task, compact_journal_thread_func);
+			g_object_unref (task);
+			g_mutex_unlock (&priv->mutex);
+			return;
+		}
+		break;
 	}
 
 	if (error)
@@ -575,54 +896,6 @@ tracker_direct_connection_update_finish (TrackerSparqlConnection  *self,
 	g_task_propagate_boolean (G_TASK (res), error);
 }
 
-static void
-error_free (GError *error)
-{
-	if (error)
-		g_error_free (error);
-}
-
-static void
-update_array_async_thread_func (GTask        *task,
-                                gpointer      source_object,
-                                gpointer      task_data,
-                                GCancellable *cancellable)
-{
-	gchar **updates = task_data;
-	gchar *concatenated;
-	GPtrArray *errors;
-	GError *error = NULL;
-	gint i;
-
-	errors = g_ptr_array_new_with_free_func ((GDestroyNotify) error_free);
-	g_ptr_array_set_size (errors, g_strv_length (updates));
-
-	/* Fast path, perform everything as a single update */
-	concatenated = g_strjoinv ("; ", updates);
-	tracker_sparql_connection_update (source_object, concatenated,
-	                                  g_task_get_priority (task),
-	                                  cancellable, &error);
-
-	if (!error) {
-		g_task_return_pointer (task, errors,
-		                       (GDestroyNotify) g_ptr_array_unref);
-		return;
-	}
-
-	/* Slow path, perform updates one by one */
-	for (i = 0; updates[i]; i++) {
-		GError **err = NULL;
-
-		err = (GError **) &g_ptr_array_index (errors, i);
-		tracker_sparql_connection_update (source_object, updates[i],
-		                                  g_task_get_priority (task),
-		                                  cancellable, err);
-	}
-
-	g_task_return_pointer (task, errors,
-	                       (GDestroyNotify) g_ptr_array_unref);
-}
-
 static void
 tracker_direct_connection_update_array_async (TrackerSparqlConnection  *self,
                                               gchar                   **updates,
@@ -632,10 +905,15 @@ tracker_direct_connection_update_array_async (TrackerSparqlConnection  *self,
                                               GAsyncReadyCallback       callback,
                                               gpointer                  user_data)
 {
+	TrackerDirectConnectionPrivate *priv;
+	TrackerDirectConnection *conn;
 	GTask *task;
 	gchar **copy;
 	gint i = 0;
 
+	conn = TRACKER_DIRECT_CONNECTION (self);
+	priv = tracker_direct_connection_get_instance_private (conn);
+
 	copy = g_new0 (gchar*, n_updates + 1);
 
 	for (i = 0; i < n_updates; i++) {
@@ -645,9 +923,14 @@ tracker_direct_connection_update_array_async (TrackerSparqlConnection  *self,
 
 	task = g_task_new (self, cancellable, callback, user_data);
 	g_task_set_priority (task, priority);
-	g_task_set_task_data (task, copy, (GDestroyNotify) g_strfreev);
+	g_task_set_task_data (task,
+	                      task_data_update_array_new (copy),
+	                      (GDestroyNotify) task_data_free);
 
-	g_task_run_in_thread (task, update_array_async_thread_func);
+	/* Go through the update thread, so batches are
+	 * committed in the order they were issued.
+	 */
+	g_thread_pool_push (priv->update_thread, task, NULL);
 }
 
 static GPtrArray *
@@ -713,6 +996,78 @@ tracker_direct_connection_update_blank_finish (TrackerSparqlConnection  *self,
 	return g_task_propagate_pointer (G_TASK (res), error);
 }
 
+static GVariant *
+serialize_resources (TrackerResource **resources,
+                     gint              n_resources)
+{
+	GVariantBuilder builder;
+	gint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa(ysss)"));
+
+	for (i = 0; i < n_resources; i++) {
+		g_variant_builder_add_value (&builder,
+		                             tracker_resource_serialize_statements (resources[i], NULL));
+	}
+
+	return g_variant_builder_end (&builder);
+}
+
+static void
+tracker_direct_connection_update_resources (TrackerSparqlConnection  *self,
+                                            TrackerResource         **resources,
+                                            gint                      n_resources,
+                                            const gchar              *graph,
+                                            gint                      priority,
+                                            GCancellable             *cancellable,
+                                            GError                  **error)
+{
+	TrackerDirectConnectionPrivate *priv;
+	TrackerDirectConnection *conn;
+	TrackerData *data;
+	GVariant *statements;
+
+	conn = TRACKER_DIRECT_CONNECTION (self);
+	priv = tracker_direct_connection_get_instance_private (conn);
+
+	statements = g_variant_ref_sink (serialize_resources (resources, n_resources));
+
+	g_mutex_lock (&priv->mutex);
+	data = tracker_data_manager_get_data (priv->data_manager);
+	tracker_data_update_statements (data, graph, statements, error);
+	g_mutex_unlock (&priv->mutex);
+
+	g_variant_unref (statements);
+}
+
+static void
+tracker_direct_connection_update_resources_async (TrackerSparqlConnection  *self,
+                                                  TrackerResource         **resources,
+                                                  gint                      n_resources,
+                                                  const gchar              *graph,
+                                                  gint                      priority,
+                                                  GCancellable             *cancellable,
+                                                  GAsyncReadyCallback       callback,
+                                                  gpointer                  user_data)
+{
+	/* Resources are serialized right away, so callers
+	 * may keep modifying them after this call.
+	 */
+	tracker_direct_connection_update_statements_async (TRACKER_DIRECT_CONNECTION (self),
+	                                                   graph,
+	                                                   serialize_resources (resources, n_resources),
+	                                                   priority, cancellable,
+	                                                   callback, user_data);
+}
+
+static void
+tracker_direct_connection_update_resources_finish (TrackerSparqlConnection  *self,
+                                                   GAsyncResult             *res,
+                                                   GError                  **error)
+{
+	g_task_propagate_boolean (G_TASK (res), error);
+}
+
 static void
 tracker_direct_connection_load (TrackerSparqlConnection  *self,
                                 GFile                    *file,
@@ -772,6 +1127,61 @@ tracker_direct_connection_get_namespace_manager (TrackerSparqlConnection *self)
 	return priv->namespace_manager;
 }
 
+static GVariant *
+tracker_direct_connection_explain_query (TrackerSparqlQueryIntrospection  *self,
+                                         const gchar                      *sparql,
+                                         gboolean                          profile,
+                                         GCancellable                     *cancellable,
+                                         GError                          **error)
+{
+	TrackerDirectConnectionPrivate *priv;
+	TrackerDirectConnection *conn;
+	TrackerSparqlQuery *query;
+	GVariant *retval;
+
+	conn = TRACKER_DIRECT_CONNECTION (self);
+	priv = tracker_direct_connection_get_instance_private (conn);
+
+	g_mutex_lock (&priv->mutex);
+	query = tracker_sparql_query_new (priv->data_manager, sparql);
+	retval = tracker_sparql_query_explain (query, profile, error);
+	g_object_unref (query);
+	g_mutex_unlock (&priv->mutex);
+
+	return retval;
+}
+
+static gchar **
+tracker_direct_connection_get_dependencies (TrackerSparqlQueryIntrospection  *self,
+                                            const gchar                      *sparql,
+                                            GCancellable                     *cancellable,
+                                            gint                             *n_classes,
+                                            GError                          **error)
+{
+	TrackerDirectConnectionPrivate *priv;
+	TrackerDirectConnection *conn;
+	TrackerSparqlQuery *query;
+	gchar **retval;
+
+	conn = TRACKER_DIRECT_CONNECTION (self);
+	priv = tracker_direct_connection_get_instance_private (conn);
+
+	g_mutex_lock (&priv->mutex);
+	query = tracker_sparql_query_new (priv->data_manager, sparql);
+	retval = tracker_sparql_query_get_notify_dependencies (query, n_classes, error);
+	g_object_unref (query);
+	g_mutex_unlock (&priv->mutex);
+
+	return retval;
+}
+
+static void
+tracker_direct_connection_query_introspection_iface_init (TrackerSparqlQueryIntrospectionIface *iface)
+{
+	iface->explain_query = tracker_direct_connection_explain_query;
+	iface->get_dependencies = tracker_direct_connection_get_dependencies;
+}
+
 static void
 tracker_direct_connection_class_init (TrackerDirectConnectionClass *klass)
 {
@@ -796,6 +1206,9 @@ tracker_direct_connection_class_init (TrackerDirectConnectionClass *klass)
 	sparql_connection_class->update_blank = tracker_direct_connection_update_blank;
 	sparql_connection_class->update_blank_async = tracker_direct_connection_update_blank_async;
 	sparql_connection_class->update_blank_finish = tracker_direct_connection_update_blank_finish;
+	sparql_connection_class->update_resources = tracker_direct_connection_update_resources;
+	sparql_connection_class->update_resources_async = tracker_direct_connection_update_resources_async;
+	sparql_connection_class->update_resources_finish = tracker_direct_connection_update_resources_finish;
 	sparql_connection_class->load = tracker_direct_connection_load;
 	sparql_connection_class->load_async = tracker_direct_connection_load_async;
 	sparql_connection_class->load_finish = tracker_direct_connection_load_finish;
@@ -893,3 +1306,170 @@ tracker_direct_connection_sync (TrackerDirectConnection *conn)
 	if (wal_iface)
 		tracker_db_interface_sqlite_wal_checkpoint (wal_iface, TRUE, NULL);
 }
+
+/* Performs a step of background maintenance (see
+ * tracker_data_manager_maintenance_step()) in the update thread, so
+ * it never overlaps with an update transaction. The task is sorted by
+ * @priority against pending updates.
+ */
+void
+tracker_direct_connection_maintenance_async (TrackerDirectConnection *conn,
+                                             guint                    n_ids,
+                                             guint                    n_pages,
+                                             gint                     priority,
+                                             GCancellable            *cancellable,
+                                             GAsyncReadyCallback      callback,
+                                             gpointer                 user_data)
+{
+	TrackerDirectConnectionPrivate *priv;
+	GTask *task;
+
+	priv = tracker_direct_connection_get_instance_private (conn);
+
+	task = g_task_new (conn, cancellable, callback, user_data);
+	g_task_set_priority (task, priority);
+	g_task_set_task_data (task,
+	                      task_data_maintenance_new (n_ids, n_pages),
+	                      (GDestroyNotify) task_data_free);
+
+	g_thread_pool_push (priv->update_thread, task, NULL);
+}
+
+gboolean
+tracker_direct_connection_maintenance_finish (TrackerDirectConnection  *conn,
+                                              GAsyncResult             *res,
+                                              gdouble                  *progress,
+                                              GError                  **error)
+{
+	MaintenanceResult *result;
+	gboolean more_work;
+
+	result = g_task_propagate_pointer (G_TASK (res), error);
+	if (!result)
+		return FALSE;
+
+	if (progress)
+		*progress = result->progress;
+
+	more_work = result->more_work;
+	g_free (result);
+
+	return more_work;
+}
+
+/* Compacts the journal into a snapshot of the live data if the chunks
+ * written since the last one make it worth it (see
+ * tracker_data_compaction_begin()). The database state is pinned in
+ * the update thread, then the snapshot is written in a thread of its
+ * own without blocking updates.
+ */
+void
+tracker_direct_connection_compact_journal_async (TrackerDirectConnection *conn,
+                                                 gsize                    min_tail_size,
+                                                 gint                     priority,
+                                                 GCancellable            *cancellable,
+                                                 GAsyncReadyCallback      callback,
+                                                 gpointer                 user_data)
+{
+	TrackerDirectConnectionPrivate *priv;
+	GTask *task;
+
+	priv = tracker_direct_connection_get_instance_private (conn);
+
+	task = g_task_new (conn, cancellable, callback, user_data);
+	g_task_set_priority (task, priority);
+	g_task_set_task_data (task,
+	                      task_data_compact_journal_new (min_tail_size),
+	                      (GDestroyNotify) task_data_free);
+
+	g_thread_pool_push (priv->update_thread, task, NULL);
+}
+
+gboolean
+tracker_direct_connection_compact_journal_finish (TrackerDirectConnection  *conn,
+                                                  GAsyncResult             *res,
+                                                  GError                  **error)
+{
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/* Imports a Turtle file that may be too large to be loaded in a
+ * single transaction, see tracker_data_import_turtle_file(). Data
+ * committed before an error or cancellation stays in the store.
+ */
+void
+tracker_direct_connection_import_async (TrackerDirectConnection *conn,
+                                        GFile                   *file,
+                                        gsize                    commit_statements,
+                                        gsize                    commit_bytes,
+                                        gboolean                 defer_fts,
+                                        gint                     priority,
+                                        GCancellable            *cancellable,
+                                        TrackerBusyCallback      busy_callback,
+                                        gpointer                 busy_user_data,
+                                        GAsyncReadyCallback      callback,
+                                        gpointer                 user_data)
+{
+	TrackerDirectConnectionPrivate *priv;
+	GTask *task;
+
+	g_return_if_fail (G_IS_FILE (file));
+
+	priv = tracker_direct_connection_get_instance_private (conn);
+
+	task = g_task_new (conn, cancellable, callback, user_data);
+	g_task_set_priority (task, priority);
+	g_task_set_task_data (task,
+	                      task_data_import_new (file, commit_statements,
+	                                            commit_bytes, defer_fts,
+	                                            busy_callback, busy_user_data),
+	                      (GDestroyNotify) task_data_free);
+
+	g_thread_pool_push (priv->update_thread, task, NULL);
+}
+
+gboolean
+tracker_direct_connection_import_finish (TrackerDirectConnection  *conn,
+                                         GAsyncResult             *res,
+                                         GError                  **error)
+{
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/* Applies statements as produced by tracker_resource_serialize_statements(),
+ * one a(ysss) array per resource, in a single transaction. This is the
+ * entry point for statements that were already serialized elsewhere,
+ * e.g. received over D-Bus.
+ */
+void
+tracker_direct_connection_update_statements_async (TrackerDirectConnection *conn,
+                                                   const gchar             *graph,
+                                                   GVariant                *statements,
+                                                   gint                     priority,
+                                                   GCancellable            *cancellable,
+                                                   GAsyncReadyCallback      callback,
+                                                   gpointer                 user_data)
+{
+	TrackerDirectConnectionPrivate *priv;
+	GTask *task;
+
+	g_return_if_fail (g_variant_is_of_type (statements, G_VARIANT_TYPE ("aa(ysss)")));
+
+	priv = tracker_direct_connection_get_instance_private (conn);
+
+	task = g_task_new (conn, cancellable, callback, user_data);
+	g_task_set_priority (task, priority);
+	g_task_set_task_data (task,
+	                      task_data_update_statements_new (graph, statements),
+	                      (GDestroyNotify) task_data_free);
+
+	g_thread_pool_push (priv->update_thread, task, NULL);
+}
+
+gboolean
+tracker_direct_connection_update_statements_finish (TrackerDirectConnection  *conn,
+                                                    GAsyncResult             *res,
+                                                    GError                  **error)
+{
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
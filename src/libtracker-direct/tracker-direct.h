@@ -56,4 +56,52 @@ void tracker_direct_connection_set_default_flags (TrackerDBManagerFlags flags);
 
 void tracker_direct_connection_sync (TrackerDirectConnection *conn);
 
+void tracker_direct_connection_maintenance_async (TrackerDirectConnection *conn,
+                                                  guint                    n_ids,
+                                                  guint                    n_pages,
+                                                  gint                     priority,
+                                                  GCancellable            *cancellable,
+                                                  GAsyncReadyCallback      callback,
+                                                  gpointer                 user_data);
+gboolean tracker_direct_connection_maintenance_finish (TrackerDirectConnection  *conn,
+                                                       GAsyncResult             *res,
+                                                       gdouble                  *progress,
+                                                       GError                  **error);
+
+void tracker_direct_connection_compact_journal_async (TrackerDirectConnection *conn,
+                                                      gsize                    min_tail_size,
+                                                      gint                     priority,
+                                                      GCancellable            *cancellable,
+                                                      GAsyncReadyCallback      callback,
+                                                      gpointer                 user_data);
+gboolean tracker_direct_connection_compact_journal_finish (TrackerDirectConnection  *conn,
+                                                           GAsyncResult             *res,
+                                                           GError                  **error);
+
+void tracker_direct_connection_import_async (TrackerDirectConnection *conn,
+                                             GFile                   *file,
+                                             gsize                    commit_statements,
+                                             gsize                    commit_bytes,
+                                             gboolean                 defer_fts,
+                                             gint                     priority,
+                                             GCancellable            *cancellable,
+                                             TrackerBusyCallback      busy_callback,
+                                             gpointer                 busy_user_data,
+                                             GAsyncReadyCallback      callback,
+                                             gpointer                 user_data);
+gboolean tracker_direct_connection_import_finish (TrackerDirectConnection  *conn,
+                                                  GAsyncResult             *res,
+                                                  GError                  **error);
+
+void tracker_direct_connection_update_statements_async (TrackerDirectConnection *conn,
+                                                        const gchar             *graph,
+                                                        GVariant                *statements,
+                                                        gint                     priority,
+                                                        GCancellable            *cancellable,
+                                                        GAsyncReadyCallback      callback,
+                                                        gpointer                 user_data);
+gboolean tracker_direct_connection_update_statements_finish (TrackerDirectConnection  *conn,
+                                                             GAsyncResult             *res,
+                                                             GError                  **error);
+
 #endif /* __TRACKER_LOCAL_CONNECTION_H__ */
@@ -61,6 +61,12 @@ struct _TrackerDecoratorInfo {
 struct _ClassInfo {
 	gchar *class_name;
 	gint priority;
+
+	/* Paging state, only meaningful on the first class
+	 * of each priority group.
+	 */
+	gint last_id;
+	guint exhausted : 1;
 };
 
 struct _SparqlUpdate {
@@ -93,9 +99,11 @@ struct _TrackerDecoratorPrivate {
 	GCancellable *cancellable;
 
 	gint batch_size;
+	gint query_group; /* First class of the group being queried, or -1 */
 
 	guint processing : 1;
 	guint querying   : 1;
+	guint pass_found_items : 1;
 };
 
 enum {
@@ -595,186 +603,270 @@ decorator_cancel_active_tasks (TrackerDecorator *decorator)
 }
 
 static void
-query_append_id (GString *string,
-                 gint     id)
+query_add_id_filter (GString  *query,
+                     GArray   *ids,
+                     guint     n_ids)
 {
-	if (string->len > 1 && string->str[string->len - 1] != '(')
-		g_string_append_c (string, ',');
+	guint i;
 
-	g_string_append_printf (string, "%d", id);
+	if (!ids || n_ids == 0)
+		return;
+
+	g_string_append (query, "&& tracker:id(?urn) IN (");
+
+	for (i = 0; i < n_ids; i++) {
+		if (i != 0)
+			g_string_append (query, ",");
+
+		g_string_append_printf (query, "%d",
+		                        g_array_index (ids, gint, i));
+	}
+
+	g_string_append (query, ")");
 }
 
+/* Blacklisted items that no longer match are not counted, so only
+ * those still matching must be discounted from the remaining items.
+ */
 static void
-query_add_blacklisted_filter (TrackerDecorator *decorator,
-                              GString          *query)
+query_add_blacklist_filter (GString   *query,
+                            GSequence *blacklist)
 {
-	TrackerDecoratorPrivate *priv = decorator->priv;
 	GSequenceIter *iter;
 
-	if (g_sequence_get_length (priv->blacklist_items) == 0)
+	if (g_sequence_is_empty (blacklist))
 		return;
 
 	g_string_append (query, "&& tracker:id(?urn) NOT IN (");
 
-	iter = g_sequence_get_begin_iter (priv->blacklist_items);
+	for (iter = g_sequence_get_begin_iter (blacklist);
+	     !g_sequence_iter_is_end (iter);
+	     iter = g_sequence_iter_next (iter)) {
+		if (!g_sequence_iter_is_begin (iter))
+			g_string_append (query, ",");
 
-	while (!g_sequence_iter_is_end (iter)) {
-		query_append_id (query, GPOINTER_TO_INT (g_sequence_get (iter)));
-		iter = g_sequence_iter_next (iter);
+		g_string_append_printf (query, "%d",
+		                        GPOINTER_TO_INT (g_sequence_get (iter)));
 	}
 
 	g_string_append (query, ")");
 }
 
-static void
-query_add_update_buffer_ids (GString *query,
-                             GArray  *commit_buffer)
+/* Appends the graph pattern for the group of classes sharing priority
+ * with the class at @first, returns the position of the next group.
+ */
+static guint
+query_append_class_group (TrackerDecorator *decorator,
+                          GString          *query,
+                          guint             first,
+                          const gchar      *extra_filter)
 {
-	SparqlUpdate *update;
-	gint i;
+	TrackerDecoratorPrivate *priv = decorator->priv;
+	ClassInfo *group, *cur;
+	guint i;
+
+	group = &g_array_index (priv->classes, ClassInfo, first);
+
+	g_string_append_printf (query,
+	                        "{ ?urn a rdfs:Resource;"
+	                        "       a ?type ;"
+	                        "       tracker:available true ."
+	                        "  FILTER (! EXISTS { ?urn nie:dataSource <%s> } ",
+	                        priv->data_source);
 
-	for (i = 0; i < commit_buffer->len; i++) {
-		update = &g_array_index (commit_buffer, SparqlUpdate, i);
-		query_append_id (query, update->id);
+	if (extra_filter)
+		g_string_append (query, extra_filter);
+
+	g_string_append (query, " && ?type IN (");
+
+	for (i = first; i < priv->classes->len; i++) {
+		cur = &g_array_index (priv->classes, ClassInfo, i);
+
+		if (cur->priority != group->priority)
+			break;
+
+		if (i != first)
+			g_string_append (query, ",");
+
+		g_string_append (query, cur->class_name);
 	}
+
+	g_string_append (query, "))}");
+
+	return i;
 }
 
-static void
-query_add_processing_filter (TrackerDecorator *decorator,
-                             GString          *query)
+static gchar *
+create_query_string (TrackerDecorator  *decorator,
+                     const gchar       *select_clause,
+                     gint               group,
+                     const gchar       *extra_filter,
+                     const gchar       *modifiers)
 {
 	TrackerDecoratorPrivate *priv = decorator->priv;
+	GString *query;
+	guint i;
 
-	if ((!priv->sparql_buffer || priv->sparql_buffer->len == 0) &&
-	    (!priv->commit_buffer || priv->commit_buffer->len == 0))
-	    return;
+	if (priv->classes->len == 0)
+		return NULL;
 
-	g_string_append (query, "&& tracker:id(?urn) NOT IN (");
+	query = g_string_new ("SELECT ");
+	g_string_append_printf (query, "%s { SELECT ?urn WHERE {", select_clause);
+
+	if (group >= 0) {
+		query_append_class_group (decorator, query, group, extra_filter);
+	} else {
+		i = 0;
 
-	if (priv->sparql_buffer && priv->sparql_buffer->len > 0)
-		query_add_update_buffer_ids (query, priv->sparql_buffer);
-	if (priv->commit_buffer && priv->commit_buffer->len > 0)
-		query_add_update_buffer_ids (query, priv->commit_buffer);
+		while (i < priv->classes->len) {
+			if (i != 0)
+				g_string_append (query, " UNION ");
 
-	g_string_append (query, ")");
+			i = query_append_class_group (decorator, query, i, extra_filter);
+		}
+	}
+
+	g_string_append (query, "}}");
+
+	if (modifiers)
+		g_string_append_printf (query, " %s", modifiers);
+
+	return g_string_free (query, FALSE);
 }
 
+/* Items are paged through by tracker:id, each priority group keeps the
+ * last ID it has seen in its first ClassInfo, so the store never needs
+ * to be told about the items being processed, those and blacklisted
+ * ones are filtered out client side. Items that get modified behind a
+ * cursor are caught up by the next pass, a new pass is started if the
+ * previous one found anything.
+ */
 static void
-query_add_id_filter (GString  *query,
-                     GArray   *ids)
+decorator_reset_cursors (TrackerDecorator *decorator,
+                         gboolean          restart)
 {
-	gint i;
-
-	if (!ids || ids->len == 0)
-		return;
+	TrackerDecoratorPrivate *priv = decorator->priv;
+	ClassInfo *info;
+	guint i;
 
-	g_string_append (query, "&& tracker:id(?urn) IN (");
+	for (i = 0; i < priv->classes->len; i++) {
+		info = &g_array_index (priv->classes, ClassInfo, i);
 
-	for (i = 0; i < ids->len; i++) {
-		if (i != 0)
-			g_string_append (query, ",");
+		if (restart)
+			info->last_id = 0;
 
-		g_string_append_printf (query, "%d",
-		                        g_array_index (ids, gint, i));
+		info->exhausted = FALSE;
 	}
 
-	g_string_append (query, ")");
+	if (restart)
+		priv->pass_found_items = FALSE;
 }
 
-static void
-query_append_current_tasks_filter (TrackerDecorator *decorator,
-				   GString          *query)
+static gint
+decorator_next_class_group (TrackerDecorator *decorator)
 {
 	TrackerDecoratorPrivate *priv = decorator->priv;
-	GHashTableIter iter;
-	gint i = 0, id;
-	GTask *task;
+	ClassInfo *info, *group = NULL;
+	guint i;
 
-	if (g_hash_table_size (priv->tasks) == 0)
-		return;
+	for (i = 0; i < priv->classes->len; i++) {
+		info = &g_array_index (priv->classes, ClassInfo, i);
 
-	g_string_append (query, "&& tracker:id(?urn) NOT IN (");
-	g_hash_table_iter_init (&iter, priv->tasks);
+		if (group && group->priority == info->priority)
+			continue;
 
-	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &task)) {
-		if (i != 0)
-			g_string_append (query, ",");
+		group = info;
 
-		id = GPOINTER_TO_INT (g_task_get_task_data (task));
-		g_string_append_printf (query, "%d", id);
-		i++;
+		if (!group->exhausted)
+			return (gint) i;
 	}
 
-	g_string_append (query, ")");
+	if (!priv->pass_found_items || priv->classes->len == 0)
+		return -1;
+
+	decorator_reset_cursors (decorator, TRUE);
+
+	return 0;
 }
 
 static gchar *
-create_query_string (TrackerDecorator  *decorator,
-                     gchar            **select_clauses,
-                     gboolean           for_prepended)
+create_next_items_query (TrackerDecorator *decorator)
 {
 	TrackerDecoratorPrivate *priv = decorator->priv;
-	ClassInfo *prev = NULL, *cur;
-	GString *query;
-	gint i;
-
-	query = g_string_new ("SELECT ");
-
-	for (i = 0; select_clauses[i]; i++) {
-		g_string_append_printf (query, "%s ", select_clauses[i]);
+	const gchar *clauses =
+		"?urn tracker:id(?urn) nie:url(?urn) nie:mimeType(?urn)";
+	gchar *query, *filter, *modifiers;
+
+	if (priv->prepended_ids->len > 0) {
+		GString *ids;
+		guint n_ids;
+
+		n_ids = MIN (priv->prepended_ids->len, QUERY_BATCH_SIZE);
+		ids = g_string_new (NULL);
+		query_add_id_filter (ids, priv->prepended_ids, n_ids);
+		g_array_remove_range (priv->prepended_ids, 0, n_ids);
+
+		priv->query_group = -1;
+		modifiers = g_strdup_printf ("LIMIT %d", QUERY_BATCH_SIZE);
+		query = create_query_string (decorator, clauses, -1,
+		                             ids->str, modifiers);
+		g_string_free (ids, TRUE);
+		g_free (modifiers);
+
+		return query;
 	}
 
-	g_string_append (query, "{ SELECT ?urn WHERE {");
+	priv->query_group = decorator_next_class_group (decorator);
 
-	for (i = 0; i < priv->classes->len; i++) {
-		cur = &g_array_index (priv->classes, ClassInfo, i);
+	if (priv->query_group < 0)
+		return NULL;
 
-		if (!prev || prev->priority != cur->priority) {
-			if (prev)
-				g_string_append (query, "))} UNION ");
+	filter = g_strdup_printf ("&& tracker:id(?urn) > %d",
+	                          g_array_index (priv->classes, ClassInfo,
+	                                         priv->query_group).last_id);
+	modifiers = g_strdup_printf ("ORDER BY tracker:id(?urn) LIMIT %d",
+	                             QUERY_BATCH_SIZE);
+	query = create_query_string (decorator, clauses, priv->query_group,
+	                             filter, modifiers);
+	g_free (filter);
+	g_free (modifiers);
 
-			g_string_append_printf (query,
-			                        "{ ?urn a rdfs:Resource;"
-			                        "       a ?type ;"
-			                        "       tracker:available true ."
-			                        "  FILTER (! EXISTS { ?urn nie:dataSource <%s> } ",
-			                        priv->data_source);
+	return query;
+}
 
-			query_add_blacklisted_filter (decorator, query);
-			query_add_processing_filter (decorator, query);
+static GHashTable *
+decorator_get_processing_ids (TrackerDecorator *decorator)
+{
+	TrackerDecoratorPrivate *priv = decorator->priv;
+	GArray *buffers[] = { priv->sparql_buffer, priv->commit_buffer };
+	SparqlUpdate *update;
+	GHashTable *ids;
+	guint i, j;
 
-			if (for_prepended && priv->prepended_ids->len > 0) {
-				query_add_id_filter (query, priv->prepended_ids);
-				g_array_set_size (priv->prepended_ids, 0);
-			}
+	ids = g_hash_table_new (NULL, NULL);
 
-			query_append_current_tasks_filter (decorator, query);
-			g_string_append (query, " && ?type IN (");
-		} else {
-			g_string_append (query, ",");
+	for (i = 0; i < G_N_ELEMENTS (buffers); i++) {
+		for (j = 0; buffers[i] && j < buffers[i]->len; j++) {
+			update = &g_array_index (buffers[i], SparqlUpdate, j);
+			g_hash_table_add (ids, GINT_TO_POINTER (update->id));
 		}
-
-		g_string_append_printf (query, "%s", cur->class_name);
-		prev = cur;
 	}
 
-	g_string_append_printf (query, "))}}} LIMIT %d", QUERY_BATCH_SIZE);
-
-	return g_string_free (query, FALSE);
+	return ids;
 }
 
-static gchar *
-create_remaining_items_query (TrackerDecorator *decorator)
+static gssize
+decorator_get_n_processing_items (TrackerDecorator *decorator)
 {
-	gchar *clauses[] = {
-		"?urn",
-		"tracker:id(?urn)",
-		"nie:url(?urn)",
-		"nie:mimeType(?urn)",
-		NULL
-	};
+	TrackerDecoratorPrivate *priv = decorator->priv;
+	gssize n_items = 0;
 
-	return create_query_string (decorator, clauses, TRUE);
+	if (priv->sparql_buffer)
+		n_items += priv->sparql_buffer->len;
+	if (priv->commit_buffer)
+		n_items += priv->commit_buffer->len;
+
+	return n_items;
 }
 
 static void
@@ -786,12 +878,15 @@ decorator_query_remaining_items_cb (GObject      *object,
 	TrackerDecoratorPrivate *priv;
 	TrackerSparqlCursor *cursor;
 	GError *error = NULL;
+	gssize n_items;
 
 	cursor = tracker_sparql_connection_query_finish (TRACKER_SPARQL_CONNECTION (object),
 							 result, &error);
 
 	if (error || !tracker_sparql_cursor_next (cursor, NULL, &error)) {
+		decorator->priv->querying = FALSE;
 		decorator_notify_task_error (decorator, error);
+		g_clear_object (&cursor);
 		g_error_free (error);
 		return;
 	}
@@ -799,12 +894,21 @@ decorator_query_remaining_items_cb (GObject      *object,
 	priv = decorator->priv;
 	priv->querying = FALSE;
 
-	priv->n_remaining_items = g_queue_get_length (&priv->item_cache) +
-		tracker_sparql_cursor_get_integer (cursor, 0);
+	/* The count query doesn't exclude items being processed, it is
+	 * cheaper to discount those here.
+	 */
+	n_items = tracker_sparql_cursor_get_integer (cursor, 0);
+	n_items -= decorator_get_n_processing_items (decorator);
 	g_object_unref (cursor);
 
+	priv->n_remaining_items = g_queue_get_length (&priv->item_cache) +
+		MAX (n_items, 0);
+
 	g_debug ("Found %" G_GSIZE_FORMAT " items to extract", priv->n_remaining_items);
 
+	/* Start paging from scratch */
+	decorator_reset_cursors (decorator, TRUE);
+
 	if (priv->n_remaining_items > 0)
 		decorator_cache_next_items (decorator);
 	else
@@ -814,12 +918,17 @@ decorator_query_remaining_items_cb (GObject      *object,
 static void
 decorator_query_remaining_items (TrackerDecorator *decorator)
 {
-	gchar *query, *clauses[] = { "COUNT(?urn)", NULL };
 	TrackerSparqlConnection *sparql_conn;
 	TrackerDecoratorPrivate *priv;
+	GString *filter;
+	gchar *query;
 
 	priv = decorator->priv;
-	query = create_query_string (decorator, clauses, FALSE);
+	filter = g_string_new (NULL);
+	query_add_blacklist_filter (filter, priv->blacklist_items);
+	query = create_query_string (decorator, "COUNT(?urn)", -1,
+	                             filter->len > 0 ? filter->str : NULL, NULL);
+	g_string_free (filter, TRUE);
 
 	if (query) {
 		sparql_conn = tracker_miner_get_connection (TRACKER_MINER (decorator));
@@ -829,6 +938,7 @@ decorator_query_remaining_items (TrackerDecorator *decorator)
 		                                       decorator);
 		g_free (query);
 	} else {
+		priv->querying = FALSE;
 		decorator_notify_empty (decorator);
 	}
 }
@@ -876,6 +986,54 @@ decorator_item_cache_remove (TrackerDecorator *decorator,
 	}
 }
 
+static void
+decorator_cache_items_from_cursor (TrackerDecorator    *decorator,
+                                   TrackerSparqlCursor *cursor)
+{
+	TrackerDecoratorPrivate *priv = decorator->priv;
+	TrackerDecoratorInfo *info;
+	GHashTable *processing_ids;
+	gint id, last_id = 0;
+	guint n_rows = 0;
+
+	processing_ids = decorator_get_processing_ids (decorator);
+
+	while (tracker_sparql_cursor_next (cursor, NULL, NULL)) {
+		id = tracker_sparql_cursor_get_integer (cursor, 1);
+		n_rows++;
+
+		/* Resources matching several classes in the group */
+		if (id == last_id)
+			continue;
+
+		last_id = MAX (last_id, id);
+
+		if (g_hash_table_contains (processing_ids, GINT_TO_POINTER (id)) ||
+		    g_sequence_lookup (priv->blacklist_items,
+		                       GINT_TO_POINTER (id),
+		                       sequence_compare_func,
+		                       NULL) != NULL)
+			continue;
+
+		info = tracker_decorator_info_new (decorator, cursor);
+		g_queue_push_tail (&priv->item_cache, info);
+		priv->pass_found_items = TRUE;
+	}
+
+	g_hash_table_unref (processing_ids);
+
+	if (priv->query_group >= 0) {
+		ClassInfo *group;
+
+		group = &g_array_index (priv->classes, ClassInfo, priv->query_group);
+
+		if (n_rows > 0)
+			group->last_id = last_id;
+		if (n_rows < QUERY_BATCH_SIZE)
+			group->exhausted = TRUE;
+	}
+}
+
 static void
 decorator_cache_items_cb (GObject      *object,
                           GAsyncResult *result,
@@ -885,7 +1043,6 @@ decorator_cache_items_cb (GObject      *object,
 	TrackerDecoratorPrivate *priv;
 	TrackerSparqlConnection *conn;
 	TrackerSparqlCursor *cursor;
-	TrackerDecoratorInfo *info;
 	GError *error = NULL;
 
 	conn = TRACKER_SPARQL_CONNECTION (object);
@@ -896,27 +1053,34 @@ decorator_cache_items_cb (GObject      *object,
 	if (error) {
 		decorator_notify_task_error (decorator, error);
 		g_error_free (error);
-	} else {
-		while (tracker_sparql_cursor_next (cursor, NULL, NULL)) {
-			info = tracker_decorator_info_new (decorator, cursor);
-			g_queue_push_tail (&priv->item_cache, info);
-		}
+
+		if (priv->processing)
+			decorator_finish (decorator);
+
+		return;
 	}
 
-	if (!g_queue_is_empty (&priv->item_cache) && !priv->processing) {
-		decorator_start (decorator);
-	} else if (g_queue_is_empty (&priv->item_cache) && priv->processing) {
-		decorator_finish (decorator);
+	decorator_cache_items_from_cursor (decorator, cursor);
+	g_object_unref (cursor);
+
+	if (g_queue_is_empty (&priv->item_cache)) {
+		/* Nothing usable in this page, look further */
+		decorator_cache_next_items (decorator);
+		return;
 	}
 
+	if (!priv->processing)
+		decorator_start (decorator);
+
 	decorator_pair_tasks (decorator);
-	g_object_unref (cursor);
 }
 
 static void
 decorator_cache_next_items (TrackerDecorator *decorator)
 {
 	TrackerDecoratorPrivate *priv = decorator->priv;
+	TrackerSparqlConnection *sparql_conn;
+	gchar *query;
 
 	if (priv->querying ||
 	    g_hash_table_size (priv->tasks) > 0 ||
@@ -927,18 +1091,31 @@ decorator_cache_next_items (TrackerDecorator *decorator)
 
 	if (priv->n_remaining_items == 0) {
 		decorator_query_remaining_items (decorator);
-	} else {
-		TrackerSparqlConnection *sparql_conn;
-		gchar *query;
+		return;
+	}
 
-		sparql_conn = tracker_miner_get_connection (TRACKER_MINER (decorator));
-		query = create_remaining_items_query (decorator);
-		tracker_sparql_connection_query_async (sparql_conn, query,
-						       priv->cancellable,
-						       decorator_cache_items_cb,
-						       decorator);
-		g_free (query);
+	query = create_next_items_query (decorator);
+
+	if (!query) {
+		/* All classes were paged through */
+		priv->querying = FALSE;
+
+		if (priv->processing) {
+			decorator_finish (decorator);
+		} else {
+			priv->n_remaining_items = 0;
+			decorator_notify_empty (decorator);
+		}
+
+		return;
 	}
+
+	sparql_conn = tracker_miner_get_connection (TRACKER_MINER (decorator));
+	tracker_sparql_connection_query_async (sparql_conn, query,
+	                                       priv->cancellable,
+	                                       decorator_cache_items_cb,
+	                                       decorator);
+	g_free (query);
 }
 
 static void
@@ -959,6 +1136,7 @@ update_notifier (TrackerDecorator *decorator)
 			g_warning ("Could not create notifier: %s\n",
 				   error->message);
 			g_error_free (error);
+			return;
 		}
 
 		g_signal_connect_swapped (priv->notifier, "events",
@@ -1001,6 +1179,8 @@ decorator_add_class (TrackerDecorator *decorator,
 
 	info.class_name = g_strdup (class);
 	info.priority = G_PRIORITY_DEFAULT;
+	info.last_id = 0;
+	info.exhausted = FALSE;
 	g_array_append_val (priv->classes, info);
 }
 
@@ -1086,8 +1266,11 @@ notifier_events_cb (TrackerDecorator *decorator,
 		}
 	}
 
-	if (check_added)
+	if (check_added) {
+		/* New items might show up past the cursors */
+		decorator_reset_cursors (decorator, FALSE);
 		decorator_cache_next_items (decorator);
+	}
 }
 
 static gboolean
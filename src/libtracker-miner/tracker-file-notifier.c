@@ -1202,15 +1202,23 @@ monitor_item_updated_cb (TrackerMonitor *monitor,
 
 	tracker_file_notifier_ensure_parents (notifier, file);
 
+	if (is_directory) {
+		/* The monitor couldn't tell what changed inside (eg. the
+		 * inotify queue overflowed), check the contents again.
+		 * This ends up in ::child-updated or ::directory-updated.
+		 */
+		tracker_indexing_tree_notify_update (priv->indexing_tree,
+		                                     file, FALSE);
+		return;
+	}
+
 	/* Fetch the interned copy */
 	canonical = tracker_file_system_get_file (priv->file_system,
 	                                          file, file_type, NULL);
 	g_signal_emit (notifier, signals[FILE_UPDATED], 0, canonical, FALSE);
 
-	if (!is_directory) {
-		tracker_file_system_forget_files (priv->file_system, canonical,
-		                                  G_FILE_TYPE_REGULAR);
-	}
+	tracker_file_system_forget_files (priv->file_system, canonical,
+	                                  G_FILE_TYPE_REGULAR);
 }
 
 static void
@@ -44,7 +44,7 @@ struct _FileNodeProperty {
 struct _FileNodeData {
 	GFile *file;
 	gchar *uri_prefix;
-	GArray *properties;
+	GArray *properties;   /* Created on first property set */
 	guint shallow   : 1;
 	guint unowned : 1;
 	guint file_type : 4;
@@ -81,6 +81,12 @@ G_DEFINE_TYPE (TrackerFileSystem, tracker_file_system, G_TYPE_OBJECT)
  * tracker_file_system_forget_files() is called to delete them if there are
  * references held on them elsewhere, and they will stay until all references
  * are dropped.
+ *
+ * Nodes only store the URI portion relative to their parent, and the
+ * property array is only allocated for nodes that get properties set.
+ * Nodes can't be allocated from an arena or have their GFile created
+ * lazily, the canonical GFile and its weak ref are what drive the node
+ * lifetime, so it must exist for as long as the node does.
  */
 
 
@@ -105,7 +111,7 @@ file_node_data_free (FileNodeData *data,
 	data->file = NULL;
 	g_free (data->uri_prefix);
 
-	for (i = 0; i < data->properties->len; i++) {
+	for (i = 0; data->properties && i < data->properties->len; i++) {
 		FileNodeProperty *property;
 		GDestroyNotify destroy_notify;
 
@@ -120,7 +126,10 @@ file_node_data_free (FileNodeData *data,
 		}
 	}
 
-	g_array_free (data->properties, TRUE);
+	if (data->properties) {
+		g_array_free (data->properties, TRUE);
+	}
+
 	g_slice_free (FileNodeData, data);
 }
 
@@ -137,7 +146,6 @@ file_node_data_new (TrackerFileSystem *file_system,
 	data->file = g_object_ref (file);
 	data->file_type = file_type;
 	data->uri_prefix = uri_prefix;
-	data->properties = g_array_new (FALSE, TRUE, sizeof (FileNodeProperty));
 
 	lookup_data = g_object_get_qdata (G_OBJECT (data->file),
 	                                  quark_file_node);
@@ -167,7 +175,6 @@ file_node_data_root_new (GFile *root)
 	data = g_slice_new0 (FileNodeData);
 	data->uri_prefix = g_file_get_uri (root);
 	data->file = g_object_ref (root);
-	data->properties = g_array_new (FALSE, TRUE, sizeof (FileNodeProperty));
 	data->file_type = G_FILE_TYPE_DIRECTORY;
 	data->shallow = TRUE;
 
@@ -809,9 +816,10 @@ tracker_file_system_set_property (TrackerFileSystem *file_system,
 	data = node->data;
 
 	property.prop_quark = prop;
-	match = bsearch (&property, data->properties->data,
-	                 data->properties->len, sizeof (FileNodeProperty),
-	                 search_property_node);
+	match = (!data->properties) ? NULL :
+		bsearch (&property, data->properties->data,
+		         data->properties->len, sizeof (FileNodeProperty),
+		         search_property_node);
 
 	if (match) {
 		if (destroy_notify) {
@@ -823,6 +831,10 @@ tracker_file_system_set_property (TrackerFileSystem *file_system,
 		FileNodeProperty *item;
 		guint i;
 
+		if (!data->properties) {
+			data->properties = g_array_new (FALSE, TRUE, sizeof (FileNodeProperty));
+		}
+
 		/* No match, insert new element */
 		for (i = 0; i < data->properties->len; i++) {
 			item = &g_array_index (data->properties,
@@ -863,9 +875,10 @@ tracker_file_system_get_property_full (TrackerFileSystem *file_system,
 	data = node->data;
 	property.prop_quark = prop;
 
-	match = bsearch (&property, data->properties->data,
-	                 data->properties->len, sizeof (FileNodeProperty),
-	                 search_property_node);
+	match = (!data->properties) ? NULL :
+		bsearch (&property, data->properties->data,
+		         data->properties->len, sizeof (FileNodeProperty),
+		         search_property_node);
 
 	if (prop_data)
 		*prop_data = (match) ? match->value : NULL;
@@ -919,9 +932,10 @@ tracker_file_system_unset_property (TrackerFileSystem *file_system,
 	data = node->data;
 	property.prop_quark = prop;
 
-	match = bsearch (&property, data->properties->data,
-	                 data->properties->len, sizeof (FileNodeProperty),
-	                 search_property_node);
+	match = (!data->properties) ? NULL :
+		bsearch (&property, data->properties->data,
+		         data->properties->len, sizeof (FileNodeProperty),
+		         search_property_node);
 
 	if (!match) {
 		return;
@@ -960,9 +974,10 @@ tracker_file_system_steal_property (TrackerFileSystem *file_system,
 	data = node->data;
 	property.prop_quark = prop;
 
-	match = bsearch (&property, data->properties->data,
-	                 data->properties->len, sizeof (FileNodeProperty),
-	                 search_property_node);
+	match = (!data->properties) ? NULL :
+		bsearch (&property, data->properties->data,
+		         data->properties->len, sizeof (FileNodeProperty),
+		         search_property_node);
 
 	if (!match) {
 		return NULL;
@@ -19,6 +19,8 @@
  * Author: Carlos Garnacho  <carlos@lanedo.com>
  */
 
+#include <string.h>
+
 #include <libtracker-common/tracker-file-utils.h>
 #include "tracker-indexing-tree.h"
 
@@ -35,6 +37,8 @@ G_DEFINE_TYPE (TrackerIndexingTree, tracker_indexing_tree, G_TYPE_OBJECT)
 typedef struct _TrackerIndexingTreePrivate TrackerIndexingTreePrivate;
 typedef struct _NodeData NodeData;
 typedef struct _PatternData PatternData;
+typedef struct _FilterMatcher FilterMatcher;
+typedef struct _GlobToken GlobToken;
 typedef struct _FindNodeData FindNodeData;
 
 struct _NodeData
@@ -48,10 +52,48 @@ struct _NodeData
 struct _PatternData
 {
 	GPatternSpec *pattern;
+	gchar *glob;
 	TrackerFilterType type;
 	GFile *file; /* Only filled in in absolute paths */
 };
 
+typedef enum {
+	GLOB_TOKEN_LITERAL,
+	GLOB_TOKEN_ANY,
+	GLOB_TOKEN_STAR,
+	GLOB_TOKEN_ACCEPT
+} GlobTokenType;
+
+/* One UTF-8 character of a glob, or a wildcard */
+struct _GlobToken
+{
+	guint8 type;
+	guint8 len;
+	gchar bytes[6];
+};
+
+/* All globs of a filter type, compiled together. The common "name",
+ * "*.ext" and "prefix*" forms are hash lookups, everything else is
+ * merged into a single automaton that is walked once per basename.
+ */
+struct _FilterMatcher
+{
+	GHashTable *exact;
+	GHashTable *suffixes;
+	GHashTable *prefixes;
+	GArray *suffix_lengths;
+	GArray *prefix_lengths;
+
+	GArray *tokens;
+	GArray *starts;
+
+	GPtrArray *files;
+	GPtrArray *patterns; /* Globs that can't be compiled */
+	GPtrArray *all_patterns;
+
+	guint match_all : 1;
+};
+
 struct _FindNodeData
 {
 	GEqualFunc func;
@@ -63,6 +105,7 @@ struct _TrackerIndexingTreePrivate
 {
 	GNode *config_tree;
 	GList *filter_patterns;
+	FilterMatcher *matchers[TRACKER_FILTER_PARENT_DIRECTORY + 1];
 	TrackerFilterPolicy policies[TRACKER_FILTER_PARENT_DIRECTORY + 1];
 
 	GFile *root;
@@ -121,6 +164,7 @@ pattern_data_new (const gchar *glob_string,
 
 	data = g_slice_new0 (PatternData);
 	data->pattern = g_pattern_spec_new (glob_string);
+	data->glob = g_strdup (glob_string);
 	data->type = type;
 
 	if (g_path_is_absolute (glob_string)) {
@@ -138,9 +182,400 @@ pattern_data_free (PatternData *data)
 	}
 
 	g_pattern_spec_free (data->pattern);
+	g_free (data->glob);
 	g_slice_free (PatternData, data);
 }
 
+static void
+filter_matcher_add_length (GArray *lengths,
+                           gsize   len)
+{
+	guint i;
+
+	for (i = 0; i < lengths->len; i++) {
+		if (g_array_index (lengths, gsize, i) == len)
+			return;
+	}
+
+	g_array_append_val (lengths, len);
+}
+
+static gint
+compare_lengths (gconstpointer a,
+                 gconstpointer b)
+{
+	gsize len_a = *((gsize *) a), len_b = *((gsize *) b);
+
+	return (len_a > len_b) - (len_a < len_b);
+}
+
+static void
+filter_matcher_add_automaton (FilterMatcher *matcher,
+                              const gchar   *glob)
+{
+	const gchar *p, *end;
+	GlobToken token;
+	guint start;
+
+	start = matcher->tokens->len;
+	g_array_append_val (matcher->starts, start);
+
+	p = glob;
+	end = glob + strlen (glob);
+
+	while (p < end) {
+		memset (&token, 0, sizeof (GlobToken));
+
+		if (*p == '*') {
+			p++;
+
+			/* Consecutive stars are the same as one */
+			if (matcher->tokens->len > start &&
+			    g_array_index (matcher->tokens, GlobToken,
+			                   matcher->tokens->len - 1).type == GLOB_TOKEN_STAR)
+				continue;
+
+			token.type = GLOB_TOKEN_STAR;
+		} else if (*p == '?') {
+			p++;
+			token.type = GLOB_TOKEN_ANY;
+		} else {
+			token.type = GLOB_TOKEN_LITERAL;
+			token.len = MIN (g_utf8_skip[*(guchar *) p], end - p);
+			memcpy (token.bytes, p, token.len);
+			p += token.len;
+		}
+
+		g_array_append_val (matcher->tokens, token);
+	}
+
+	memset (&token, 0, sizeof (GlobToken));
+	token.type = GLOB_TOKEN_ACCEPT;
+	g_array_append_val (matcher->tokens, token);
+}
+
+static void
+filter_matcher_add_glob (FilterMatcher *matcher,
+                         PatternData   *data,
+                         const gchar   *glob)
+{
+	const gchar *p, *first_star = NULL, *last_star = NULL;
+	gboolean has_joker = FALSE, split_stars = FALSE;
+
+	if (!g_utf8_validate (glob, -1, NULL)) {
+		g_ptr_array_add (matcher->patterns, data);
+		return;
+	}
+
+	for (p = glob; *p; p++) {
+		if (*p == '?') {
+			has_joker = TRUE;
+		} else if (*p == '*') {
+			if (last_star && last_star != p - 1)
+				split_stars = TRUE;
+			if (!first_star)
+				first_star = p;
+			last_star = p;
+		}
+	}
+
+	if (has_joker || split_stars) {
+		filter_matcher_add_automaton (matcher, glob);
+	} else if (!first_star) {
+		g_hash_table_add (matcher->exact, g_strdup (glob));
+	} else if (first_star == glob && last_star == p - 1) {
+		matcher->match_all = TRUE;
+	} else if (first_star == glob) {
+		const gchar *suffix = last_star + 1;
+
+		g_hash_table_add (matcher->suffixes, g_strdup (suffix));
+		filter_matcher_add_length (matcher->suffix_lengths, p - suffix);
+	} else if (last_star == p - 1) {
+		gsize prefix_len = first_star - glob;
+
+		g_hash_table_add (matcher->prefixes, g_strndup (glob, prefix_len));
+		filter_matcher_add_length (matcher->prefix_lengths, prefix_len);
+	} else {
+		filter_matcher_add_automaton (matcher, glob);
+	}
+}
+
+static FilterMatcher *
+filter_matcher_new (GList             *filter_patterns,
+                    TrackerFilterType  type)
+{
+	FilterMatcher *matcher;
+	GList *l;
+
+	matcher = g_slice_new0 (FilterMatcher);
+	matcher->exact = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	matcher->suffixes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	matcher->prefixes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	matcher->suffix_lengths = g_array_new (FALSE, FALSE, sizeof (gsize));
+	matcher->prefix_lengths = g_array_new (FALSE, FALSE, sizeof (gsize));
+	matcher->tokens = g_array_new (FALSE, FALSE, sizeof (GlobToken));
+	matcher->starts = g_array_new (FALSE, FALSE, sizeof (guint));
+	matcher->files = g_ptr_array_new ();
+	matcher->patterns = g_ptr_array_new ();
+	matcher->all_patterns = g_ptr_array_new ();
+
+	for (l = filter_patterns; l; l = l->next) {
+		PatternData *data = l->data;
+
+		if (data->type != type)
+			continue;
+
+		g_ptr_array_add (matcher->all_patterns, data);
+
+		if (data->file)
+			g_ptr_array_add (matcher->files, data->file);
+
+		filter_matcher_add_glob (matcher, data, data->glob);
+	}
+
+	g_array_sort (matcher->suffix_lengths, compare_lengths);
+	g_array_sort (matcher->prefix_lengths, compare_lengths);
+
+	return matcher;
+}
+
+static void
+filter_matcher_free (FilterMatcher *matcher)
+{
+	g_hash_table_unref (matcher->exact);
+	g_hash_table_unref (matcher->suffixes);
+	g_hash_table_unref (matcher->prefixes);
+	g_array_unref (matcher->suffix_lengths);
+	g_array_unref (matcher->prefix_lengths);
+	g_array_unref (matcher->tokens);
+	g_array_unref (matcher->starts);
+	g_ptr_array_unref (matcher->files);
+	g_ptr_array_unref (matcher->patterns);
+	g_ptr_array_unref (matcher->all_patterns);
+	g_slice_free (FilterMatcher, matcher);
+}
+
+#define STATE_BITS (GLIB_SIZEOF_LONG * 8)
+#define MAX_STACK_STATE_WORDS 64
+
+/* Adds a state and its epsilon closure, returns %TRUE if the
+ * rest of the input is known to match.
+ */
+static inline gboolean
+automaton_add_state (const GlobToken *tokens,
+                     gulong          *set,
+                     guint            state)
+{
+	set[state / STATE_BITS] |= 1UL << (state % STATE_BITS);
+
+	if (tokens[state].type != GLOB_TOKEN_STAR)
+		return FALSE;
+
+	/* A trailing star accepts everything */
+	if (tokens[state + 1].type == GLOB_TOKEN_ACCEPT)
+		return TRUE;
+
+	set[(state + 1) / STATE_BITS] |= 1UL << ((state + 1) % STATE_BITS);
+	return FALSE;
+}
+
+static gboolean
+filter_matcher_run_automaton (FilterMatcher *matcher,
+                              const gchar   *str,
+                              gsize          len)
+{
+	const GlobToken *tokens;
+	const gchar *p, *end;
+	gulong *current, *next, *tmp, *heap = NULL;
+	gboolean match = FALSE;
+	guint n_words, i, w;
+
+	tokens = (const GlobToken *) matcher->tokens->data;
+	n_words = (matcher->tokens->len + STATE_BITS - 1) / STATE_BITS;
+
+	/* Keep the state sets on the stack, so matching is reentrant */
+	if (n_words <= MAX_STACK_STATE_WORDS)
+		current = g_newa (gulong, 2 * n_words);
+	else
+		current = heap = g_new (gulong, 2 * n_words);
+
+	next = current + n_words;
+	memset (current, 0, n_words * sizeof (gulong));
+
+	for (i = 0; i < matcher->starts->len; i++) {
+		if (automaton_add_state (tokens, current,
+		                         g_array_index (matcher->starts, guint, i))) {
+			match = TRUE;
+			goto out;
+		}
+	}
+
+	p = str;
+	end = str + len;
+
+	while (p < end) {
+		gsize n = MIN (g_utf8_skip[*(guchar *) p], end - p);
+		gboolean alive = FALSE;
+
+		memset (next, 0, n_words * sizeof (gulong));
+
+		for (w = 0; w < n_words; w++) {
+			gulong bits = current[w];
+
+			while (bits) {
+				const GlobToken *token;
+				guint state, target;
+
+				state = w * STATE_BITS + g_bit_nth_lsf (bits, -1);
+				bits &= bits - 1;
+				token = &tokens[state];
+
+				switch (token->type) {
+				case GLOB_TOKEN_LITERAL:
+					if (token->len != n || memcmp (token->bytes, p, n) != 0)
+						continue;
+					target = state + 1;
+					break;
+				case GLOB_TOKEN_ANY:
+					target = state + 1;
+					break;
+				case GLOB_TOKEN_STAR:
+					target = state;
+					break;
+				default:
+					continue;
+				}
+
+				if (automaton_add_state (tokens, next, target)) {
+					match = TRUE;
+					goto out;
+				}
+
+				alive = TRUE;
+			}
+		}
+
+		if (!alive)
+			goto out;
+
+		tmp = current;
+		current = next;
+		next = tmp;
+		p += n;
+	}
+
+	for (w = 0; w < n_words && !match; w++) {
+		gulong bits = current[w];
+
+		while (bits) {
+			guint state = w * STATE_BITS + g_bit_nth_lsf (bits, -1);
+
+			bits &= bits - 1;
+
+			if (tokens[state].type == GLOB_TOKEN_ACCEPT) {
+				match = TRUE;
+				break;
+			}
+		}
+	}
+
+out:
+	g_free (heap);
+
+	return match;
+}
+
+static gboolean
+filter_matcher_match (FilterMatcher *matcher,
+                      GFile         *file,
+                      gchar         *basename)
+{
+	gsize len;
+	guint i;
+
+	for (i = 0; i < matcher->files->len; i++) {
+		GFile *filter_file = g_ptr_array_index (matcher->files, i);
+
+		if (g_file_equal (file, filter_file) ||
+		    g_file_has_prefix (file, filter_file))
+			return TRUE;
+	}
+
+	if (matcher->match_all)
+		return TRUE;
+
+	/* The compiled forms only agree with GPatternSpec on UTF-8 */
+	if (!g_utf8_validate (basename, -1, NULL)) {
+		for (i = 0; i < matcher->all_patterns->len; i++) {
+			PatternData *data = g_ptr_array_index (matcher->all_patterns, i);
+
+			if (g_pattern_match_string (data->pattern, basename))
+				return TRUE;
+		}
+
+		return FALSE;
+	}
+
+	for (i = 0; i < matcher->patterns->len; i++) {
+		PatternData *data = g_ptr_array_index (matcher->patterns, i);
+
+		if (g_pattern_match_string (data->pattern, basename))
+			return TRUE;
+	}
+
+	if (g_hash_table_contains (matcher->exact, basename))
+		return TRUE;
+
+	len = strlen (basename);
+
+	for (i = 0; i < matcher->suffix_lengths->len; i++) {
+		gsize suffix_len = g_array_index (matcher->suffix_lengths, gsize, i);
+
+		if (suffix_len > len)
+			break;
+
+		if (g_hash_table_contains (matcher->suffixes,
+		                           &basename[len - suffix_len]))
+			return TRUE;
+	}
+
+	for (i = 0; i < matcher->prefix_lengths->len; i++) {
+		gsize prefix_len = g_array_index (matcher->prefix_lengths, gsize, i);
+		gboolean found;
+		gchar c;
+
+		if (prefix_len > len)
+			break;
+
+		/* Look up the prefix in place */
+		c = basename[prefix_len];
+		basename[prefix_len] = '\0';
+		found = g_hash_table_contains (matcher->prefixes, basename);
+		basename[prefix_len] = c;
+
+		if (found)
+			return TRUE;
+	}
+
+	if (matcher->starts->len > 0 &&
+	    filter_matcher_run_automaton (matcher, basename, len))
+		return TRUE;
+
+	return FALSE;
+}
+
+static void
+indexing_tree_invalidate_matcher (TrackerIndexingTree *tree,
+                                  TrackerFilterType    type)
+{
+	TrackerIndexingTreePrivate *priv = tree->priv;
+
+	if (priv->matchers[type]) {
+		filter_matcher_free (priv->matchers[type]);
+		priv->matchers[type] = NULL;
+	}
+}
+
 static void
 tracker_indexing_tree_get_property (GObject    *object,
                                     guint       prop_id,
@@ -218,10 +653,15 @@ tracker_indexing_tree_finalize (GObject *object)
 {
 	TrackerIndexingTreePrivate *priv;
 	TrackerIndexingTree *tree;
+	gint i;
 
 	tree = TRACKER_INDEXING_TREE (object);
 	priv = tree->priv;
 
+	for (i = TRACKER_FILTER_FILE; i <= TRACKER_FILTER_PARENT_DIRECTORY; i++) {
+		indexing_tree_invalidate_matcher (tree, i);
+	}
+
 	g_list_foreach (priv->filter_patterns, (GFunc) pattern_data_free, NULL);
 	g_list_free (priv->filter_patterns);
 
@@ -702,6 +1142,7 @@ tracker_indexing_tree_add_filter (TrackerIndexingTree *tree,
 
 	data = pattern_data_new (glob_string, filter);
 	priv->filter_patterns = g_list_prepend (priv->filter_patterns, data);
+	indexing_tree_invalidate_matcher (tree, filter);
 }
 
 /**
@@ -734,6 +1175,8 @@ tracker_indexing_tree_clear_filters (TrackerIndexingTree *tree,
 			pattern_data_free (data);
 		}
 	}
+
+	indexing_tree_invalidate_matcher (tree, type);
 }
 
 /**
@@ -752,39 +1195,23 @@ tracker_indexing_tree_file_matches_filter (TrackerIndexingTree *tree,
                                            GFile               *file)
 {
 	TrackerIndexingTreePrivate *priv;
-	GList *filters;
 	gchar *basename;
+	gboolean match;
 
 	g_return_val_if_fail (TRACKER_IS_INDEXING_TREE (tree), FALSE);
 	g_return_val_if_fail (G_IS_FILE (file), FALSE);
 
 	priv = tree->priv;
-	filters = priv->filter_patterns;
-	basename = g_file_get_basename (file);
-
-	while (filters) {
-		PatternData *data = filters->data;
-
-		filters = filters->next;
-
-		if (data->type != type)
-			continue;
 
-		if (data->file &&
-		    (g_file_equal (file, data->file) ||
-		     g_file_has_prefix (file, data->file))) {
-			g_free (basename);
-			return TRUE;
-		}
-
-		if (g_pattern_match_string (data->pattern, basename)) {
-			g_free (basename);
-			return TRUE;
-		}
-	}
+	/* Filters are compiled on first use after any change */
+	if (!priv->matchers[type])
+		priv->matchers[type] = filter_matcher_new (priv->filter_patterns, type);
 
+	basename = g_file_get_basename (file);
+	match = filter_matcher_match (priv->matchers[type], file, basename);
 	g_free (basename);
-	return FALSE;
+
+	return match;
 }
 
 static gboolean
@@ -26,6 +26,7 @@
 #include "tracker-monitor.h"
 #include "tracker-utils.h"
 #include "tracker-priority-queue.h"
+#include "tracker-queued-files.h"
 #include "tracker-task-pool.h"
 #include "tracker-sparql-buffer.h"
 #include "tracker-file-notifier.h"
@@ -146,6 +147,11 @@ typedef struct {
 	GFile *dest_file;
 } QueueEvent;
 
+typedef struct {
+	TrackerMinerFS *fs;
+	GFile *prefix;
+} QueueRemoveData;
+
 typedef struct {
 	GFile *file;
 	gchar *urn;
@@ -156,6 +162,7 @@ typedef struct {
 
 struct _TrackerMinerFSPrivate {
 	TrackerPriorityQueue *items;
+	TrackerQueuedFiles *queued_files;
 
 	guint item_queues_handler_id;
 	GFile *item_queue_blocker;
@@ -592,6 +599,7 @@ tracker_miner_fs_init (TrackerMinerFS *object)
 	priv->extraction_timer_stopped = TRUE;
 
 	priv->items = tracker_priority_queue_new ();
+	priv->queued_files = tracker_queued_files_new ();
 
 #ifdef EVENT_QUEUE_ENABLE_TRACE
 	priv->queue_status_timeout_id = g_timeout_add_seconds (EVENT_QUEUE_STATUS_TIMEOUT_SECS,
@@ -828,13 +836,6 @@ queue_event_coalesce (const QueueEvent  *first,
 	return QUEUE_ACTION_NONE;
 }
 
-static gboolean
-queue_event_is_descendant (QueueEvent *event,
-			   GFile      *prefix)
-{
-	return g_file_has_prefix (event->file, prefix);
-}
-
 static gboolean
 queue_event_is_equal_or_descendant (QueueEvent *event,
 				    GFile      *prefix)
@@ -843,6 +844,34 @@ queue_event_is_equal_or_descendant (QueueEvent *event,
 		g_file_has_prefix (event->file, prefix));
 }
 
+static gboolean
+queue_event_remove_equal_or_descendant (QueueEvent      *event,
+                                        QueueRemoveData *data)
+{
+	if (!queue_event_is_equal_or_descendant (event, data->prefix))
+		return FALSE;
+
+	/* The event is going away from the queue */
+	tracker_queued_files_remove (data->fs->priv->queued_files, event->file);
+	return TRUE;
+}
+
+static void
+miner_fs_queue_remove_equal_or_descendant (TrackerMinerFS *fs,
+                                           GFile          *file)
+{
+	QueueRemoveData data = { fs, file };
+
+	/* Skip the linear walk if nothing at or below @file is queued */
+	if (!tracker_queued_files_contains (fs->priv->queued_files, file, TRUE))
+		return;
+
+	tracker_priority_queue_foreach_remove (fs->priv->items,
+	                                       (GEqualFunc) queue_event_remove_equal_or_descendant,
+	                                       &data,
+	                                       (GDestroyNotify) queue_event_free);
+}
+
 static void
 fs_finalize (GObject *object)
 {
@@ -880,6 +909,7 @@ fs_finalize (GObject *object)
 					(GFunc) queue_event_free,
 					NULL);
 	tracker_priority_queue_unref (priv->items);
+	tracker_queued_files_free (priv->queued_files);
 
 	g_object_unref (priv->root);
 
@@ -1116,8 +1146,7 @@ notify_roots_finished (TrackerMinerFS *fs,
 		 * container/folder has been added to Tracker (so not
 		 * too frequently)
 		 */
-		if (check_queues &&
-		    tracker_priority_queue_find (fs->priv->items, NULL, (GEqualFunc) queue_event_is_descendant, root)) {
+		if (check_queues && tracker_queued_files_contains (fs->priv->queued_files, root, FALSE)) {
 			continue;
 		}
 
@@ -1668,6 +1697,7 @@ item_queue_get_next_file (TrackerMinerFS           *fs,
 		*priority_out = priority;
 		*attributes_update = event->attributes_update;
 
+		tracker_queued_files_remove (fs->priv->queued_files, event->file);
 		queue_event_free (event);
 		tracker_priority_queue_pop (fs->priv->items, NULL);
 	}
@@ -1675,6 +1705,32 @@ item_queue_get_next_file (TrackerMinerFS           *fs,
 	return TRUE;
 }
 
+static void
+update_queue_metrics (TrackerMinerFS *fs,
+                      guint           items_remaining,
+                      guint           items_total)
+{
+	static TrackerMetric *remaining = NULL, *total = NULL, *pending_tasks = NULL;
+
+	if (g_once_init_enter (&remaining)) {
+		total = tracker_metrics_gauge ("tracker_miner_fs_items_found",
+		                               NULL,
+		                               "Files and directories found since the miner started");
+		pending_tasks = tracker_metrics_gauge ("tracker_miner_fs_sparql_buffer_tasks",
+		                                       NULL,
+		                                       "Updates queued in the SPARQL buffer");
+		g_once_init_leave (&remaining,
+		                   tracker_metrics_gauge ("tracker_miner_fs_items_remaining",
+		                                          NULL,
+		                                          "Items queued for processing"));
+	}
+
+	tracker_metric_set (remaining, items_remaining);
+	tracker_metric_set (total, items_total);
+	tracker_metric_set (pending_tasks,
+	                    tracker_task_pool_get_size (TRACKER_TASK_POOL (fs->priv->sparql_buffer)));
+}
+
 static gdouble
 item_queue_get_progress (TrackerMinerFS *fs,
                          guint          *n_items_processed,
@@ -1688,6 +1744,8 @@ item_queue_get_progress (TrackerMinerFS *fs,
 	items_total += fs->priv->total_directories_found;
 	items_total += fs->priv->total_files_found;
 
+	update_queue_metrics (fs, items_to_process, items_total);
+
 	if (n_items_processed) {
 		*n_items_processed = ((items_total >= items_to_process) ?
 		                      (items_total - items_to_process) : 0);
@@ -1910,10 +1968,7 @@ miner_handle_next_item (TrackerMinerFS *fs)
 			g_warning ("Parent '%s' not indexed yet", uri);
 			g_free (uri);
 
-			tracker_priority_queue_foreach_remove (fs->priv->items,
-							       (GEqualFunc) queue_event_is_equal_or_descendant,
-							       parent,
-							       (GDestroyNotify) queue_event_free);
+			miner_fs_queue_remove_equal_or_descendant (fs, parent);
 			keep_processing = TRUE;
 		}
 
@@ -2086,10 +2141,7 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 
 	if (event->type == TRACKER_MINER_FS_EVENT_MOVED) {
 		/* Remove all children of the dest location from being processed. */
-		tracker_priority_queue_foreach_remove (fs->priv->items,
-						       (GEqualFunc) queue_event_is_equal_or_descendant,
-						       event->dest_file,
-						       (GDestroyNotify) queue_event_free);
+		miner_fs_queue_remove_equal_or_descendant (fs, event->dest_file);
 	}
 
 	old = queue_event_get_last_event_node (event);
@@ -2101,6 +2153,8 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 		action = queue_event_coalesce (old->data, event, &replacement);
 
 		if (action & QUEUE_ACTION_DELETE_FIRST) {
+			tracker_queued_files_remove (fs->priv->queued_files,
+			                             ((QueueEvent *) old->data)->file);
 			queue_event_free (old->data);
 			tracker_priority_queue_remove_node (fs->priv->items,
 							    old);
@@ -2118,10 +2172,7 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 	if (event) {
 		if (event->type == TRACKER_MINER_FS_EVENT_DELETED) {
 			/* Remove all children of this file from being processed. */
-			tracker_priority_queue_foreach_remove (fs->priv->items,
-							       (GEqualFunc) queue_event_is_equal_or_descendant,
-							       event->file,
-							       (GDestroyNotify) queue_event_free);
+			miner_fs_queue_remove_equal_or_descendant (fs, event->file);
 		}
 
 		/* Ensure IRI is cached */
@@ -2130,6 +2181,7 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 
 		link = tracker_priority_queue_add (fs->priv->items, event, priority);
 		queue_event_save_node (event, link);
+		tracker_queued_files_add (fs->priv->queued_files, event->file);
 		item_queue_handlers_set_up (fs);
 	}
 }
@@ -2382,10 +2434,7 @@ indexing_tree_directory_removed (TrackerIndexingTree *indexing_tree,
 	/* Remove anything contained in the removed directory
 	 * from all relevant processing queues.
 	 */
-	tracker_priority_queue_foreach_remove (priv->items,
-					       (GEqualFunc) queue_event_is_equal_or_descendant,
-					       directory,
-					       (GDestroyNotify) queue_event_free);
+	miner_fs_queue_remove_equal_or_descendant (fs, directory);
 
 	g_debug ("  Removed files at %f\n", g_timer_elapsed (timer, NULL));
 	g_timer_destroy (timer);
@@ -42,6 +42,7 @@
 #include <libtracker-common/tracker-dbus.h>
 #include <libtracker-common/tracker-type-utils.h>
 #include <libtracker-common/tracker-domain-ontology.h>
+#include <libtracker-common/tracker-metrics.h>
 
 #include "tracker-miner-proxy.h"
 
@@ -51,6 +52,7 @@ typedef struct {
 	GDBusNodeInfo *introspection_data;
 	gchar *dbus_path;
 	guint registration_id;
+	guint metrics_registration_id;
 	guint watch_name_id;
 	GHashTable *pauses;
 	gint availability_cookie;
@@ -231,6 +233,11 @@ tracker_miner_proxy_finalize (GObject *object)
 		                                     priv->registration_id);
 	}
 
+	if (priv->metrics_registration_id != 0) {
+		g_dbus_connection_unregister_object (priv->d_connection,
+		                                     priv->metrics_registration_id);
+	}
+
 	if (priv->introspection_data) {
 		g_dbus_node_info_unref (priv->introspection_data);
 	}
@@ -817,6 +824,16 @@ tracker_miner_proxy_initable_init (GInitable     *initable,
 		return FALSE;
 	}
 
+	/* org.freedesktop.Tracker1.Metrics, on the same object */
+	priv->metrics_registration_id =
+		tracker_metrics_dbus_register (priv->d_connection,
+		                               priv->dbus_path,
+		                               &inner_error);
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return FALSE;
+	}
+
 	domain_ontology = tracker_domain_ontology_new (tracker_sparql_connection_get_domain (),
 	                                               cancellable, &inner_error);
 	if (inner_error) {
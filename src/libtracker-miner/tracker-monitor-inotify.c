@@ -0,0 +1,1179 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "tracker-monitor-inotify.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <glib-unix.h>
+
+#include <libtracker-common/tracker-common.h>
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | \
+                    IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | \
+                    IN_ONLYDIR | IN_EXCL_UNLINK)
+
+/* A single read returns as many queued events as fit */
+#define READ_BUFFER_SIZE 65536
+
+/* Time the reader thread lets events pile up between reads */
+#define BATCH_INTERVAL_MSEC 10
+
+/* Time an IN_MOVED_FROM waits for its IN_MOVED_TO */
+#define MOVE_PAIRING_MSEC 50
+
+/* IN_MODIFY events on files kept open are coalesced for this long */
+#define CHANGES_COALESCE_MSEC 1000
+
+/* Directories evicted from the watch budget are rescanned in rounds */
+#define RESCAN_INTERVAL_MSEC (15 * 1000)
+#define RESCAN_BATCH_SIZE 500
+
+typedef enum {
+	WATCH_STATE_ACTIVE,
+	WATCH_STATE_POLLED,
+	WATCH_STATE_CANCELLED
+} WatchState;
+
+struct _TrackerInotifyWatch {
+	TrackerMonitorInotify *inotify;
+	GFile *file;
+	gint wd;
+	WatchState state;
+	GList link;
+
+	/* Contents seen on the last rescan of a polled directory,
+	 * name -> ChildInfo. NULL until the first rescan.
+	 */
+	GHashTable *children;
+};
+
+struct _TrackerMonitorInotify {
+	gint fd;
+	gint wakeup_fds[2];
+	GThread *thread;
+	GAsyncQueue *batches;
+
+	GMainContext *context;
+	GSource *batch_source;
+	GSource *moves_source;
+	GSource *changes_source;
+	GSource *rescan_source;
+	GCancellable *cancellable;
+
+	GHashTable *watches;         /* wd -> TrackerInotifyWatch */
+	GQueue active;               /* Most recently active first */
+	GQueue polled;               /* Next to rescan first */
+	GHashTable *scanning;        /* Polled watches being rescanned */
+	guint budget;
+	guint rescan_interval;       /* msec */
+	gboolean budget_warned;
+	gboolean overflow_warned;
+	gboolean rescan_running;
+
+	GHashTable *pending_moves;   /* cookie -> PendingMove */
+	GHashTable *pending_changes; /* GFile -> is_directory */
+
+	TrackerMonitorInotifyFunc func;
+	gpointer user_data;
+};
+
+typedef struct {
+	gint wd;
+	guint32 mask;
+	guint32 cookie;
+	gchar *name;
+} RawEvent;
+
+typedef struct {
+	GSource source;
+	TrackerMonitorInotify *inotify;
+} BatchSource;
+
+typedef struct {
+	GFile *file;
+	gboolean is_directory;
+	gint64 time;
+} PendingMove;
+
+typedef struct {
+	gint64 mtime;
+	gboolean is_directory;
+} ChildInfo;
+
+typedef struct {
+	gchar *name;
+	GFileMonitorEvent event_type;
+	gboolean is_directory;
+} ChildEvent;
+
+typedef struct {
+	TrackerInotifyWatch *watch;
+	GFile *file;
+	GHashTable *children;
+	GArray *events;
+} RescanJob;
+
+static void schedule_rescan (TrackerMonitorInotify *inotify,
+                             gboolean               soon);
+
+static void
+emit_event (TrackerMonitorInotify *inotify,
+            GFile                 *file,
+            GFile                 *other_file,
+            GFileMonitorEvent      event_type,
+            gboolean               is_directory)
+{
+	inotify->func (file, other_file, event_type, is_directory,
+	               inotify->user_data);
+}
+
+static void
+update_watch_metrics (TrackerMonitorInotify *inotify)
+{
+	static TrackerMetric *active = NULL, *polled = NULL;
+
+	if (g_once_init_enter (&active)) {
+		polled = tracker_metrics_gauge ("tracker_miner_monitor_watches",
+		                                "state=\"polled\"",
+		                                "Monitored directories, by how changes are noticed");
+		g_once_init_leave (&active,
+		                   tracker_metrics_gauge ("tracker_miner_monitor_watches",
+		                                          "state=\"active\"",
+		                                          "Monitored directories, by how changes are noticed"));
+	}
+
+	tracker_metric_set (active, inotify->active.length);
+	tracker_metric_set (polled, inotify->polled.length);
+}
+
+static GSource *
+add_timeout (TrackerMonitorInotify *inotify,
+             guint                  msec,
+             GSourceFunc            func)
+{
+	GSource *source;
+
+	source = g_timeout_source_new (msec);
+	g_source_set_callback (source, func, inotify, NULL);
+	g_source_attach (source, inotify->context);
+
+	return source;
+}
+
+static void
+clear_source (GSource **source)
+{
+	if (*source) {
+		g_source_destroy (*source);
+		g_source_unref (*source);
+		*source = NULL;
+	}
+}
+
+/* Watch budget */
+
+static void
+watch_unlink (TrackerInotifyWatch *watch)
+{
+	TrackerMonitorInotify *inotify = watch->inotify;
+
+	if (watch->state == WATCH_STATE_ACTIVE)
+		g_queue_unlink (&inotify->active, &watch->link);
+	else if (watch->state == WATCH_STATE_POLLED)
+		g_queue_unlink (&inotify->polled, &watch->link);
+
+	if (watch->wd >= 0) {
+		g_hash_table_remove (inotify->watches, GINT_TO_POINTER (watch->wd));
+		inotify_rm_watch (inotify->fd, watch->wd);
+		watch->wd = -1;
+	}
+
+	g_clear_pointer (&watch->children, g_hash_table_unref);
+	watch->state = WATCH_STATE_CANCELLED;
+}
+
+static void
+watch_make_polled (TrackerInotifyWatch *watch)
+{
+	TrackerMonitorInotify *inotify = watch->inotify;
+
+	watch_unlink (watch);
+	watch->state = WATCH_STATE_POLLED;
+
+	/* Put it first, so the rescan taking its baseline happens soon */
+	g_queue_push_head_link (&inotify->polled, &watch->link);
+	schedule_rescan (inotify, TRUE);
+}
+
+static void
+ensure_budget (TrackerMonitorInotify *inotify)
+{
+	while (inotify->active.length >= inotify->budget &&
+	       inotify->active.tail) {
+		TrackerInotifyWatch *watch = inotify->active.tail->data;
+		gchar *uri;
+
+		if (!inotify->budget_warned) {
+			g_message ("The maximum number of monitors (%d) has been reached, "
+			           "least recently active directories will be polled",
+			           inotify->budget);
+			inotify->budget_warned = TRUE;
+		}
+
+		uri = g_file_get_uri (watch->file);
+		g_debug ("Evicted monitor for path:'%s', polling it instead", uri);
+		g_free (uri);
+
+		watch_make_polled (watch);
+	}
+}
+
+/* Adds the kernel watch, and makes @watch the most recently active */
+static gboolean
+watch_start (TrackerInotifyWatch *watch)
+{
+	TrackerMonitorInotify *inotify = watch->inotify;
+	TrackerInotifyWatch *other;
+	gchar *path;
+	gint wd;
+
+	path = g_file_get_path (watch->file);
+	if (!path)
+		return FALSE;
+
+	ensure_budget (inotify);
+	wd = inotify_add_watch (inotify->fd, path, WATCH_MASK);
+
+	if (wd < 0) {
+		g_debug ("Could not add inotify watch for path:'%s', %s, polling it instead",
+		         path, g_strerror (errno));
+		g_free (path);
+		return FALSE;
+	}
+
+	g_free (path);
+
+	/* The same directory seen through another path, eg. the old
+	 * location of a moved directory. The kernel watch is ours now.
+	 */
+	other = g_hash_table_lookup (inotify->watches, GINT_TO_POINTER (wd));
+	if (other && other != watch) {
+		g_hash_table_remove (inotify->watches, GINT_TO_POINTER (wd));
+		other->wd = -1;
+		watch_make_polled (other);
+	}
+
+	watch->wd = wd;
+	watch->state = WATCH_STATE_ACTIVE;
+	g_hash_table_insert (inotify->watches, GINT_TO_POINTER (wd), watch);
+	g_queue_push_head_link (&inotify->active, &watch->link);
+
+	return TRUE;
+}
+
+static void
+watch_touch (TrackerInotifyWatch *watch)
+{
+	TrackerMonitorInotify *inotify = watch->inotify;
+
+	if (watch->state != WATCH_STATE_ACTIVE ||
+	    inotify->active.head == &watch->link)
+		return;
+
+	g_queue_unlink (&inotify->active, &watch->link);
+	g_queue_push_head_link (&inotify->active, &watch->link);
+}
+
+static void
+watch_promote (TrackerInotifyWatch *watch)
+{
+	TrackerMonitorInotify *inotify = watch->inotify;
+
+	g_queue_unlink (&inotify->polled, &watch->link);
+
+	if (watch_start (watch)) {
+		g_clear_pointer (&watch->children, g_hash_table_unref);
+	} else {
+		g_queue_push_tail_link (&inotify->polled, &watch->link);
+	}
+}
+
+/* Pending moves and changes */
+
+static void
+pending_move_free (PendingMove *move)
+{
+	g_object_unref (move->file);
+	g_slice_free (PendingMove, move);
+}
+
+static gboolean
+flush_moves_cb (gpointer user_data)
+{
+	TrackerMonitorInotify *inotify = user_data;
+	GHashTableIter iter;
+	GList *expired = NULL, *l;
+	gpointer value;
+	gint64 now;
+
+	now = g_get_monotonic_time ();
+
+	g_hash_table_iter_init (&iter, inotify->pending_moves);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		PendingMove *move = value;
+
+		if (now - move->time < MOVE_PAIRING_MSEC * 1000)
+			continue;
+
+		g_hash_table_iter_steal (&iter);
+		expired = g_list_prepend (expired, move);
+	}
+
+	/* Moved somewhere we don't see */
+	for (l = expired; l; l = l->next) {
+		PendingMove *move = l->data;
+
+		emit_event (inotify, move->file, NULL,
+		            G_FILE_MONITOR_EVENT_MOVED_OUT, move->is_directory);
+	}
+
+	g_list_free_full (expired, (GDestroyNotify) pending_move_free);
+
+	if (g_hash_table_size (inotify->pending_moves) > 0)
+		return G_SOURCE_CONTINUE;
+
+	g_source_unref (inotify->moves_source);
+	inotify->moves_source = NULL;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pending_move_add (TrackerMonitorInotify *inotify,
+                  guint32                cookie,
+                  GFile                 *file,
+                  gboolean               is_directory)
+{
+	PendingMove *move;
+
+	move = g_slice_new (PendingMove);
+	move->file = g_object_ref (file);
+	move->is_directory = is_directory;
+	move->time = g_get_monotonic_time ();
+	g_hash_table_insert (inotify->pending_moves, GUINT_TO_POINTER (cookie), move);
+
+	if (!inotify->moves_source)
+		inotify->moves_source = add_timeout (inotify, MOVE_PAIRING_MSEC, flush_moves_cb);
+}
+
+static PendingMove *
+pending_move_take (TrackerMonitorInotify *inotify,
+                   guint32                cookie)
+{
+	PendingMove *move;
+
+	move = g_hash_table_lookup (inotify->pending_moves, GUINT_TO_POINTER (cookie));
+	if (move)
+		g_hash_table_steal (inotify->pending_moves, GUINT_TO_POINTER (cookie));
+
+	return move;
+}
+
+static gboolean
+flush_changes_cb (gpointer user_data)
+{
+	TrackerMonitorInotify *inotify = user_data;
+	GHashTable *changes;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_source_unref (inotify->changes_source);
+	inotify->changes_source = NULL;
+
+	/* Handlers may queue more changes */
+	changes = inotify->pending_changes;
+	inotify->pending_changes = g_hash_table_new_full (g_file_hash,
+	                                                  (GEqualFunc) g_file_equal,
+	                                                  g_object_unref,
+	                                                  NULL);
+
+	g_hash_table_iter_init (&iter, changes);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		emit_event (inotify, key, NULL,
+		            G_FILE_MONITOR_EVENT_CHANGED, GPOINTER_TO_INT (value));
+	}
+
+	g_hash_table_unref (changes);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pending_change_add (TrackerMonitorInotify *inotify,
+                    GFile                 *file,
+                    gboolean               is_directory)
+{
+	g_hash_table_insert (inotify->pending_changes,
+	                     g_object_ref (file),
+	                     GINT_TO_POINTER (is_directory));
+
+	if (!inotify->changes_source)
+		inotify->changes_source = add_timeout (inotify, CHANGES_COALESCE_MSEC, flush_changes_cb);
+}
+
+static void
+pending_change_flush (TrackerMonitorInotify *inotify,
+                      GFile                 *file)
+{
+	gpointer is_directory;
+
+	if (!g_hash_table_lookup_extended (inotify->pending_changes, file,
+	                                   NULL, &is_directory))
+		return;
+
+	g_hash_table_remove (inotify->pending_changes, file);
+	emit_event (inotify, file, NULL,
+	            G_FILE_MONITOR_EVENT_CHANGED, GPOINTER_TO_INT (is_directory));
+}
+
+/* Event processing */
+
+/* The kernel dropped events, anything in the directories with a
+ * kernel watch may have changed unnoticed. Report the topmost of
+ * those as updated, so their contents are checked again. Polled
+ * directories are diffed on rescan, so nothing is lost there.
+ */
+static void
+handle_overflow (TrackerMonitorInotify *inotify)
+{
+	GHashTable *watched;
+	GPtrArray *topmost;
+	GList *l;
+	guint i;
+
+	if (!inotify->overflow_warned) {
+		g_warning ("The inotify event queue overflowed, checking all "
+		           "monitored directories for missed changes");
+		inotify->overflow_warned = TRUE;
+	}
+
+	watched = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+
+	for (l = inotify->active.head; l; l = l->next) {
+		TrackerInotifyWatch *watch = l->data;
+
+		g_hash_table_add (watched, watch->file);
+	}
+
+	/* Collected first, handlers may change the watches */
+	topmost = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (l = inotify->active.head; l; l = l->next) {
+		TrackerInotifyWatch *watch = l->data;
+		GFile *parent;
+
+		parent = g_file_get_parent (watch->file);
+
+		if (!parent || !g_hash_table_contains (watched, parent))
+			g_ptr_array_add (topmost, g_object_ref (watch->file));
+
+		g_clear_object (&parent);
+	}
+
+	g_hash_table_unref (watched);
+
+	for (i = 0; i < topmost->len; i++) {
+		emit_event (inotify, g_ptr_array_index (topmost, i), NULL,
+		            G_FILE_MONITOR_EVENT_CHANGED, TRUE);
+	}
+
+	g_ptr_array_unref (topmost);
+}
+
+static void
+process_event (TrackerMonitorInotify *inotify,
+               RawEvent              *event)
+{
+	TrackerInotifyWatch *watch;
+	PendingMove *move;
+	gboolean is_directory;
+	GFile *file;
+
+	if (event->mask & IN_Q_OVERFLOW) {
+		handle_overflow (inotify);
+		return;
+	}
+
+	watch = g_hash_table_lookup (inotify->watches, GINT_TO_POINTER (event->wd));
+
+	/* Removed while the event was queued */
+	if (!watch)
+		return;
+
+	if (event->mask & IN_IGNORED) {
+		/* Deleted or unmounted, the kernel already dropped the watch */
+		g_hash_table_remove (inotify->watches, GINT_TO_POINTER (event->wd));
+		watch->wd = -1;
+		watch_unlink (watch);
+		update_watch_metrics (inotify);
+		return;
+	}
+
+	watch_touch (watch);
+
+	/* Events on the directory itself are reported by its parent */
+	if (!event->name)
+		return;
+
+	/* IN_ISDIR spares us a stat() */
+	is_directory = (event->mask & IN_ISDIR) != 0;
+	file = g_file_get_child (watch->file, event->name);
+
+	if (event->mask & IN_MOVED_FROM) {
+		pending_change_flush (inotify, file);
+		pending_move_add (inotify, event->cookie, file, is_directory);
+	} else if (event->mask & IN_MOVED_TO) {
+		move = pending_move_take (inotify, event->cookie);
+
+		if (move) {
+			emit_event (inotify, move->file, file,
+			            G_FILE_MONITOR_EVENT_RENAMED, is_directory);
+			pending_move_free (move);
+		} else {
+			emit_event (inotify, file, NULL,
+			            G_FILE_MONITOR_EVENT_MOVED_IN, is_directory);
+		}
+	} else if (event->mask & IN_CREATE) {
+		emit_event (inotify, file, NULL,
+		            G_FILE_MONITOR_EVENT_CREATED, is_directory);
+	} else if (event->mask & IN_DELETE) {
+		g_hash_table_remove (inotify->pending_changes, file);
+		emit_event (inotify, file, NULL,
+		            G_FILE_MONITOR_EVENT_DELETED, is_directory);
+	} else if (event->mask & IN_MODIFY) {
+		pending_change_add (inotify, file, is_directory);
+	} else if (event->mask & IN_CLOSE_WRITE) {
+		pending_change_flush (inotify, file);
+	} else if (event->mask & IN_ATTRIB) {
+		emit_event (inotify, file, NULL,
+		            G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED, is_directory);
+	}
+
+	g_object_unref (file);
+}
+
+static gboolean
+batch_source_prepare (GSource *source,
+                      gint    *timeout)
+{
+	BatchSource *batch_source = (BatchSource *) source;
+
+	*timeout = -1;
+
+	return g_async_queue_length (batch_source->inotify->batches) > 0;
+}
+
+static gboolean
+batch_source_check (GSource *source)
+{
+	BatchSource *batch_source = (BatchSource *) source;
+
+	return g_async_queue_length (batch_source->inotify->batches) > 0;
+}
+
+static gboolean
+batch_source_dispatch (GSource     *source,
+                       GSourceFunc  callback,
+                       gpointer     user_data)
+{
+	TrackerMonitorInotify *inotify = ((BatchSource *) source)->inotify;
+	GArray *batch;
+	guint i;
+
+	while ((batch = g_async_queue_try_pop (inotify->batches)) != NULL) {
+		for (i = 0; i < batch->len; i++)
+			process_event (inotify, &g_array_index (batch, RawEvent, i));
+
+		g_array_unref (batch);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs batch_source_funcs = {
+	batch_source_prepare,
+	batch_source_check,
+	batch_source_dispatch,
+	NULL
+};
+
+/* Reader thread */
+
+static void
+raw_event_clear (RawEvent *event)
+{
+	g_free (event->name);
+}
+
+static GArray *
+parse_events (const gchar *buffer,
+              gssize       len)
+{
+	GArray *batch;
+	gssize offset = 0;
+
+	batch = g_array_new (FALSE, FALSE, sizeof (RawEvent));
+	g_array_set_clear_func (batch, (GDestroyNotify) raw_event_clear);
+
+	while (offset < len) {
+		const struct inotify_event *event;
+		RawEvent raw;
+
+		event = (const struct inotify_event *) &buffer[offset];
+		raw.wd = event->wd;
+		raw.mask = event->mask;
+		raw.cookie = event->cookie;
+		raw.name = (event->len > 0 && event->name[0] != '\0') ?
+			g_strdup (event->name) : NULL;
+		g_array_append_val (batch, raw);
+
+		offset += sizeof (struct inotify_event) + event->len;
+	}
+
+	return batch;
+}
+
+static gpointer
+reader_thread_func (gpointer user_data)
+{
+	TrackerMonitorInotify *inotify = user_data;
+	gchar buffer[READ_BUFFER_SIZE] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+	struct pollfd fds[2];
+
+	fds[0].fd = inotify->fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = inotify->wakeup_fds[0];
+	fds[1].events = POLLIN;
+
+	while (TRUE) {
+		gssize len;
+
+		if (poll (fds, G_N_ELEMENTS (fds), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			g_warning ("Could not poll inotify: %s", g_strerror (errno));
+			break;
+		}
+
+		/* Shutting down */
+		if (fds[1].revents != 0)
+			break;
+
+		len = read (inotify->fd, buffer, sizeof (buffer));
+
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+
+			g_warning ("Could not read inotify events: %s", g_strerror (errno));
+			break;
+		}
+
+		g_async_queue_push (inotify->batches, parse_events (buffer, len));
+		g_main_context_wakeup (inotify->context);
+
+		/* Let the next events pile up, so they are handled
+		 * in a single main loop iteration.
+		 */
+		g_usleep (BATCH_INTERVAL_MSEC * 1000);
+	}
+
+	return NULL;
+}
+
+/* Rescans of polled directories */
+
+static void
+rescan_job_free (RescanJob *job)
+{
+	guint i;
+
+	for (i = 0; i < job->events->len; i++)
+		g_free (g_array_index (job->events, ChildEvent, i).name);
+
+	g_array_unref (job->events);
+	g_clear_pointer (&job->children, g_hash_table_unref);
+	g_object_unref (job->file);
+	g_slice_free (RescanJob, job);
+}
+
+static void
+rescan_job_add_event (RescanJob         *job,
+                      const gchar       *name,
+                      GFileMonitorEvent  event_type,
+                      gboolean           is_directory)
+{
+	ChildEvent event;
+
+	event.name = g_strdup (name);
+	event.event_type = event_type;
+	event.is_directory = is_directory;
+	g_array_append_val (job->events, event);
+}
+
+static void
+rescan_job_run (RescanJob    *job,
+                GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GHashTable *children;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	enumerator = g_file_enumerate_children (job->file,
+	                                        G_FILE_ATTRIBUTE_STANDARD_NAME ","
+	                                        G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+	                                        G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+	                                        G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+	                                        G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+	                                        cancellable, NULL);
+	if (!enumerator) {
+		/* Gone or not readable, its parent reports on it */
+		g_clear_pointer (&job->children, g_hash_table_unref);
+		return;
+	}
+
+	children = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	while ((info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL) {
+		const gchar *name;
+		ChildInfo *child, *old = NULL;
+
+		name = g_file_info_get_name (info);
+		child = g_new (ChildInfo, 1);
+		child->is_directory = g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY;
+		child->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+			g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+		if (job->children)
+			old = g_hash_table_lookup (job->children, name);
+
+		/* Directories have their own watch, only
+		 * their presence matters here.
+		 */
+		if (!job->children) {
+			/* First rescan, take the baseline */
+		} else if (!old) {
+			rescan_job_add_event (job, name, G_FILE_MONITOR_EVENT_CREATED, child->is_directory);
+		} else if (old->is_directory != child->is_directory) {
+			rescan_job_add_event (job, name, G_FILE_MONITOR_EVENT_DELETED, old->is_directory);
+			rescan_job_add_event (job, name, G_FILE_MONITOR_EVENT_CREATED, child->is_directory);
+		} else if (!child->is_directory && old->mtime != child->mtime) {
+			rescan_job_add_event (job, name, G_FILE_MONITOR_EVENT_CHANGED, FALSE);
+		}
+
+		if (old)
+			g_hash_table_remove (job->children, name);
+
+		g_hash_table_insert (children, g_strdup (name), child);
+		g_object_unref (info);
+	}
+
+	g_object_unref (enumerator);
+
+	if (job->children) {
+		g_hash_table_iter_init (&iter, job->children);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			ChildInfo *old = value;
+
+			rescan_job_add_event (job, key, G_FILE_MONITOR_EVENT_DELETED, old->is_directory);
+		}
+
+		g_hash_table_unref (job->children);
+	}
+
+	job->children = children;
+}
+
+static void
+rescan_thread_func (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+	GPtrArray *jobs = task_data;
+	guint i;
+
+	for (i = 0; i < jobs->len; i++) {
+		if (g_task_return_error_if_cancelled (task))
+			return;
+
+		rescan_job_run (g_ptr_array_index (jobs, i), cancellable);
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+rescan_done_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+	TrackerMonitorInotify *inotify = user_data;
+	GPtrArray *jobs;
+	TrackerInotifyWatch *next;
+	guint i, j;
+
+	/* Only cancelled on finalization, @inotify is gone by now */
+	if (!g_task_propagate_boolean (G_TASK (result), NULL))
+		return;
+
+	inotify->rescan_running = FALSE;
+	jobs = g_task_get_task_data (G_TASK (result));
+
+	for (i = 0; i < jobs->len; i++) {
+		RescanJob *job = g_ptr_array_index (jobs, i);
+		TrackerInotifyWatch *watch = job->watch;
+
+		/* Removed while being scanned */
+		if (!g_hash_table_remove (inotify->scanning, watch) ||
+		    watch->state != WATCH_STATE_POLLED)
+			continue;
+
+		watch->children = g_steal_pointer (&job->children);
+
+		if (job->events->len == 0)
+			continue;
+
+		/* It's busy again, give it back a kernel watch */
+		watch_promote (watch);
+
+		for (j = 0; j < job->events->len; j++) {
+			ChildEvent *event = &g_array_index (job->events, ChildEvent, j);
+			GFile *child;
+
+			child = g_file_get_child (job->file, event->name);
+			emit_event (inotify, child, NULL,
+			            event->event_type, event->is_directory);
+			g_object_unref (child);
+		}
+	}
+
+	update_watch_metrics (inotify);
+
+	/* Newly evicted directories go first, take their baseline soon */
+	next = inotify->polled.head ? inotify->polled.head->data : NULL;
+	schedule_rescan (inotify, next && !next->children);
+}
+
+static gboolean
+rescan_cb (gpointer user_data)
+{
+	TrackerMonitorInotify *inotify = user_data;
+	GPtrArray *jobs;
+	GTask *task;
+	guint i, n_jobs;
+
+	g_source_unref (inotify->rescan_source);
+	inotify->rescan_source = NULL;
+
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) rescan_job_free);
+	n_jobs = MIN (RESCAN_BATCH_SIZE, inotify->polled.length);
+
+	for (i = 0; i < n_jobs; i++) {
+		GList *link = g_queue_pop_head_link (&inotify->polled);
+		TrackerInotifyWatch *watch = link->data;
+		RescanJob *job;
+
+		g_queue_push_tail_link (&inotify->polled, link);
+
+		job = g_slice_new0 (RescanJob);
+		job->watch = watch;
+		job->file = g_object_ref (watch->file);
+		job->children = g_steal_pointer (&watch->children);
+		job->events = g_array_new (FALSE, FALSE, sizeof (ChildEvent));
+		g_ptr_array_add (jobs, job);
+
+		g_hash_table_add (inotify->scanning, watch);
+	}
+
+	if (jobs->len == 0) {
+		g_ptr_array_unref (jobs);
+		return G_SOURCE_REMOVE;
+	}
+
+	inotify->rescan_running = TRUE;
+
+	task = g_task_new (NULL, inotify->cancellable, rescan_done_cb, inotify);
+	g_task_set_task_data (task, jobs, (GDestroyNotify) g_ptr_array_unref);
+	g_task_run_in_thread (task, rescan_thread_func);
+	g_object_unref (task);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_rescan (TrackerMonitorInotify *inotify,
+                 gboolean               soon)
+{
+	/* Rescheduled once the running one finishes */
+	if (inotify->rescan_running)
+		return;
+
+	if (inotify->rescan_source) {
+		if (!soon)
+			return;
+
+		clear_source (&inotify->rescan_source);
+	}
+
+	if (g_queue_is_empty (&inotify->polled))
+		return;
+
+	inotify->rescan_source = add_timeout (inotify,
+	                                      soon ? 0 : inotify->rescan_interval,
+	                                      rescan_cb);
+}
+
+/* Public API */
+
+TrackerMonitorInotify *
+tracker_monitor_inotify_new (guint                       watch_budget,
+                             TrackerMonitorInotifyFunc   func,
+                             gpointer                    user_data,
+                             GError                    **error)
+{
+	TrackerMonitorInotify *inotify;
+	gint fd, wakeup_fds[2];
+
+	fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+
+	if (fd < 0) {
+		gint errsv = errno;
+
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+		             "Could not initialize inotify: %s",
+		             g_strerror (errsv));
+		return NULL;
+	}
+
+	if (!g_unix_open_pipe (wakeup_fds, FD_CLOEXEC, error)) {
+		close (fd);
+		return NULL;
+	}
+
+	inotify = g_new0 (TrackerMonitorInotify, 1);
+	inotify->fd = fd;
+	inotify->wakeup_fds[0] = wakeup_fds[0];
+	inotify->wakeup_fds[1] = wakeup_fds[1];
+	inotify->budget = MAX (watch_budget, 1);
+	inotify->rescan_interval = RESCAN_INTERVAL_MSEC;
+	inotify->func = func;
+	inotify->user_data = user_data;
+	inotify->cancellable = g_cancellable_new ();
+	inotify->context = g_main_context_ref_thread_default ();
+	inotify->batches = g_async_queue_new_full ((GDestroyNotify) g_array_unref);
+
+	inotify->watches = g_hash_table_new (NULL, NULL);
+	inotify->scanning = g_hash_table_new (NULL, NULL);
+	inotify->pending_moves =
+		g_hash_table_new_full (NULL, NULL, NULL,
+		                       (GDestroyNotify) pending_move_free);
+	inotify->pending_changes =
+		g_hash_table_new_full (g_file_hash,
+		                       (GEqualFunc) g_file_equal,
+		                       g_object_unref,
+		                       NULL);
+
+	inotify->batch_source = g_source_new (&batch_source_funcs, sizeof (BatchSource));
+	((BatchSource *) inotify->batch_source)->inotify = inotify;
+	g_source_attach (inotify->batch_source, inotify->context);
+
+	inotify->thread = g_thread_new ("tracker-inotify", reader_thread_func, inotify);
+
+	return inotify;
+}
+
+/* All watches must be freed before this */
+void
+tracker_monitor_inotify_free (TrackerMonitorInotify *inotify)
+{
+	gchar c = 0;
+
+	g_cancellable_cancel (inotify->cancellable);
+
+	if (write (inotify->wakeup_fds[1], &c, 1) != 1)
+		g_warning ("Could not stop the inotify thread: %s", g_strerror (errno));
+
+	g_thread_join (inotify->thread);
+
+	clear_source (&inotify->batch_source);
+	clear_source (&inotify->moves_source);
+	clear_source (&inotify->changes_source);
+	clear_source (&inotify->rescan_source);
+
+	g_async_queue_unref (inotify->batches);
+	g_main_context_unref (inotify->context);
+	g_object_unref (inotify->cancellable);
+
+	g_hash_table_unref (inotify->watches);
+	g_hash_table_unref (inotify->scanning);
+	g_hash_table_unref (inotify->pending_moves);
+	g_hash_table_unref (inotify->pending_changes);
+
+	close (inotify->wakeup_fds[0]);
+	close (inotify->wakeup_fds[1]);
+	close (inotify->fd);
+
+	g_free (inotify);
+}
+
+TrackerInotifyWatch *
+tracker_monitor_inotify_add (TrackerMonitorInotify *inotify,
+                             GFile                 *file)
+{
+	TrackerInotifyWatch *watch;
+
+	g_return_val_if_fail (inotify != NULL, NULL);
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+	watch = g_slice_new0 (TrackerInotifyWatch);
+	watch->inotify = inotify;
+	watch->file = g_object_ref (file);
+	watch->wd = -1;
+	watch->state = WATCH_STATE_CANCELLED;
+	watch->link.data = watch;
+
+	/* Locations that don't exist yet, or that we can't
+	 * get a kernel watch for, are polled.
+	 */
+	if (!watch_start (watch))
+		watch_make_polled (watch);
+
+	update_watch_metrics (inotify);
+
+	return watch;
+}
+
+guint
+tracker_monitor_inotify_get_n_polled (TrackerMonitorInotify *inotify)
+{
+	g_return_val_if_fail (inotify != NULL, 0);
+
+	return inotify->polled.length;
+}
+
+void
+tracker_monitor_inotify_set_rescan_interval (TrackerMonitorInotify *inotify,
+                                             guint                  msec)
+{
+	g_return_if_fail (inotify != NULL);
+
+	inotify->rescan_interval = msec;
+
+	/* Reschedule the pending rescan with the new interval */
+	if (inotify->rescan_source) {
+		clear_source (&inotify->rescan_source);
+		schedule_rescan (inotify, FALSE);
+	}
+}
+
+void
+tracker_inotify_watch_cancel (TrackerInotifyWatch *watch)
+{
+	if (!watch || watch->state == WATCH_STATE_CANCELLED)
+		return;
+
+	watch_unlink (watch);
+	update_watch_metrics (watch->inotify);
+}
+
+void
+tracker_inotify_watch_free (TrackerInotifyWatch *watch)
+{
+	if (!watch)
+		return;
+
+	tracker_inotify_watch_cancel (watch);
+	g_hash_table_remove (watch->inotify->scanning, watch);
+	g_object_unref (watch->file);
+	g_slice_free (TrackerInotifyWatch, watch);
+}
+
+#else /* __linux__ */
+
+TrackerMonitorInotify *
+tracker_monitor_inotify_new (guint                       watch_budget,
+                             TrackerMonitorInotifyFunc   func,
+                             gpointer                    user_data,
+                             GError                    **error)
+{
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+	                     "Inotify is not available on this platform");
+	return NULL;
+}
+
+void
+tracker_monitor_inotify_free (TrackerMonitorInotify *inotify)
+{
+	g_return_if_reached ();
+}
+
+TrackerInotifyWatch *
+tracker_monitor_inotify_add (TrackerMonitorInotify *inotify,
+                             GFile                 *file)
+{
+	g_return_val_if_reached (NULL);
+}
+
+guint
+tracker_monitor_inotify_get_n_polled (TrackerMonitorInotify *inotify)
+{
+	g_return_val_if_reached (0);
+}
+
+void
+tracker_monitor_inotify_set_rescan_interval (TrackerMonitorInotify *inotify,
+                                             guint                  msec)
+{
+	g_return_if_reached ();
+}
+
+void
+tracker_inotify_watch_cancel (TrackerInotifyWatch *watch)
+{
+	g_return_if_reached ();
+}
+
+void
+tracker_inotify_watch_free (TrackerInotifyWatch *watch)
+{
+	g_return_if_reached ();
+}
+
+#endif /* __linux__ */
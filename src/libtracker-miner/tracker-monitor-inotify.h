@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_MINER_MONITOR_INOTIFY_H__
+#define __LIBTRACKER_MINER_MONITOR_INOTIFY_H__
+
+#if !defined (__LIBTRACKER_MINER_H_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "Only <libtracker-miner/tracker-miner.h> can be included directly."
+#endif
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _TrackerMonitorInotify TrackerMonitorInotify;
+typedef struct _TrackerInotifyWatch TrackerInotifyWatch;
+
+/* Paired moves are reported as G_FILE_MONITOR_EVENT_RENAMED, unpaired
+ * ones as _MOVED_OUT/_MOVED_IN with a NULL @other_file.
+ */
+typedef void (* TrackerMonitorInotifyFunc) (GFile             *file,
+                                            GFile             *other_file,
+                                            GFileMonitorEvent  event_type,
+                                            gboolean           is_directory,
+                                            gpointer           user_data);
+
+TrackerMonitorInotify * tracker_monitor_inotify_new       (guint                       watch_budget,
+                                                           TrackerMonitorInotifyFunc   func,
+                                                           gpointer                    user_data,
+                                                           GError                    **error);
+void                    tracker_monitor_inotify_free      (TrackerMonitorInotify      *inotify);
+
+TrackerInotifyWatch *   tracker_monitor_inotify_add       (TrackerMonitorInotify      *inotify,
+                                                           GFile                      *file);
+guint                   tracker_monitor_inotify_get_n_polled (TrackerMonitorInotify   *inotify);
+void                    tracker_monitor_inotify_set_rescan_interval (TrackerMonitorInotify *inotify,
+                                                                     guint                  msec);
+
+void                    tracker_inotify_watch_cancel      (TrackerInotifyWatch        *watch);
+void                    tracker_inotify_watch_free        (TrackerInotifyWatch        *watch);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_MINER_MONITOR_INOTIFY_H__ */
@@ -31,6 +31,7 @@
 #endif
 
 #include "tracker-monitor.h"
+#include "tracker-monitor-inotify.h"
 
 #define TRACKER_MONITOR_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), TRACKER_TYPE_MONITOR, TrackerMonitorPrivate))
 
@@ -40,6 +41,9 @@
 struct TrackerMonitorPrivate {
 	GHashTable    *monitors;
 
+	/* Used instead of GFileMonitor where available */
+	TrackerMonitorInotify *inotify;
+
 	gboolean       enabled;
 
 	guint          monitor_limit;
@@ -95,6 +99,11 @@ static guint          get_inotify_limit            (void);
 static GFileMonitor * directory_monitor_new        (TrackerMonitor *monitor,
                                                     GFile          *file);
 static void           directory_monitor_cancel     (GFileMonitor     *dir_monitor);
+static void           monitor_inotify_event_cb     (GFile             *file,
+                                                    GFile             *other_file,
+                                                    GFileMonitorEvent  event_type,
+                                                    gboolean           is_directory,
+                                                    gpointer           user_data);
 
 
 static void           emit_signal_for_event        (TrackerMonitor    *monitor,
@@ -204,13 +213,6 @@ tracker_monitor_init (TrackerMonitor *object)
 	/* By default we enable monitoring */
 	priv->enabled = TRUE;
 
-	/* Create monitors table for this module */
-	priv->monitors =
-		g_hash_table_new_full (g_file_hash,
-		                       (GEqualFunc) g_file_equal,
-		                       (GDestroyNotify) g_object_unref,
-		                       (GDestroyNotify) directory_monitor_cancel);
-
 	priv->cached_events =
 		g_hash_table_new_full (g_file_hash,
 		                       (GEqualFunc) g_file_equal,
@@ -267,6 +269,20 @@ tracker_monitor_init (TrackerMonitor *object)
 			 * negative maximum.
 			 */
 			priv->monitor_limit = MAX (priv->monitor_limit, 0);
+
+			/* Read inotify events ourselves, so the file
+			 * type comes with them, and directories over
+			 * the limit are polled instead of dropped.
+			 */
+			priv->inotify = tracker_monitor_inotify_new (priv->monitor_limit,
+			                                             monitor_inotify_event_cb,
+			                                             object,
+			                                             &error);
+			if (!priv->inotify) {
+				g_debug ("Could not use inotify directly, using GIO: %s",
+				         error->message);
+				g_clear_error (&error);
+			}
 		}
 		else if (strcmp (name, "GKqueueDirectoryMonitor") == 0 ||
 		         strcmp (name, "GKqueueFileMonitor") == 0) {
@@ -305,6 +321,15 @@ tracker_monitor_init (TrackerMonitor *object)
 
 	g_object_unref (file);
 
+	/* Create monitors table for this module */
+	priv->monitors =
+		g_hash_table_new_full (g_file_hash,
+		                       (GEqualFunc) g_file_equal,
+		                       (GDestroyNotify) g_object_unref,
+		                       priv->inotify ?
+		                       (GDestroyNotify) tracker_inotify_watch_free :
+		                       (GDestroyNotify) directory_monitor_cancel);
+
 	if (priv->enabled)
 		g_debug ("Monitor limit is %d", priv->monitor_limit);
 }
@@ -319,6 +344,9 @@ tracker_monitor_finalize (GObject *object)
 	g_hash_table_unref (priv->cached_events);
 	g_hash_table_unref (priv->monitors);
 
+	if (priv->inotify)
+		tracker_monitor_inotify_free (priv->inotify);
+
 	G_OBJECT_CLASS (tracker_monitor_parent_class)->finalize (object);
 }
 
@@ -632,30 +660,19 @@ cache_event (TrackerMonitor    *monitor,
 }
 
 static void
-monitor_event_cb (GFileMonitor      *file_monitor,
-                  GFile             *file,
-                  GFile             *other_file,
-                  GFileMonitorEvent  event_type,
-                  gpointer           user_data)
+monitor_event_dispatch (TrackerMonitor    *monitor,
+                        GFile             *file,
+                        GFile             *other_file,
+                        GFileMonitorEvent  event_type,
+                        gboolean           is_directory)
 {
-	TrackerMonitor *monitor;
 	gchar *file_uri;
 	gchar *other_file_uri;
-	gboolean is_directory = FALSE;
-
-	monitor = user_data;
-
-	if (G_UNLIKELY (!monitor->priv->enabled)) {
-		g_debug ("Silently dropping monitor event, monitor disabled for now");
-		return;
-	}
 
 	/* Get URIs as paths may not be in UTF-8 */
 	file_uri = g_file_get_uri (file);
 
 	if (!other_file) {
-		is_directory = check_is_directory (monitor, file);
-
 		/* Avoid non-indexable-files */
 		if (monitor->priv->tree &&
 		    !tracker_indexing_tree_file_is_indexable (monitor->priv->tree,
@@ -674,13 +691,6 @@ monitor_event_cb (GFileMonitor      *file_monitor,
 		         is_directory ? "directory" : "file",
 		         file_uri);
 	} else {
-		if (event_type == G_FILE_MONITOR_EVENT_RENAMED ||
-		    event_type == G_FILE_MONITOR_EVENT_MOVED_OUT) {
-			is_directory = check_is_directory (monitor, other_file);
-		} else if (event_type == G_FILE_MONITOR_EVENT_MOVED_IN) {
-			is_directory = check_is_directory (monitor, file);
-		}
-
 		/* Avoid doing anything of both
 		 * file/other_file are non-indexable
 		 */
@@ -768,6 +778,57 @@ monitor_event_cb (GFileMonitor      *file_monitor,
 	g_free (other_file_uri);
 }
 
+static void
+monitor_event_cb (GFileMonitor      *file_monitor,
+                  GFile             *file,
+                  GFile             *other_file,
+                  GFileMonitorEvent  event_type,
+                  gpointer           user_data)
+{
+	TrackerMonitor *monitor;
+	gboolean is_directory = FALSE;
+
+	monitor = user_data;
+
+	if (G_UNLIKELY (!monitor->priv->enabled)) {
+		g_debug ("Silently dropping monitor event, monitor disabled for now");
+		return;
+	}
+
+	if (!other_file) {
+		is_directory = check_is_directory (monitor, file);
+	} else if (event_type == G_FILE_MONITOR_EVENT_RENAMED ||
+	           event_type == G_FILE_MONITOR_EVENT_MOVED_OUT) {
+		is_directory = check_is_directory (monitor, other_file);
+	} else if (event_type == G_FILE_MONITOR_EVENT_MOVED_IN) {
+		is_directory = check_is_directory (monitor, file);
+	}
+
+	monitor_event_dispatch (monitor, file, other_file,
+	                        event_type, is_directory);
+}
+
+static void
+monitor_inotify_event_cb (GFile             *file,
+                          GFile             *other_file,
+                          GFileMonitorEvent  event_type,
+                          gboolean           is_directory,
+                          gpointer           user_data)
+{
+	TrackerMonitor *monitor;
+
+	monitor = user_data;
+
+	if (G_UNLIKELY (!monitor->priv->enabled)) {
+		g_debug ("Silently dropping monitor event, monitor disabled for now");
+		return;
+	}
+
+	/* The file type comes with the event, no need to stat() it */
+	monitor_event_dispatch (monitor, file, other_file,
+	                        event_type, is_directory);
+}
+
 static GFileMonitor *
 directory_monitor_new (TrackerMonitor *monitor,
                        GFile          *file)
@@ -809,6 +870,29 @@ directory_monitor_cancel (GFileMonitor *monitor)
 	}
 }
 
+/* Watches are either GFileMonitors or TrackerInotifyWatches,
+ * depending on the backend in use.
+ */
+static gpointer
+directory_watch_new (TrackerMonitor *monitor,
+                     GFile          *file)
+{
+	if (monitor->priv->inotify)
+		return tracker_monitor_inotify_add (monitor->priv->inotify, file);
+
+	return directory_monitor_new (monitor, file);
+}
+
+static void
+directory_watch_cancel (TrackerMonitor *monitor,
+                        gpointer        watch)
+{
+	if (monitor->priv->inotify)
+		tracker_inotify_watch_cancel (watch);
+	else if (watch)
+		g_file_monitor_cancel (G_FILE_MONITOR (watch));
+}
+
 TrackerMonitor *
 tracker_monitor_new (void)
 {
@@ -875,9 +959,9 @@ tracker_monitor_set_enabled (TrackerMonitor *monitor,
 		file = k->data;
 
 		if (enabled) {
-			GFileMonitor *dir_monitor;
+			gpointer dir_monitor;
 
-			dir_monitor = directory_monitor_new (monitor, file);
+			dir_monitor = directory_watch_new (monitor, file);
 			g_hash_table_replace (monitor->priv->monitors,
 			                      g_object_ref (file), dir_monitor);
 		} else {
@@ -894,7 +978,7 @@ gboolean
 tracker_monitor_add (TrackerMonitor *monitor,
                      GFile          *file)
 {
-	GFileMonitor *dir_monitor = NULL;
+	gpointer dir_monitor = NULL;
 	gchar *uri;
 
 	g_return_val_if_fail (TRACKER_IS_MONITOR (monitor), FALSE);
@@ -904,8 +988,11 @@ tracker_monitor_add (TrackerMonitor *monitor,
 		return TRUE;
 	}
 
-	/* Cap the number of monitors */
-	if (g_hash_table_size (monitor->priv->monitors) >= monitor->priv->monitor_limit) {
+	/* Cap the number of monitors, the inotify backend polls
+	 * the least recently active directories instead.
+	 */
+	if (!monitor->priv->inotify &&
+	    g_hash_table_size (monitor->priv->monitors) >= monitor->priv->monitor_limit) {
 		monitor->priv->monitors_ignored++;
 
 		if (!monitor->priv->monitor_limit_warned) {
@@ -926,7 +1013,7 @@ tracker_monitor_add (TrackerMonitor *monitor,
 		 *
 		 * Also, we assume ALL paths passed are directories.
 		 */
-		dir_monitor = directory_monitor_new (monitor, file);
+		dir_monitor = directory_watch_new (monitor, file);
 
 		if (!dir_monitor) {
 			g_warning ("Could not add monitor for path:'%s'",
@@ -1062,7 +1149,7 @@ monitor_cancel_recursively (TrackerMonitor *monitor,
 		}
 
 		uri = g_file_get_uri (iter_file);
-		g_file_monitor_cancel (G_FILE_MONITOR (iter_file_monitor));
+		directory_watch_cancel (monitor, iter_file_monitor);
 		g_debug ("Cancelled monitor for path:'%s'", uri);
 		g_free (uri);
 
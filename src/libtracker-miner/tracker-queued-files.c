@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "tracker-queued-files.h"
+
+/* Keeps track of which files have queued events on them or any of their
+ * descendants, so the (linear) removal of children from the miner queue
+ * is only performed when there's anything to remove.
+ */
+
+typedef struct {
+	guint n_queued;      /* Queued events on this very file */
+	guint n_descendants; /* Queued events on files below it */
+} QueuedFileCount;
+
+struct _TrackerQueuedFiles
+{
+	GHashTable *counts; /* GFile -> QueuedFileCount, for every
+	                     * queued file and its parents */
+};
+
+TrackerQueuedFiles *
+tracker_queued_files_new (void)
+{
+	TrackerQueuedFiles *queued_files;
+
+	queued_files = g_slice_new0 (TrackerQueuedFiles);
+	queued_files->counts = g_hash_table_new_full (g_file_hash,
+	                                              (GEqualFunc) g_file_equal,
+	                                              g_object_unref,
+	                                              g_free);
+	return queued_files;
+}
+
+void
+tracker_queued_files_free (TrackerQueuedFiles *queued_files)
+{
+	g_hash_table_unref (queued_files->counts);
+	g_slice_free (TrackerQueuedFiles, queued_files);
+}
+
+static void
+queued_files_update (TrackerQueuedFiles *queued_files,
+                     GFile              *file,
+                     gboolean            added)
+{
+	QueuedFileCount *count;
+	gboolean is_self = TRUE;
+	GFile *cur, *parent;
+
+	cur = g_object_ref (file);
+
+	while (cur) {
+		count = g_hash_table_lookup (queued_files->counts, cur);
+
+		if (!count) {
+			g_assert (added);
+			count = g_new0 (QueuedFileCount, 1);
+			g_hash_table_insert (queued_files->counts,
+			                     g_object_ref (cur), count);
+		}
+
+		if (added && is_self) {
+			count->n_queued++;
+		} else if (added) {
+			count->n_descendants++;
+		} else if (is_self) {
+			g_assert (count->n_queued > 0);
+			count->n_queued--;
+		} else {
+			g_assert (count->n_descendants > 0);
+			count->n_descendants--;
+		}
+
+		if (count->n_queued == 0 && count->n_descendants == 0)
+			g_hash_table_remove (queued_files->counts, cur);
+
+		parent = g_file_get_parent (cur);
+		g_object_unref (cur);
+		cur = parent;
+		is_self = FALSE;
+	}
+}
+
+void
+tracker_queued_files_add (TrackerQueuedFiles *queued_files,
+                          GFile              *file)
+{
+	queued_files_update (queued_files, file, TRUE);
+}
+
+void
+tracker_queued_files_remove (TrackerQueuedFiles *queued_files,
+                             GFile              *file)
+{
+	queued_files_update (queued_files, file, FALSE);
+}
+
+gboolean
+tracker_queued_files_contains (TrackerQueuedFiles *queued_files,
+                               GFile              *file,
+                               gboolean            include_self)
+{
+	QueuedFileCount *count;
+
+	count = g_hash_table_lookup (queued_files->counts, file);
+
+	if (!count)
+		return FALSE;
+
+	return (count->n_descendants > 0 ||
+	        (include_self && count->n_queued > 0));
+}
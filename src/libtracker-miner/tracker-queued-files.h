@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_MINER_QUEUED_FILES_H__
+#define __LIBTRACKER_MINER_QUEUED_FILES_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _TrackerQueuedFiles TrackerQueuedFiles;
+
+TrackerQueuedFiles *tracker_queued_files_new      (void);
+void                tracker_queued_files_free     (TrackerQueuedFiles *queued_files);
+
+void                tracker_queued_files_add      (TrackerQueuedFiles *queued_files,
+                                                   GFile              *file);
+void                tracker_queued_files_remove   (TrackerQueuedFiles *queued_files,
+                                                   GFile              *file);
+
+gboolean            tracker_queued_files_contains (TrackerQueuedFiles *queued_files,
+                                                   GFile              *file,
+                                                   gboolean            include_self);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_MINER_QUEUED_FILES_H__ */
@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <libtracker-sparql/tracker-sparql.h>
 
 #include "tracker-sparql-buffer.h"
@@ -28,6 +30,17 @@
 /* Maximum time (seconds) before forcing a sparql buffer flush */
 #define MAX_SPARQL_BUFFER_TIME  15
 
+/* Minimum time (milliseconds) before the flush timeout kicks in,
+ * the actual timeout is derived from the measured commit latency.
+ */
+#define MIN_SPARQL_BUFFER_TIME_MS  500
+
+/* Amount of buffered SPARQL (bytes) that forces a flush */
+#define MAX_SPARQL_BUFFER_BYTES  (4 * 1024 * 1024)
+
+/* Number of update_array batches allowed in flight at once */
+#define MAX_SPARQL_BUFFER_PIPELINE  2
+
 typedef struct _TrackerSparqlBufferPrivate TrackerSparqlBufferPrivate;
 typedef struct _SparqlTaskData SparqlTaskData;
 typedef struct _UpdateArrayData UpdateArrayData;
@@ -43,7 +56,13 @@ struct _TrackerSparqlBufferPrivate
 	TrackerSparqlConnection *connection;
 	guint flush_timeout_id;
 	GPtrArray *tasks;
+	gsize n_bytes;
 	gint n_updates;
+
+	/* Moving average of the time (in seconds) it takes
+	 * for an update_array batch to be committed.
+	 */
+	gdouble commit_latency;
 };
 
 struct _SparqlTaskData
@@ -61,6 +80,7 @@ struct _UpdateArrayData {
 	TrackerSparqlBuffer *buffer;
 	GPtrArray *tasks;
 	GArray *sparql_array;
+	gint64 start_time;
 };
 
 G_DEFINE_TYPE (TrackerSparqlBuffer, tracker_sparql_buffer, TRACKER_TYPE_TASK_POOL)
@@ -158,6 +178,7 @@ static void
 reset_flush_timeout (TrackerSparqlBuffer *buffer)
 {
 	TrackerSparqlBufferPrivate *priv;
+	guint timeout_ms;
 
 	priv = buffer->priv;
 
@@ -165,9 +186,47 @@ reset_flush_timeout (TrackerSparqlBuffer *buffer)
 		g_source_remove (priv->flush_timeout_id);
 	}
 
-	priv->flush_timeout_id = g_timeout_add_seconds (MAX_SPARQL_BUFFER_TIME,
-	                                                flush_timeout_cb,
-	                                                buffer);
+	/* A store that commits fast gets trickling updates sooner,
+	 * the timeout is otherwise bound by MAX_SPARQL_BUFFER_TIME.
+	 */
+	if (priv->commit_latency > 0) {
+		timeout_ms = CLAMP (priv->commit_latency * 4 * 1000,
+		                    MIN_SPARQL_BUFFER_TIME_MS,
+		                    MAX_SPARQL_BUFFER_TIME * 1000);
+	} else {
+		timeout_ms = MAX_SPARQL_BUFFER_TIME * 1000;
+	}
+
+	priv->flush_timeout_id = g_timeout_add (timeout_ms,
+	                                        flush_timeout_cb,
+	                                        buffer);
+}
+
+static const gchar *
+sparql_buffer_get_flush_reason (TrackerSparqlBuffer *buffer)
+{
+	TrackerSparqlBufferPrivate *priv = buffer->priv;
+	guint limit;
+
+	if (!priv->tasks || priv->tasks->len == 0)
+		return NULL;
+
+	limit = tracker_task_pool_get_limit (TRACKER_TASK_POOL (buffer));
+
+	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (buffer)))
+		return "SPARQL buffer limit reached";
+	if (priv->n_bytes >= MAX_SPARQL_BUFFER_BYTES)
+		return "SPARQL buffer size limit reached";
+	if (priv->n_updates == 0 && priv->tasks->len > limit / 2) {
+		/* We've filled half of the buffer and no batch is being
+		 * committed, flush it now rather than leave the connection
+		 * idle. Otherwise keep filling, the batch is sent once the
+		 * previous one finishes or the limit is reached.
+		 */
+		return "SPARQL buffer half-full";
+	}
+
+	return NULL;
 }
 
 static void
@@ -228,13 +287,23 @@ tracker_sparql_buffer_update_array_cb (GObject      *object,
 	gint i;
 
 	/* Get arrays of errors and queries */
+	const gchar *reason;
+	gdouble elapsed;
+
 	update_data = user_data;
 	buffer = TRACKER_SPARQL_BUFFER (update_data->buffer);
 	priv = buffer->priv;
 	priv->n_updates--;
 
-	g_debug ("(Sparql buffer) Finished array-update with %u tasks",
-	         update_data->tasks->len);
+	elapsed = (gdouble) (g_get_monotonic_time () - update_data->start_time) / G_USEC_PER_SEC;
+
+	if (priv->commit_latency > 0)
+		priv->commit_latency = (0.8 * priv->commit_latency) + (0.2 * elapsed);
+	else
+		priv->commit_latency = elapsed;
+
+	g_debug ("(Sparql buffer) Finished array-update with %u tasks in %.3fs",
+	         update_data->tasks->len, elapsed);
 
 	sparql_array_errors = tracker_sparql_connection_update_array_finish (priv->connection,
 	                                                                     result,
@@ -295,8 +364,14 @@ tracker_sparql_buffer_update_array_cb (GObject      *object,
 		g_error_free (global_error);
 	}
 
-	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (buffer))) {
-		tracker_sparql_buffer_flush (buffer, "SPARQL buffer limit reached (after flush)");
+	reason = sparql_buffer_get_flush_reason (buffer);
+
+	if (reason) {
+		tracker_sparql_buffer_flush (buffer, reason);
+	} else if (priv->tasks && priv->tasks->len > 0 &&
+	           priv->flush_timeout_id == 0) {
+		/* Tasks were left behind while the pipeline was full */
+		reset_flush_timeout (buffer);
 	}
 }
 
@@ -311,7 +386,7 @@ tracker_sparql_buffer_flush (TrackerSparqlBuffer *buffer,
 
 	priv = buffer->priv;
 
-	if (priv->n_updates > 0) {
+	if (priv->n_updates >= MAX_SPARQL_BUFFER_PIPELINE) {
 		return FALSE;
 	}
 
@@ -343,6 +418,7 @@ tracker_sparql_buffer_flush (TrackerSparqlBuffer *buffer,
 	update_data->buffer = buffer;
 	update_data->tasks = g_ptr_array_ref (priv->tasks);
 	update_data->sparql_array = sparql_array;
+	update_data->start_time = g_get_monotonic_time ();
 
 	/* Empty pool, update_data will keep
 	 * references to the tasks to keep
@@ -350,6 +426,7 @@ tracker_sparql_buffer_flush (TrackerSparqlBuffer *buffer,
 	 */
 	g_ptr_array_unref (priv->tasks);
 	priv->tasks = NULL;
+	priv->n_bytes = 0;
 	priv->n_updates++;
 
 	/* Start the update */
@@ -416,9 +493,11 @@ sparql_buffer_push_high_priority (TrackerSparqlBuffer *buffer,
 
 static void
 sparql_buffer_push_to_pool (TrackerSparqlBuffer *buffer,
-                            TrackerTask         *task)
+                            TrackerTask         *task,
+                            SparqlTaskData      *data)
 {
 	TrackerSparqlBufferPrivate *priv;
+	const gchar *reason;
 
 	priv = buffer->priv;
 
@@ -436,12 +515,12 @@ sparql_buffer_push_to_pool (TrackerSparqlBuffer *buffer,
 	/* We add a reference here because we unref when removed from
 	 * the GPtrArray. */
 	g_ptr_array_add (priv->tasks, tracker_task_ref (task));
+	priv->n_bytes += strlen (data->str);
+
+	reason = sparql_buffer_get_flush_reason (buffer);
 
-	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (buffer))) {
-		tracker_sparql_buffer_flush (buffer, "SPARQL buffer limit reached");
-	} else if (priv->tasks->len > tracker_task_pool_get_limit (TRACKER_TASK_POOL (buffer)) / 2) {
-		/* We've filled half of the buffer, flush it as we receive more tasks */
-		tracker_sparql_buffer_flush (buffer, "SPARQL buffer half-full");
+	if (reason) {
+		tracker_sparql_buffer_flush (buffer, reason);
 	}
 }
 
@@ -473,7 +552,7 @@ tracker_sparql_buffer_push (TrackerSparqlBuffer *buffer,
 	if (priority <= G_PRIORITY_HIGH) {
 		sparql_buffer_push_high_priority (buffer, task, data);
 	} else {
-		sparql_buffer_push_to_pool (buffer, task);
+		sparql_buffer_push_to_pool (buffer, task, data);
 	}
 }
 
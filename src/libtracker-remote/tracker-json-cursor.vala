@@ -19,121 +19,570 @@
  * Author: Carlos Garnacho <carlosg@gnome.org>
  */
 
-public class Tracker.Remote.JsonCursor : Tracker.Sparql.Cursor {
-	internal Json.Parser _parser;
-	internal Json.Array _vars;
-	internal Json.Array _results;
-	internal Json.Object _cur_row;
-	internal uint _cur_idx = 0;
-	internal bool _started_iterating = false;
+/* Reads application/sparql-results+json documents as the cursor is
+ * iterated, so only the current row is kept in memory. The "head"
+ * object is expected to precede "results", as all known endpoints do.
+ * ASK replies are presented as a single boolean "result" column, like
+ * local connections do.
+ */
+public class Tracker.Remote.JsonCursor : Tracker.Sparql.Cursor, GLib.Initable, GLib.AsyncInitable {
+	const int BUFFER_SIZE = 65536;
 
-	const string XSD_NS = "http://www.w3.org/2001/XMLSchema#";
+	InputStream _stream;
+	Cancellable? _cancellable;
+	uint8[] _buffer;
+	int _buffer_len = 0;
+	int _buffer_pos = 0;
+	bool _eof = false;
 
-	public JsonCursor (string document, long length) throws GLib.Error {
-		var parser = new Json.Parser ();
-		parser.load_from_data (document, length);
+	/* Set while init_async() or next_async() parse, which must not block
+	 * on the stream. Parsing restarts from _row_start after refilling.
+	 */
+	bool _nonblocking = false;
+	int _row_start = 0;
 
-		var root = parser.get_root ().get_object ();
-		var head = root.get_object_member ("head");
-		var results = root.get_object_member ("results");
+	string[] _vars;
+	/* variable name -> column + 1 */
+	HashTable<string, int> _columns;
+	string?[] _values;
+	Sparql.ValueType[] _types;
+	string? _boolean;
+	bool _first_row = true;
+	bool _finished = false;
 
-		_parser = parser;
-		_vars = head.get_array_member ("vars");
-		_results = results.get_array_member ("bindings");
-		_started_iterating = false;
+	/* The header is read by init() or init_async() */
+	public JsonCursor (InputStream stream) {
+		_stream = stream;
+		_buffer = new uint8[BUFFER_SIZE];
+		_columns = new HashTable<string, int> (str_hash, str_equal);
 	}
 
-	public override int n_columns {
-		get { return (int) _vars.get_length (); }
+	public bool init (Cancellable? cancellable = null) throws GLib.Error {
+		_cancellable = cancellable;
+		parse_header ();
+		return true;
 	}
 
-	public override Sparql.ValueType get_value_type (int column) requires (_cur_row != null) {
-		var col_node = _cur_row.get_member (get_variable_name (column));
+	public async bool init_async (int io_priority = Priority.DEFAULT, Cancellable? cancellable = null) throws GLib.Error {
+		_cancellable = cancellable;
 
-		if (col_node == null)
-			return Sparql.ValueType.UNBOUND;
+		while (true) {
+			_nonblocking = true;
 
-		var object = col_node.get_object ();//_cur_row.get_object_member (get_variable_name (column));
-		unowned string str = object.get_string_member ("type");
+			try {
+				parse_header ();
+				return true;
+			} catch (IOError.WOULD_BLOCK e) {
+				/* Incomplete header, parse it again once there is more data */
+				_buffer_pos = 0;
+				_vars = null;
+				_boolean = null;
+				_finished = false;
+			} finally {
+				_nonblocking = false;
+			}
 
-		switch (str) {
-		case "uri":
-			return Sparql.ValueType.URI;
-		case "bnode":
-			return Sparql.ValueType.BLANK_NODE;
-		case "literal": {
-			var node = object.get_member ("datatype");
-
-			if (node == null)
-				return Sparql.ValueType.STRING;
-
-			str = node.get_string ();
-
-			switch (str) {
-			case XSD_NS + "byte":
-			case XSD_NS + "int":
-			case XSD_NS + "integer":
-			case XSD_NS + "long":
-				return Sparql.ValueType.INTEGER;
-			case XSD_NS + "decimal":
-			case XSD_NS + "double":
-				return Sparql.ValueType.DOUBLE;
-			case XSD_NS + "dateTime":
-				return Sparql.ValueType.DATETIME;
+			yield fill_async (io_priority, cancellable);
+		}
+	}
+
+	private void parse_header () throws GLib.Error {
+		expect ('{');
+
+		if (accept ('}')) {
+			throw new Sparql.Error.INTERNAL ("Malformed JSON results: no head");
+		}
+
+		do {
+			var name = read_string ();
+			expect (':');
+
+			if (name == "head") {
+				parse_head ();
+			} else if (name == "results") {
+				if (_vars == null)
+					throw new Sparql.Error.INTERNAL ("Malformed JSON results: results precede head");
+
+				if (seek_bindings ()) {
+					set_columns ();
+					return;
+				}
+			} else if (name == "boolean") {
+				_boolean = read_literal ();
+
+				if (_boolean != "true" && _boolean != "false")
+					throw parse_error ("invalid boolean");
+			} else {
+				skip_value ();
+			}
+		} while (accept (','));
+
+		expect ('}');
+
+		if (_vars == null)
+			throw new Sparql.Error.INTERNAL ("Malformed JSON results: no head");
+
+		if (_boolean != null)
+			_vars = { "result" };
+		else
+			_finished = true;
+
+		set_columns ();
+	}
+
+	private GLib.Error parse_error (string message) {
+		return new Sparql.Error.INTERNAL ("Malformed JSON results: %s", message);
+	}
+
+	private uint8 peek () throws GLib.Error {
+		if (_buffer_pos == _buffer_len) {
+			if (_nonblocking && !_eof)
+				throw new IOError.WOULD_BLOCK ("Row is not fully buffered");
+
+			if (!_eof) {
+				_buffer_len = (int) _stream.read (_buffer, _cancellable);
+				_buffer_pos = 0;
+				_eof = (_buffer_len == 0);
+			}
+
+			if (_eof)
+				throw parse_error ("unexpected end of document");
+		}
+
+		return _buffer[_buffer_pos];
+	}
+
+	/* Appends more data after the row being parsed by next_async() */
+	private async void fill_async (int io_priority, Cancellable? cancellable) throws GLib.Error {
+		if (_row_start > 0) {
+			Memory.move (_buffer, &_buffer[_row_start], _buffer_len - _row_start);
+			_buffer_len -= _row_start;
+			_buffer_pos -= _row_start;
+			_row_start = 0;
+		}
+
+		/* Rows larger than the buffer */
+		if (_buffer_len == _buffer.length)
+			_buffer.resize (_buffer.length * 2);
+
+		var n = yield _stream.read_async (_buffer[_buffer_len:_buffer.length], io_priority, cancellable);
+
+		_buffer_len += (int) n;
+		_eof = (n == 0);
+	}
+
+	private uint8 get_char () throws GLib.Error {
+		var c = peek ();
+		_buffer_pos++;
+		return c;
+	}
+
+	private uint8 peek_non_space () throws GLib.Error {
+		var c = peek ();
+
+		while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+			_buffer_pos++;
+			c = peek ();
+		}
+
+		return c;
+	}
+
+	private bool accept (char expected) throws GLib.Error {
+		if (peek_non_space () != expected)
+			return false;
+
+		_buffer_pos++;
+		return true;
+	}
+
+	private void expect (char expected) throws GLib.Error {
+		if (!accept (expected))
+			throw parse_error ("expected '%c'".printf (expected));
+	}
+
+	private unichar read_hex4 () throws GLib.Error {
+		unichar value = 0;
+
+		for (int i = 0; i < 4; i++) {
+			var digit = ((char) get_char ()).xdigit_value ();
+
+			if (digit < 0)
+				throw parse_error ("invalid \\u escape");
+
+			value = (value << 4) | (unichar) digit;
+		}
+
+		return value;
+	}
+
+	private string read_string () throws GLib.Error {
+		var str = new StringBuilder ();
+
+		expect ('"');
+
+		while (true) {
+			/* Copy plain runs straight from the buffer */
+			int start = _buffer_pos;
+			while (_buffer_pos < _buffer_len &&
+			       _buffer[_buffer_pos] != '"' &&
+			       _buffer[_buffer_pos] != '\\') {
+				_buffer_pos++;
+			}
+
+			if (_buffer_pos > start)
+				str.append_len ((string) (&_buffer[start]), _buffer_pos - start);
+
+			var c = get_char ();
+
+			if (c == '"')
+				break;
+			if (c != '\\')
+				continue;
+
+			c = get_char ();
+
+			switch (c) {
+			case '"':
+			case '\\':
+			case '/':
+				str.append_c ((char) c);
+				break;
+			case 'b':
+				str.append_c ('\b');
+				break;
+			case 'f':
+				str.append_c ('\f');
+				break;
+			case 'n':
+				str.append_c ('\n');
+				break;
+			case 'r':
+				str.append_c ('\r');
+				break;
+			case 't':
+				str.append_c ('\t');
+				break;
+			case 'u':
+				var ch = read_hex4 ();
+
+				if (ch >= 0xD800 && ch <= 0xDBFF) {
+					/* Surrogate pair */
+					if (get_char () != '\\' || get_char () != 'u')
+						throw parse_error ("unpaired surrogate");
+
+					var low = read_hex4 ();
+					if (low < 0xDC00 || low > 0xDFFF)
+						throw parse_error ("unpaired surrogate");
+
+					ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+				}
+
+				str.append_unichar (ch);
+				break;
 			default:
-				return Sparql.ValueType.STRING;
+				throw parse_error ("invalid escape sequence");
+			}
+		}
+
+		return str.str;
+	}
+
+	private void skip_value () throws GLib.Error {
+		var c = peek_non_space ();
+
+		if (c == '"') {
+			read_string ();
+		} else if (c == '{') {
+			_buffer_pos++;
+			if (accept ('}'))
+				return;
+
+			do {
+				read_string ();
+				expect (':');
+				skip_value ();
+			} while (accept (','));
+
+			expect ('}');
+		} else if (c == '[') {
+			_buffer_pos++;
+			if (accept (']'))
+				return;
+
+			do {
+				skip_value ();
+			} while (accept (','));
+
+			expect (']');
+		} else {
+			read_literal ();
+		}
+	}
+
+	/* true, false, null or a number */
+	private string read_literal () throws GLib.Error {
+		var str = new StringBuilder ();
+		var c = peek_non_space ();
+
+		while (c != ',' && c != '}' && c != ']' &&
+		       c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+			str.append_c ((char) c);
+			_buffer_pos++;
+			c = peek ();
+		}
+
+		if (str.len == 0)
+			throw parse_error ("expected a value");
+
+		return str.str;
+	}
+
+	private void parse_head () throws GLib.Error {
+		/* There are no variables in replies to ASK queries */
+		_vars = {};
+
+		expect ('{');
+		if (accept ('}'))
+			return;
+
+		do {
+			var name = read_string ();
+			expect (':');
+
+			if (name != "vars") {
+				skip_value ();
+				continue;
+			}
+
+			string[] vars = {};
+
+			expect ('[');
+			if (!accept (']')) {
+				do {
+					vars += read_string ();
+				} while (accept (','));
+
+				expect (']');
 			}
+
+			_vars = vars;
+		} while (accept (','));
+
+		expect ('}');
+	}
+
+	private void set_columns () {
+		for (int i = 0; i < _vars.length; i++)
+			_columns.insert (_vars[i], i + 1);
+
+		_values = new string?[_vars.length];
+		_types = new Sparql.ValueType[_vars.length];
+	}
+
+	/* Moves into the bindings array, returns false if there is none */
+	private bool seek_bindings () throws GLib.Error {
+		expect ('{');
+		if (accept ('}'))
+			return false;
+
+		do {
+			var name = read_string ();
+			expect (':');
+
+			if (name == "bindings") {
+				expect ('[');
+				return true;
+			}
+
+			skip_value ();
+		} while (accept (','));
+
+		expect ('}');
+		return false;
+	}
+
+	private void parse_binding (int column) throws GLib.Error {
+		string? type = null, value = null, datatype = null;
+
+		expect ('{');
+		if (!accept ('}')) {
+			do {
+				var name = read_string ();
+				expect (':');
+
+				switch (name) {
+				case "type":
+					type = read_string ();
+					break;
+				case "value":
+					value = read_string ();
+					break;
+				case "datatype":
+					datatype = read_string ();
+					break;
+				default:
+					skip_value ();
+					break;
+				}
+			} while (accept (','));
+
+			expect ('}');
 		}
 
+		switch (type) {
+		case "uri":
+			_types[column] = Sparql.ValueType.URI;
+			break;
+		case "bnode":
+			_types[column] = Sparql.ValueType.BLANK_NODE;
+			break;
+		case "literal":
+		case "typed-literal":
+			_types[column] = literal_value_type (datatype);
+			break;
 		default:
-			return Sparql.ValueType.STRING;
+			_types[column] = Sparql.ValueType.STRING;
+			break;
 		}
+
+		_values[column] = value;
 	}
 
-	public override unowned string? get_variable_name (int column) {
-		return _vars.get_string_element (column);
+	public override int n_columns {
+		get { return _vars.length; }
 	}
 
-	public override unowned string? get_string (int column, out long length = null) requires (_cur_row != null) {
-		var col_node = _cur_row.get_member (get_variable_name (column));
-		length = 0;
+	public override Sparql.ValueType get_value_type (int column) requires (!_first_row && !_finished) {
+		if (column < 0 || column >= _vars.length)
+			return Sparql.ValueType.UNBOUND;
 
-		if (col_node == null)
+		return _types[column];
+	}
+
+	public override unowned string? get_variable_name (int column) {
+		if (column < 0 || column >= _vars.length)
 			return null;
 
-		var object = col_node.get_object ();
+		return _vars[column];
+	}
+
+	public override unowned string? get_string (int column, out long length = null) requires (!_first_row && !_finished) {
+		length = 0;
 
-		if (object == null)
+		if (column < 0 || column >= _vars.length)
 			return null;
 
-		unowned string str = object.get_string_member ("value");
-		length = str.length;
+		unowned string? str = _values[column];
+		if (str != null)
+			length = str.length;
+
 		return str;
 	}
 
 	public override bool next (Cancellable? cancellable = null) throws IOError, GLib.Error {
-		if (_started_iterating)
-			_cur_idx++;
-
-		if (_cur_idx >= _results.get_length ())
+		if (_finished)
 			return false;
 
 		if (cancellable != null && cancellable.is_cancelled ())
 			throw new IOError.CANCELLED ("Operation was cancelled");
 
-		_started_iterating = true;
-		_cur_row = _results.get_object_element (_cur_idx);
+		_cancellable = cancellable;
+
+		return read_row ();
+	}
+
+	private bool read_row () throws GLib.Error {
+		if (_boolean != null) {
+			if (!_first_row) {
+				_finished = true;
+				return false;
+			}
+
+			_first_row = false;
+			_values[0] = _boolean;
+			_types[0] = Sparql.ValueType.BOOLEAN;
+			return true;
+		}
+
+		if (_first_row ? accept (']') : !accept (',')) {
+			if (!_first_row)
+				expect (']');
+
+			/* The rest of the document is of no interest */
+			_first_row = false;
+			_finished = true;
+			return false;
+		}
+
+		_first_row = false;
+
+		for (int i = 0; i < _vars.length; i++) {
+			_values[i] = null;
+			_types[i] = Sparql.ValueType.UNBOUND;
+		}
+
+		expect ('{');
+		if (accept ('}'))
+			return true;
+
+		do {
+			var name = read_string ();
+			expect (':');
+
+			int column = _columns.lookup (name) - 1;
+
+			if (column >= 0)
+				parse_binding (column);
+			else
+				skip_value ();
+		} while (accept (','));
+
+		expect ('}');
+
 		return true;
 	}
 
 	public async override bool next_async (Cancellable? cancellable = null) throws IOError, GLib.Error {
-		return next (cancellable);
+		if (_finished)
+			return false;
+
+		if (cancellable != null && cancellable.is_cancelled ())
+			throw new IOError.CANCELLED ("Operation was cancelled");
+
+		_cancellable = cancellable;
+		_row_start = _buffer_pos;
+
+		bool first_row = _first_row;
+
+		while (true) {
+			_nonblocking = true;
+
+			try {
+				return read_row ();
+			} catch (IOError.WOULD_BLOCK e) {
+				/* Incomplete row, parse it again once there is more data */
+				_buffer_pos = _row_start;
+				_first_row = first_row;
+			} finally {
+				_nonblocking = false;
+			}
+
+			yield fill_async (Priority.DEFAULT, cancellable);
+		}
 	}
 
 	public override void rewind () {
-		_started_iterating = false;
+		/* Rows are not kept around after being read */
+		warning ("Remote cursors can not be rewound");
 	}
 
 	public override void close () {
+		_finished = true;
+
+		try {
+			_stream.close ();
+		} catch (GLib.Error e) {
+		}
 	}
 }
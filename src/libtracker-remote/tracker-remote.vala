@@ -32,7 +32,8 @@ public class Tracker.Remote.Connection : Tracker.Sparql.Connection {
 	}
 
 	private Soup.Message create_request (string sparql) {
-		var uri = _base_uri + sparql;
+		/* Reserved characters like '+' or '#' would change the query */
+		var uri = _base_uri + Uri.escape_string (sparql, null, false);
 		var message = new Soup.Message ("GET", uri);
 		var headers = message.request_headers;
 
@@ -42,43 +43,97 @@ public class Tracker.Remote.Connection : Tracker.Sparql.Connection {
 		return message;
 	}
 
-	private Sparql.Cursor create_cursor (Soup.Message message) throws GLib.Error, Sparql.Error {
-		string document = (string) message.response_body.flatten ().data;
+	/* Error replies are small, they are read whole */
+	private Sparql.Error status_error (Soup.Message message, MemoryOutputStream output) throws GLib.Error {
+		output.write_all ({ 0 }, null);
+		output.close ();
+		string document = (string) output.get_data ();
 
-		if (message.status_code != Soup.Status.OK) {
-			throw new Sparql.Error.UNSUPPORTED ("Unhandled status code %u, document is: %s",
-			                                    message.status_code, document);
-		}
+		return new Sparql.Error.UNSUPPORTED ("Unhandled status code %u, document is: %s",
+		                                     message.status_code, document);
+	}
 
+	/* The returned cursor still needs its header read, through
+	 * GLib.Initable or GLib.AsyncInitable.
+	 */
+	private Sparql.Cursor create_cursor (Soup.Message message, InputStream stream) throws GLib.Error, Sparql.Error {
 		var headers = message.response_headers;
 		var content_type = headers.get_content_type (null);
-		long length = document.length;
 
 		if (content_type == JSON_TYPE) {
-			return new Tracker.Remote.JsonCursor (document, length);
+			return new Tracker.Remote.JsonCursor (stream);
 		} else if (content_type == XML_TYPE) {
-			return new Tracker.Remote.XmlCursor (document, length);
+			return new Tracker.Remote.XmlCursor (stream);
 		} else {
-			throw new Sparql.Error.UNSUPPORTED ("Unknown content type '%s', document is: %s", content_type, document);
+			stream.close ();
+			throw new Sparql.Error.UNSUPPORTED ("Unknown content type '%s'", content_type);
 		}
 	}
 
 	public override Sparql.Cursor query (string sparql, Cancellable? cancellable) throws GLib.Error, Sparql.Error, IOError {
 		var message = create_request (sparql);
+		var stream = _session.send (message, cancellable);
+
+		if (message.status_code != Soup.Status.OK) {
+			var output = new MemoryOutputStream.resizable ();
+			output.splice (stream, OutputStreamSpliceFlags.CLOSE_SOURCE, cancellable);
+			throw status_error (message, output);
+		}
 
-		_session.send_message (message);
+		var cursor = create_cursor (message, stream);
 
-		if (cancellable != null && cancellable.is_cancelled ())
-			throw new IOError.CANCELLED ("Operation was cancelled");
+		try {
+			((Initable) cursor).init (cancellable);
+		} catch (GLib.Error e) {
+			cursor.close ();
+			throw e;
+		}
 
-		return create_cursor (message);
+		return cursor;
 	}
 
 	public async override Sparql.Cursor query_async (string sparql, Cancellable? cancellable) throws GLib.Error, Sparql.Error, IOError {
 		var message = create_request (sparql);
+		var stream = yield _session.send_async (message, cancellable);
+
+		if (message.status_code != Soup.Status.OK) {
+			var output = new MemoryOutputStream.resizable ();
+			yield output.splice_async (stream, OutputStreamSpliceFlags.CLOSE_SOURCE, Priority.DEFAULT, cancellable);
+			throw status_error (message, output);
+		}
+
+		var cursor = create_cursor (message, stream);
+
+		try {
+			yield ((AsyncInitable) cursor).init_async (Priority.DEFAULT, cancellable);
+		} catch (GLib.Error e) {
+			cursor.close ();
+			throw e;
+		}
 
-		yield _session.send_async (message, cancellable);
+		return cursor;
+	}
+}
 
-		return create_cursor (message);
+namespace Tracker.Remote {
+	const string XSD_NS = "http://www.w3.org/2001/XMLSchema#";
+
+	internal Sparql.ValueType literal_value_type (string? datatype) {
+		switch (datatype) {
+		case XSD_NS + "byte":
+		case XSD_NS + "int":
+		case XSD_NS + "integer":
+		case XSD_NS + "long":
+			return Sparql.ValueType.INTEGER;
+		case XSD_NS + "decimal":
+		case XSD_NS + "double":
+			return Sparql.ValueType.DOUBLE;
+		case XSD_NS + "dateTime":
+			return Sparql.ValueType.DATETIME;
+		case XSD_NS + "boolean":
+			return Sparql.ValueType.BOOLEAN;
+		default:
+			return Sparql.ValueType.STRING;
+		}
 	}
 }
@@ -19,185 +19,344 @@
  * Author: Carlos Garnacho <carlosg@gnome.org>
  */
 
-public class Tracker.Remote.XmlCursor : Tracker.Sparql.Cursor {
-	Xml.Node *_results;
-	Xml.Node *_cur_row;
-	HashTable<string, Xml.Node*> _cur_row_map;
-	string [] _vars;
+/* Reads application/sparql-results+xml documents through a libxml2
+ * text reader fed from the response stream, so only the current row
+ * is kept in memory. ASK replies are presented as a single boolean
+ * "result" column, like local connections do.
+ */
+public class Tracker.Remote.XmlCursor : Tracker.Sparql.Cursor, GLib.Initable, GLib.AsyncInitable {
+	const int BUFFER_SIZE = 65536;
+
+	InputStream _stream;
+	Cancellable? _cancellable;
+	GLib.Error? _error;
+	Xml.TextReader _reader;
+
+	/* Read ahead by init_async() and next_async(), handed to the reader
+	 * before the stream. Data before _scan_offset was already looked at
+	 * by pending_has_node().
+	 */
+	ByteArray _pending = new ByteArray ();
+	int _scan_offset = 0;
+	bool _eof = false;
+
+	string[] _vars;
+	/* variable name -> column + 1 */
+	HashTable<string, int> _columns;
+	string?[] _values;
+	Sparql.ValueType[] _types;
+	string? _boolean;
+	bool _first_row = true;
+	bool _finished = false;
+
+	private static int read_callback (void* context, char[] buffer, int len) {
+		unowned XmlCursor cursor = (XmlCursor) context;
+		unowned uint8[] data = (uint8[]) buffer;
+
+		data.length = len;
+
+		if (cursor._pending.len > 0) {
+			var n = int.min (len, (int) cursor._pending.len);
+
+			Memory.copy (data, cursor._pending.data, n);
+			cursor._pending.remove_range (0, n);
+			cursor._scan_offset = int.max (0, cursor._scan_offset - n);
+			return n;
+		}
 
-	const string XSD_NS = "http://www.w3.org/2001/XMLSchema#";
+		if (cursor._eof)
+			return 0;
 
-	private Xml.Node * find_first_child_node (Xml.Node *node) {
-		for (Xml.Node* iter = node->children; iter != null; iter = iter->next) {
-			if (iter->type != Xml.ElementType.ELEMENT_NODE)
-				continue;
-			return iter;
+		try {
+			return (int) cursor._stream.read (data, cursor._cancellable);
+		} catch (GLib.Error e) {
+			cursor._error = e.copy ();
+			return -1;
 		}
+	}
 
-		return null;
+	private static int close_callback (void* context) {
+		/* The stream is closed along with the cursor */
+		return 0;
 	}
 
-	private Xml.Node * find_next_node (Xml.Node *node) {
-		for (Xml.Node* iter = node->next; iter != null; iter = iter->next) {
-			if (iter->type != Xml.ElementType.ELEMENT_NODE)
-				continue;
-			return iter;
+	private bool read_node () throws GLib.Error {
+		var ret = _reader.read ();
+
+		if (_error != null) {
+			var error = (owned) _error;
+			throw error;
 		}
 
-		return null;
-	}
+		if (ret < 0)
+			throw new Sparql.Error.INTERNAL ("Could not parse XML document");
 
-	private Xml.Node * lookup_child_node (Xml.Node *node, string name) {
-		for (Xml.Node* iter = node->children; iter != null; iter = iter->next) {
-			if (iter->type != Xml.ElementType.ELEMENT_NODE)
-				continue;
-			if (iter->name == name)
-				return iter;
-		}
+		return ret > 0;
+	}
 
-		return null;
+	private bool is_element (string name) {
+		return _reader.node_type () == Xml.ReaderType.ELEMENT &&
+		       _reader.const_local_name () == name;
 	}
 
-	private Xml.Attr * lookup_attribute (Xml.Node *node, string name) {
-		for (Xml.Attr* iter = node->properties; iter != null; iter = iter->next) {
-			if (iter->name == name)
-				return iter;
-		}
+	private bool is_end_element (string name) {
+		return _reader.node_type () == Xml.ReaderType.END_ELEMENT &&
+		       _reader.const_local_name () == name;
+	}
 
-		return null;
+	/* The header is read by init() or init_async() */
+	public XmlCursor (InputStream stream) {
+		_stream = stream;
+		_columns = new HashTable<string, int> (str_hash, str_equal);
 	}
 
-	private void parse_vars (Xml.Node *vars) {
-		for (Xml.Node* iter = vars->children; iter != null; iter = iter->next) {
-			if (iter->name != "variable" ||
-			    iter->type != Xml.ElementType.ELEMENT_NODE)
-				continue;
+	public bool init (Cancellable? cancellable = null) throws GLib.Error {
+		_cancellable = cancellable;
 
-			var attr = lookup_attribute (iter, "name");
-			if (attr == null)
-				continue;
+		Xml.Parser.init ();
+		_reader = new Xml.TextReader.for_io (read_callback, close_callback, this, "", null, 0);
 
-			_vars += attr->children->content;
+		if (_reader == null)
+			throw new Sparql.Error.INTERNAL ("Could not parse XML document");
+
+		string[] vars = {};
+
+		while (true) {
+			if (!read_node ()) {
+				/* No results, e.g. the reply to an ASK query */
+				_finished = true;
+				break;
+			}
+
+			if (is_element ("variable")) {
+				var name = _reader.get_attribute ("name");
+				if (name != null)
+					vars += name;
+			} else if (is_element ("results")) {
+				if (_reader.is_empty_element () > 0)
+					_finished = true;
+				break;
+			} else if (is_element ("boolean")) {
+				_boolean = _reader.read_string ();
+
+				if (_boolean != "true" && _boolean != "false")
+					throw new Sparql.Error.INTERNAL ("Could not parse XML document: invalid boolean");
+			}
 		}
-	}
 
-	public XmlCursor (string document, long length) throws Sparql.Error {
-		Xml.Parser.init ();
-		var doc = Xml.Parser.parse_memory (document, (int) length);
+		if (_boolean != null) {
+			vars = { "result" };
+			_finished = false;
+		}
 
-		if (doc == null)
-			throw new Sparql.Error.INTERNAL ("Could not parse XML document");
+		_vars = vars;
 
-		var root = doc->get_root_element ();
-		_results = lookup_child_node (root, "results");
+		for (int i = 0; i < _vars.length; i++)
+			_columns.insert (_vars[i], i + 1);
 
-		var vars = lookup_child_node (root, "head");
-		parse_vars (vars);
-		Xml.Parser.cleanup ();
+		_values = new string?[_vars.length];
+		_types = new Sparql.ValueType[_vars.length];
 
-		_cur_row_map = new HashTable<string, Xml.Node*> (str_hash, str_equal);
+		return true;
+	}
+
+	public async bool init_async (int io_priority = Priority.DEFAULT, Cancellable? cancellable = null) throws GLib.Error {
+		/* libxml2 pulls data synchronously, so read ahead here until
+		 * the header is buffered.
+		 */
+		while (!_eof && !pending_has_node ({ "<results", "</boolean>" }))
+			yield read_pending (io_priority, cancellable);
+
+		return init (cancellable);
 	}
 
 	public override int n_columns {
-		get { return (int) _vars.length; }
+		get { return _vars.length; }
 	}
 
-	public override Sparql.ValueType get_value_type (int column) requires (_cur_row != null) {
-		var variable = _vars[column];
-		Xml.Node* node = (Xml.Node*) _cur_row_map.get (variable);
-		if (node == null)
+	public override Sparql.ValueType get_value_type (int column) requires (!_first_row && !_finished) {
+		if (column < 0 || column >= _vars.length)
 			return Sparql.ValueType.UNBOUND;
 
-		switch (node->children->name) {
-		case "uri":
-			return Sparql.ValueType.URI;
-		case "bnode":
-			return Sparql.ValueType.BLANK_NODE;
-		case "literal":
-			var attr = lookup_attribute (node, "datatype");
-			if (attr == null)
-				return Sparql.ValueType.STRING;
-
-			switch (attr->children->content) {
-			case XSD_NS + "byte":
-			case XSD_NS + "int":
-			case XSD_NS + "integer":
-			case XSD_NS + "long":
-				return Sparql.ValueType.INTEGER;
-			case XSD_NS + "decimal":
-			case XSD_NS + "double":
-				return Sparql.ValueType.DOUBLE;
-			case XSD_NS + "dateTime":
-				return Sparql.ValueType.DATETIME;
-			default:
-				return Sparql.ValueType.STRING;
-			}
-		default:
-			return Sparql.ValueType.STRING;
-		}
+		return _types[column];
 	}
 
 	public override unowned string? get_variable_name (int column) {
-		if (column < 0 || column > _vars.length)
+		if (column < 0 || column >= _vars.length)
 			return null;
 		return _vars[column];
 	}
 
-	public override unowned string? get_string (int column, out long length = null) requires (_cur_row != null) {
+	public override unowned string? get_string (int column, out long length = null) requires (!_first_row && !_finished) {
 		length = 0;
 
-		var variable = _vars[column];
-		Xml.Node* node = (Xml.Node*) _cur_row_map.get (variable);
-		if (node == null)
+		if (column < 0 || column >= _vars.length)
 			return null;
 
-		var child = find_first_child_node (node);
-		if (child == null)
-			return null;
+		unowned string? str = _values[column];
+		if (str != null)
+			length = str.length;
 
-		var text = child->children;
-		if (text == null ||
-		    text->type != Xml.ElementType.TEXT_NODE)
-			return null;
+		return str;
+	}
+
+	private void read_value (int column) {
+		var name = _reader.const_local_name ();
+
+		switch (name) {
+		case "uri":
+			_types[column] = Sparql.ValueType.URI;
+			break;
+		case "bnode":
+			_types[column] = Sparql.ValueType.BLANK_NODE;
+			break;
+		case "literal":
+			_types[column] = literal_value_type (_reader.get_attribute ("datatype"));
+			break;
+		default:
+			return;
+		}
 
-		length = text->content.length;
-		return text->content;
+		if (_reader.is_empty_element () > 0)
+			_values[column] = "";
+		else
+			_values[column] = _reader.read_string () ?? "";
 	}
 
 	public override bool next (Cancellable? cancellable = null) throws IOError, GLib.Error {
-		if (_cur_row == null)
-			_cur_row = find_first_child_node (_results);
-		else
-			_cur_row = find_next_node (_cur_row);
+		if (_finished)
+			return false;
 
-		_cur_row_map.remove_all ();
+		if (cancellable != null && cancellable.is_cancelled ())
+			throw new IOError.CANCELLED ("Operation was cancelled");
 
-		if (_cur_row == null)
-			return false;
+		_cancellable = cancellable;
 
-		for (Xml.Node* iter = _cur_row->children; iter != null; iter = iter->next) {
-			if (iter->name != "binding")
-				continue;
+		if (_boolean != null) {
+			if (!_first_row) {
+				_finished = true;
+				return false;
+			}
+
+			_first_row = false;
+			_values[0] = _boolean;
+			_types[0] = Sparql.ValueType.BOOLEAN;
+			return true;
+		}
 
-			var attr = lookup_attribute (iter, "name");
-			if (attr == null)
+		_first_row = false;
+
+		/* Find the next row */
+		while (true) {
+			if (!read_node () || is_end_element ("results")) {
+				_finished = true;
+				return false;
+			}
+
+			if (is_element ("result"))
+				break;
+		}
+
+		for (int i = 0; i < _vars.length; i++) {
+			_values[i] = null;
+			_types[i] = Sparql.ValueType.UNBOUND;
+		}
+
+		if (_reader.is_empty_element () > 0)
+			return true;
+
+		int column = -1;
+
+		while (read_node () && !is_end_element ("result")) {
+			if (_reader.node_type () != Xml.ReaderType.ELEMENT)
 				continue;
 
-			var binding_name = attr->children->content;
-			_cur_row_map.insert (binding_name, iter);
+			if (_reader.const_local_name () == "binding") {
+				var name = _reader.get_attribute ("name");
+				column = name != null ? _columns.lookup (name) - 1 : -1;
+			} else if (column >= 0) {
+				read_value (column);
+			}
 		}
 
 		return true;
 	}
 
+	private int find_pending (string needle, int from) {
+		unowned uint8[] data = _pending.data;
+
+		for (int i = from; i + needle.length <= data.length; i++) {
+			if (Memory.cmp (&data[i], needle, needle.length) == 0)
+				return i;
+		}
+
+		return -1;
+	}
+
+	/* Whether _pending has a node starting with one of @needles, and
+	 * the node after it, so the reader gets past it without reading from
+	 * the stream. The scan resumes from where the previous one stopped.
+	 */
+	private bool pending_has_node (string[] needles) {
+		unowned uint8[] data = _pending.data;
+
+		for (int i = _scan_offset; i < data.length; i++) {
+			if (data[i] != '<')
+				continue;
+
+			foreach (unowned string needle in needles) {
+				/* Can't tell yet */
+				if (i + needle.length > data.length) {
+					_scan_offset = i;
+					return false;
+				}
+
+				if (Memory.cmp (&data[i], needle, needle.length) == 0) {
+					_scan_offset = i;
+					return find_pending ("<", i + needle.length) >= 0;
+				}
+			}
+		}
+
+		_scan_offset = data.length;
+		return false;
+	}
+
+	private async void read_pending (int io_priority, Cancellable? cancellable) throws GLib.Error {
+		var bytes = yield _stream.read_bytes_async (BUFFER_SIZE, io_priority, cancellable);
+
+		if (bytes.get_size () == 0)
+			_eof = true;
+		else
+			_pending.append (bytes.get_data ());
+	}
+
 	public async override bool next_async (Cancellable? cancellable = null) throws IOError, GLib.Error {
+		if (_finished)
+			return false;
+
+		/* libxml2 pulls data synchronously, so read ahead here until
+		 * the row is buffered. Documents using prefixed element names
+		 * are buffered whole.
+		 */
+		while (!_eof && _boolean == null &&
+		       !pending_has_node ({ "</results", "</result>", "<result/>" }))
+			yield read_pending (Priority.DEFAULT, cancellable);
+
 		return next (cancellable);
 	}
 
 	public override void rewind () {
-		_cur_row = null;
+		/* Rows are not kept around after being read */
+		warning ("Remote cursors can not be rewound");
 	}
 
 	public override void close () {
+		_finished = true;
+
+		try {
+			_stream.close ();
+		} catch (GLib.Error e) {
+		}
 	}
 }
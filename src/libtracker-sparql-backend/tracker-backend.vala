@@ -20,7 +20,7 @@
 static string domain_name = null;
 static Tracker.DomainOntology domain_ontology = null;
 
-class Tracker.Sparql.Backend : Connection {
+class Tracker.Sparql.Backend : Connection, QueryIntrospection {
 	bool initialized;
 	Tracker.Sparql.Connection direct = null;
 	Tracker.Sparql.Connection bus = null;
@@ -153,6 +153,22 @@ class Tracker.Sparql.Backend : Connection {
 		return yield bus.statistics_async (cancellable);
 	}
 
+	public GLib.Variant? explain_query (string sparql, bool profile, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError, GLib.Error {
+		debug ("%s(): '%s'", GLib.Log.METHOD, sparql);
+		if (direct == null) {
+			throw new Sparql.Error.UNSUPPORTED ("Query explanation is only available for direct connections");
+		}
+		return direct.explain (sparql, profile, cancellable);
+	}
+
+	public string[]? get_dependencies (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError, GLib.Error {
+		debug ("%s(): '%s'", GLib.Log.METHOD, sparql);
+		if (direct == null) {
+			throw new Sparql.Error.UNSUPPORTED ("Query dependencies are only available for direct connections");
+		}
+		return direct.get_query_dependencies (sparql, cancellable);
+	}
+
 	public override NamespaceManager? get_namespace_manager () {
 		if (direct != null)
 			return direct.get_namespace_manager ();
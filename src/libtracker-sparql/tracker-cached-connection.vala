@@ -0,0 +1,642 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * SECTION: tracker-sparql-cached-connection
+ * @short_description: Caching query results
+ * @title: TrackerSparqlCachedConnection
+ * @stability: Unstable
+ * @include: tracker-sparql.h
+ *
+ * <para>
+ * #TrackerSparqlCachedConnection wraps a #TrackerSparqlConnection and
+ * keeps the results of read queries in memory, so clients that repeat
+ * identical queries get them without a round trip to the store.
+ * </para>
+ *
+ * <para>
+ * Each cached query is tagged with the RDF classes whose changes may
+ * alter its results, as found by
+ * tracker_sparql_connection_get_query_dependencies(). Entries are
+ * dropped as #TrackerNotifier reports changes on those classes. Queries
+ * that can not be tracked this way are never cached. Updates done
+ * through the cached connection clear the whole cache, so the caller
+ * always reads its own writes.
+ * </para>
+ *
+ * <para>
+ * Notifications are only emitted by tracker-store, the wrapped
+ * connection is expected to be the one returned by
+ * tracker_sparql_connection_get(). Changes done by other clients
+ * become visible once tracker-store signals them, which may take up
+ * to its GraphUpdated delay.
+ * </para>
+ */
+
+/**
+ * TrackerSparqlCachedConnection:
+ *
+ * The <structname>TrackerSparqlCachedConnection</structname> object
+ * caches the results of queries done on another connection.
+ */
+public class Tracker.Sparql.CachedConnection : Connection, QueryIntrospection {
+	const size_t DEFAULT_MAX_SIZE = 4 * 1024 * 1024;
+
+	// Queries found not to be cacheable are remembered, so their
+	// dependencies are not looked up each time
+	const uint MAX_UNCACHEABLE = 256;
+
+	// Rough memory taken by each cached value, besides the string
+	const size_t VALUE_OVERHEAD = sizeof (void*) + sizeof (ValueType);
+
+	class Entry {
+		public string sparql;
+		public string[] dependencies;
+		public string[] variable_names;
+		// n_rows * n_columns values, row by row
+		public ValueType[] types;
+		public string?[] values;
+		public int n_rows;
+		public size_t size;
+		public uint64 last_used;
+	}
+
+	class CachedCursor : Cursor {
+		Entry entry;
+		int row = -1;
+
+		public CachedCursor (Connection connection, Entry entry) {
+			this.connection = connection;
+			this.entry = entry;
+		}
+
+		public override int n_columns {
+			get { return entry.variable_names.length; }
+		}
+
+		private bool valid_column (int column) {
+			return row >= 0 && row < entry.n_rows &&
+			       column >= 0 && column < entry.variable_names.length;
+		}
+
+		public override ValueType get_value_type (int column) {
+			if (!valid_column (column))
+				return ValueType.UNBOUND;
+
+			return entry.types[row * entry.variable_names.length + column];
+		}
+
+		public override unowned string? get_variable_name (int column) {
+			if (column < 0 || column >= entry.variable_names.length)
+				return null;
+
+			return entry.variable_names[column];
+		}
+
+		public override unowned string? get_string (int column, out long length = null) {
+			length = 0;
+
+			if (!valid_column (column))
+				return null;
+
+			unowned string? str = entry.values[row * entry.variable_names.length + column];
+			if (str != null)
+				length = str.length;
+
+			return str;
+		}
+
+		public override bool next (Cancellable? cancellable = null) throws GLib.Error {
+			if (row + 1 >= entry.n_rows) {
+				row = entry.n_rows;
+				return false;
+			}
+
+			row++;
+			return true;
+		}
+
+		public async override bool next_async (Cancellable? cancellable = null) throws GLib.Error {
+			return next (cancellable);
+		}
+
+		public override void rewind () {
+			row = -1;
+		}
+	}
+
+	// Results found too big to cache while reading them: serves the
+	// rows read so far, then the rest straight from the wrapped cursor
+	class StreamingCursor : CachedCursor {
+		Cursor cursor;
+		bool buffered = true;
+
+		public StreamingCursor (Connection connection, Entry entry, Cursor cursor) {
+			base (connection, entry);
+			this.cursor = cursor;
+		}
+
+		public override ValueType get_value_type (int column) {
+			if (!buffered)
+				return cursor.get_value_type (column);
+
+			return base.get_value_type (column);
+		}
+
+		public override unowned string? get_string (int column, out long length = null) {
+			if (!buffered)
+				return cursor.get_string (column, out length);
+
+			return base.get_string (column, out length);
+		}
+
+		public override bool next (Cancellable? cancellable = null) throws GLib.Error {
+			if (buffered && base.next (cancellable))
+				return true;
+
+			buffered = false;
+			return cursor.next (cancellable);
+		}
+
+		public async override bool next_async (Cancellable? cancellable = null) throws GLib.Error {
+			if (buffered && base.next (cancellable))
+				return true;
+
+			buffered = false;
+			return yield cursor.next_async (cancellable);
+		}
+
+		// The buffered rows are read again from the wrapped cursor
+		public override void rewind () {
+			buffered = false;
+			cursor.rewind ();
+		}
+
+		public override void close () {
+			cursor.close ();
+		}
+	}
+
+	Connection base_connection;
+	Notifier notifier;
+
+	// Guards everything below, the connection may be used from
+	// several threads and notifier events arrive in the main one
+	Mutex mutex;
+
+	HashTable<string, Entry> entries;
+	HashTable<string, string> uncacheable;
+	bool dependencies_supported = true;
+
+	// Clock for least recently used eviction
+	uint64 stamp;
+
+	// Bumped whenever entries are invalidated, results of queries
+	// that were running meanwhile are not stored
+	uint invalidation_serial;
+
+	size_t _max_size;
+	size_t _size;
+	uint64 _n_hits;
+	uint64 _n_misses;
+	uint64 _n_invalidations;
+
+	/**
+	 * TrackerSparqlCachedConnection:max-size:
+	 *
+	 * Approximate amount of memory in bytes that cached results may
+	 * take. Least recently used entries are evicted past this size.
+	 *
+	 * Since: 2.2
+	 */
+	public size_t max_size {
+		get {
+			mutex.lock ();
+			var value = _max_size;
+			mutex.unlock ();
+			return value;
+		}
+		set {
+			mutex.lock ();
+			_max_size = value;
+			evict ();
+			mutex.unlock ();
+		}
+	}
+
+	/**
+	 * TrackerSparqlCachedConnection:size:
+	 *
+	 * Approximate amount of memory in bytes taken by cached results.
+	 *
+	 * Since: 2.2
+	 */
+	public size_t size {
+		get {
+			mutex.lock ();
+			var value = _size;
+			mutex.unlock ();
+			return value;
+		}
+	}
+
+	/**
+	 * TrackerSparqlCachedConnection:n-hits:
+	 *
+	 * Number of queries answered from the cache.
+	 *
+	 * Since: 2.2
+	 */
+	public uint64 n_hits {
+		get {
+			mutex.lock ();
+			var value = _n_hits;
+			mutex.unlock ();
+			return value;
+		}
+	}
+
+	/**
+	 * TrackerSparqlCachedConnection:n-misses:
+	 *
+	 * Number of queries forwarded to the wrapped connection.
+	 *
+	 * Since: 2.2
+	 */
+	public uint64 n_misses {
+		get {
+			mutex.lock ();
+			var value = _n_misses;
+			mutex.unlock ();
+			return value;
+		}
+	}
+
+	/**
+	 * TrackerSparqlCachedConnection:n-invalidations:
+	 *
+	 * Number of cached entries dropped because of changes in the store.
+	 *
+	 * Since: 2.2
+	 */
+	public uint64 n_invalidations {
+		get {
+			mutex.lock ();
+			var value = _n_invalidations;
+			mutex.unlock ();
+			return value;
+		}
+	}
+
+	/**
+	 * TrackerSparqlCachedConnection:hit-rate:
+	 *
+	 * Fraction of queries answered from the cache, between 0 and 1.
+	 *
+	 * Since: 2.2
+	 */
+	public double hit_rate {
+		get {
+			mutex.lock ();
+			uint64 hits = _n_hits, total = _n_hits + _n_misses;
+			mutex.unlock ();
+			return total > 0 ? (double) hits / total : 0;
+		}
+	}
+
+	/**
+	 * tracker_sparql_cached_connection_new:
+	 * @connection: the #TrackerSparqlConnection to cache queries of
+	 * @max_size: approximate memory limit for cached results, in bytes
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Creates a connection that caches the results of queries done
+	 * on @connection.
+	 *
+	 * Returns: a new #TrackerSparqlCachedConnection, or %NULL on error.
+	 * Free with g_object_unref() when done.
+	 *
+	 * Since: 2.2
+	 */
+	public CachedConnection (Connection connection, size_t max_size = DEFAULT_MAX_SIZE, Cancellable? cancellable = null) throws GLib.Error {
+		base_connection = connection;
+		entries = new HashTable<string, Entry> (str_hash, str_equal);
+		uncacheable = new HashTable<string, string> (str_hash, str_equal);
+		this.max_size = max_size;
+
+		notifier = new Notifier (null, NotifierFlags.NONE, cancellable);
+		notifier.events.connect (events_cb);
+	}
+
+	public override void dispose () {
+		if (notifier != null) {
+			notifier.events.disconnect (events_cb);
+			notifier = null;
+		}
+
+		base.dispose ();
+	}
+
+	private void events_cb (GenericArray<NotifierEvent> events) {
+		var classes = new HashTable<unowned string, unowned string> (str_hash, str_equal);
+
+		foreach (unowned NotifierEvent event in events.data) {
+			classes.add (event.get_rdf_type ());
+		}
+
+		mutex.lock ();
+		invalidation_serial++;
+
+		entries.foreach_remove ((sparql, entry) => {
+			foreach (unowned string dependency in entry.dependencies) {
+				if (classes.contains (dependency)) {
+					_size -= entry.size;
+					_n_invalidations++;
+					return true;
+				}
+			}
+
+			return false;
+		});
+		mutex.unlock ();
+	}
+
+	/**
+	 * tracker_sparql_cached_connection_flush:
+	 * @self: a #TrackerSparqlCachedConnection
+	 *
+	 * Drops all cached results.
+	 *
+	 * Since: 2.2
+	 */
+	public void flush () {
+		mutex.lock ();
+		invalidation_serial++;
+		entries.remove_all ();
+		_size = 0;
+		mutex.unlock ();
+	}
+
+	// Called with the mutex held
+	private void evict () {
+		if (entries == null)
+			return;
+
+		while (_size > _max_size) {
+			Entry? oldest = null;
+
+			foreach (var entry in entries.get_values ()) {
+				if (oldest == null || entry.last_used < oldest.last_used)
+					oldest = entry;
+			}
+
+			if (oldest == null)
+				break;
+
+			entries.remove (oldest.sparql);
+			_size -= oldest.size;
+		}
+	}
+
+	// On a miss, @serial tells whether entries were invalidated
+	// by the time the result is stored
+	private Cursor? lookup (string sparql, out uint serial) {
+		mutex.lock ();
+		var entry = entries.lookup (sparql);
+		serial = invalidation_serial;
+
+		if (entry == null) {
+			_n_misses++;
+			mutex.unlock ();
+			return null;
+		}
+
+		entry.last_used = ++stamp;
+		_n_hits++;
+		mutex.unlock ();
+
+		return new CachedCursor (this, entry);
+	}
+
+	private string[]? get_dependencies (string sparql, Cancellable? cancellable) {
+		string[]? dependencies = null;
+
+		mutex.lock ();
+		bool skip = !dependencies_supported || uncacheable.contains (sparql);
+		mutex.unlock ();
+
+		if (skip)
+			return null;
+
+		try {
+			dependencies = base_connection.get_query_dependencies (sparql, cancellable);
+		} catch (Sparql.Error.UNSUPPORTED e) {
+			mutex.lock ();
+			dependencies_supported = false;
+			mutex.unlock ();
+		} catch (GLib.Error e) {
+			// Errors are reported when running the query
+		}
+
+		if (dependencies == null) {
+			mutex.lock ();
+			if (uncacheable.size () >= MAX_UNCACHEABLE)
+				uncacheable.remove_all ();
+
+			uncacheable.add (sparql);
+			mutex.unlock ();
+		}
+
+		return dependencies;
+	}
+
+	private Entry create_entry (string sparql, string[] dependencies, Cursor cursor) {
+		var entry = new Entry ();
+
+		entry.sparql = sparql;
+		entry.dependencies = dependencies;
+		entry.size = sparql.length;
+
+		entry.variable_names = new string[cursor.n_columns];
+		for (int i = 0; i < cursor.n_columns; i++) {
+			entry.variable_names[i] = cursor.get_variable_name (i);
+			entry.size += entry.variable_names[i].length;
+		}
+
+		return entry;
+	}
+
+	private void add_row (Entry entry, Cursor cursor) {
+		for (int i = 0; i < entry.variable_names.length; i++) {
+			unowned string? str = cursor.get_string (i);
+
+			entry.types += cursor.get_value_type (i);
+			entry.values += str;
+			entry.size += VALUE_OVERHEAD + (str != null ? str.length + 1 : 0);
+		}
+
+		entry.n_rows++;
+	}
+
+	private void store (Entry entry, uint serial) {
+		mutex.lock ();
+
+		// Changes were signalled while the query ran, or it is too big
+		if (serial != invalidation_serial || entry.size > _max_size) {
+			mutex.unlock ();
+			return;
+		}
+
+		var old_entry = entries.lookup (entry.sparql);
+		if (old_entry != null)
+			_size -= old_entry.size;
+
+		entry.last_used = ++stamp;
+		entries.replace (entry.sparql, entry);
+		_size += entry.size;
+
+		evict ();
+		mutex.unlock ();
+	}
+
+	public override Cursor query (string sparql, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		uint serial;
+		var cached = lookup (sparql, out serial);
+		if (cached != null)
+			return cached;
+
+		var dependencies = get_dependencies (sparql, cancellable);
+		if (dependencies == null)
+			return base_connection.query (sparql, cancellable);
+
+		var cursor = base_connection.query (sparql, cancellable);
+		var entry = create_entry (sparql, dependencies, cursor);
+		var limit = max_size;
+
+		while (cursor.next (cancellable)) {
+			add_row (entry, cursor);
+
+			// Too big to be cached, stream the rest
+			if (entry.size > limit)
+				return new StreamingCursor (this, entry, cursor);
+		}
+
+		cursor.close ();
+		store (entry, serial);
+
+		return new CachedCursor (this, entry);
+	}
+
+	public async override Cursor query_async (string sparql, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		uint serial;
+		var cached = lookup (sparql, out serial);
+		if (cached != null)
+			return cached;
+
+		var dependencies = get_dependencies (sparql, cancellable);
+		if (dependencies == null)
+			return yield base_connection.query_async (sparql, cancellable);
+
+		var cursor = yield base_connection.query_async (sparql, cancellable);
+		var entry = create_entry (sparql, dependencies, cursor);
+		var limit = max_size;
+
+		while (yield cursor.next_async (cancellable)) {
+			add_row (entry, cursor);
+
+			// Too big to be cached, stream the rest
+			if (entry.size > limit)
+				return new StreamingCursor (this, entry, cursor);
+		}
+
+		cursor.close ();
+		store (entry, serial);
+
+		return new CachedCursor (this, entry);
+	}
+
+	public override void update (string sparql, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		base_connection.update (sparql, priority, cancellable);
+		flush ();
+	}
+
+	public async override void update_async (string sparql, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		yield base_connection.update_async (sparql, priority, cancellable);
+		flush ();
+	}
+
+	public async override GenericArray<Sparql.Error?>? update_array_async (string[] sparql, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		var errors = yield base_connection.update_array_async (sparql, priority, cancellable);
+		flush ();
+		return errors;
+	}
+
+	public override GLib.Variant? update_blank (string sparql, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		var variant = base_connection.update_blank (sparql, priority, cancellable);
+		flush ();
+		return variant;
+	}
+
+	public async override GLib.Variant? update_blank_async (string sparql, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		var variant = yield base_connection.update_blank_async (sparql, priority, cancellable);
+		flush ();
+		return variant;
+	}
+
+	public override void update_resources (Resource[] resources, string? graph = null, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		base_connection.update_resources (resources, graph, priority, cancellable);
+		flush ();
+	}
+
+	public async override void update_resources_async (Resource[] resources, string? graph = null, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		yield base_connection.update_resources_async (resources, graph, priority, cancellable);
+		flush ();
+	}
+
+	public override void load (File file, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		base_connection.load (file, cancellable);
+		flush ();
+	}
+
+	public async override void load_async (File file, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		yield base_connection.load_async (file, cancellable);
+		flush ();
+	}
+
+	public override Cursor? statistics (Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		return base_connection.statistics (cancellable);
+	}
+
+	public async override Cursor? statistics_async (Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		return yield base_connection.statistics_async (cancellable);
+	}
+
+	public GLib.Variant? explain_query (string sparql, bool profile, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		return base_connection.explain (sparql, profile, cancellable);
+	}
+
+	public string[]? get_dependencies (string sparql, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		return base_connection.get_query_dependencies (sparql, cancellable);
+	}
+
+	public override NamespaceManager? get_namespace_manager () {
+		return base_connection.get_namespace_manager ();
+	}
+}
@@ -464,6 +464,69 @@ public abstract class Tracker.Sparql.Connection : Object {
 		return null;
 	}
 
+	/**
+	 * tracker_sparql_connection_update_resources:
+	 * @self: a #TrackerSparqlConnection
+	 * @resources: (array length=resources_length1): the #TrackerResource<!-- -->s to store
+	 * @resources_length1: the amount of resources you pass as @resources
+	 * @graph: (allow-none): the graph to store the data in, or %NULL
+	 * @priority: the priority for the operation
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Stores @resources in a single transaction, with the same result as
+	 * running the updates from tracker_resource_print_sparql_update() on
+	 * each of them. Where the connection allows it, the resources are
+	 * handed to the store as statements, so no SPARQL text is generated
+	 * and parsed. The API call is completely synchronous, so it may block.
+	 *
+	 * Since: 2.2
+	 */
+	public virtual void update_resources (Resource[] resources, string? graph = null, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		update (print_resources (resources, graph), priority, cancellable);
+	}
+
+	/**
+	 * tracker_sparql_connection_update_resources_async:
+	 * @self: a #TrackerSparqlConnection
+	 * @resources: (array length=resources_length1): the #TrackerResource<!-- -->s to store
+	 * @resources_length1: the amount of resources you pass as @resources
+	 * @graph: (allow-none): the graph to store the data in, or %NULL
+	 * @priority: the priority for the asynchronous operation
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @_callback_: user-defined #GAsyncReadyCallback to be called when
+	 *              asynchronous operation is finished.
+	 * @_user_data_: user-defined data to be passed to @_callback_
+	 *
+	 * Stores asynchronously @resources in a single transaction. See
+	 * tracker_sparql_connection_update_resources().
+	 *
+	 * Since: 2.2
+	 */
+
+	/**
+	 * tracker_sparql_connection_update_resources_finish:
+	 * @self: a #TrackerSparqlConnection
+	 * @_res_: a #GAsyncResult with the result of the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Finishes the asynchronous update_resources operation.
+	 *
+	 * Since: 2.2
+	 */
+	public async virtual void update_resources_async (Resource[] resources, string? graph = null, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		yield update_async (print_resources (resources, graph), priority, cancellable);
+	}
+
+	private static string print_resources (Resource[] resources, string? graph) {
+		var sparql = new StringBuilder ();
+
+		foreach (unowned Resource resource in resources)
+			sparql.append (resource.print_sparql_update (null, graph));
+
+		return sparql.str;
+	}
+
 	/**
 	 * tracker_sparql_connection_load:
 	 * @self: a #TrackerSparqlConnection
@@ -560,6 +623,77 @@ public abstract class Tracker.Sparql.Connection : Object {
 		return null;
 	}
 
+	/**
+	 * tracker_sparql_connection_explain:
+	 * @self: a #TrackerSparqlConnection
+	 * @sparql: string containing the SPARQL query
+	 * @profile: whether to also execute the query and time it
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Describes how @sparql is executed by the connection. This is
+	 * meant as a tool to tune queries, the returned dictionary
+	 * (of type a{sv}) contains the following keys:
+	 *
+	 * - "sql" (s): the SQL the query is translated to
+	 * - "plan" (as): the SQLite query plan for that SQL
+	 * - "parse-time" (d), "translate-time" (d): seconds spent parsing
+	 *   the query and translating it to SQL
+	 *
+	 * If @profile is %TRUE the query is also executed, and the
+	 * "prepare-time" (d), "step-time" (d), "statement-cache-hit" (b)
+	 * and "rows" (t) keys are added.
+	 *
+	 * Only SELECT and ASK queries are supported. Connections that do not
+	 * run queries in-process fail with %TRACKER_SPARQL_ERROR_UNSUPPORTED.
+	 *
+	 * Returns: a #GVariant on success, %NULL on error. Call
+	 * g_variant_unref() on it when no longer needed.
+	 *
+	 * Since: 2.2
+	 */
+	public GLib.Variant? explain (string sparql, bool profile, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		var introspection = this as QueryIntrospection;
+
+		if (introspection == null)
+			throw new Sparql.Error.UNSUPPORTED ("Query explanation is not supported by this connection");
+
+		return introspection.explain_query (sparql, profile, cancellable);
+	}
+
+	/**
+	 * tracker_sparql_connection_get_query_dependencies:
+	 * @self: a #TrackerSparqlConnection
+	 * @sparql: string containing the SPARQL query
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @result_length1: (out): return location for the number of classes
+	 * @error: #GError for error reporting.
+	 *
+	 * Finds the RDF classes whose changes may alter the results of
+	 * @sparql. These are classes with tracker:notify set, so
+	 * #TrackerNotifier events on them cover all such changes.
+	 *
+	 * If the query reads data that is not covered by notifications
+	 * (e.g. it uses variable predicates, fts:match, or classes without
+	 * a notify superclass), %NULL is returned without setting @error.
+	 *
+	 * Only SELECT and ASK queries are supported. Connections that do not
+	 * translate queries in-process fail with %TRACKER_SPARQL_ERROR_UNSUPPORTED.
+	 *
+	 * Returns: (array length=result_length1) (transfer full) (nullable):
+	 * the class IRIs, free with g_strfreev().
+	 *
+	 * Since: 2.2
+	 */
+	public string[]? get_query_dependencies (string sparql, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		var introspection = this as QueryIntrospection;
+
+		if (introspection == null)
+			throw new Sparql.Error.UNSUPPORTED ("Query dependencies are not supported by this connection");
+
+		return introspection.get_dependencies (sparql, cancellable);
+	}
+
 	/**
 	 * tracker_sparql_connection_get_namespace_manager:
 	 * @self: a #TrackerSparqlConnection
@@ -607,3 +741,15 @@ public abstract class Tracker.Sparql.Connection : Object {
 	 */
 	public extern static string? get_domain ();
 }
+
+/*
+ * Implemented by connections that translate queries in-process, backs
+ * tracker_sparql_connection_explain() and
+ * tracker_sparql_connection_get_query_dependencies(). These are not
+ * #TrackerSparqlConnection vfuncs, so its class structure stays the
+ * same for connections built out of tree.
+ */
+public interface Tracker.Sparql.QueryIntrospection : Connection {
+	public abstract GLib.Variant? explain_query (string sparql, bool profile, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError;
+	public abstract string[]? get_dependencies (string sparql, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError;
+}
@@ -18,7 +18,6 @@
  */
 
 #include <glib.h>
-#include <json-glib/json-glib.h>
 
 #include <string.h>
 
@@ -945,123 +944,304 @@ tracker_resource_compare (TrackerResource *a,
 	return strcmp (a_priv->identifier, b_priv->identifier);
 };
 
-
-/* Helper function for serialization code. This allows you to selectively
- * populate 'interned_namespaces' from 'all_namespaces' based on when a
- * particular prefix is actually used. This is quite inefficient compared
- * to just dumping all known namespaces, but it makes the serializated
- * output more readable.
+/* Serialization
+ *
+ * All serializers share the same building blocks:
+ *
+ *  - A ResourceWriter, which accumulates output in a buffer that is
+ *    written out to a GOutputStream every WRITE_CHUNK_SIZE bytes, or
+ *    kept in memory for the tracker_resource_print_*() functions.
+ *
+ *  - A NamespaceCache, which resolves the prefix of compact URIs once
+ *    per prefix, and optionally records the prefixes used by a document.
+ *
+ *  - collect_resources(), which lists each resource reachable from the
+ *    top-level one exactly once, even with repeated or cyclic relations.
  */
+
+#define WRITE_CHUNK_SIZE 8192
+
+/* Same as TrackerNamespaceManager */
+#define MAX_PREFIX_LENGTH 100
+
+typedef struct {
+	GOutputStream *stream;
+	GCancellable *cancellable;
+	GString *buffer;
+	GError *error;
+} ResourceWriter;
+
 static void
-maybe_intern_prefix_of_compact_uri (TrackerNamespaceManager *all_namespaces,
-                                    TrackerNamespaceManager *interned_namespaces,
-                                    const char              *uri)
+writer_init (ResourceWriter *writer,
+             GOutputStream  *stream,
+             GCancellable   *cancellable)
 {
-	/* The TrackerResource API doesn't distinguish between compact URIs and full
-	 * URIs. This is fine as long as users don't add prefixes that can be
-	 * confused with URIs. Both URIs and CURIEs can have anything following
-	 * the ':', so without hardcoding knowledge of well-known protocols here,
-	 * we can't really tell if the user has done something dumb like defining a
-	 * "urn" prefix.
-	 */
-	char *prefix = g_uri_parse_scheme (uri);
+	writer->stream = stream;
+	writer->cancellable = cancellable;
+	writer->buffer = g_string_sized_new (stream ? WRITE_CHUNK_SIZE + 256 : 256);
+	writer->error = NULL;
+}
 
-	if (prefix == NULL) {
-		g_warning ("Invalid URI or compact URI: %s", uri);
+static void
+writer_flush (ResourceWriter *writer)
+{
+	if (writer->stream == NULL || writer->error != NULL ||
+	    writer->buffer->len == 0)
 		return;
-	}
 
-	if (tracker_namespace_manager_has_prefix (all_namespaces, prefix)) {
-		if (!tracker_namespace_manager_has_prefix (interned_namespaces, prefix)) {
-			const char *namespace = tracker_namespace_manager_lookup_prefix (all_namespaces, prefix);
-			tracker_namespace_manager_add_prefix (interned_namespaces, prefix, namespace);
-		}
+	g_output_stream_write_all (writer->stream,
+	                           writer->buffer->str, writer->buffer->len,
+	                           NULL, writer->cancellable, &writer->error);
+	g_string_truncate (writer->buffer, 0);
+}
+
+/* Called between items, returns FALSE if writing failed */
+static gboolean
+writer_check (ResourceWriter *writer)
+{
+	if (writer->buffer->len >= WRITE_CHUNK_SIZE)
+		writer_flush (writer);
+
+	return writer->error == NULL;
+}
+
+static gboolean
+writer_finish (ResourceWriter  *writer,
+               GError         **error)
+{
+	writer_flush (writer);
+	g_string_free (writer->buffer, TRUE);
+
+	if (writer->error) {
+		g_propagate_error (error, writer->error);
+		return FALSE;
 	}
 
-	g_free (prefix);
+	return TRUE;
 }
 
+static char *
+writer_steal (ResourceWriter *writer)
+{
+	g_assert (writer->stream == NULL);
+
+	return g_string_free (writer->buffer, FALSE);
+}
 
 typedef struct {
-	TrackerNamespaceManager *all_namespaces, *our_namespaces;
-	GString *string;
-	GList *done_list;
-} GenerateTurtleData;
+	TrackerNamespaceManager *all_namespaces;
+	/* Prefixes actually used, for formats that declare them */
+	TrackerNamespaceManager *our_namespaces;
+	/* prefix -> namespace, or "" for unknown prefixes */
+	GHashTable *prefixes;
+} NamespaceCache;
 
-void generate_turtle (TrackerResource *resource, GenerateTurtleData *data);
+static void
+namespace_cache_init (NamespaceCache          *cache,
+                      TrackerNamespaceManager *namespaces,
+                      gboolean                 track_used)
+{
+	if (namespaces == NULL) {
+		namespaces = tracker_namespace_manager_get_default ();
+	}
 
-gboolean
-is_blank_node (const char *uri_or_curie_or_blank)
+	cache->all_namespaces = namespaces;
+	cache->our_namespaces = track_used ? tracker_namespace_manager_new () : NULL;
+	cache->prefixes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+namespace_cache_clear (NamespaceCache *cache)
 {
-	return (strncmp(uri_or_curie_or_blank, "_:", 2) == 0);
+	g_clear_object (&cache->our_namespaces);
+	g_hash_table_unref (cache->prefixes);
 }
 
-gboolean
-is_builtin_class (const gchar             *uri_or_curie,
-                  TrackerNamespaceManager *namespaces)
+/* Returns the namespace if @uri_or_curie is a compact URI with a known
+ * prefix, or %NULL for full URIs and blank nodes.
+ *
+ * The TrackerResource API doesn't distinguish between compact URIs and full
+ * URIs. This is fine as long as users don't add prefixes that can be
+ * confused with URIs. Both URIs and CURIEs can have anything following
+ * the ':', so without hardcoding knowledge of well-known protocols here,
+ * we can't really tell if the user has done something dumb like defining a
+ * "urn" prefix.
+ */
+static const char *
+namespace_cache_lookup (NamespaceCache *cache,
+                        const char     *uri_or_curie)
 {
-	gchar *prefix = NULL;
+	char prefix[MAX_PREFIX_LENGTH + 1];
+	const char *colon, *namespace;
+	gsize len;
+
+	colon = strchr (uri_or_curie, ':');
+	if (colon == NULL)
+		return NULL;
+
+	len = colon - uri_or_curie;
+	if (len == 0 || len > MAX_PREFIX_LENGTH)
+		return NULL;
+
+	memcpy (prefix, uri_or_curie, len);
+	prefix[len] = '\0';
 
-	prefix = g_uri_parse_scheme (uri_or_curie);
+	namespace = g_hash_table_lookup (cache->prefixes, prefix);
 
-	if (prefix &&
-	    tracker_namespace_manager_has_prefix (namespaces, prefix))
-		return TRUE;
+	if (namespace == NULL) {
+		namespace = tracker_namespace_manager_lookup_prefix (cache->all_namespaces, prefix);
+
+		if (namespace && cache->our_namespaces) {
+			tracker_namespace_manager_add_prefix (cache->our_namespaces, prefix, namespace);
+		}
 
-	return FALSE;
+		namespace = g_strdup (namespace ? namespace : "");
+		g_hash_table_insert (cache->prefixes, g_strdup (prefix), (gpointer) namespace);
+	}
+
+	return namespace[0] != '\0' ? namespace : NULL;
 }
 
-void
-generate_nested_turtle_resource (TrackerResource    *resource,
-                                 GenerateTurtleData *data)
+static char *
+namespace_cache_expand (NamespaceCache *cache,
+                        const char     *uri_or_curie)
 {
-	/* We don't need to produce turtle for builtin classes */
-	if (is_builtin_class (tracker_resource_get_identifier (resource),
-	                      data->all_namespaces))
-		return;
+	const char *namespace;
 
-	if (g_list_find_custom (data->done_list, resource, (GCompareFunc) tracker_resource_compare) == NULL) {
-		generate_turtle (resource, data);
+	namespace = namespace_cache_lookup (cache, uri_or_curie);
 
-		g_string_append (data->string, "\n");
+	if (namespace == NULL)
+		return g_strdup (uri_or_curie);
 
-		data->done_list = g_list_prepend (data->done_list, resource);
-	}
+	return g_strconcat (namespace, strchr (uri_or_curie, ':') + 1, NULL);
 }
 
-void
-generate_turtle_resources_foreach (gpointer key,
-                                   gpointer value_ptr,
-                                   gpointer user_data)
+static gboolean
+is_blank_node (const char *uri_or_curie_or_blank)
+{
+	return (strncmp(uri_or_curie_or_blank, "_:", 2) == 0);
+}
+
+static gboolean
+is_builtin_class (const gchar    *uri_or_curie,
+                  NamespaceCache *namespaces)
 {
-	const GValue *value = value_ptr;
-	GenerateTurtleData *data = user_data;
+	return (!is_blank_node (uri_or_curie) &&
+	        namespace_cache_lookup (namespaces, uri_or_curie) != NULL);
+}
+
+static gboolean
+is_rdf_type (const char *property)
+{
+	return (strcmp (property, "rdf:type") == 0 ||
+	        strcmp (property, TRACKER_PREFIX_RDF "type") == 0);
+}
+
+typedef struct {
 	TrackerResource *resource;
-	int i;
+	GHashTableIter iter;
+	GPtrArray *array;
+	guint array_index;
+} CollectFrame;
 
-	if (G_VALUE_HOLDS (value, TRACKER_TYPE_RESOURCE)) {
-		resource = g_value_get_object (value);
-		generate_nested_turtle_resource (resource, data);
-	} else if (G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY)) {
-		GPtrArray *array = g_value_get_boxed (value);
-		const GValue *array_value;
+static TrackerResource *
+collect_frame_next_relation (CollectFrame *frame)
+{
+	const GValue *value;
 
-		for (i = 0; i < array->len; i++) {
-			array_value = g_ptr_array_index (array, i);
+	while (TRUE) {
+		if (frame->array) {
+			if (frame->array_index < frame->array->len) {
+				value = g_ptr_array_index (frame->array, frame->array_index);
+				frame->array_index++;
+
+				if (G_VALUE_HOLDS (value, TRACKER_TYPE_RESOURCE))
+					return g_value_get_object (value);
 
-			if (G_VALUE_HOLDS (array_value, TRACKER_TYPE_RESOURCE)) {
-				resource = g_value_get_object (array_value);
-				generate_nested_turtle_resource (resource, data);
+				continue;
 			}
+
+			frame->array = NULL;
+		}
+
+		if (!g_hash_table_iter_next (&frame->iter, NULL, (gpointer *)&value))
+			return NULL;
+
+		if (G_VALUE_HOLDS (value, TRACKER_TYPE_RESOURCE)) {
+			return g_value_get_object (value);
+		} else if (G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY)) {
+			frame->array = g_value_get_boxed (value);
+			frame->array_index = 0;
 		}
 	}
 }
 
 static void
-generate_turtle_uri_value (const char              *uri_or_curie_or_blank,
-                           GString                 *string,
-                           TrackerNamespaceManager *all_namespaces,
-                           TrackerNamespaceManager *our_namespaces)
+collect_frame_push (GArray          *stack,
+                    TrackerResource *resource)
+{
+	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
+	CollectFrame frame = { 0, };
+
+	frame.resource = resource;
+	g_hash_table_iter_init (&frame.iter, priv->properties);
+	g_array_append_val (stack, frame);
+}
+
+/* Returns @resource and all the resources reachable from it, each one
+ * once, with related resources ahead of the resources referring to them.
+ * Resources that are builtin classes (e.g. nfo:Document) are left out,
+ * the ontology describes them already. The walk uses an explicit stack,
+ * so long chains of relations don't exhaust the C stack.
+ */
+static GPtrArray *
+collect_resources (TrackerResource *resource,
+                   NamespaceCache  *namespaces)
+{
+	GPtrArray *resources;
+	GHashTable *visited;
+	GArray *stack;
+
+	resources = g_ptr_array_new ();
+	visited = g_hash_table_new (g_str_hash, g_str_equal);
+	stack = g_array_new (FALSE, FALSE, sizeof (CollectFrame));
+
+	g_hash_table_add (visited, (gpointer) tracker_resource_get_identifier (resource));
+	collect_frame_push (stack, resource);
+
+	while (stack->len > 0) {
+		CollectFrame *frame = &g_array_index (stack, CollectFrame, stack->len - 1);
+		TrackerResource *relation;
+		const char *identifier;
+
+		relation = collect_frame_next_relation (frame);
+
+		if (relation == NULL) {
+			g_ptr_array_add (resources, frame->resource);
+			g_array_set_size (stack, stack->len - 1);
+			continue;
+		}
+
+		identifier = tracker_resource_get_identifier (relation);
+
+		if (is_builtin_class (identifier, namespaces) ||
+		    g_hash_table_contains (visited, identifier))
+			continue;
+
+		g_hash_table_add (visited, (gpointer) identifier);
+		collect_frame_push (stack, relation);
+	}
+
+	g_array_unref (stack);
+	g_hash_table_unref (visited);
+
+	return resources;
+}
+
+static void
+generate_turtle_uri_value (const char     *uri_or_curie_or_blank,
+                           GString        *string,
+                           NamespaceCache *namespaces)
 {
 	/* The tracker_resource_set_uri() function accepts URIs
 	 * (such as http://example.com/) and compact URIs (such as nie:DataObject),
@@ -1072,45 +1252,30 @@ generate_turtle_uri_value (const char              *uri_or_curie_or_blank,
 	 * clearer if we leave them be. We still need to attempt to expand them
 	 * internally in order to know whether they need <> brackets around them.
 	 */
-	if (is_blank_node (uri_or_curie_or_blank)) {
+	if (is_blank_node (uri_or_curie_or_blank) ||
+	    namespace_cache_lookup (namespaces, uri_or_curie_or_blank) != NULL) {
 		g_string_append (string, uri_or_curie_or_blank);
 	} else {
-		char *prefix = g_uri_parse_scheme (uri_or_curie_or_blank);
-
-		if (prefix && tracker_namespace_manager_has_prefix (all_namespaces, prefix)) {
-			/* It's a compact URI and we know the prefix */
-			if (our_namespaces != NULL) {
-				maybe_intern_prefix_of_compact_uri (all_namespaces, our_namespaces, uri_or_curie_or_blank);
-			};
-
-			g_string_append (string, uri_or_curie_or_blank);
-		} else {
-			/* It's a full URI (or something invalid, but we can't really tell that here) */
-			g_string_append_printf (string, "<%s>", uri_or_curie_or_blank);
-		}
-
-		g_free (prefix);
+		/* It's a full URI (or something invalid, but we can't really tell that here) */
+		g_string_append_printf (string, "<%s>", uri_or_curie_or_blank);
 	}
 }
 
 static void
-generate_turtle_value (const GValue            *value,
-                       GString                 *string,
-                       TrackerNamespaceManager *all_namespaces,
-                       TrackerNamespaceManager *our_namespaces)
+generate_turtle_value (const GValue   *value,
+                       GString        *string,
+                       NamespaceCache *namespaces)
 {
 	GType type = G_VALUE_TYPE (value);
 	if (type == TRACKER_TYPE_URI) {
 		generate_turtle_uri_value (g_value_get_string (value),
 		                           string,
-		                           all_namespaces,
-		                           our_namespaces);
+		                           namespaces);
 	} else if (type == TRACKER_TYPE_RESOURCE) {
 		TrackerResource *relation = TRACKER_RESOURCE (g_value_get_object (value));
 		generate_turtle_uri_value (tracker_resource_get_identifier (relation),
 		                           string,
-		                           all_namespaces,
-		                           our_namespaces);
+		                           namespaces);
 	} else if (type == G_TYPE_STRING) {
 		char *escaped = tracker_sparql_escape_string (g_value_get_string (value));
 		g_string_append_printf(string, "\"%s\"", escaped);
@@ -1145,17 +1310,16 @@ generate_turtle_value (const GValue            *value,
 	}
 }
 
-void
-generate_turtle_property (const char              *property,
-                          const GValue            *value,
-                          GString                 *string,
-                          TrackerNamespaceManager *all_namespaces,
-                          TrackerNamespaceManager *our_namespaces)
+static void
+generate_turtle_property (const char     *property,
+                          const GValue   *value,
+                          GString        *string,
+                          NamespaceCache *namespaces)
 {
-	if (strcmp (property, TRACKER_PREFIX_RDF "type") == 0 || strcmp (property, "rdf:type") == 0) {
+	if (is_rdf_type (property)) {
 		g_string_append (string, "a");
 	} else {
-		g_string_append (string, property);
+		generate_turtle_uri_value (property, string, namespaces);
 	}
 
 	g_string_append (string, " ");
@@ -1165,54 +1329,137 @@ generate_turtle_property (const char              *property,
 		if (array->len > 0) {
 			generate_turtle_value (g_ptr_array_index (array, 0),
 			                       string,
-			                       all_namespaces,
-			                       our_namespaces);
+			                       namespaces);
 			for (i = 1; i < array->len; i++) {
 				g_string_append (string, " , ");
 				generate_turtle_value (g_ptr_array_index (array, i),
 				                       string,
-				                       all_namespaces,
-				                       our_namespaces);
+				                       namespaces);
 			}
 		}
 	} else {
-		generate_turtle_value (value, string, all_namespaces, our_namespaces);
+		generate_turtle_value (value, string, namespaces);
 	}
 }
 
-void
-generate_turtle (TrackerResource    *resource,
-                 GenerateTurtleData *data)
+static void
+generate_turtle (TrackerResource *resource,
+                 GString         *string,
+                 NamespaceCache  *namespaces)
 {
 	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
 	GHashTableIter iter;
 	const char *property;
 	const GValue *value;
+	gboolean had_property = FALSE;
 
-	/* First we recurse to any relations that aren't already in the done list */
-	g_hash_table_foreach (priv->properties, generate_turtle_resources_foreach, data);
-
-	generate_turtle_uri_value (tracker_resource_get_identifier(resource),
-	        data->string, data->all_namespaces, data->our_namespaces);
-	g_string_append (data->string, " ");
+	generate_turtle_uri_value (priv->identifier, string, namespaces);
+	g_string_append (string, " ");
 
 	g_hash_table_iter_init (&iter, priv->properties);
-	if (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value)) {
-		while (TRUE) {
-			generate_turtle_property (property, value, data->string, data->all_namespaces, data->our_namespaces);
+	while (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value)) {
+		if (had_property) {
+			g_string_append (string, " ;\n  ");
+		}
+
+		generate_turtle_property (property, value, string, namespaces);
+		had_property = TRUE;
+	}
+
+	g_string_append (string, " .\n");
+}
+
+static void
+lookup_turtle_value_prefix (const GValue   *value,
+                            NamespaceCache *namespaces)
+{
+	if (G_VALUE_HOLDS (value, TRACKER_TYPE_URI)) {
+		namespace_cache_lookup (namespaces, g_value_get_string (value));
+	} else if (G_VALUE_HOLDS (value, TRACKER_TYPE_RESOURCE)) {
+		namespace_cache_lookup (namespaces,
+		                        tracker_resource_get_identifier (g_value_get_object (value)));
+	}
+}
+
+/* Turtle declares prefixes upfront, this records the ones the
+ * document is going to use before anything is written.
+ */
+static void
+lookup_turtle_prefixes (GPtrArray      *resources,
+                        NamespaceCache *namespaces)
+{
+	guint i, j;
+
+	for (i = 0; i < resources->len; i++) {
+		TrackerResourcePrivate *priv = GET_PRIVATE (g_ptr_array_index (resources, i));
+		GHashTableIter iter;
+		const char *property;
+		const GValue *value;
 
-			maybe_intern_prefix_of_compact_uri (data->all_namespaces, data->our_namespaces, property);
+		if (g_hash_table_size (priv->properties) == 0)
+			continue;
 
-			if (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value)) {
-				g_string_append (data->string, " ;\n  ");
+		namespace_cache_lookup (namespaces, priv->identifier);
+
+		g_hash_table_iter_init (&iter, priv->properties);
+		while (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value)) {
+			namespace_cache_lookup (namespaces, property);
+
+			if (G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY)) {
+				GPtrArray *array = g_value_get_boxed (value);
+
+				for (j = 0; j < array->len; j++)
+					lookup_turtle_value_prefix (g_ptr_array_index (array, j), namespaces);
 			} else {
-				g_string_append (data->string, " .\n");
-				break;
+				lookup_turtle_value_prefix (value, namespaces);
 			}
 		}
 	}
 }
 
+static void
+write_turtle (TrackerResource         *self,
+              TrackerNamespaceManager *namespaces,
+              ResourceWriter          *writer)
+{
+	TrackerResourcePrivate *priv = GET_PRIVATE (self);
+	NamespaceCache cache;
+	GPtrArray *resources;
+	char *prefixes;
+	guint i;
+
+	if (g_hash_table_size (priv->properties) == 0) {
+		return;
+	}
+
+	namespace_cache_init (&cache, namespaces, TRUE);
+	resources = collect_resources (self, &cache);
+
+	lookup_turtle_prefixes (resources, &cache);
+
+	prefixes = tracker_namespace_manager_print_turtle (cache.our_namespaces);
+	g_string_append (writer->buffer, prefixes);
+	g_string_append (writer->buffer, "\n");
+	g_free (prefixes);
+
+	for (i = 0; i < resources->len && writer_check (writer); i++) {
+		TrackerResource *resource = g_ptr_array_index (resources, i);
+
+		if (g_hash_table_size (GET_PRIVATE (resource)->properties) == 0)
+			continue;
+
+		generate_turtle (resource, writer->buffer, &cache);
+
+		/* Related resources are separated by a blank line */
+		if (resource != self) {
+			g_string_append (writer->buffer, "\n");
+		}
+	}
+
+	g_ptr_array_unref (resources);
+	namespace_cache_clear (&cache);
+}
+
 /**
  * tracker_resource_print_turtle:
  * @self: a #TrackerResource
@@ -1237,118 +1484,50 @@ char *
 tracker_resource_print_turtle (TrackerResource         *self,
                                TrackerNamespaceManager *namespaces)
 {
-	TrackerResourcePrivate *priv;
-	GenerateTurtleData context;
-	char *prefixes;
+	ResourceWriter writer;
 
 	g_return_val_if_fail (TRACKER_IS_RESOURCE (self), "");
 
-	priv = GET_PRIVATE (self);
-
-	if (namespaces == NULL) {
-		namespaces = tracker_namespace_manager_get_default ();
-	}
-
-	if (g_hash_table_size (priv->properties) == 0) {
-		return g_strdup("");
-	}
-
-	context.all_namespaces = namespaces;
-	context.our_namespaces = tracker_namespace_manager_new ();
-	context.string = g_string_new ("");
-	context.done_list = NULL;
-
-	maybe_intern_prefix_of_compact_uri (context.all_namespaces, context.our_namespaces, tracker_resource_get_identifier(self));
-
-	generate_turtle (self, &context);
-
-	prefixes = tracker_namespace_manager_print_turtle (context.our_namespaces);
-	g_string_prepend (context.string, "\n");
-	g_string_prepend (context.string, prefixes);
-
-	g_object_unref (context.our_namespaces);
-	g_free (prefixes);
-
-	g_list_free (context.done_list);
+	writer_init (&writer, NULL, NULL);
+	write_turtle (self, namespaces, &writer);
 
-	return g_string_free (context.string, FALSE);
+	return writer_steal (&writer);
 }
 
-typedef struct {
-	TrackerNamespaceManager *namespaces;
-	GString *string;
-	const char *graph_id;
-	GList *done_list;
-} GenerateSparqlData;
-
-static void generate_sparql_deletes (TrackerResource *resource, GenerateSparqlData *data);
-static void generate_sparql_insert_pattern (TrackerResource *resource, GenerateSparqlData *data);
-
-static void
-generate_sparql_relation_deletes_foreach (gpointer key,
-                                          gpointer value_ptr,
-                                          gpointer user_data)
-{
-	const GValue *value = value_ptr;
-	GenerateSparqlData *data = user_data;
-
-	if (G_VALUE_HOLDS (value, TRACKER_TYPE_RESOURCE)) {
-		TrackerResource *relation = g_value_get_object (value);
-
-		if (g_list_find_custom (data->done_list, relation, (GCompareFunc) tracker_resource_compare) == NULL) {
-			generate_sparql_deletes (relation, data);
-			data->done_list = g_list_prepend (data->done_list, relation);
-		}
-	}
-}
-
-static void
-generate_sparql_relation_inserts_foreach (gpointer key,
-                                          gpointer value_ptr,
-                                          gpointer user_data)
+/**
+ * tracker_resource_write_turtle:
+ * @self: a #TrackerResource
+ * @namespaces: (allow-none): a set of prefixed URLs, or %NULL to use the
+ *     default set
+ * @stream: a #GOutputStream to write to
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: #GError for error reporting
+ *
+ * Writes the same Turtle document as tracker_resource_print_turtle() to
+ * @stream. The document is written as it is generated, in chunks of a
+ * few kilobytes, so large graphs of resources are never held in memory
+ * as text.
+ *
+ * Returns: %TRUE on success, %FALSE if writing to @stream failed
+ *
+ * Since: 2.2
+ */
+gboolean
+tracker_resource_write_turtle (TrackerResource          *self,
+                               TrackerNamespaceManager  *namespaces,
+                               GOutputStream            *stream,
+                               GCancellable             *cancellable,
+                               GError                  **error)
 {
-	const GValue *value = value_ptr;
-	GenerateSparqlData *data = user_data;
-
-	if (G_VALUE_HOLDS (value, TRACKER_TYPE_RESOURCE)) {
-		TrackerResource *relation = g_value_get_object (value);
+	ResourceWriter writer;
 
-		/* We don't need to produce inserts for builtin classes */
-		if (is_builtin_class (tracker_resource_get_identifier (relation),
-		                      data->namespaces))
-			return;
+	g_return_val_if_fail (TRACKER_IS_RESOURCE (self), FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
 
-		if (g_list_find_custom (data->done_list, relation, (GCompareFunc) tracker_resource_compare) == NULL) {
-			generate_sparql_insert_pattern (relation, data);
-			data->done_list = g_list_prepend (data->done_list, relation);
-		}
-	} else if (G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY)) {
-		GPtrArray *array = g_value_get_boxed (value);
-		const GValue *array_value;
-		TrackerResource *relation;
-		gint i;
-
-		for (i = 0; i < array->len; i++) {
-			array_value = g_ptr_array_index (array, i);
-
-			if (!G_VALUE_HOLDS (array_value, TRACKER_TYPE_RESOURCE))
-				continue;
+	writer_init (&writer, stream, cancellable);
+	write_turtle (self, namespaces, &writer);
 
-			relation = g_value_get_object (array_value);
-
-			/* We don't need to produce inserts for builtin classes */
-			if (is_builtin_class (tracker_resource_get_identifier (relation),
-					      data->namespaces))
-				continue;
-
-			if (g_list_find_custom (data->done_list, relation,
-						(GCompareFunc) tracker_resource_compare) != NULL)
-				continue;
-
-			generate_sparql_insert_pattern (relation, data);
-			data->done_list = g_list_prepend (data->done_list, relation);
-		}
-	}
+	return writer_finish (&writer, error);
 }
 
 static char *
@@ -1359,9 +1538,10 @@ variable_name_for_property (const char *property) {
 }
 
 static void
-generate_sparql_delete_queries (TrackerResource     *resource,
-                                GHashTable          *overwrite_flags,
-                                GenerateSparqlData  *data)
+generate_sparql_delete_queries (TrackerResource *resource,
+                                GString         *string,
+                                NamespaceCache  *namespaces,
+                                const char      *graph_id)
 {
 	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
 	GHashTableIter iter;
@@ -1373,87 +1553,121 @@ generate_sparql_delete_queries (TrackerResource     *resource,
 		/* Whether to generate the DELETE is based on whether set_value was ever
 		* called for this property. That's tracked in the overwrite_flags hash table.
 		*/
-		if (g_hash_table_lookup (overwrite_flags, property)) {
+		if (g_hash_table_lookup (priv->overwrite, property)) {
 			char *variable_name = variable_name_for_property (property);
 
-			g_string_append (data->string, "DELETE WHERE {\n");
+			g_string_append (string, "DELETE WHERE {\n");
 
-			if (data->graph_id) {
-				g_string_append_printf (data->string, "GRAPH <%s> {\n", data->graph_id);
+			if (graph_id) {
+				g_string_append_printf (string, "GRAPH <%s> {\n", graph_id);
 			}
 
-			g_string_append (data->string, "  ");
-			generate_turtle_uri_value (priv->identifier, data->string, data->namespaces, NULL);
-			g_string_append_printf (data->string, " %s ?%s }", property, variable_name);
+			g_string_append (string, "  ");
+			generate_turtle_uri_value (priv->identifier, string, namespaces);
+			g_string_append (string, " ");
+			generate_turtle_uri_value (property, string, namespaces);
+			g_string_append_printf (string, " ?%s }", variable_name);
 			g_free (variable_name);
 
-			if (data->graph_id) {
-				g_string_append (data->string, " }");
+			if (graph_id) {
+				g_string_append (string, " }");
 			}
 
-			g_string_append (data->string, ";\n");
+			g_string_append (string, ";\n");
 		}
 	}
 }
 
-void
-generate_sparql_deletes (TrackerResource    *resource,
-                         GenerateSparqlData *data)
-{
-	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
-
-	if (! is_blank_node (priv->identifier) && g_hash_table_size (priv->overwrite) > 0) {
-		generate_sparql_delete_queries (resource, priv->overwrite, data);
-	}
-
-	/* Now emit any sub-resources. */
-	g_hash_table_foreach (priv->properties, generate_sparql_relation_deletes_foreach, data);
-}
-
 static void
-generate_sparql_insert_pattern (TrackerResource    *resource,
-                                GenerateSparqlData *data)
+generate_sparql_insert_pattern (TrackerResource *resource,
+                                GString         *string,
+                                NamespaceCache  *namespaces)
 {
 	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
 	GHashTableIter iter;
 	const char *property;
-	char *full_property;
 	const GValue *value;
 	gboolean had_property = FALSE;
+	guint pass;
 
-	/* First, emit any sub-resources. */
-	g_hash_table_foreach (priv->properties, generate_sparql_relation_inserts_foreach, data);
-
-	generate_turtle_uri_value (priv->identifier, data->string, data->namespaces, NULL);
-	g_string_append_printf (data->string, " ");
+	generate_turtle_uri_value (priv->identifier, string, namespaces);
+	g_string_append_printf (string, " ");
 
 	/* rdf:type needs to be first, otherwise you'll see 'subject x is not in domain y'
 	 * errors for the properties you try to set.
 	 */
-	value = g_hash_table_lookup (priv->properties, "rdf:type");
-	if (value != NULL) {
-		generate_turtle_property ("a", value, data->string, data->namespaces, NULL);
-		had_property = TRUE;
-	}
-
-	g_hash_table_iter_init (&iter, priv->properties);
-	while (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value)) {
-		full_property = tracker_namespace_manager_expand_uri (data->namespaces, property);
+	for (pass = 0; pass < 2; pass++) {
+		g_hash_table_iter_init (&iter, priv->properties);
+		while (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value)) {
+			if (is_rdf_type (property) != (pass == 0))
+				continue;
 
-		if (strcmp (full_property, TRACKER_PREFIX_RDF "type") != 0 && strcmp (property, "rdf:type") != 0) {
 			if (had_property) {
-				g_string_append (data->string, " ; \n  ");
+				g_string_append (string, " ; \n  ");
 			}
 
-			generate_turtle_property (property, value, data->string, data->namespaces, NULL);
-
+			generate_turtle_property (property, value, string, namespaces);
 			had_property = TRUE;
 		}
+	}
+
+	g_string_append (string, " .\n");
+}
 
-		g_free (full_property);
+static void
+write_sparql_update (TrackerResource         *self,
+                     TrackerNamespaceManager *namespaces,
+                     const char              *graph_id,
+                     ResourceWriter          *writer)
+{
+	TrackerResourcePrivate *priv = GET_PRIVATE (self);
+	NamespaceCache cache;
+	GPtrArray *resources;
+	guint i;
+
+	if (g_hash_table_size (priv->properties) == 0) {
+		return;
+	}
+
+	namespace_cache_init (&cache, namespaces, FALSE);
+	resources = collect_resources (self, &cache);
+
+	/* Delete the existing data. If we don't do this, we may get constraint
+	 * violations due to trying to add a second value to a single-valued
+	 * property, and we may get old metadata hanging around.
+	 */
+	for (i = 0; i < resources->len && writer_check (writer); i++) {
+		TrackerResource *resource = g_ptr_array_index (resources, i);
+		TrackerResourcePrivate *resource_priv = GET_PRIVATE (resource);
+
+		if (! is_blank_node (resource_priv->identifier) &&
+		    g_hash_table_size (resource_priv->overwrite) > 0) {
+			generate_sparql_delete_queries (resource, writer->buffer, &cache, graph_id);
+		}
+	}
+
+	/* Finally insert the data */
+	g_string_append (writer->buffer, "INSERT {\n");
+	if (graph_id) {
+		g_string_append_printf (writer->buffer, "GRAPH <%s> {\n", graph_id);
+	}
+
+	for (i = 0; i < resources->len && writer_check (writer); i++) {
+		TrackerResource *resource = g_ptr_array_index (resources, i);
+
+		if (g_hash_table_size (GET_PRIVATE (resource)->properties) == 0)
+			continue;
+
+		generate_sparql_insert_pattern (resource, writer->buffer, &cache);
+	}
+
+	if (graph_id) {
+		g_string_append (writer->buffer, "}\n");
 	}
+	g_string_append (writer->buffer, "};\n");
 
-	g_string_append (data->string, " .\n");
+	g_ptr_array_unref (resources);
+	namespace_cache_clear (&cache);
 }
 
 /**
@@ -1481,164 +1695,513 @@ tracker_resource_print_sparql_update (TrackerResource         *resource,
                                       TrackerNamespaceManager *namespaces,
                                       const char              *graph_id)
 {
-	TrackerResourcePrivate *priv;
-	GenerateSparqlData context;
+	ResourceWriter writer;
 
 	g_return_val_if_fail (TRACKER_IS_RESOURCE (resource), "");
 
-	priv = GET_PRIVATE(resource);
+	writer_init (&writer, NULL, NULL);
+	write_sparql_update (resource, namespaces, graph_id, &writer);
 
-	if (namespaces == NULL) {
-		namespaces = tracker_namespace_manager_get_default ();
+	return writer_steal (&writer);
+}
+
+/**
+ * tracker_resource_write_sparql_update:
+ * @self: a #TrackerResource
+ * @namespaces: (allow-none): a set of prefixed URLs, or %NULL to use the
+ *     default set
+ * @graph_id: (allow-none): the URN of the graph the data should be added to,
+ *     or %NULL
+ * @stream: a #GOutputStream to write to
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: #GError for error reporting
+ *
+ * Writes the same SPARQL update as tracker_resource_print_sparql_update()
+ * to @stream, in chunks of a few kilobytes as it is generated.
+ *
+ * Returns: %TRUE on success, %FALSE if writing to @stream failed
+ *
+ * Since: 2.2
+ */
+gboolean
+tracker_resource_write_sparql_update (TrackerResource          *self,
+                                      TrackerNamespaceManager  *namespaces,
+                                      const char               *graph_id,
+                                      GOutputStream            *stream,
+                                      GCancellable             *cancellable,
+                                      GError                  **error)
+{
+	ResourceWriter writer;
+
+	g_return_val_if_fail (TRACKER_IS_RESOURCE (self), FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+
+	writer_init (&writer, stream, cancellable);
+	write_sparql_update (self, namespaces, graph_id, &writer);
+
+	return writer_finish (&writer, error);
+}
+
+typedef struct {
+	NamespaceCache *namespaces;
+	GVariantBuilder *builder;
+} GenerateStatementsData;
+
+static void
+add_statement (GenerateStatementsData *data,
+               guchar                  op,
+               const char             *subject,
+               const char             *predicate,
+               const char             *object)
+{
+	g_variant_builder_add (data->builder, "(ysss)", op, subject, predicate, object);
+}
+
+static void
+generate_statement_value (const char             *subject,
+                          const char             *predicate,
+                          const GValue           *value,
+                          GenerateStatementsData *data)
+{
+	GType type = G_VALUE_TYPE (value);
+
+	if (type == TRACKER_TYPE_URI || type == TRACKER_TYPE_RESOURCE) {
+		const char *uri;
+		char *object;
+
+		if (type == TRACKER_TYPE_URI)
+			uri = g_value_get_string (value);
+		else
+			uri = tracker_resource_get_identifier (g_value_get_object (value));
+
+		/* Blank node labels are kept, the receiving end maps them to
+		 * fresh URNs the same way it does for SPARQL updates.
+		 */
+		object = is_blank_node (uri) ? g_strdup (uri) : namespace_cache_expand (data->namespaces, uri);
+		add_statement (data, TRACKER_RESOURCE_STATEMENT_INSERT_URI, subject, predicate, object);
+		g_free (object);
+	} else if (type == G_TYPE_STRING) {
+		add_statement (data, TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL,
+		               subject, predicate, g_value_get_string (value));
+	} else if (type == G_TYPE_BOOLEAN) {
+		add_statement (data, TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL,
+		               subject, predicate, g_value_get_boolean (value) ? "true" : "false");
+	} else if (type == G_TYPE_DATE) {
+		char date_string[256];
+		g_date_strftime (date_string, 256, "%Y-%m-%d%z", g_value_get_boxed (value));
+		add_statement (data, TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL,
+		               subject, predicate, date_string);
+	} else if (type == G_TYPE_DATE_TIME) {
+		char *datetime_string;
+		datetime_string = g_date_time_format (g_value_get_boxed (value), "%Y-%m-%dT%H:%M:%S%z");
+		add_statement (data, TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL,
+		               subject, predicate, datetime_string);
+		g_free (datetime_string);
+	} else if (type == G_TYPE_DOUBLE || type == G_TYPE_FLOAT) {
+		/* We can't use GValue transformations here; they're locale-dependent. */
+		char buffer[256];
+		g_ascii_dtostr (buffer, 255, g_value_get_double (value));
+		add_statement (data, TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL,
+		               subject, predicate, buffer);
+	} else if (type == G_TYPE_PTR_ARRAY) {
+		GPtrArray *array = g_value_get_boxed (value);
+		guint i;
+
+		for (i = 0; i < array->len; i++)
+			generate_statement_value (subject, predicate, g_ptr_array_index (array, i), data);
+	} else {
+		GValue str_value = G_VALUE_INIT;
+		g_value_init (&str_value, G_TYPE_STRING);
+		if (g_value_transform (value, &str_value)) {
+			add_statement (data, TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL,
+			               subject, predicate, g_value_get_string (&str_value));
+		} else {
+			g_warning ("Cannot serialize value of type %s to statements",
+			            G_VALUE_TYPE_NAME (value));
+		}
+		g_value_unset (&str_value);
 	}
+}
 
-	if (g_hash_table_size (priv->properties) == 0) {
-		return g_strdup("");
+static void
+generate_statement_deletes (TrackerResource        *resource,
+                            GenerateStatementsData *data)
+{
+	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
+	GHashTableIter iter;
+	const char *property;
+	char *subject;
+
+	if (is_blank_node (priv->identifier) || g_hash_table_size (priv->overwrite) == 0)
+		return;
+
+	subject = namespace_cache_expand (data->namespaces, priv->identifier);
+
+	g_hash_table_iter_init (&iter, priv->properties);
+	while (g_hash_table_iter_next (&iter, (gpointer *)&property, NULL)) {
+		char *predicate;
+
+		if (!g_hash_table_lookup (priv->overwrite, property))
+			continue;
+
+		predicate = namespace_cache_expand (data->namespaces, property);
+		add_statement (data, TRACKER_RESOURCE_STATEMENT_DELETE_ALL,
+		               subject, predicate, "");
+		g_free (predicate);
 	}
 
-	context.namespaces = namespaces;
-	context.string = g_string_new (NULL);
-	context.graph_id = graph_id;
+	g_free (subject);
+}
 
-	/* Resources can be recursive, and may have repeated or even cyclic
-	 * relationships. This list keeps track of what we already processed.
-	 */
-	context.done_list = NULL;
+static void
+generate_statement_inserts (TrackerResource        *resource,
+                            GenerateStatementsData *data)
+{
+	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
+	GHashTableIter iter;
+	const char *property;
+	const GValue *value;
+	char *subject;
+	guint pass;
 
-	/* Delete the existing data. If we don't do this, we may get constraint
-	 * violations due to trying to add a second value to a single-valued
-	 * property, and we may get old metadata hanging around.
+	subject = is_blank_node (priv->identifier) ?
+		g_strdup (priv->identifier) :
+		namespace_cache_expand (data->namespaces, priv->identifier);
+
+	/* rdf:type needs to be first, otherwise the properties are not
+	 * in the domain of the resource yet.
 	 */
-	generate_sparql_deletes (resource, &context);
+	for (pass = 0; pass < 2; pass++) {
+		g_hash_table_iter_init (&iter, priv->properties);
+		while (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value)) {
+			char *predicate;
 
-	g_list_free (context.done_list);
-	context.done_list = NULL;
+			predicate = namespace_cache_expand (data->namespaces, property);
 
-	/* Finally insert the data */
-	g_string_append (context.string, "INSERT {\n");
-	if (graph_id) {
-		g_string_append_printf (context.string, "GRAPH <%s> {\n", graph_id);
+			if ((strcmp (predicate, TRACKER_PREFIX_RDF "type") == 0) == (pass == 0))
+				generate_statement_value (subject, predicate, value, data);
+
+			g_free (predicate);
+		}
 	}
 
-	generate_sparql_insert_pattern (resource, &context);
+	g_free (subject);
+}
 
-	if (graph_id) {
-		g_string_append (context.string, "}\n");
+/**
+ * tracker_resource_serialize_statements:
+ * @self: a #TrackerResource
+ * @namespaces: (allow-none): a set of prefixed URLs, or %NULL to use the
+ *     default set
+ *
+ * Flattens the information stored in @resource into a list of statements,
+ * with the same semantics as the update generated by
+ * tracker_resource_print_sparql_update().
+ *
+ * The returned #GVariant has type `a(ysss)`; each element holds a
+ * #TrackerResourceStatementOp, the subject, the predicate and the object.
+ * All compact URIs are expanded using @namespaces, blank node identifiers
+ * are kept as-is. Deletions for properties that were set with the
+ * tracker_resource_set_ functions come first, followed by insertions,
+ * sub-resources before the resources referencing them.
+ *
+ * This is meant for feeding resources to a store without producing and
+ * parsing SPARQL text, see tracker_sparql_connection_update_resources().
+ *
+ * Returns: (transfer floating): a #GVariant of type `a(ysss)`
+ *
+ * Since: 2.2
+ */
+GVariant *
+tracker_resource_serialize_statements (TrackerResource         *self,
+                                       TrackerNamespaceManager *namespaces)
+{
+	TrackerResourcePrivate *priv;
+	GenerateStatementsData context;
+	GVariantBuilder builder;
+	NamespaceCache cache;
+	GPtrArray *resources;
+	guint i;
+
+	g_return_val_if_fail (TRACKER_IS_RESOURCE (self), NULL);
+
+	priv = GET_PRIVATE (self);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ysss)"));
+
+	if (g_hash_table_size (priv->properties) == 0) {
+		return g_variant_builder_end (&builder);
 	}
-	g_string_append (context.string, "};\n");
 
-	g_list_free (context.done_list);
-	context.done_list = NULL;
+	namespace_cache_init (&cache, namespaces, FALSE);
+	resources = collect_resources (self, &cache);
+
+	context.namespaces = &cache;
+	context.builder = &builder;
+
+	for (i = 0; i < resources->len; i++)
+		generate_statement_deletes (g_ptr_array_index (resources, i), &context);
+
+	for (i = 0; i < resources->len; i++)
+		generate_statement_inserts (g_ptr_array_index (resources, i), &context);
+
+	g_ptr_array_unref (resources);
+	namespace_cache_clear (&cache);
 
-	return g_string_free (context.string, FALSE);
+	return g_variant_builder_end (&builder);
 }
 
 typedef struct {
-	TrackerNamespaceManager *all_namespaces, *our_namespaces;
-	JsonBuilder *builder;
-	GList *done_list;
+	NamespaceCache namespaces;
+	GHashTable *visited;
+	ResourceWriter *writer;
 } GenerateJsonldData;
 
-static void generate_jsonld_foreach (gpointer key, gpointer value_ptr, gpointer user_data);
-
 static void
-tracker_resource_generate_jsonld (TrackerResource    *self,
-                                  GenerateJsonldData *data)
+generate_jsonld_indent (GString *string,
+                        guint    level)
 {
-	TrackerResourcePrivate *priv = GET_PRIVATE (self);
-	JsonBuilder *builder = data->builder;
+	guint i;
 
-	/* The JSON-LD spec says it is "important that nodes have an identifier", but
-	 * doesn't mandate one. I think it's better to omit the ID for blank nodes
-	 * (where the caller passed NULL as an identifier) than to emit something
-	 * SPARQL-specific like '_:123'.
-	 */
-	if (strncmp (priv->identifier, "_:", 2) != 0) {
-		json_builder_set_member_name (builder, "@id");
-		json_builder_add_string_value (builder, priv->identifier);
+	for (i = 0; i < level; i++)
+		g_string_append (string, "  ");
+}
+
+static void
+generate_jsonld_string (GString    *string,
+                        const char *str)
+{
+	const char *p;
+
+	g_string_append_c (string, '"');
+
+	for (p = str; *p; p++) {
+		switch (*p) {
+		case '"':
+			g_string_append (string, "\\\"");
+			break;
+		case '\\':
+			g_string_append (string, "\\\\");
+			break;
+		case '\b':
+			g_string_append (string, "\\b");
+			break;
+		case '\f':
+			g_string_append (string, "\\f");
+			break;
+		case '\n':
+			g_string_append (string, "\\n");
+			break;
+		case '\r':
+			g_string_append (string, "\\r");
+			break;
+		case '\t':
+			g_string_append (string, "\\t");
+			break;
+		default:
+			if ((guchar) *p < 0x20)
+				g_string_append_printf (string, "\\u%04x", (guint) *p);
+			else
+				g_string_append_c (string, *p);
+			break;
+		}
 	}
 
-	g_hash_table_foreach (priv->properties, generate_jsonld_foreach, data);
-};
+	g_string_append_c (string, '"');
+}
+
+static void generate_jsonld_object (TrackerResource *resource, guint level, gboolean toplevel, GenerateJsonldData *data);
 
 static void
 generate_jsonld_value (const GValue       *value,
+                       guint               level,
                        GenerateJsonldData *data)
 {
-	JsonNode *node;
+	GString *string = data->writer->buffer;
+	GType type = G_VALUE_TYPE (value);
 
-	if (G_VALUE_HOLDS (value, TRACKER_TYPE_RESOURCE)) {
+	if (type == TRACKER_TYPE_RESOURCE) {
 		TrackerResource *resource;
+		const char *identifier;
 
 		resource = TRACKER_RESOURCE (g_value_get_object (value));
+		identifier = tracker_resource_get_identifier (resource);
 
-		if (g_list_find_custom (data->done_list, resource, (GCompareFunc) tracker_resource_compare) == NULL) {
-			json_builder_begin_object (data->builder);
-
-			tracker_resource_generate_jsonld (resource, data);
-
-			json_builder_end_object (data->builder);
-
-			data->done_list = g_list_prepend (data->done_list, resource);
+		if (!g_hash_table_contains (data->visited, identifier)) {
+			g_hash_table_add (data->visited, (gpointer) identifier);
+			generate_jsonld_object (resource, level, FALSE, data);
 		} else {
-			json_builder_add_string_value (data->builder, tracker_resource_get_identifier(resource));
+			generate_jsonld_string (string, identifier);
 		}
-	} else if (G_VALUE_HOLDS (value, TRACKER_TYPE_URI)) {
+	} else if (type == TRACKER_TYPE_URI) {
 		/* URIs can be treated the same as strings in JSON-LD provided the @context
-		 * sets the type of that property correctly. However, json_node_set_value()
-		 * will reject a GValue holding TRACKER_TYPE_URI, so we have to extract the
-		 * string manually here.
+		 * sets the type of that property correctly.
 		 */
 		const char *uri = g_value_get_string (value);
-		maybe_intern_prefix_of_compact_uri (data->all_namespaces, data->our_namespaces, uri);
-		node = json_node_new (JSON_NODE_VALUE);
-		json_node_set_string (node, uri);
-		json_builder_add_value (data->builder, node);
+		namespace_cache_lookup (&data->namespaces, uri);
+		generate_jsonld_string (string, uri);
+	} else if (type == G_TYPE_STRING) {
+		generate_jsonld_string (string, g_value_get_string (value));
+	} else if (type == G_TYPE_BOOLEAN) {
+		g_string_append (string, g_value_get_boolean (value) ? "true" : "false");
+	} else if (type == G_TYPE_INT || type == G_TYPE_INT64 ||
+	           type == G_TYPE_UINT || type == G_TYPE_UINT64 ||
+	           type == G_TYPE_LONG || type == G_TYPE_ULONG) {
+		GValue str_value = G_VALUE_INIT;
+		g_value_init (&str_value, G_TYPE_STRING);
+		g_value_transform (value, &str_value);
+		g_string_append (string, g_value_get_string (&str_value));
+		g_value_unset (&str_value);
+	} else if (type == G_TYPE_DOUBLE || type == G_TYPE_FLOAT) {
+		char buffer[G_ASCII_DTOSTR_BUF_SIZE];
+		g_ascii_dtostr (buffer, sizeof (buffer), g_value_get_double (value));
+		g_string_append (string, buffer);
+	} else if (type == G_TYPE_DATE) {
+		char date_string[256];
+		g_date_strftime (date_string, 256, "%Y-%m-%d%z", g_value_get_boxed (value));
+		generate_jsonld_string (string, date_string);
+	} else if (type == G_TYPE_DATE_TIME) {
+		char *datetime_string;
+		datetime_string = g_date_time_format (g_value_get_boxed (value), "%Y-%m-%dT%H:%M:%S%z");
+		generate_jsonld_string (string, datetime_string);
+		g_free (datetime_string);
 	} else {
-		node = json_node_new (JSON_NODE_VALUE);
-		json_node_set_value (node, value);
-		json_builder_add_value (data->builder, node);
+		GValue str_value = G_VALUE_INIT;
+		g_value_init (&str_value, G_TYPE_STRING);
+		if (g_value_transform (value, &str_value)) {
+			generate_jsonld_string (string, g_value_get_string (&str_value));
+		} else {
+			g_warning ("Cannot serialize value of type %s to JSON-LD",
+			            G_VALUE_TYPE_NAME (value));
+			g_string_append (string, "null");
+		}
+		g_value_unset (&str_value);
 	}
 }
 
 static void
-generate_jsonld_foreach (gpointer key,
-                         gpointer value_ptr,
-                         gpointer user_data)
+generate_jsonld_member_name (GString    *string,
+                             const char *name,
+                             guint       level,
+                             gboolean   *first)
 {
-	const char *property = key;
-	const GValue *value = value_ptr;
-	GenerateJsonldData *data = user_data;
-	JsonBuilder *builder = data->builder;
+	if (!*first)
+		g_string_append (string, ",\n");
 
-	if (strcmp (property, "rdf:type") == 0) {
-		property = "@type";
-	} else {
-		maybe_intern_prefix_of_compact_uri (data->all_namespaces, data->our_namespaces, property);
+	*first = FALSE;
+
+	generate_jsonld_indent (string, level);
+	generate_jsonld_string (string, name);
+	g_string_append (string, " : ");
+}
+
+static void
+generate_jsonld_object (TrackerResource    *resource,
+                        guint               level,
+                        gboolean            toplevel,
+                        GenerateJsonldData *data)
+{
+	TrackerResourcePrivate *priv = GET_PRIVATE (resource);
+	GString *string = data->writer->buffer;
+	GHashTableIter iter;
+	const char *property;
+	const GValue *value;
+	gboolean first = TRUE;
+
+	g_string_append (string, "{\n");
+
+	/* The JSON-LD spec says it is "important that nodes have an identifier", but
+	 * doesn't mandate one. I think it's better to omit the ID for blank nodes
+	 * (where the caller passed NULL as an identifier) than to emit something
+	 * SPARQL-specific like '_:123'.
+	 */
+	if (!is_blank_node (priv->identifier)) {
+		generate_jsonld_member_name (string, "@id", level + 1, &first);
+		generate_jsonld_string (string, priv->identifier);
 	}
 
-	json_builder_set_member_name (builder, property);
+	g_hash_table_iter_init (&iter, priv->properties);
+	while (g_hash_table_iter_next (&iter, (gpointer *)&property, (gpointer *)&value) &&
+	       writer_check (data->writer)) {
+		if (is_rdf_type (property)) {
+			property = "@type";
+		} else {
+			namespace_cache_lookup (&data->namespaces, property);
+		}
 
-	if (G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY)) {
-		json_builder_begin_array (builder);
-		g_ptr_array_foreach (g_value_get_boxed (value), (GFunc) generate_jsonld_value, data);
-		json_builder_end_array (builder);
-	} else {
-		generate_jsonld_value (value, data);
+		generate_jsonld_member_name (string, property, level + 1, &first);
+
+		if (G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY)) {
+			GPtrArray *array = g_value_get_boxed (value);
+			guint i;
+
+			g_string_append (string, "[\n");
+
+			for (i = 0; i < array->len; i++) {
+				if (i > 0)
+					g_string_append (string, ",\n");
+
+				generate_jsonld_indent (string, level + 2);
+				generate_jsonld_value (g_ptr_array_index (array, i), level + 2, data);
+			}
+
+			g_string_append (string, "\n");
+			generate_jsonld_indent (string, level + 1);
+			g_string_append (string, "]");
+		} else {
+			generate_jsonld_value (value, level + 1, data);
+		}
 	}
+
+	if (toplevel) {
+		gboolean first_prefix = TRUE;
+		GHashTableIter prefix_iter;
+		const char *prefix, *namespace;
+
+		/* All prefixes in use were looked up by now, so the
+		 * context can be written last.
+		 */
+		generate_jsonld_member_name (string, "@context", level + 1, &first);
+		g_string_append (string, "{\n");
+
+		g_hash_table_iter_init (&prefix_iter, data->namespaces.prefixes);
+		while (g_hash_table_iter_next (&prefix_iter, (gpointer *)&prefix, (gpointer *)&namespace)) {
+			if (namespace[0] == '\0')
+				continue;
+
+			generate_jsonld_member_name (string, prefix, level + 2, &first_prefix);
+			generate_jsonld_string (string, namespace);
+		}
+
+		g_string_append (string, "\n");
+		generate_jsonld_indent (string, level + 1);
+		g_string_append (string, "}");
+	}
+
+	g_string_append (string, "\n");
+	generate_jsonld_indent (string, level);
+	g_string_append (string, "}");
 }
 
 static void
-generate_jsonld_namespace_mapping_foreach (gpointer key,
-                                           gpointer value,
-                                           gpointer user_data)
+write_jsonld (TrackerResource         *self,
+              TrackerNamespaceManager *namespaces,
+              ResourceWriter          *writer)
 {
-	GenerateJsonldData *data = user_data;
+	GenerateJsonldData context;
 
-	json_builder_set_member_name (data->builder, key);
-	json_builder_add_string_value (data->builder, value);
-}
+	namespace_cache_init (&context.namespaces, namespaces, FALSE);
+	context.visited = g_hash_table_new (g_str_hash, g_str_equal);
+	context.writer = writer;
+
+	namespace_cache_lookup (&context.namespaces, tracker_resource_get_identifier (self));
+	g_hash_table_add (context.visited, (gpointer) tracker_resource_get_identifier (self));
 
+	generate_jsonld_object (self, 0, TRUE, &context);
+
+	g_hash_table_unref (context.visited);
+	namespace_cache_clear (&context.namespaces);
+}
 
 /**
  * tracker_resource_print_jsonld:
@@ -1664,45 +2227,46 @@ char *
 tracker_resource_print_jsonld (TrackerResource         *self,
                                TrackerNamespaceManager *namespaces)
 {
-	GenerateJsonldData context;
-	JsonNode *json_root_node;
-	JsonGenerator *generator;
-	char *result;
-
-	if (namespaces == NULL) {
-		namespaces = tracker_namespace_manager_get_default ();
-	}
-
-	context.all_namespaces = namespaces;
-	context.our_namespaces = tracker_namespace_manager_new ();
-	context.builder = json_builder_new ();
-	context.done_list = NULL;
-
-	maybe_intern_prefix_of_compact_uri (context.all_namespaces, context.our_namespaces, tracker_resource_get_identifier (self));
+	ResourceWriter writer;
 
-	json_builder_begin_object (context.builder);
-
-	tracker_resource_generate_jsonld (self, &context);
-
-	json_builder_set_member_name (context.builder, "@context");
-	json_builder_begin_object (context.builder);
-	tracker_namespace_manager_foreach (context.our_namespaces, generate_jsonld_namespace_mapping_foreach, &context);
-	json_builder_end_object (context.builder);
+	g_return_val_if_fail (TRACKER_IS_RESOURCE (self), "");
 
-	json_builder_end_object (context.builder);
+	writer_init (&writer, NULL, NULL);
+	write_jsonld (self, namespaces, &writer);
 
-	json_root_node = json_builder_get_root (context.builder);
+	return writer_steal (&writer);
+}
 
-	generator = json_generator_new ();
-	json_generator_set_root (generator, json_root_node);
-	json_generator_set_pretty (generator, TRUE);
+/**
+ * tracker_resource_write_jsonld:
+ * @self: a #TrackerResource
+ * @namespaces: (allow-none): a set of prefixed URLs, or %NULL to use the
+ *     default set
+ * @stream: a #GOutputStream to write to
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: #GError for error reporting
+ *
+ * Writes the same JSON-LD document as tracker_resource_print_jsonld()
+ * to @stream, in chunks of a few kilobytes as it is generated.
+ *
+ * Returns: %TRUE on success, %FALSE if writing to @stream failed
+ *
+ * Since: 2.2
+ */
+gboolean
+tracker_resource_write_jsonld (TrackerResource          *self,
+                               TrackerNamespaceManager  *namespaces,
+                               GOutputStream            *stream,
+                               GCancellable             *cancellable,
+                               GError                  **error)
+{
+	ResourceWriter writer;
 
-	result = json_generator_to_data (generator, NULL);
+	g_return_val_if_fail (TRACKER_IS_RESOURCE (self), FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
 
-	g_list_free (context.done_list);
-	json_node_free (json_root_node);
-	g_object_unref (context.builder);
-	g_object_unref (generator);
+	writer_init (&writer, stream, cancellable);
+	write_jsonld (self, namespaces, &writer);
 
-	return result;
+	return writer_finish (&writer, error);
 }
@@ -21,12 +21,31 @@
 #define __LIBTRACKER_RESOURCE_H__
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "tracker-namespace-manager.h"
 
 G_BEGIN_DECLS
 
 #define TRACKER_TYPE_RESOURCE tracker_resource_get_type()
+
+/**
+ * TrackerResourceStatementOp:
+ * @TRACKER_RESOURCE_STATEMENT_DELETE_ALL: delete all values of the predicate,
+ *     the object is empty
+ * @TRACKER_RESOURCE_STATEMENT_INSERT_URI: insert a URI or blank node object
+ * @TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL: insert the string form of a
+ *     literal object
+ *
+ * Operations found in the output of tracker_resource_serialize_statements().
+ *
+ * Since: 2.2
+ */
+typedef enum {
+	TRACKER_RESOURCE_STATEMENT_DELETE_ALL = 'd',
+	TRACKER_RESOURCE_STATEMENT_INSERT_URI = 'i',
+	TRACKER_RESOURCE_STATEMENT_INSERT_LITERAL = 'l',
+} TrackerResourceStatementOp;
 G_DECLARE_DERIVABLE_TYPE (TrackerResource, tracker_resource, TRACKER, RESOURCE, GObject)
 
 struct _TrackerResourceClass
@@ -74,8 +93,14 @@ char *tracker_resource_print_turtle(TrackerResource *self, TrackerNamespaceManag
 
 char *tracker_resource_print_sparql_update (TrackerResource *self, TrackerNamespaceManager *namespaces, const char *graph_id);
 
+GVariant *tracker_resource_serialize_statements (TrackerResource *self, TrackerNamespaceManager *namespaces);
+
 char *tracker_resource_print_jsonld (TrackerResource *self, TrackerNamespaceManager *namespaces);
 
+gboolean tracker_resource_write_turtle (TrackerResource *self, TrackerNamespaceManager *namespaces, GOutputStream *stream, GCancellable *cancellable, GError **error);
+gboolean tracker_resource_write_sparql_update (TrackerResource *self, TrackerNamespaceManager *namespaces, const char *graph_id, GOutputStream *stream, GCancellable *cancellable, GError **error);
+gboolean tracker_resource_write_jsonld (TrackerResource *self, TrackerNamespaceManager *namespaces, GOutputStream *stream, GCancellable *cancellable, GError **error);
+
 G_END_DECLS
 
 #endif /* __LIBTRACKER_RESOURCE_H__ */
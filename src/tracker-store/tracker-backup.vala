@@ -23,13 +23,24 @@ public class Tracker.Backup : Object {
 	public const string PATH = "/org/freedesktop/Tracker1/Backup";
 
 	public async void save (BusName sender, string destination_uri) throws Error {
+		yield save_backup (sender, destination_uri, false);
+	}
+
+	// Only writes the database pages changed since the last incremental
+	// backup to the same destination, in builds without the journal.
+	public async void save_incremental (BusName sender, string destination_uri) throws Error {
+		yield save_backup (sender, destination_uri, true);
+	}
+
+	async void save_backup (BusName sender, string destination_uri, bool incremental) throws Error {
 		var resources = (Resources) Tracker.DBus.get_object (typeof (Resources));
 		if (resources != null) {
 			Tracker.Store.disable_signals ();
 			Tracker.Events.shutdown ();
 		}
 
-		var request = DBusRequest.begin (sender, "D-Bus request to save backup into '%s'", destination_uri);
+		var request = DBusRequest.begin (sender, "D-Bus request to save %sbackup into '%s'",
+		                                 incremental ? "incremental " : "", destination_uri);
 		try {
 			var destination = File.new_for_uri (destination_uri);
 
@@ -41,9 +52,9 @@ public class Tracker.Backup : Object {
 
 			Error backup_error = null;
 			var data_manager = Tracker.Main.get_data_manager ();
-			Data.backup_save (data_manager, destination, destination, error => {
+			Data.backup_save (data_manager, destination, destination, incremental, error => {
 				backup_error = error;
-				save.callback ();
+				save_backup.callback ();
 			});
 			yield;
 
@@ -37,6 +37,7 @@
 #define CONFIG_PATH   "/org/freedesktop/tracker/store/"
 
 #define GRAPHUPDATED_DELAY_DEFAULT	1000
+#define SLOW_QUERY_THRESHOLD_DEFAULT	1000
 
 static void config_set_property         (GObject       *object,
                                          guint          param_id,
@@ -53,6 +54,7 @@ enum {
 	PROP_0,
 	PROP_VERBOSITY,
 	PROP_GRAPHUPDATED_DELAY,
+	PROP_SLOW_QUERY_THRESHOLD,
 };
 
 G_DEFINE_TYPE (TrackerConfig, tracker_config, G_TYPE_SETTINGS);
@@ -86,6 +88,16 @@ tracker_config_class_init (TrackerConfigClass *klass)
 	                                                    GRAPHUPDATED_DELAY_DEFAULT,
 	                                                    G_PARAM_READWRITE));
 
+	g_object_class_install_property (object_class,
+	                                 PROP_SLOW_QUERY_THRESHOLD,
+	                                 g_param_spec_int  ("slow-query-threshold",
+	                                                    "Slow query threshold",
+	                                                    "Time in ms. after which a request is kept in the slow query log, 0 disables it (1000)",
+	                                                    0,
+	                                                    G_MAXINT,
+	                                                    SLOW_QUERY_THRESHOLD_DEFAULT,
+	                                                    G_PARAM_READWRITE));
+
 }
 
 static void
@@ -105,6 +117,11 @@ config_set_property (GObject      *object,
 		                                       g_value_get_int (value));
 		break;
 
+	case PROP_SLOW_QUERY_THRESHOLD:
+		tracker_config_set_slow_query_threshold (TRACKER_CONFIG (object),
+		                                         g_value_get_int (value));
+		break;
+
 	case PROP_VERBOSITY:
 		tracker_config_set_verbosity (TRACKER_CONFIG (object),
 		                              g_value_get_enum (value));
@@ -127,6 +144,10 @@ config_get_property (GObject    *object,
 		break;
 
 		/* General */
+	case PROP_SLOW_QUERY_THRESHOLD:
+		g_value_set_int (value, tracker_config_get_slow_query_threshold (TRACKER_CONFIG (object)));
+		break;
+
 	case PROP_VERBOSITY:
 		g_value_set_enum (value, tracker_config_get_verbosity (TRACKER_CONFIG (object)));
 		break;
@@ -179,6 +200,7 @@ config_constructed (GObject *object)
 	 */
 	g_settings_bind (settings, "verbosity", object, "verbosity", G_SETTINGS_BIND_GET | G_SETTINGS_BIND_GET_NO_CHANGES);
 	g_settings_bind (settings, "graphupdated-delay", object, "graphupdated-delay", G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "slow-query-threshold", object, "slow-query-threshold", G_SETTINGS_BIND_GET);
 }
 
 TrackerConfig *
@@ -259,3 +281,21 @@ tracker_config_set_graphupdated_delay (TrackerConfig *config,
 	g_settings_set_int(G_SETTINGS (config), "graphupdated-delay", value);
 	g_object_notify (G_OBJECT (config), "graphupdated-delay");
 }
+
+gint
+tracker_config_get_slow_query_threshold (TrackerConfig *config)
+{
+	g_return_val_if_fail (TRACKER_IS_CONFIG (config), SLOW_QUERY_THRESHOLD_DEFAULT);
+
+	return g_settings_get_int (G_SETTINGS (config), "slow-query-threshold");
+}
+
+void
+tracker_config_set_slow_query_threshold (TrackerConfig *config,
+                                         gint           value)
+{
+	g_return_if_fail (TRACKER_IS_CONFIG (config));
+
+	g_settings_set_int (G_SETTINGS (config), "slow-query-threshold", value);
+	g_object_notify (G_OBJECT (config), "slow-query-threshold");
+}
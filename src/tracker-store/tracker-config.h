@@ -56,6 +56,11 @@ gint           tracker_config_get_graphupdated_delay               (TrackerConfi
 void           tracker_config_set_graphupdated_delay               (TrackerConfig *config,
                                                                     gint           value);
 
+gint           tracker_config_get_slow_query_threshold             (TrackerConfig *config);
+
+void           tracker_config_set_slow_query_threshold             (TrackerConfig *config,
+                                                                    gint           value);
+
 G_END_DECLS
 
 #endif /* __TRACKER_STORE_CONFIG_H__ */
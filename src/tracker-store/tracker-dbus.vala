@@ -22,6 +22,7 @@ public class Tracker.DBus {
 	static DBusConnection connection;
 
 	const string SERVICE = "org.freedesktop.Tracker1";
+	const string METRICS_PATH = "/org/freedesktop/Tracker1/Metrics";
 
 	static uint name_owner_changed_id;
 	static Tracker.Statistics statistics;
@@ -32,6 +33,7 @@ public class Tracker.DBus {
 	static uint steroids_id;
 	static Tracker.Status notifier;
 	static uint notifier_id;
+	static uint metrics_id;
 	static Tracker.Backup backup;
 	static uint backup_id;
 	static uint domain_watch_id;
@@ -170,6 +172,11 @@ public class Tracker.DBus {
 			notifier_id = 0;
 		}
 
+		if (metrics_id != 0) {
+			connection.unregister_object (metrics_id);
+			metrics_id = 0;
+		}
+
 		if (domain_watch_id != 0) {
 			GLib.Bus.unwatch_name (domain_watch_id);
 			domain_watch_id = 0;
@@ -193,6 +200,13 @@ public class Tracker.DBus {
 
 		notifier_id = register_object (connection, notifier, Tracker.Status.PATH);
 
+		/* Add org.freedesktop.Tracker1.Metrics */
+		try {
+			metrics_id = Tracker.Metric.dbus_register (connection, METRICS_PATH);
+		} catch (Error e) {
+			critical ("Could not register D-Bus object at '%s': %s", METRICS_PATH, e.message);
+		}
+
 		return notifier;
 	}
 
@@ -0,0 +1,569 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Optional SPARQL 1.1 protocol endpoint, only reachable through the
+ * loopback interface or a Unix socket. Queries go through the same
+ * scheduler as Steroids.Query, results are streamed from the cursor as
+ * application/sparql-results+json using chunked transfer encoding.
+ *
+ * Web pages can make browsers send requests to loopback ports, so TCP
+ * clients must name a loopback host and present the token stored in
+ * the user runtime directory, either as a bearer token or as the
+ * "token" URI parameter. The Unix socket is only accessible to the user.
+ */
+public class Tracker.HttpEndpoint : Object {
+	public const string PATH = "/sparql";
+
+	const string JSON_TYPE = "application/sparql-results+json";
+	const string XSD_NS = "http://www.w3.org/2001/XMLSchema#";
+
+	const int BUFFER_SIZE = 65536;
+	const string TOKEN_FILENAME = "http-token";
+
+	Soup.Server server;
+	string? socket_path;
+	string? token;
+	string? token_path;
+	uint n_requests;
+
+	class Chunk {
+		public uint8[] data;
+		public size_t size;
+	}
+
+	/* Hands the data written from the query thread over to libsoup in
+	 * the main thread, the writer blocks while too much data is queued
+	 * for a slow client.
+	 */
+	class ResponseWriter : OutputStream {
+		const size_t MAX_PENDING_BYTES = 4 * BUFFER_SIZE;
+		/* How often a blocked writer checks for cancellation, and for
+		 * how long a client may stop reading before the query is aborted.
+		 */
+		const int64 WAKEUP_INTERVAL = 100 * TimeSpan.MILLISECOND;
+		const int64 STALL_TIMEOUT = 60 * TimeSpan.SECOND;
+
+		unowned Soup.Server server;
+		Soup.Message msg;
+		bool gzip;
+
+		Mutex mutex;
+		Cond cond;
+		Queue<Chunk> chunks = new Queue<Chunk> ();
+		size_t pending;
+		bool closed;
+		uint flush_id;
+
+		/* Only accessed from the main thread */
+		Queue<Chunk> in_flight = new Queue<Chunk> ();
+		ulong wrote_chunk_id;
+		bool started;
+
+		public ResponseWriter (Soup.Server server, Soup.Message msg, bool gzip) {
+			this.server = server;
+			this.msg = msg;
+			this.gzip = gzip;
+
+			wrote_chunk_id = msg.wrote_chunk.connect (wrote_chunk_cb);
+		}
+
+		public override ssize_t write (uint8[] buffer, Cancellable? cancellable = null) throws IOError {
+			var chunk = new Chunk ();
+			chunk.data = buffer;
+			chunk.size = buffer.length;
+
+			mutex.lock ();
+
+			int64 deadline = get_monotonic_time () + STALL_TIMEOUT;
+
+			while (!closed && pending > MAX_PENDING_BYTES) {
+				int64 now = get_monotonic_time ();
+
+				if (cancellable != null && cancellable.is_cancelled ()) {
+					mutex.unlock ();
+					throw new IOError.CANCELLED ("Operation was cancelled");
+				}
+
+				if (now >= deadline) {
+					mutex.unlock ();
+					throw new IOError.TIMED_OUT ("Client stopped reading results");
+				}
+
+				cond.wait_until (mutex, int64.min (deadline, now + WAKEUP_INTERVAL));
+			}
+
+			if (closed) {
+				mutex.unlock ();
+				throw new IOError.CLOSED ("Client connection was closed");
+			}
+
+			pending += chunk.size;
+			chunks.push_tail (chunk);
+
+			if (flush_id == 0) {
+				flush_id = Idle.add (() => {
+					flush_chunks ();
+					return false;
+				});
+			}
+
+			mutex.unlock ();
+
+			return buffer.length;
+		}
+
+		public override bool close (Cancellable? cancellable = null) throws IOError {
+			return true;
+		}
+
+		private void wrote_chunk_cb () {
+			var chunk = in_flight.pop_head ();
+
+			if (chunk == null)
+				return;
+
+			mutex.lock ();
+			pending -= chunk.size;
+			cond.signal ();
+			mutex.unlock ();
+		}
+
+		private void flush_chunks () {
+			Chunk chunk;
+
+			if (!started) {
+				var headers = msg.response_headers;
+
+				msg.set_status (Soup.Status.OK);
+				headers.set_encoding (Soup.Encoding.CHUNKED);
+				headers.set_content_type (JSON_TYPE, null);
+				if (gzip)
+					headers.replace ("Content-Encoding", "gzip");
+
+				/* Written chunks are not kept around */
+				msg.response_body.set_accumulate (false);
+				started = true;
+			}
+
+			mutex.lock ();
+
+			if (flush_id != 0) {
+				Source.remove (flush_id);
+				flush_id = 0;
+			}
+
+			while ((chunk = chunks.pop_head ()) != null) {
+				msg.response_body.append_take ((owned) chunk.data);
+				in_flight.push_tail (chunk);
+			}
+
+			mutex.unlock ();
+
+			server.unpause_message (msg);
+		}
+
+		/* Makes the query thread bail out on its next write */
+		public void abort () {
+			mutex.lock ();
+			closed = true;
+			cond.broadcast ();
+			mutex.unlock ();
+		}
+
+		public void finish () {
+			msg.disconnect (wrote_chunk_id);
+
+			/* The message is gone along with the client */
+			if (closed)
+				return;
+
+			flush_chunks ();
+
+			msg.response_body.complete ();
+			server.unpause_message (msg);
+		}
+
+		public void fail (Error e) {
+			msg.disconnect (wrote_chunk_id);
+
+			if (closed)
+				return;
+
+			if (started) {
+				/* Too late to change the status, leave the client
+				 * with a truncated document.
+				 */
+				warning ("Could not send query results: %s", e.message);
+				flush_chunks ();
+				msg.response_body.complete ();
+			} else {
+				uint status = Soup.Status.INTERNAL_SERVER_ERROR;
+
+				if (e is Sparql.Error && !(e is Sparql.Error.INTERNAL))
+					status = Soup.Status.BAD_REQUEST;
+
+				msg.set_status (status);
+				msg.set_response ("text/plain", Soup.MemoryUse.COPY, e.message.data);
+			}
+
+			server.unpause_message (msg);
+		}
+	}
+
+	public HttpEndpoint (int port, string? socket_path) throws Error {
+		server = new Soup.Server ("server-header", "tracker-store ");
+		server.add_handler (PATH, handle_request);
+
+		if (socket_path != null) {
+			var socket = new Socket (SocketFamily.UNIX, SocketType.STREAM, SocketProtocol.DEFAULT);
+
+			/* Remove stale sockets from previous runs */
+			FileUtils.unlink (socket_path);
+
+			bind_private (socket, socket_path);
+			socket.listen ();
+
+			server.listen_socket (socket, 0);
+			this.socket_path = socket_path;
+		}
+
+		if (port > 0) {
+			create_token ();
+			server.listen_local (port, 0);
+		}
+	}
+
+	public void shutdown () {
+		server.disconnect ();
+
+		if (socket_path != null)
+			FileUtils.unlink (socket_path);
+		if (token_path != null)
+			FileUtils.unlink (token_path);
+	}
+
+	/* The socket is bound inside a directory only accessible to the
+	 * user, so it can't be connected to before its mode is set, then
+	 * moved in place.
+	 */
+	private static void bind_private (Socket socket, string socket_path) throws Error {
+		var dir = DirUtils.mkdtemp (socket_path + ".XXXXXX");
+
+		if (dir == null)
+			throw new IOError.FAILED ("Could not create directory for '%s': %s", socket_path, strerror (errno));
+
+		var tmp_path = Path.build_filename (dir, "socket");
+
+		try {
+			socket.bind (new UnixSocketAddress (tmp_path), true);
+			FileUtils.chmod (tmp_path, 0600);
+
+			if (FileUtils.rename (tmp_path, socket_path) != 0)
+				throw new IOError.FAILED ("Could not move socket to '%s': %s", socket_path, strerror (errno));
+		} finally {
+			FileUtils.unlink (tmp_path);
+			DirUtils.remove (dir);
+		}
+	}
+
+	private void create_token () throws Error {
+		var dir = Path.build_filename (Environment.get_user_runtime_dir (), "tracker");
+		var random = File.new_for_path ("/dev/urandom").read ();
+		uint8 bytes[16];
+		size_t len;
+
+		random.read_all (bytes, out len);
+		random.close ();
+
+		var str = new StringBuilder ();
+		foreach (var b in bytes)
+			str.append_printf ("%02x", b);
+
+		if (DirUtils.create_with_parents (dir, 0700) != 0 ||
+		    FileUtils.chmod (dir, 0700) != 0)
+			throw new IOError.FAILED ("Could not create '%s': %s", dir, strerror (errno));
+
+		token_path = Path.build_filename (dir, TOKEN_FILENAME);
+		FileUtils.set_contents (token_path, str.str);
+		FileUtils.chmod (token_path, 0600);
+		token = str.str;
+	}
+
+	private static bool is_loopback_host (string host) {
+		string name = host;
+
+		if (host.has_prefix ("[")) {
+			int end = host.index_of_char (']');
+			if (end > 0)
+				name = host.substring (0, end + 1);
+		} else {
+			int colon = host.index_of_char (':');
+			if (colon >= 0)
+				name = host.substring (0, colon);
+		}
+
+		return (name.ascii_casecmp ("localhost") == 0 ||
+		        name == "127.0.0.1" ||
+		        name == "[::1]");
+	}
+
+	private static bool tokens_equal (string a, string b) {
+		uint8 diff = 0;
+
+		if (a.length != b.length)
+			return false;
+
+		for (int i = 0; i < a.length; i++)
+			diff |= (uint8) a[i] ^ (uint8) b[i];
+
+		return diff == 0;
+	}
+
+	private bool authorize (Soup.Message msg, HashTable<string, string>? query, Soup.ClientContext client) {
+		string? given = null;
+
+		/* Unix socket clients went through the file permissions */
+		if (!(client.get_local_address () is InetSocketAddress))
+			return true;
+
+		var host = msg.request_headers.get_one ("Host");
+
+		if (host == null || !is_loopback_host (host)) {
+			msg.set_status (Soup.Status.FORBIDDEN);
+			return false;
+		}
+
+		var authorization = msg.request_headers.get_one ("Authorization");
+
+		if (authorization != null && authorization.has_prefix ("Bearer "))
+			given = authorization.substring ("Bearer ".length).strip ();
+		else if (query != null)
+			given = query.lookup ("token");
+
+		if (given == null || token == null || !tokens_equal (given, token)) {
+			msg.set_status (Soup.Status.UNAUTHORIZED);
+			msg.response_headers.append ("WWW-Authenticate", "Bearer");
+			return false;
+		}
+
+		return true;
+	}
+
+	private void handle_request (Soup.Server server, Soup.Message msg, string path, HashTable<string, string>? query, Soup.ClientContext client) {
+		string? sparql = null;
+
+		if (!authorize (msg, query, client))
+			return;
+
+		if (msg.method == "GET") {
+			if (query != null)
+				sparql = query.lookup ("query");
+		} else if (msg.method == "POST") {
+			var content_type = msg.request_headers.get_content_type (null);
+			var body = (string) msg.request_body.flatten ().data;
+
+			if (content_type == "application/sparql-query") {
+				sparql = body;
+			} else if (content_type == "application/x-www-form-urlencoded") {
+				sparql = Soup.Form.decode (body).lookup ("query");
+			} else {
+				msg.set_status (Soup.Status.UNSUPPORTED_MEDIA_TYPE);
+				return;
+			}
+		} else {
+			/* Updates are not available through this endpoint */
+			msg.set_status (Soup.Status.METHOD_NOT_ALLOWED);
+			msg.response_headers.append ("Allow", "GET, POST");
+			return;
+		}
+
+		if (sparql == null) {
+			msg.set_status (Soup.Status.BAD_REQUEST);
+			msg.set_response ("text/plain", Soup.MemoryUse.STATIC, "No query given".data);
+			return;
+		}
+
+		var encodings = msg.request_headers.get_list ("Accept-Encoding");
+		bool gzip = encodings != null && Soup.header_contains (encodings, "gzip");
+
+		server.pause_message (msg);
+		run_query.begin (msg, sparql, gzip);
+	}
+
+	private async void run_query (Soup.Message msg, string sparql, bool gzip) {
+		var client_id = "http:%u".printf (++n_requests);
+		var writer = new ResponseWriter (server, msg, gzip);
+
+		/* Stop the query if the client goes away */
+		ulong finished_id = msg.finished.connect (() => {
+			writer.abort ();
+			Tracker.Store.unreg_batches (client_id);
+		});
+
+		debug ("[HTTP] %s query: %s", client_id, sparql);
+
+		try {
+			var sparql_conn = Tracker.Main.get_sparql_connection ();
+
+			yield Tracker.Store.sparql_query (sparql_conn, sparql, Priority.HIGH, (cursor, stats, cancellable) => {
+				OutputStream stream = writer;
+
+				if (gzip)
+					stream = new ConverterOutputStream (writer, new ZlibCompressor (ZlibCompressorFormat.GZIP, -1));
+
+				write_results (cursor, stream, stats, cancellable);
+				stream.close (cancellable);
+			}, client_id);
+
+			msg.disconnect (finished_id);
+			writer.finish ();
+		} catch (Error e) {
+			msg.disconnect (finished_id);
+			writer.fail (e);
+		}
+
+		Tracker.Store.unreg_batches (client_id);
+	}
+
+	private static void append_json_string (StringBuilder str, string? value) {
+		long start = 0;
+
+		str.append_c ('"');
+
+		if (value == null) {
+			str.append_c ('"');
+			return;
+		}
+
+		for (long i = 0; i < value.length; i++) {
+			char c = value[i];
+
+			if (c != '"' && c != '\\' && (uchar) c >= 0x20)
+				continue;
+
+			str.append_len (value.offset (start), (ssize_t) (i - start));
+			start = i + 1;
+
+			switch (c) {
+			case '"':
+				str.append ("\\\"");
+				break;
+			case '\\':
+				str.append ("\\\\");
+				break;
+			case '\n':
+				str.append ("\\n");
+				break;
+			case '\r':
+				str.append ("\\r");
+				break;
+			case '\t':
+				str.append ("\\t");
+				break;
+			default:
+				str.append_printf ("\\u%04x", (uint) c);
+				break;
+			}
+		}
+
+		str.append_len (value.offset (start), (ssize_t) (value.length - start));
+		str.append_c ('"');
+	}
+
+	private static unowned string? get_datatype (Sparql.ValueType type) {
+		switch (type) {
+		case Sparql.ValueType.INTEGER:
+			return XSD_NS + "integer";
+		case Sparql.ValueType.DOUBLE:
+			return XSD_NS + "double";
+		case Sparql.ValueType.DATETIME:
+			return XSD_NS + "dateTime";
+		case Sparql.ValueType.BOOLEAN:
+			return XSD_NS + "boolean";
+		default:
+			return null;
+		}
+	}
+
+	/* Runs in the query thread */
+	private static void write_results (Sparql.Cursor cursor, OutputStream stream, Tracker.Store.QueryStats stats, Cancellable cancellable) throws Error {
+		var str = new StringBuilder.sized (BUFFER_SIZE);
+		int n_columns = cursor.n_columns;
+
+		str.append ("{\"head\":{\"vars\":[");
+
+		for (int i = 0; i < n_columns; i++) {
+			if (i > 0)
+				str.append_c (',');
+			append_json_string (str, cursor.get_variable_name (i));
+		}
+
+		str.append ("]},\"results\":{\"bindings\":[");
+
+		while (cursor.next (cancellable)) {
+			bool first = true;
+
+			if (stats.n_rows > 0)
+				str.append_c (',');
+
+			str.append_c ('{');
+
+			for (int i = 0; i < n_columns; i++) {
+				var type = cursor.get_value_type (i);
+
+				if (type == Sparql.ValueType.UNBOUND)
+					continue;
+
+				if (!first)
+					str.append_c (',');
+				first = false;
+
+				append_json_string (str, cursor.get_variable_name (i));
+
+				if (type == Sparql.ValueType.URI)
+					str.append (":{\"type\":\"uri\",\"value\":");
+				else if (type == Sparql.ValueType.BLANK_NODE)
+					str.append (":{\"type\":\"bnode\",\"value\":");
+				else
+					str.append (":{\"type\":\"literal\",\"value\":");
+
+				append_json_string (str, cursor.get_string (i));
+
+				unowned string? datatype = get_datatype (type);
+				if (datatype != null)
+					str.append_printf (",\"datatype\":\"%s\"", datatype);
+
+				str.append_c ('}');
+			}
+
+			str.append_c ('}');
+			stats.n_rows++;
+
+			if (str.len >= BUFFER_SIZE) {
+				stream.write_all (str.data, null, cancellable);
+				stats.n_bytes += str.len;
+				str.truncate (0);
+			}
+		}
+
+		str.append ("]}}");
+		stream.write_all (str.data, null, cancellable);
+		stats.n_bytes += str.len;
+	}
+}
@@ -41,6 +41,7 @@ License which can be viewed at:
 
 	static Tracker.Direct.Connection connection;
 	static Tracker.Data.Manager data_manager;
+	static Tracker.HttpEndpoint http_endpoint;
 
 	/* Private command line parameters */
 	static bool version;
@@ -52,6 +53,8 @@ License which can be viewed at:
 	static File data_location;
 	static File ontology_location;
 	static string domain;
+	static int http_port;
+	static string http_socket;
 
 	const OptionEntry entries[] = {
 		/* Daemon options */
@@ -62,6 +65,10 @@ License which can be viewed at:
 		{ "force-reindex", 'r', 0, OptionArg.NONE, ref force_reindex, N_("Force a re-index of all content"), null },
 		{ "readonly-mode", 'n', 0, OptionArg.NONE, ref readonly_mode, N_("Only allow read based actions on the database"), null },
 		{ "domain-ontology", 'd', 0, OptionArg.STRING, ref domain_ontology, N_("Load a specified domain ontology"), null },
+
+		/* Endpoint options */
+		{ "http-port", 0, 0, OptionArg.INT, ref http_port, N_("Serve SPARQL queries over HTTP on this loopback port"), N_("PORT") },
+		{ "http-socket", 0, 0, OptionArg.FILENAME, ref http_socket, N_("Serve SPARQL queries over HTTP on this Unix socket"), N_("PATH") },
 		{ null }
 	};
 
@@ -72,6 +79,7 @@ License which can be viewed at:
 		message ("Store options:");
 		message ("  Readonly mode  ........................  %s", readonly_mode ? "yes" : "no");
 		message ("  GraphUpdated Delay ....................  %d", config.graphupdated_delay);
+		message ("  Slow Query Threshold ..................  %d", config.slow_query_threshold);
 
 		if (domain_ontology != null)
 			message ("  Domain ontology........................  %s", domain_ontology);
@@ -79,6 +87,11 @@ License which can be viewed at:
 		if (domain != null)
 			message ("  Domain.................................  %s", domain);
 
+		if (http_port > 0)
+			message ("  HTTP port..............................  %d", http_port);
+		if (http_socket != null)
+			message ("  HTTP socket............................  %s", http_socket);
+
 		if (cache_location != null)
 			message ("  Cache location.........................  %s", cache_location.get_uri());
 		if (data_location != null)
@@ -288,6 +301,14 @@ License which can be viewed at:
 
 		Tracker.DBJournal.set_rotating (do_rotating, chunk_size, rotate_to);
 
+		Tracker.DBManager.set_role_params (Tracker.DBRole.WRITER,
+		                                   db_config.writer_cache_size, 0);
+		Tracker.DBManager.set_role_params (Tracker.DBRole.READER,
+		                                   db_config.reader_cache_size,
+		                                   (int64) db_config.reader_mmap_size * 1024 * 1024);
+		Tracker.DBManager.set_role_params (Tracker.DBRole.CHECKPOINT,
+		                                   db_config.checkpoint_cache_size, 0);
+
 		try {
 			connection = new Tracker.Direct.Connection (Sparql.ConnectionFlags.NONE,
 			                                            cache_location,
@@ -310,6 +331,14 @@ License which can be viewed at:
 			Tracker.Writeback.init (data_manager, get_writeback_predicates);
 			Tracker.Store.resume ();
 
+			if (http_port > 0 || http_socket != null) {
+				try {
+					http_endpoint = new Tracker.HttpEndpoint (http_port, http_socket);
+				} catch (Error e) {
+					critical ("Could not start HTTP endpoint: %s", e.message);
+				}
+			}
+
 			message ("Waiting for D-Bus requests...");
 		}
 
@@ -332,6 +361,11 @@ License which can be viewed at:
 		 */
 		message ("Shutdown started");
 
+		if (http_endpoint != null) {
+			http_endpoint.shutdown ();
+			http_endpoint = null;
+		}
+
 		Tracker.Store.shutdown ();
 
 		Timeout.add (5000, shutdown_timeout_cb, Priority.LOW);
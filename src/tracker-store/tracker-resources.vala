@@ -46,6 +46,7 @@ public class Tracker.Resources : Object {
 	 * sent to us by the bus, which in turn makes libdbus-glib perform exit(). */
 
 	const int DBUS_ARBITRARY_MAX_MSG_SIZE = 10000000;
+	const double[] GRAPH_UPDATED_BATCH_BUCKETS = { 1, 10, 100, 1000, 10000, 100000 };
 
 	DBusConnection connection;
 
@@ -58,12 +59,20 @@ public class Tracker.Resources : Object {
 	}
 
 	public async void load (BusName sender, string uri) throws Error {
-		var request = DBusRequest.begin (sender, "Resources.Load (uri: '%s')", uri);
+		yield load_turtle_file (sender, uri, false);
+	}
+
+	public async void bulk_load (BusName sender, string uri) throws Error {
+		yield load_turtle_file (sender, uri, true);
+	}
+
+	async void load_turtle_file (BusName sender, string uri, bool bulk) throws Error {
+		var request = DBusRequest.begin (sender, "Resources.%s (uri: '%s')", bulk ? "BulkLoad" : "Load", uri);
 		try {
 			var file = File.new_for_uri (uri);
 			var sparql_conn = Tracker.Main.get_sparql_connection ();
 
-			yield Tracker.Store.queue_turtle_import (sparql_conn, file, sender);
+			yield Tracker.Store.queue_turtle_import (sparql_conn, file, bulk, sender);
 
 			request.end ();
 		} catch (DBInterfaceError.NO_SPACE ie) {
@@ -86,7 +95,7 @@ public class Tracker.Resources : Object {
 			var builder = new VariantBuilder ((VariantType) "aas");
 			var sparql_conn = Tracker.Main.get_sparql_connection ();
 
-			yield Tracker.Store.sparql_query (sparql_conn, query, Priority.HIGH, cursor => {
+			yield Tracker.Store.sparql_query (sparql_conn, query, Priority.HIGH, (cursor, stats, cancellable) => {
 				while (cursor.next ()) {
 					builder.open ((VariantType) "as");
 
@@ -98,9 +107,11 @@ public class Tracker.Resources : Object {
 						}
 
 						builder.add ("s", str);
+						stats.n_bytes += str.length + 1;
 					}
 
 					builder.close ();
+					stats.n_rows++;
 				}
 			}, sender);
 
@@ -216,6 +227,10 @@ public class Tracker.Resources : Object {
 		});
 		var inserts = builder.end ();
 
+		Metric.histogram ("tracker_store_graph_updated_batch_size", null,
+		                  "Events carried by each GraphUpdated signal",
+		                  GRAPH_UPDATED_BATCH_BUCKETS).observe (deletes.n_children () + inserts.n_children ());
+
 		graph_updated (cl.uri, deletes, inserts);
 	}
 
@@ -29,7 +29,10 @@ public class Tracker.Statistics : Object {
 		var data_manager = Tracker.Main.get_data_manager ();
 		var ontologies = data_manager.get_ontologies ();
 
-		if (!initialized) {
+		/* Counts are loaded at startup and kept up to date on
+		 * commit, older databases opened read-only need counting.
+		 */
+		if (!initialized && !data_manager.has_class_counts ()) {
 			var iface = data_manager.get_db_interface ();
 
 			foreach (var cl in ontologies.get_classes ()) {
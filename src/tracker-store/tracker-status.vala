@@ -109,6 +109,29 @@ public class Tracker.Status : Object {
 		return this.status;
 	}
 
+	public HashTable<string, Variant>[] get_slow_queries () {
+		HashTable<string, Variant>[] result = {};
+
+		foreach (var entry in Tracker.Store.get_slow_queries ()) {
+			var dict = new HashTable<string, Variant> (str_hash, str_equal);
+
+			dict.insert ("timestamp", new Variant.int64 (entry.timestamp));
+			dict.insert ("query", new Variant.string (entry.query));
+			dict.insert ("client", new Variant.string (entry.client));
+			if (entry.queue_time >= 0)
+				dict.insert ("queue-time", new Variant.double (entry.queue_time));
+			if (entry.translate_time >= 0)
+				dict.insert ("translate-time", new Variant.double (entry.translate_time));
+			dict.insert ("execute-time", new Variant.double (entry.execute_time));
+			dict.insert ("rows", new Variant.uint64 (entry.n_rows));
+			dict.insert ("bytes", new Variant.uint64 (entry.n_bytes));
+
+			result += dict;
+		}
+
+		return result;
+	}
+
 	public async void wait () throws Error {
 		if (status == "Idle") {
 			/* tracker-store is idle */
@@ -31,7 +31,7 @@ public class Tracker.Steroids : Object {
 			string[] variable_names = null;
 			var sparql_conn = Tracker.Main.get_sparql_connection ();
 
-			yield Tracker.Store.sparql_query (sparql_conn, query, Priority.HIGH, cursor => {
+			yield Tracker.Store.sparql_query (sparql_conn, query, Priority.HIGH, (cursor, stats, cancellable) => {
 				var data_output_stream = new DataOutputStream (new BufferedOutputStream.sized (output_stream, BUFFER_SIZE));
 				data_output_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
 
@@ -74,6 +74,10 @@ public class Tracker.Steroids : Object {
 						data_output_stream.put_string (column_data[i] != null ? column_data[i] : "");
 						data_output_stream.put_byte (0);
 					}
+
+					stats.n_rows++;
+					// column count, types and offsets, then the strings
+					stats.n_bytes += sizeof (int32) * (1 + 2 * n_columns) + last_offset + 1;
 				}
 			}, sender);
 
@@ -157,6 +161,58 @@ public class Tracker.Steroids : Object {
 		return yield update_internal (sender, Priority.LOW, true, input_stream);
 	}
 
+	async void update_resources_internal (BusName sender, int priority, UnixInputStream input_stream) throws Error {
+		var request = DBusRequest.begin (sender,
+			"Steroids.%sUpdateResources",
+			priority != Priority.HIGH ? "Batch" : "");
+		try {
+			size_t bytes_read;
+
+			var data_input_stream = new DataInputStream (input_stream);
+			data_input_stream.set_buffer_size (BUFFER_SIZE);
+			data_input_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
+
+			int data_size = data_input_stream.read_int32 (null);
+			if (data_size < 0)
+				throw new Sparql.Error.PARSE ("Invalid statements size");
+
+			uint8[] data = new uint8[data_size];
+
+			data_input_stream.read_all (data, out bytes_read);
+
+			data_input_stream = null;
+
+			/* Not trusted, so the contents get validated on access */
+			var variant = new Variant.from_bytes (new VariantType ("(saa(ysss))"), new Bytes.take ((owned) data), false);
+			var graph = variant.get_child_value (0).get_string ();
+			var statements = variant.get_child_value (1);
+
+			request.debug ("resources: %u", (uint) statements.n_children ());
+			var sparql_conn = Tracker.Main.get_sparql_connection ();
+
+			yield Tracker.Store.update_statements (sparql_conn, graph != "" ? graph : null, statements, priority, sender);
+
+			request.end ();
+		} catch (DBInterfaceError.NO_SPACE ie) {
+			throw new Sparql.Error.NO_SPACE (ie.message);
+		} catch (Error e) {
+			request.end (e);
+			if (e is Sparql.Error) {
+				throw e;
+			} else {
+				throw new Sparql.Error.INTERNAL (e.message);
+			}
+		}
+	}
+
+	public async void update_resources (BusName sender, UnixInputStream input_stream) throws Error {
+		yield update_resources_internal (sender, Priority.HIGH, input_stream);
+	}
+
+	public async void batch_update_resources (BusName sender, UnixInputStream input_stream) throws Error {
+		yield update_resources_internal (sender, Priority.LOW, input_stream);
+	}
+
 	[DBus (signature = "as")]
 	public async Variant update_array (BusName sender, UnixInputStream input_stream) throws Error {
 		var request = DBusRequest.begin (sender, "Steroids.UpdateArray");
@@ -208,19 +264,21 @@ public class Tracker.Steroids : Object {
 				combined_query = null;
 			}
 
-			// combined query was not successful, try queries one by one
-			for (i = 0; i < query_count; i++) {
-				request.debug ("query: %s", query_array[i]);
+			// combined query was not successful, bisect it so the
+			// failing queries are isolated in as few transactions
+			// as possible, while the rest still go in bulk
+			var batch = new UpdateArrayBatch (sparql_conn, sender, query_array);
+			if (query_count > 0)
+				yield batch.update_range (0, query_count, true);
 
-				try {
-					yield Tracker.Store.sparql_update (sparql_conn, query_array[i], Priority.LOW, sender);
+			for (i = 0; i < query_count; i++) {
+				if (batch.errors[i] == null) {
 					builder.add ("s", "");
 					builder.add ("s", "");
-				} catch (Error e1) {
+				} else {
 					builder.add ("s", "org.freedesktop.Tracker1.SparqlError.Internal");
-					builder.add ("s", e1.message);
+					builder.add ("s", batch.errors[i]);
 				}
-
 			}
 
 			request.end ();
@@ -236,3 +294,56 @@ public class Tracker.Steroids : Object {
 		}
 	}
 }
+
+class Tracker.UpdateArrayBatch : Object {
+	Tracker.Direct.Connection sparql_conn;
+	BusName sender;
+	string[] queries;
+
+	public string?[] errors;
+
+	public UpdateArrayBatch (Tracker.Direct.Connection sparql_conn, BusName sender, string[] queries) {
+		this.sparql_conn = sparql_conn;
+		this.sender = sender;
+		this.queries = queries;
+		this.errors = new string?[queries.length];
+	}
+
+	// Returns true if all queries in [start, end) were applied,
+	// errors are recorded for the queries that failed.
+	public async bool update_range (int start, int end, bool known_to_fail) {
+		if (end - start == 1) {
+			try {
+				yield Tracker.Store.sparql_update (sparql_conn, queries[start], Priority.LOW, sender);
+				return true;
+			} catch (Error e) {
+				errors[start] = e.message;
+				return false;
+			}
+		}
+
+		if (!known_to_fail) {
+			var combined_query = new StringBuilder ();
+
+			for (int i = start; i < end; i++)
+				combined_query.append (queries[i]);
+
+			try {
+				yield Tracker.Store.sparql_update (sparql_conn, combined_query.str, Priority.LOW, sender);
+				return true;
+			} catch {
+			}
+		}
+
+		// if the first half goes through as a whole, the
+		// failure must be in the second half
+		int middle = start + (end - start) / 2;
+
+		if (yield update_range (start, middle, false))
+			yield update_range (middle, end, true);
+		else
+			yield update_range (middle, end, false);
+
+		return false;
+	}
+}
@@ -25,6 +25,25 @@ public class Tracker.Store {
 	const int MAX_TASK_TIME = 30;
 	const int GRAPH_UPDATED_IMMEDIATE_EMIT_AT = 50000;
 
+	const int SLOW_QUERY_LOG_SIZE = 100;
+	const int SLOW_QUERY_MAX_LENGTH = 1024;
+
+	// Background maintenance kicks in after this many seconds
+	// without updates, and works in chunks small enough not to
+	// delay incoming updates noticeably.
+	const int MAINTENANCE_IDLE_TIME = 30;
+	const uint MAINTENANCE_CHUNK_IDS = 5000;
+	const uint MAINTENANCE_CHUNK_PAGES = 256;
+
+	// The journal is compacted after maintenance, once the chunks
+	// written since the last snapshot take at least this many bytes
+	// (and more than the snapshot itself).
+	const size_t COMPACTION_MIN_TAIL_SIZE = 16 * 1024 * 1024;
+
+	// Bulk Turtle imports are committed in chunks of this size
+	const size_t IMPORT_COMMIT_STATEMENTS = 50000;
+	const size_t IMPORT_COMMIT_BYTES = 8 * 1024 * 1024;
+
 	static int max_task_time;
 	static bool active;
 
@@ -32,29 +51,83 @@ public class Tracker.Store {
 	static uint signal_timeout;
 	static int n_updates;
 
+	static uint maintenance_timeout;
+	static bool maintenance_running;
+	static Cancellable maintenance_cancellable;
+
 	static HashTable<string, Cancellable> client_cancellables;
 
+	// Filled in by the SparqlQueryInThread function
+	public class QueryStats {
+		public uint64 n_rows;
+		public uint64 n_bytes;
+	}
+
+	// Times are in seconds, negative if the phase was not
+	// measured separately (e.g. for updates).
+	public class SlowQuery {
+		public int64 timestamp;
+		public string query;
+		public string client;
+		public double queue_time = -1;
+		public double translate_time = -1;
+		public double execute_time = -1;
+		public uint64 n_rows;
+		public uint64 n_bytes;
+	}
+
+	static Queue<SlowQuery> slow_queries;
+
 	public delegate void SignalEmissionFunc (HashTable<Tracker.Class, Tracker.Events.Batch>? graph_updated, HashTable<int, GLib.Array<int>>? writeback);
 	static unowned SignalEmissionFunc signal_callback;
 
-	public delegate void SparqlQueryInThread (Sparql.Cursor cursor) throws Error;
+	public delegate void SparqlQueryInThread (Sparql.Cursor cursor, QueryStats stats, Cancellable cancellable) throws Error;
 
 	class CursorTask {
-		public Sparql.Cursor cursor;
+		public Tracker.Direct.Connection conn;
+		public string sparql;
+		public Cancellable cancellable;
 		public unowned SourceFunc callback;
 		public unowned SparqlQueryInThread thread_func;
 		public Error error;
-
-		public CursorTask (Sparql.Cursor cursor) {
-			this.cursor = cursor;
+		public QueryStats stats = new QueryStats ();
+		public int64 queued_time;
+		public double queue_time;
+		public double translate_time;
+		public double execute_time;
+
+		public CursorTask (Tracker.Direct.Connection conn, string sparql, Cancellable cancellable) {
+			this.conn = conn;
+			this.sparql = sparql;
+			this.cancellable = cancellable;
 		}
 	}
 
 	static ThreadPool<CursorTask> cursor_pool;
 
+	private static double seconds_since (int64 time) {
+		return (double) (get_monotonic_time () - time) / TimeSpan.SECOND;
+	}
+
+	private static void observe_request_time (string method, int64 start_time) {
+		Metric.histogram ("tracker_store_request_duration_seconds",
+		                  "method=\"%s\"".printf (method),
+		                  "Time taken by store requests, including queueing").observe (seconds_since (start_time));
+	}
+
 	private static void cursor_dispatch_cb (owned CursorTask task) {
+		task.queue_time = seconds_since (task.queued_time);
+
 		try {
-			task.thread_func (task.cursor);
+			task.cancellable.set_error_if_cancelled ();
+
+			var start_time = get_monotonic_time ();
+			var cursor = task.conn.query (task.sparql, task.cancellable);
+			task.translate_time = seconds_since (start_time);
+
+			start_time = get_monotonic_time ();
+			task.thread_func (cursor, task.stats, task.cancellable);
+			task.execute_time = seconds_since (start_time);
 		} catch (Error e) {
 			task.error = e;
 		}
@@ -74,6 +147,7 @@ public class Tracker.Store {
 		}
 
 		client_cancellables = new HashTable <string, Cancellable> (str_hash, str_equal);
+		slow_queries = new Queue<SlowQuery> ();
 
 		try {
 			cursor_pool = new ThreadPool<CursorTask>.with_owned_data (cursor_dispatch_cb, 16, false);
@@ -95,6 +169,71 @@ public class Tracker.Store {
 			Source.remove (signal_timeout);
 			signal_timeout = 0;
 		}
+
+		if (maintenance_timeout != 0) {
+			Source.remove (maintenance_timeout);
+			maintenance_timeout = 0;
+		}
+
+		if (maintenance_cancellable != null)
+			maintenance_cancellable.cancel ();
+	}
+
+	private static void schedule_maintenance () {
+		if (maintenance_timeout != 0)
+			Source.remove (maintenance_timeout);
+
+		maintenance_timeout = Timeout.add_seconds (MAINTENANCE_IDLE_TIME, () => {
+			maintenance_timeout = 0;
+			if (!maintenance_running)
+				run_maintenance.begin ();
+			return false;
+		});
+	}
+
+	// Deletes unreferenced resources and reclaims free pages
+	// chunk by chunk, stopping as soon as updates come in. The
+	// data manager keeps track of the position, so the next idle
+	// period resumes where this one stopped. A finished pass is
+	// followed by journal compaction.
+	private static async void run_maintenance () {
+		var conn = Tracker.Main.get_sparql_connection ();
+		var progress_gauge = Metric.gauge ("tracker_store_maintenance_progress", null,
+		                                   "Progress of the current background maintenance pass");
+		bool more_work = true;
+
+		maintenance_running = true;
+		maintenance_cancellable = new Cancellable ();
+
+		while (more_work && active && n_updates == 0) {
+			double progress;
+
+			try {
+				more_work = yield conn.maintenance_async (MAINTENANCE_CHUNK_IDS, MAINTENANCE_CHUNK_PAGES,
+				                                          Priority.LOW, null, out progress);
+			} catch (Error e) {
+				warning ("Could not perform database maintenance: %s", e.message);
+				break;
+			}
+
+			progress_gauge.set (progress);
+			debug ("Database maintenance at %.0f%%", progress * 100);
+		}
+
+		// Snapshots only take a short pause of the update queue,
+		// but are still best written while nothing else goes on.
+		if (!more_work && active && n_updates == 0) {
+			try {
+				yield conn.compact_journal_async (COMPACTION_MIN_TAIL_SIZE, Priority.LOW,
+				                                  maintenance_cancellable);
+			} catch (Error e) {
+				if (!(e is IOError.CANCELLED))
+					warning ("Could not compact the journal: %s", e.message);
+			}
+		}
+
+		maintenance_cancellable = null;
+		maintenance_running = false;
 	}
 
 	private static Cancellable create_cancellable (string client_id) {
@@ -131,8 +270,46 @@ public class Tracker.Store {
 		}
 	}
 
+	private static void log_slow_query (SlowQuery entry) {
+		int threshold = config.slow_query_threshold;
+
+		if (threshold <= 0)
+			return;
+
+		double total = (entry.queue_time > 0 ? entry.queue_time : 0) +
+		               (entry.translate_time > 0 ? entry.translate_time : 0) +
+		               (entry.execute_time > 0 ? entry.execute_time : 0);
+
+		if (total * 1000 < threshold)
+			return;
+
+		entry.timestamp = get_real_time ();
+
+		if (entry.query.char_count () > SLOW_QUERY_MAX_LENGTH) {
+			entry.query = entry.query.substring (0, entry.query.index_of_nth_char (SLOW_QUERY_MAX_LENGTH)) + "...";
+		}
+
+		debug ("Slow query from %s took %.3fs: %s", entry.client, total, entry.query);
+
+		slow_queries.push_tail (entry);
+
+		if (slow_queries.get_length () > SLOW_QUERY_LOG_SIZE)
+			slow_queries.pop_head ();
+	}
+
+	public static SlowQuery[] get_slow_queries () {
+		SlowQuery[] entries = {};
+
+		foreach (var entry in slow_queries.head) {
+			entries += entry;
+		}
+
+		return entries;
+	}
+
 	public static async void sparql_query (Tracker.Direct.Connection conn, string sparql, int priority, SparqlQueryInThread in_thread, string client_id) throws Error {
 		var cancellable = create_cancellable (client_id);
+		var start_time = get_monotonic_time ();
 		uint timeout_id = 0;
 
 		if (max_task_time != 0) {
@@ -143,14 +320,10 @@ public class Tracker.Store {
 			});
 		}
 
-		var cursor = yield conn.query_async (sparql, cancellable);
-
-		if (timeout_id != 0)
-			GLib.Source.remove (timeout_id);
-
-		var task = new CursorTask (cursor);
+		var task = new CursorTask (conn, sparql, cancellable);
 		task.thread_func = in_thread;
 		task.callback = sparql_query.callback;
+		task.queued_time = get_monotonic_time ();
 
 		try {
 			cursor_pool.add (task);
@@ -160,8 +333,39 @@ public class Tracker.Store {
 
 		yield;
 
+		if (timeout_id != 0)
+			GLib.Source.remove (timeout_id);
+
 		if (task.error != null)
 			throw task.error;
+
+		observe_request_time ("query", start_time);
+
+		var entry = new SlowQuery ();
+		entry.query = sparql;
+		entry.client = client_id;
+		entry.queue_time = task.queue_time;
+		entry.translate_time = task.translate_time;
+		entry.execute_time = task.execute_time;
+		entry.n_rows = task.stats.n_rows;
+		entry.n_bytes = task.stats.n_bytes;
+		log_slow_query (entry);
+	}
+
+	private static void update_finished () {
+		n_updates--;
+		if (n_updates == 0)
+			schedule_maintenance ();
+	}
+
+	// Updates are queued, translated and executed in a single
+	// step by the connection, so only the total time is known.
+	private static void log_slow_update (string sparql, string client_id, int64 start_time) {
+		var entry = new SlowQuery ();
+		entry.query = sparql;
+		entry.client = client_id;
+		entry.execute_time = seconds_since (start_time);
+		log_slow_query (entry);
 	}
 
 	public static async void sparql_update (Tracker.Direct.Connection conn, string sparql, int priority, string client_id) throws Error {
@@ -170,8 +374,14 @@ public class Tracker.Store {
 		n_updates++;
 		ensure_signal_timeout ();
 		var cancellable = create_cancellable (client_id);
-		yield conn.update_async (sparql, priority, cancellable);
-		n_updates--;
+		var start_time = get_monotonic_time ();
+		try {
+			yield conn.update_async (sparql, priority, cancellable);
+		} finally {
+			update_finished ();
+		}
+		observe_request_time ("update", start_time);
+		log_slow_update (sparql, client_id, start_time);
 	}
 
 	public static async Variant sparql_update_blank (Tracker.Direct.Connection conn, string sparql, int priority, string client_id) throws Error {
@@ -180,20 +390,56 @@ public class Tracker.Store {
 		n_updates++;
 		ensure_signal_timeout ();
 		var cancellable = create_cancellable (client_id);
-		var nodes = yield conn.update_blank_async (sparql, priority, cancellable);
-		n_updates--;
+		var start_time = get_monotonic_time ();
+		Variant nodes;
+		try {
+			nodes = yield conn.update_blank_async (sparql, priority, cancellable);
+		} finally {
+			update_finished ();
+		}
+		observe_request_time ("update_blank", start_time);
+		log_slow_update (sparql, client_id, start_time);
 
 		return nodes;
 	}
 
-	public static async void queue_turtle_import (Tracker.Direct.Connection conn, File file, string client_id) throws Error {
+	public static async void update_statements (Tracker.Direct.Connection conn, string? graph, Variant statements, int priority, string client_id) throws Error {
 		if (!active)
 			throw new Sparql.Error.UNSUPPORTED ("Store is not active");
 		n_updates++;
 		ensure_signal_timeout ();
 		var cancellable = create_cancellable (client_id);
-		yield conn.load_async (file, cancellable);
-		n_updates--;
+		var start_time = get_monotonic_time ();
+		try {
+			yield conn.update_statements_async (graph, statements, priority, cancellable);
+		} finally {
+			update_finished ();
+		}
+		observe_request_time ("update_resources", start_time);
+		log_slow_update ("(%u resources)".printf ((uint) statements.n_children ()), client_id, start_time);
+	}
+
+	public static async void queue_turtle_import (Tracker.Direct.Connection conn, File file, bool bulk, string client_id) throws Error {
+		if (!active)
+			throw new Sparql.Error.UNSUPPORTED ("Store is not active");
+		n_updates++;
+		ensure_signal_timeout ();
+		var cancellable = create_cancellable (client_id);
+		var start_time = get_monotonic_time ();
+		try {
+			if (bulk) {
+				// Committed in chunks with full text search deferred,
+				// only for callers that asked for it explicitly.
+				var notifier = (Status) (Tracker.DBus.get_object (typeof (Status)));
+				yield conn.import_async (file, IMPORT_COMMIT_STATEMENTS, IMPORT_COMMIT_BYTES, true,
+				                         Priority.DEFAULT, cancellable, notifier.get_callback ());
+			} else {
+				yield conn.load_async (file, cancellable);
+			}
+		} finally {
+			update_finished ();
+		}
+		observe_request_time (bulk ? "bulk_load" : "load", start_time);
 	}
 
 	public static void unreg_batches (string client_id) {
@@ -214,6 +460,7 @@ public class Tracker.Store {
 
 	public static void resume () {
 		Tracker.Store.active = true;
+		schedule_maintenance ();
 	}
 
 	private static void on_statements_committed () {
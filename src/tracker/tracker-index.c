@@ -39,6 +39,7 @@
 static gchar **reindex_mime_types;
 static gboolean index_file;
 static gboolean backup;
+static gboolean incremental;
 static gboolean restore;
 static gboolean import;
 static gchar **filenames;
@@ -61,6 +62,9 @@ static GOptionEntry entries[] = {
 	{ "backup", 'b', 0, G_OPTION_ARG_NONE, &backup,
 	  N_("Backup current index / database to the file provided"),
 	  NULL },
+	{ "incremental", 0, 0, G_OPTION_ARG_NONE, &incremental,
+	  N_("Only store what changed since the last incremental backup to the same file (see --backup)"),
+	  NULL },
 	{ "restore", 'o', 0, G_OPTION_ARG_NONE, &restore,
 	  N_("Restore a database from a previous backup (see --backup)"),
 	  NULL },
@@ -184,32 +188,50 @@ index_or_reindex_file (void)
 static int
 import_turtle_files (void)
 {
-	TrackerSparqlConnection *connection;
-	GError *error = NULL;
+	GDBusConnection *connection;
+	GDBusProxy *proxy;
 	gchar **p;
 
-	connection = tracker_sparql_connection_get (NULL, &error);
-
-	if (!connection) {
-		g_printerr ("%s: %s\n",
-		            _("Could not establish a connection to Tracker"),
-		            error ? error->message : _("No error given"));
-		g_clear_error (&error);
+	if (!tracker_dbus_get_connection ("org.freedesktop.Tracker1",
+	                                  "/org/freedesktop/Tracker1/Resources",
+	                                  "org.freedesktop.Tracker1.Resources",
+	                                  G_DBUS_PROXY_FLAGS_NONE,
+	                                  &connection,
+	                                  &proxy)) {
 		return EXIT_FAILURE;
 	}
 
+	/* Large imports can take some time */
+	g_dbus_proxy_set_default_timeout (proxy, G_MAXINT);
+
 	for (p = filenames; *p; p++) {
 		GError *error = NULL;
+		GVariant *v;
 		GFile *file;
+		gchar *uri;
 
 		g_print ("%s:'%s'\n",
 		         _("Importing Turtle file"),
 		         *p);
 
 		file = g_file_new_for_commandline_arg (*p);
-		tracker_sparql_connection_load (connection, file, NULL, &error);
+		uri = g_file_get_uri (file);
 		g_object_unref (file);
 
+		/* Datasets may be big, have them committed in chunks */
+		v = g_dbus_proxy_call_sync (proxy,
+		                            "BulkLoad",
+		                            g_variant_new ("(s)", uri),
+		                            G_DBUS_CALL_FLAGS_NONE,
+		                            -1,
+		                            NULL,
+		                            &error);
+		g_free (uri);
+
+		if (v) {
+			g_variant_unref (v);
+		}
+
 		if (error) {
 			g_printerr ("  %s, %s\n",
 			            _("Unable to import Turtle file"),
@@ -223,7 +245,7 @@ import_turtle_files (void)
 		g_print ("\n");
 	}
 
-	g_object_unref (connection);
+	g_object_unref (proxy);
 
 	return EXIT_SUCCESS;
 }
@@ -255,7 +277,7 @@ backup_index (void)
 	g_dbus_proxy_set_default_timeout (proxy, G_MAXINT);
 
 	v = g_dbus_proxy_call_sync (proxy,
-	                            "Save",
+	                            incremental ? "SaveIncremental" : "Save",
 	                            g_variant_new ("(s)", uri),
 	                            G_DBUS_CALL_FLAGS_NONE,
 	                            -1,
@@ -437,6 +459,8 @@ tracker_index (int argc, const char **argv)
 		failed = _("Only one action (--backup, --restore, --index-file or --import) can be used at a time");
 	} else if (actions > 0 && (!filenames || g_strv_length (filenames) < 1)) {
 		failed = _("Missing one or more files which are required");
+	} else if (incremental && !backup) {
+		failed = _("The --incremental option can only be used with --backup");
 	} else if ((backup || restore) && (filenames && g_strv_length (filenames) > 1)) {
 		failed = _("Only one file can be used with --backup and --restore");
 	} else if (actions > 0 && (reindex_mime_types && g_strv_length (reindex_mime_types) > 0)) {
@@ -89,6 +89,8 @@ static gboolean parse_tree            (const gchar  *option_name,
 static gchar *file;
 static gchar *query;
 static gboolean update;
+static gboolean explain;
+static gboolean profile;
 static gboolean list_classes;
 static gboolean list_class_prefixes;
 static gchar *list_properties;
@@ -113,6 +115,14 @@ static GOptionEntry entries[] = {
 	  N_("This is used with --query and for database updates only."),
 	  NULL,
 	},
+	{ "explain", 0, 0, G_OPTION_ARG_NONE, &explain,
+	  N_("Show the SQL and query plan used for the query instead of running it"),
+	  NULL,
+	},
+	{ "profile", 0, 0, G_OPTION_ARG_NONE, &profile,
+	  N_("Run the query and show the time spent in each execution phase"),
+	  NULL,
+	},
 	{ "list-classes", 'c', 0, G_OPTION_ARG_NONE, &list_classes,
 	  N_("Retrieve classes"),
 	  NULL,
@@ -1068,6 +1078,61 @@ tree_get (TrackerSparqlConnection *connection,
 	return EXIT_SUCCESS;
 }
 
+static void
+print_explanation (GVariant *explanation)
+{
+	GVariantIter *iter;
+	const gchar *str;
+	gdouble time;
+	gboolean cache_hit;
+	guint64 n_rows;
+
+	if (g_variant_lookup (explanation, "sql", "&s", &str)) {
+		g_print ("%s:\n  %s\n\n", _("SQL"), str);
+	}
+
+	if (g_variant_lookup (explanation, "plan", "as", &iter)) {
+		g_print ("%s:\n", _("Query plan"));
+
+		while (g_variant_iter_next (iter, "&s", &str)) {
+			g_print ("  %s\n", str);
+		}
+
+		g_print ("\n");
+		g_variant_iter_free (iter);
+	}
+
+	g_print ("%s:\n", _("Timings"));
+
+	if (g_variant_lookup (explanation, "parse-time", "d", &time)) {
+		g_print ("  %-10s %.3f ms\n", _("Parse"), time * 1000);
+	}
+
+	if (g_variant_lookup (explanation, "translate-time", "d", &time)) {
+		g_print ("  %-10s %.3f ms\n", _("Translate"), time * 1000);
+	}
+
+	if (g_variant_lookup (explanation, "prepare-time", "d", &time)) {
+		g_print ("  %-10s %.3f ms", _("Prepare"), time * 1000);
+
+		if (g_variant_lookup (explanation, "statement-cache-hit", "b", &cache_hit)) {
+			g_print (" (%s)", cache_hit ?
+			         _("statement cache hit") :
+			         _("statement cache miss"));
+		}
+
+		g_print ("\n");
+	}
+
+	if (g_variant_lookup (explanation, "step-time", "d", &time)) {
+		g_print ("  %-10s %.3f ms\n", _("Step"), time * 1000);
+	}
+
+	if (g_variant_lookup (explanation, "rows", "t", &n_rows)) {
+		g_print ("\n%s: %" G_GUINT64_FORMAT "\n", _("Rows"), n_rows);
+	}
+}
+
 static int
 sparql_run (void)
 {
@@ -1423,6 +1488,22 @@ sparql_run (void)
 				}
 			}
 #endif
+		} else if (explain || profile) {
+			GVariant *explanation;
+
+			explanation = tracker_sparql_connection_explain (connection, query, profile, NULL, &error);
+
+			if (error) {
+				g_printerr ("%s, %s\n",
+				            _("Could not explain query"),
+				            error->message);
+				g_error_free (error);
+
+				return EXIT_FAILURE;
+			}
+
+			print_explanation (explanation);
+			g_variant_unref (explanation);
 		} else {
 			GHashTable *prefixes = NULL;
 
@@ -1504,6 +1585,10 @@ tracker_sparql (int argc, const char **argv)
 
 	if (file && query) {
 		failed = _("File and query can not be used together");
+	} else if ((explain || profile) && !(file || query)) {
+		failed = _("The --explain and --profile arguments can only be used with --query or --file");
+	} else if ((explain || profile) && update) {
+		failed = _("The --explain and --profile arguments can not be used with --update");
 	} else if (list_properties && list_properties[0] == '\0' && !tree) {
 		failed = _("The --list-properties argument can only be empty when used with the --tree argument");
 	} else {
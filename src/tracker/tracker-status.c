@@ -35,12 +35,17 @@
 
 #include "tracker-status.h"
 #include "tracker-config.h"
+#include "tracker-dbus.h"
 
 #define STATUS_OPTIONS_ENABLED()	  \
 	(show_stat || \
+	 show_slow_queries || \
+	 show_metrics || \
 	 collect_debug_info)
 
 static gboolean show_stat;
+static gboolean show_slow_queries;
+static gboolean show_metrics;
 static gboolean collect_debug_info;
 static gchar **terms;
 
@@ -49,6 +54,14 @@ static GOptionEntry entries[] = {
 	  N_("Show statistics for current index / data set"),
 	  NULL
 	},
+	{ "slow-queries", 0, 0, G_OPTION_ARG_NONE, &show_slow_queries,
+	  N_("Show the most recent queries and updates that exceeded the store slow query threshold"),
+	  NULL
+	},
+	{ "metrics", 0, 0, G_OPTION_ARG_NONE, &show_metrics,
+	  N_("Show runtime metrics of the store and running miners, in Prometheus text format"),
+	  NULL
+	},
 	{ "collect-debug-info", 0, 0, G_OPTION_ARG_NONE, &collect_debug_info,
 	  N_("Collect debug information useful for problem reporting and investigation, results are output to terminal"),
 	  NULL },
@@ -346,6 +359,191 @@ collect_debug (void)
 	return EXIT_SUCCESS;
 }
 
+static int
+status_slow_queries (void)
+{
+	GDBusConnection *connection;
+	GDBusProxy *proxy;
+	GError *error = NULL;
+	GVariantIter *iter;
+	GVariant *v, *entry;
+	gint n_entries = 0;
+
+	if (!tracker_dbus_get_connection ("org.freedesktop.Tracker1",
+	                                  "/org/freedesktop/Tracker1/Status",
+	                                  "org.freedesktop.Tracker1.Status",
+	                                  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+	                                  &connection,
+	                                  &proxy)) {
+		return EXIT_FAILURE;
+	}
+
+	v = g_dbus_proxy_call_sync (proxy,
+	                            "GetSlowQueries",
+	                            NULL,
+	                            G_DBUS_CALL_FLAGS_NONE,
+	                            -1,
+	                            NULL,
+	                            &error);
+	g_object_unref (proxy);
+
+	if (error) {
+		g_printerr ("%s, %s\n",
+		            _("Could not get slow queries"),
+		            error->message);
+		g_error_free (error);
+
+		return EXIT_FAILURE;
+	}
+
+	g_variant_get (v, "(aa{sv})", &iter);
+
+	while ((entry = g_variant_iter_next_value (iter)) != NULL) {
+		const gchar *query = NULL, *client = NULL;
+		gdouble queue_time = -1, translate_time = -1, execute_time = 0;
+		guint64 n_rows = 0, n_bytes = 0;
+		gint64 timestamp = 0;
+		GDateTime *datetime;
+		gchar *date;
+
+		g_variant_lookup (entry, "timestamp", "x", &timestamp);
+		g_variant_lookup (entry, "query", "&s", &query);
+		g_variant_lookup (entry, "client", "&s", &client);
+		g_variant_lookup (entry, "queue-time", "d", &queue_time);
+		g_variant_lookup (entry, "translate-time", "d", &translate_time);
+		g_variant_lookup (entry, "execute-time", "d", &execute_time);
+		g_variant_lookup (entry, "rows", "t", &n_rows);
+		g_variant_lookup (entry, "bytes", "t", &n_bytes);
+
+		datetime = g_date_time_new_from_unix_local (timestamp / G_USEC_PER_SEC);
+		date = g_date_time_format (datetime, "%x %X");
+
+		g_print ("%s  %s\n", date, client ? client : "");
+
+		if (queue_time >= 0 && translate_time >= 0) {
+			g_print ("  %s: %.3fs, %s: %.3fs, %s: %.3fs\n",
+			         _("Queued"), queue_time,
+			         _("Translation"), translate_time,
+			         _("Execution"), execute_time);
+			g_print ("  %s: %" G_GUINT64_FORMAT ", %s: %" G_GUINT64_FORMAT "\n",
+			         _("Rows"), n_rows,
+			         _("Bytes written"), n_bytes);
+		} else {
+			g_print ("  %s: %.3fs\n", _("Total"), execute_time);
+		}
+
+		g_print ("  %s\n\n", query ? query : "");
+
+		g_free (date);
+		g_date_time_unref (datetime);
+		g_variant_unref (entry);
+		n_entries++;
+	}
+
+	if (n_entries == 0) {
+		g_print ("%s\n", _("No slow queries were recorded"));
+	}
+
+	g_variant_iter_free (iter);
+	g_variant_unref (v);
+
+	return EXIT_SUCCESS;
+}
+
+static gboolean
+print_metrics (GDBusConnection *connection,
+               const gchar     *name,
+               const gchar     *object_path)
+{
+	GError *error = NULL;
+	const gchar *metrics;
+	GVariant *v;
+
+	v = g_dbus_connection_call_sync (connection,
+	                                 name,
+	                                 object_path,
+	                                 "org.freedesktop.Tracker1.Metrics",
+	                                 "GetMetrics",
+	                                 NULL,
+	                                 G_VARIANT_TYPE ("(s)"),
+	                                 G_DBUS_CALL_FLAGS_NONE,
+	                                 -1,
+	                                 NULL,
+	                                 &error);
+
+	if (error) {
+		g_printerr ("%s '%s', %s\n",
+		            _("Could not get metrics from"),
+		            name,
+		            error->message);
+		g_error_free (error);
+
+		return FALSE;
+	}
+
+	g_variant_get (v, "(&s)", &metrics);
+	g_print ("# %s\n%s\n", name, metrics);
+	g_variant_unref (v);
+
+	return TRUE;
+}
+
+static int
+status_metrics (void)
+{
+	TrackerMinerManager *manager;
+	GDBusConnection *connection;
+	GError *error = NULL;
+	GSList *miners_running, *l;
+	gboolean success;
+
+	connection = g_bus_get_sync (TRACKER_IPC_BUS, NULL, &error);
+
+	if (!connection) {
+		g_printerr ("%s, %s\n",
+		            _("Could not get D-Bus connection"),
+		            error ? error->message : _("No error given"));
+		g_clear_error (&error);
+
+		return EXIT_FAILURE;
+	}
+
+	success = print_metrics (connection,
+	                         "org.freedesktop.Tracker1",
+	                         "/org/freedesktop/Tracker1/Metrics");
+
+	/* Don't auto-start the miners here */
+	manager = tracker_miner_manager_new_full (FALSE, &error);
+
+	if (manager) {
+		miners_running = tracker_miner_manager_get_running (manager);
+
+		for (l = miners_running; l; l = l->next) {
+			gchar *path;
+
+			/* Miners export metrics on their own object,
+			 * named after their D-Bus name.
+			 */
+			path = g_strconcat ("/", l->data, NULL);
+			g_strdelimit (path, ".", '/');
+			print_metrics (connection, l->data, path);
+			g_free (path);
+		}
+
+		g_slist_free_full (miners_running, g_free);
+		g_object_unref (manager);
+	} else {
+		g_printerr ("%s, %s\n",
+		            _("Could not get metrics from miners, manager could not be created"),
+		            error ? error->message : _("No error given"));
+		g_clear_error (&error);
+	}
+
+	g_object_unref (connection);
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 static int
 status_run (void)
 {
@@ -353,6 +551,14 @@ status_run (void)
 		return status_stat ();
 	}
 
+	if (show_slow_queries) {
+		return status_slow_queries ();
+	}
+
+	if (show_metrics) {
+		return status_metrics ();
+	}
+
 	if (collect_debug_info) {
 		return collect_debug ();
 	}
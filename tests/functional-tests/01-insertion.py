@@ -28,6 +28,10 @@ import time
 import random
 import string
 import datetime
+import shutil
+import tempfile
+
+from gi.repository import GLib
 
 from common.utils import configuration as cfg
 import unittest2 as ut
@@ -851,5 +855,69 @@ class TrackerStorePhoneNumberTest (CommonTrackerStoreTest):
                 self.assertRaises (Exception, self.tracker.update (INSERT_SPARQL))
 
 
+class TrackerStoreLoadTest (CommonTrackerStoreTest):
+    """
+    Load Turtle files with Resources.Load and Resources.BulkLoad
+    """
+    def setUp (self):
+        self.ttl_dir = tempfile.mkdtemp ()
+
+    def tearDown (self):
+        shutil.rmtree (self.ttl_dir)
+        self.tracker.update ("""
+            DELETE { ?u a rdfs:Resource } WHERE {
+                ?u a nmm:MusicAlbum . FILTER (STRSTARTS (STR (?u), 'test://load-'))
+            }
+        """)
+
+    def __write_ttl (self, name, n_albums, broken=False):
+        path = os.path.join (self.ttl_dir, name)
+
+        with open (path, 'w') as f:
+            f.write ("@prefix nmm: <http://www.tracker-project.org/temp/nmm#> .\n")
+            f.write ("@prefix nie: <http://www.semanticdesktop.org/ontologies/2007/01/19/nie#> .\n")
+            for i in range (0, n_albums):
+                f.write ("<test://load-%s-%d> a nmm:MusicAlbum ; nie:title 'loadalbum %d' .\n" % (name, i, i))
+            if broken:
+                f.write ("<test://load-broken> a nmm:MusicAlbum ; nie:title .\n")
+
+        return "file://" + path
+
+    def __count_albums (self):
+        results = self.tracker.query ("""
+            SELECT COUNT(?u) WHERE {
+                ?u a nmm:MusicAlbum . FILTER (STRSTARTS (STR (?u), 'test://load-'))
+            }""")
+        return int (results[0][0])
+
+    def test_load_is_atomic (self):
+        uri = self.__write_ttl ("atomic.ttl", 100, broken=True)
+
+        self.assertRaises (GLib.GError, self.tracker.load, uri)
+        self.assertEquals (self.__count_albums (), 0)
+
+    def test_load_fts (self):
+        uri = self.__write_ttl ("fts.ttl", 10)
+
+        self.tracker.load (uri)
+        self.assertEquals (self.__count_albums (), 10)
+
+        # Full text search is up to date as soon as Load returns
+        results = self.tracker.query ("""
+            SELECT ?u WHERE { ?u a nmm:MusicAlbum ; fts:match 'loadalbum' }""")
+        self.assertEquals (len (results), 10)
+
+    def test_bulk_load (self):
+        uri = self.__write_ttl ("bulk.ttl", 100)
+
+        self.tracker.bulk_load (uri)
+        self.assertEquals (self.__count_albums (), 100)
+
+        # Full text search is rebuilt once the import finishes
+        results = self.tracker.query ("""
+            SELECT ?u WHERE { ?u a nmm:MusicAlbum ; fts:match 'loadalbum' }""")
+        self.assertEquals (len (results), 100)
+
+
 if __name__ == "__main__":
 	ut.main()
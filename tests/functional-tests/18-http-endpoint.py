@@ -0,0 +1,196 @@
+#!/usr/bin/python
+#
+# Copyright (C) 2018, Red Hat Inc.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+# 02110-1301, USA.
+#
+
+"""
+Query the store through its HTTP endpoint with a remote connection,
+and check the results match those obtained over D-Bus
+"""
+import gi
+gi.require_version ('Tracker', '2.0')
+
+from gi.repository import GLib
+from gi.repository import Tracker
+
+import gzip
+import json
+import os
+import socket
+import urllib2
+from StringIO import StringIO
+
+import unittest2 as ut
+from common.utils.helpers import StoreHelper
+
+AMOUNT_OF_INSTANCES = 500
+
+def find_free_port ():
+    sock = socket.socket (socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind (("127.0.0.1", 0))
+    port = sock.getsockname ()[1]
+    sock.close ()
+    return port
+
+HTTP_PORT = find_free_port ()
+ENDPOINT = "http://127.0.0.1:%d/sparql" % HTTP_PORT
+
+class HttpStoreHelper (StoreHelper):
+    FLAGS = ['--http-port', str (HTTP_PORT)]
+
+class TestHttpEndpoint (ut.TestCase):
+    @classmethod
+    def setUpClass (self):
+        env = os.environ
+        env['LC_COLLATE'] = 'en_GB.utf8'
+
+        self.tracker = HttpStoreHelper ()
+        self.tracker.start (env=env)
+
+        query = "INSERT {\n"
+        for i in range (0, AMOUNT_OF_INSTANCES):
+            query += "<test-18:instance-%d> a nco:PersonContact ; nco:fullname 'moe \"%d\"\\n' .\n" % (i, i)
+        query += "}"
+        self.tracker.update (query)
+
+        token_path = os.path.join (GLib.get_user_runtime_dir (), "tracker", "http-token")
+        with open (token_path) as f:
+            self.token = f.read ()
+
+        self.conn = Tracker.SparqlConnection.remote_new (ENDPOINT + "?token=%s&query=" % self.token)
+
+    @classmethod
+    def tearDownClass (self):
+        self.tracker.update ("DELETE { ?u a rdfs:Resource } WHERE { ?u a nco:PersonContact . FILTER (STRSTARTS (STR (?u), 'test-18:')) }")
+        self.tracker.stop ()
+
+    def __read_cursor (self, cursor):
+        rows = []
+
+        while cursor.next (None):
+            row = []
+            for i in range (cursor.get_n_columns ()):
+                row.append ((cursor.get_value_type (i), cursor.get_string (i)[0]))
+            rows.append (row)
+
+        return rows
+
+    def __read_cursor_async (self, cursor):
+        loop = GLib.MainLoop ()
+        rows = []
+        errors = []
+
+        def next_cb (cursor, result, data):
+            try:
+                if cursor.next_finish (result):
+                    rows.append ([(cursor.get_value_type (i), cursor.get_string (i)[0])
+                                  for i in range (cursor.get_n_columns ())])
+                    cursor.next_async (None, next_cb, None)
+                    return
+            except GLib.Error as e:
+                errors.append (e)
+            loop.quit ()
+
+        cursor.next_async (None, next_cb, None)
+        loop.run ()
+
+        if errors:
+            raise errors[0]
+
+        return rows
+
+    def __check_rows (self, cursor, rows, query):
+        self.assertEquals (cursor.get_n_columns (), 2)
+        self.assertEquals (cursor.get_variable_name (0), "u")
+        self.assertEquals (cursor.get_variable_name (1), "name")
+
+        expected = [[(Tracker.SparqlValueType.URI, u), (Tracker.SparqlValueType.STRING, name)]
+                    for u, name in self.tracker.query (query)]
+        self.assertEquals (len (rows), AMOUNT_OF_INSTANCES)
+        self.assertEquals (rows, expected)
+
+    def test_http_01_query (self):
+        query = "SELECT ?u ?name { ?u nco:fullname ?name . FILTER (STRSTARTS (STR (?u), 'test-18:')) } ORDER BY ?u"
+        cursor = self.conn.query (query, None)
+
+        self.__check_rows (cursor, self.__read_cursor (cursor), query)
+
+    def test_http_02_query_async (self):
+        query = "SELECT ?u ?name { ?u nco:fullname ?name . FILTER (STRSTARTS (STR (?u), 'test-18:')) } ORDER BY DESC (?u)"
+        loop = GLib.MainLoop ()
+        cursors = []
+
+        def query_cb (conn, result, data):
+            cursors.append (conn.query_finish (result))
+            loop.quit ()
+
+        self.conn.query_async (query, None, query_cb, None)
+        loop.run ()
+
+        self.__check_rows (cursors[0], self.__read_cursor_async (cursors[0]), query)
+
+    def test_http_03_unbound (self):
+        query = "SELECT ?u ?name { ?u a nco:PersonContact . OPTIONAL { ?u nco:nickname ?name } FILTER (?u = <test-18:instance-1>) }"
+        cursor = self.conn.query (query, None)
+
+        self.assertEquals (self.__read_cursor (cursor),
+                           [[(Tracker.SparqlValueType.URI, "test-18:instance-1"),
+                             (Tracker.SparqlValueType.UNBOUND, None)]])
+
+    def test_http_04_error (self):
+        with self.assertRaises (GLib.Error):
+            self.conn.query ("SELECT ?u { ?u a nco:Foo }", None)
+
+    def test_http_05_post_gzip (self):
+        # Remote connections only send GET requests, check the
+        # rest of the protocol directly
+        query = "SELECT ?u ?name { ?u nco:fullname ?name . FILTER (STRSTARTS (STR (?u), 'test-18:')) } ORDER BY ?u"
+        request = urllib2.Request (ENDPOINT, query, {
+            "Content-Type": "application/sparql-query",
+            "Accept-Encoding": "gzip",
+            "Authorization": "Bearer " + self.token })
+        reply = urllib2.urlopen (request)
+
+        self.assertEquals (reply.info ().gettype (), "application/sparql-results+json")
+        self.assertEquals (reply.info ().getheader ("Content-Encoding"), "gzip")
+
+        results = json.loads (gzip.GzipFile (fileobj=StringIO (reply.read ())).read ())
+        self.assertEquals (results["head"]["vars"], ["u", "name"])
+
+        rows = [[b["u"]["value"], b["name"]["value"]] for b in results["results"]["bindings"]]
+        expected = [[unicode (u), unicode (name)] for u, name in self.tracker.query (query)]
+        self.assertEquals (rows, expected)
+
+    def test_http_06_no_token (self):
+        request = urllib2.Request (ENDPOINT + "?query=" + urllib2.quote ("SELECT ?u { ?u a rdfs:Class }"))
+
+        with self.assertRaises (urllib2.HTTPError) as cm:
+            urllib2.urlopen (request)
+        self.assertEquals (cm.exception.code, 401)
+
+    def test_http_07_foreign_host (self):
+        # As sent by a browser after DNS rebinding
+        request = urllib2.Request (ENDPOINT + "?token=%s&query=%s" % (self.token, urllib2.quote ("SELECT ?u { ?u a rdfs:Class }")),
+                                   headers={ "Host": "attacker.example.com:%d" % HTTP_PORT })
+
+        with self.assertRaises (urllib2.HTTPError) as cm:
+            urllib2.urlopen (request)
+        self.assertEquals (cm.exception.code, 403)
+
+if __name__ == "__main__":
+    ut.main ()
@@ -0,0 +1,193 @@
+#!/usr/bin/python
+#
+# Copyright (C) 2018, Red Hat Inc.
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+# 02110-1301, USA.
+#
+
+"""
+Check that TrackerSparqlCachedConnection answers repeated queries from
+memory, evicts least recently used results, and drops results as soon
+as the store reports changes on the classes they depend on
+"""
+import gi
+gi.require_version ('Tracker', '2.0')
+
+from gi.repository import GLib
+from gi.repository import Tracker
+
+import time
+
+import unittest2 as ut
+from common.utils.storetest import CommonTrackerStoreTest as CommonTrackerStoreTest
+
+REASONABLE_TIMEOUT = 10 # Time waiting for the notifier to catch up
+SETTLE_TIME = 2 # Longer than the store's GraphUpdated delay
+
+CONTACTS_QUERY = """
+SELECT ?u ?name WHERE {
+    ?u a nco:PersonContact ; nco:fullname ?name .
+    FILTER (STRSTARTS (STR (?u), 'test-19:'))
+} ORDER BY ?u
+"""
+
+GROUPS_QUERY = """
+SELECT ?u ?name WHERE {
+    ?u a nco:ContactGroup ; nco:contactGroupName ?name .
+    FILTER (STRSTARTS (STR (?u), 'test-19:'))
+} ORDER BY ?u
+"""
+
+class TrackerQueryCacheTests (CommonTrackerStoreTest):
+    def setUp (self):
+        self.tracker.update ("""
+            INSERT { <test-19:contact-1> a nco:PersonContact ; nco:fullname 'Contact 1' .
+                     <test-19:group-1> a nco:ContactGroup ; nco:contactGroupName 'Group 1' }
+        """)
+
+        self.conn = Tracker.SparqlConnection.get (None)
+        self.cache = Tracker.SparqlCachedConnection.new (self.conn, 1024 * 1024, None)
+
+        # Let the notifications for the changes above go by, so
+        # they don't invalidate the entries tests make
+        self.__iterate (SETTLE_TIME)
+
+    def tearDown (self):
+        self.tracker.update ("""
+            DELETE { ?u a rdfs:Resource } WHERE {
+                ?u a rdfs:Resource . FILTER (STRSTARTS (STR (?u), 'test-19:'))
+            }
+        """)
+        self.cache = None
+
+    def __query (self, sparql):
+        cursor = self.cache.query (sparql, None)
+        rows = []
+
+        while cursor.next (None):
+            rows.append (tuple (cursor.get_string (i)[0] for i in range (cursor.get_n_columns ())))
+
+        cursor.close ()
+        return rows
+
+    def __iterate (self, seconds, until=None):
+        context = GLib.MainContext.default ()
+        deadline = time.time () + seconds
+
+        while time.time () < deadline:
+            if until and until ():
+                return True
+            context.iteration (False)
+            time.sleep (0.05)
+
+        return False
+
+    def __wait_for_invalidation (self, n_invalidations):
+        if not self.__iterate (REASONABLE_TIMEOUT,
+                               lambda: self.cache.props.n_invalidations != n_invalidations):
+            self.fail ("Timeout, the cached entry was never invalidated")
+
+    def test_01_hit_and_miss (self):
+        first = self.__query (CONTACTS_QUERY)
+        self.assertEqual (first, [("test-19:contact-1", "Contact 1")])
+        self.assertEqual (self.cache.props.n_misses, 1)
+        self.assertEqual (self.cache.props.n_hits, 0)
+        self.assertGreater (self.cache.props.size, 0)
+
+        second = self.__query (CONTACTS_QUERY)
+        self.assertEqual (first, second)
+        self.assertEqual (self.cache.props.n_misses, 1)
+        self.assertEqual (self.cache.props.n_hits, 1)
+
+        # A different query text is a different entry
+        self.__query (GROUPS_QUERY)
+        self.assertEqual (self.cache.props.n_misses, 2)
+
+    def test_02_lru_eviction (self):
+        self.__query (CONTACTS_QUERY)
+        contacts_size = self.cache.props.size
+
+        # Room for a single entry
+        self.cache.props.max_size = contacts_size + contacts_size / 2
+
+        self.__query (GROUPS_QUERY)
+        self.assertLessEqual (self.cache.props.size, self.cache.props.max_size)
+
+        # The least recently used one was evicted
+        self.__query (GROUPS_QUERY)
+        self.assertEqual (self.cache.props.n_hits, 1)
+        self.__query (CONTACTS_QUERY)
+        self.assertEqual (self.cache.props.n_misses, 3)
+
+        # Shrinking the budget evicts right away
+        self.cache.props.max_size = 0
+        self.assertEqual (self.cache.props.size, 0)
+
+    def test_03_invalidation_on_notifier_event (self):
+        self.__query (CONTACTS_QUERY)
+        self.__query (GROUPS_QUERY)
+        n_invalidations = self.cache.props.n_invalidations
+
+        # Changed through another connection, only the notifier knows
+        self.tracker.update ("INSERT { <test-19:contact-2> a nco:PersonContact ; nco:fullname 'Contact 2' }")
+        self.__wait_for_invalidation (n_invalidations)
+
+        self.assertEqual (self.__query (CONTACTS_QUERY),
+                          [("test-19:contact-1", "Contact 1"),
+                           ("test-19:contact-2", "Contact 2")])
+        self.assertEqual (self.cache.props.n_misses, 3)
+
+        # Entries on other classes are kept
+        self.__query (GROUPS_QUERY)
+        self.assertEqual (self.cache.props.n_hits, 1)
+
+    def test_04_flush_on_update (self):
+        self.__query (CONTACTS_QUERY)
+        self.__query (GROUPS_QUERY)
+
+        # Read your own writes, without waiting for the notifier
+        self.cache.update ("INSERT { <test-19:group-2> a nco:ContactGroup ; nco:contactGroupName 'Group 2' }",
+                           GLib.PRIORITY_DEFAULT, None)
+        self.assertEqual (self.cache.props.size, 0)
+
+        self.assertEqual (self.__query (GROUPS_QUERY),
+                          [("test-19:group-1", "Group 1"),
+                           ("test-19:group-2", "Group 2")])
+        self.__query (CONTACTS_QUERY)
+        self.assertEqual (self.cache.props.n_hits, 0)
+        self.assertEqual (self.cache.props.n_misses, 4)
+
+    def test_05_too_big_to_cache (self):
+        self.tracker.update ("""
+            INSERT { <test-19:contact-2> a nco:PersonContact ; nco:fullname 'Contact 2' .
+                     <test-19:contact-3> a nco:PersonContact ; nco:fullname 'Contact 3' }
+        """)
+        self.__iterate (SETTLE_TIME)
+
+        # Not even the first row fits, all rows still come through
+        self.cache.props.max_size = 1
+        self.assertEqual (self.__query (CONTACTS_QUERY),
+                          [("test-19:contact-1", "Contact 1"),
+                           ("test-19:contact-2", "Contact 2"),
+                           ("test-19:contact-3", "Contact 3")])
+        self.assertEqual (self.cache.props.size, 0)
+
+        self.__query (CONTACTS_QUERY)
+        self.assertEqual (self.cache.props.n_hits, 0)
+        self.assertEqual (self.cache.props.n_misses, 2)
+
+if __name__ == "__main__":
+    ut.main()
@@ -256,6 +256,9 @@ class StoreHelper (Helper):
     def load (self, ttl_uri, timeout=5000, **kwargs):
         return self.resources.Load ('(s)', ttl_uri, timeout=timeout, **kwargs)
 
+    def bulk_load (self, ttl_uri, timeout=5000, **kwargs):
+        return self.resources.BulkLoad ('(s)', ttl_uri, timeout=timeout, **kwargs)
+
     def batch_update (self, update_sparql, **kwargs):
         return self.resources.BatchSparqlUpdate ('(s)', update_sparql, **kwargs)
 
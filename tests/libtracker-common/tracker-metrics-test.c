@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <libtracker-common/tracker-metrics.h>
+
+static void
+assert_dump_contains (const gchar *line)
+{
+	gchar *dump;
+
+	dump = tracker_metrics_dump ();
+
+	if (!strstr (dump, line)) {
+		g_test_message ("Metrics dump:\n%s", dump);
+		g_assert_not_reached ();
+	}
+
+	g_free (dump);
+}
+
+static void
+test_metrics_counter (void)
+{
+	TrackerMetric *metric;
+
+	metric = tracker_metrics_counter ("test_counter_total", NULL, "A counter");
+	g_assert (metric != NULL);
+	g_assert (tracker_metrics_counter ("test_counter_total", NULL, "A counter") == metric);
+
+	tracker_metric_add (metric, 1);
+	tracker_metric_add (metric, 2);
+
+	assert_dump_contains ("# HELP test_counter_total A counter\n"
+	                      "# TYPE test_counter_total counter\n"
+	                      "test_counter_total 3\n");
+}
+
+static void
+test_metrics_labels (void)
+{
+	TrackerMetric *a, *b;
+
+	a = tracker_metrics_counter ("test_labels_total", "op=\"a\"", "Labelled");
+	b = tracker_metrics_counter ("test_labels_total", "op=\"b\"", "Labelled");
+	g_assert (a != b);
+
+	tracker_metric_add (a, 1);
+	tracker_metric_add (b, 5);
+
+	/* Both share a single HELP/TYPE header */
+	assert_dump_contains ("# TYPE test_labels_total counter\n"
+	                      "test_labels_total{op=\"a\"} 1\n"
+	                      "test_labels_total{op=\"b\"} 5\n");
+}
+
+static void
+test_metrics_gauge (void)
+{
+	TrackerMetric *metric;
+
+	metric = tracker_metrics_gauge ("test_gauge", NULL, "A gauge");
+	tracker_metric_set (metric, 10);
+	tracker_metric_set (metric, 0.25);
+
+	assert_dump_contains ("# TYPE test_gauge gauge\n"
+	                      "test_gauge 0.25\n");
+}
+
+static void
+test_metrics_histogram (void)
+{
+	const gdouble buckets[] = { 1, 10, 100 };
+	TrackerMetric *metric;
+
+	metric = tracker_metrics_histogram ("test_histogram", "op=\"h\"", "A histogram",
+	                                    buckets, G_N_ELEMENTS (buckets));
+	tracker_metric_observe (metric, 0.5);
+	tracker_metric_observe (metric, 5);
+	tracker_metric_observe (metric, 50);
+	tracker_metric_observe (metric, 500);
+
+	/* Buckets are cumulative */
+	assert_dump_contains ("# TYPE test_histogram histogram\n"
+	                      "test_histogram_bucket{op=\"h\",le=\"1\"} 1\n"
+	                      "test_histogram_bucket{op=\"h\",le=\"10\"} 2\n"
+	                      "test_histogram_bucket{op=\"h\",le=\"100\"} 3\n"
+	                      "test_histogram_bucket{op=\"h\",le=\"+Inf\"} 4\n"
+	                      "test_histogram_sum{op=\"h\"} 555.5\n"
+	                      "test_histogram_count{op=\"h\"} 4\n");
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/libtracker-common/metrics/counter",
+	                 test_metrics_counter);
+	g_test_add_func ("/libtracker-common/metrics/labels",
+	                 test_metrics_labels);
+	g_test_add_func ("/libtracker-common/metrics/gauge",
+	                 test_metrics_gauge);
+	g_test_add_func ("/libtracker-common/metrics/histogram",
+	                 test_metrics_histogram);
+
+	return g_test_run ();
+}
@@ -157,6 +157,7 @@ test_backup_and_restore_helper (const gchar *db_location,
 	tracker_data_backup_save (manager,
 	                          backup_file,
 				  data_location,
+	                          FALSE,
 	                          backup_finished_cb,
 	                          NULL,
 	                          NULL);
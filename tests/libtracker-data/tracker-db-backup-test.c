@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data.h>
+#include <libtracker-data/tracker-db-backup.h>
+
+typedef struct {
+	gchar *dir;
+	GFile *db_file;
+	GFile *backup_file;
+	GMainLoop *loop;
+	gdouble last_progress;
+	gint n_progress;
+} TestInfo;
+
+static void
+insert_rows (GFile *db_file,
+             gint   first,
+             gint   n_rows)
+{
+	TrackerDBInterface *iface;
+	GError *error = NULL;
+	gchar *path;
+	gint i;
+
+	path = g_file_get_path (db_file);
+	iface = tracker_db_interface_sqlite_new (path, 0, &error);
+	g_assert_no_error (error);
+
+	tracker_db_interface_execute_query (iface, &error,
+	                                    "CREATE TABLE IF NOT EXISTS t (id INTEGER PRIMARY KEY, value TEXT)");
+	g_assert_no_error (error);
+
+	tracker_db_interface_start_transaction (iface);
+
+	for (i = first; i < first + n_rows; i++) {
+		tracker_db_interface_execute_query (iface, &error,
+		                                    "INSERT INTO t VALUES (%d, '%0512d')", i, i);
+		g_assert_no_error (error);
+	}
+
+	tracker_db_interface_end_db_transaction (iface, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (iface);
+	g_free (path);
+}
+
+static gint
+count_rows (GFile *db_file)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gchar *path;
+	gint count;
+
+	path = g_file_get_path (db_file);
+	iface = tracker_db_interface_sqlite_new (path, TRACKER_DB_INTERFACE_READONLY, &error);
+	g_assert_no_error (error);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              &error, "SELECT COUNT(*) FROM t");
+	g_assert_no_error (error);
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+
+	g_assert (tracker_db_cursor_iter_next (cursor, NULL, &error));
+	count = tracker_db_cursor_get_int (cursor, 0);
+
+	g_object_unref (cursor);
+	g_object_unref (stmt);
+	g_object_unref (iface);
+	g_free (path);
+
+	return count;
+}
+
+static void
+backup_progress_cb (gdouble  progress,
+                    gpointer user_data)
+{
+	TestInfo *info = user_data;
+
+	g_assert_cmpfloat (progress, >=, info->last_progress);
+	g_assert_cmpfloat (progress, <=, 1);
+	info->last_progress = progress;
+	info->n_progress++;
+}
+
+static void
+backup_finished_cb (GError   *error,
+                    gpointer  user_data)
+{
+	TestInfo *info = user_data;
+
+	g_assert_no_error (error);
+	g_main_loop_quit (info->loop);
+}
+
+static void
+run_backup (TestInfo *info,
+            gboolean  incremental)
+{
+	info->last_progress = 0;
+	info->n_progress = 0;
+
+	/* Tiny steps, so there's some progress to report */
+	tracker_db_backup_save_full (info->backup_file, info->db_file,
+	                             incremental, 4, 0,
+	                             backup_progress_cb,
+	                             backup_finished_cb,
+	                             info, NULL);
+	g_main_loop_run (info->loop);
+
+	g_assert_cmpint (info->n_progress, >, 0);
+}
+
+static GFile *
+get_file (TestInfo    *info,
+          const gchar *name)
+{
+	GFile *file;
+	gchar *path;
+
+	path = g_build_filename (info->dir, name, NULL);
+	file = g_file_new_for_path (path);
+	g_free (path);
+
+	return file;
+}
+
+static void
+test_db_backup_incremental (TestInfo      *info,
+                            gconstpointer  context)
+{
+	GFile *restored, *delta;
+	GError *error = NULL;
+	GFileInfo *file_info;
+	goffset delta_size, db_size;
+
+	/* The first one writes the base */
+	insert_rows (info->db_file, 0, 200);
+	run_backup (info, TRUE);
+	g_assert (g_file_query_exists (info->backup_file, NULL));
+
+	/* Without changes, the delta holds no pages */
+	run_backup (info, TRUE);
+
+	insert_rows (info->db_file, 200, 10);
+	run_backup (info, TRUE);
+
+	delta = get_file (info, "backup.db.2.delta");
+	g_assert (g_file_query_exists (delta, NULL));
+
+	/* Only the changed pages are stored */
+	file_info = g_file_query_info (delta, G_FILE_ATTRIBUTE_STANDARD_SIZE, 0, NULL, &error);
+	g_assert_no_error (error);
+	delta_size = g_file_info_get_size (file_info);
+	g_object_unref (file_info);
+
+	file_info = g_file_query_info (info->db_file, G_FILE_ATTRIBUTE_STANDARD_SIZE, 0, NULL, &error);
+	g_assert_no_error (error);
+	db_size = g_file_info_get_size (file_info);
+	g_object_unref (file_info);
+
+	g_assert_cmpint (delta_size, <, db_size / 2);
+
+	restored = get_file (info, "restored.db");
+	g_assert (tracker_db_backup_restore (info->backup_file, restored, &error));
+	g_assert_no_error (error);
+	g_assert_cmpint (count_rows (restored), ==, 210);
+
+	g_object_unref (restored);
+	g_object_unref (delta);
+}
+
+static void
+test_db_backup_plain (TestInfo      *info,
+                      gconstpointer  context)
+{
+	GFile *restored, *delta, *stale_delta;
+	GError *error = NULL;
+
+	insert_rows (info->db_file, 0, 200);
+	run_backup (info, TRUE);
+	insert_rows (info->db_file, 200, 10);
+	run_backup (info, TRUE);
+
+	delta = get_file (info, "backup.db.1.delta");
+	g_assert (g_file_query_exists (delta, NULL));
+
+	/* Plain backups leave whatever is next to them alone */
+	insert_rows (info->db_file, 210, 5);
+	run_backup (info, FALSE);
+	g_assert (g_file_query_exists (delta, NULL));
+
+	/* ...and the deltas of the replaced base are skipped */
+	restored = get_file (info, "restored.db");
+	g_assert (tracker_db_backup_restore (info->backup_file, restored, &error));
+	g_assert_no_error (error);
+	g_assert_cmpint (count_rows (restored), ==, 215);
+
+	/* The manifest no longer describes the base, so this starts over */
+	insert_rows (info->db_file, 215, 5);
+	run_backup (info, TRUE);
+	stale_delta = get_file (info, "backup.db.2.delta");
+	g_assert (!g_file_query_exists (stale_delta, NULL));
+
+	g_assert (tracker_db_backup_restore (info->backup_file, restored, &error));
+	g_assert_no_error (error);
+	g_assert_cmpint (count_rows (restored), ==, 220);
+
+	g_object_unref (stale_delta);
+	g_object_unref (restored);
+	g_object_unref (delta);
+}
+
+static void
+setup (TestInfo      *info,
+       gconstpointer  context)
+{
+	GError *error = NULL;
+
+	info->dir = g_dir_make_tmp ("db-backup-test-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	info->db_file = get_file (info, "meta.db");
+	info->backup_file = get_file (info, "backup.db");
+	info->loop = g_main_loop_new (NULL, FALSE);
+}
+
+static void
+teardown (TestInfo      *info,
+          gconstpointer  context)
+{
+	gchar *cleanup_command;
+
+	cleanup_command = g_strdup_printf ("rm -Rf %s/", info->dir);
+	g_spawn_command_line_sync (cleanup_command, NULL, NULL, NULL, NULL);
+	g_free (cleanup_command);
+
+	g_object_unref (info->db_file);
+	g_object_unref (info->backup_file);
+	g_main_loop_unref (info->loop);
+	g_free (info->dir);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/libtracker-data/db-backup/incremental", TestInfo, NULL,
+	            setup, test_db_backup_incremental, teardown);
+	g_test_add ("/libtracker-data/db-backup/plain", TestInfo, NULL,
+	            setup, test_db_backup_plain, teardown);
+
+	return g_test_run ();
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data.h>
+
+static gchar *tests_data_dir = NULL;
+
+typedef struct {
+	gchar *data_location;
+} TestInfo;
+
+#ifndef DISABLE_JOURNAL
+
+static const gchar *updates[] = {
+	"INSERT { <urn:compaction:1> a nie:InformationElement ; nie:title \"first\" ; "
+	"         nie:keyword \"a\" , \"b\" , \"c\" ; nie:contentCreated \"2018-03-04T10:20:30+02:00\" }",
+	"INSERT { GRAPH <urn:compaction:graph> { <urn:compaction:2> a nie:InformationElement ; nie:title \"second\" } }",
+	"INSERT { <urn:compaction:3> a nie:InformationElement ; nie:title \"removed\" }",
+	"DELETE { <urn:compaction:1> nie:keyword \"b\" }",
+	"DELETE { <urn:compaction:1> nie:title ?t } WHERE { <urn:compaction:1> nie:title ?t } "
+	"INSERT { <urn:compaction:1> nie:title \"renamed\" }",
+	"DELETE { <urn:compaction:3> a rdfs:Resource }",
+	NULL
+};
+
+/* Left in the journal tail, after the snapshot */
+static const gchar *tail_updates[] = {
+	"INSERT { <urn:compaction:4> a nie:InformationElement ; nie:title \"fourth\" ; nie:isPartOf <urn:compaction:1> }",
+	"DELETE { <urn:compaction:1> nie:keyword \"c\" }",
+	NULL
+};
+
+static const gchar *queries[] = {
+	"SELECT ?u ?t ?d { ?u a nie:InformationElement ; nie:title ?t . OPTIONAL { ?u nie:contentCreated ?d } } ORDER BY ?u",
+	"SELECT ?u ?k { ?u nie:keyword ?k } ORDER BY ?u ?k",
+	"SELECT ?g ?u { GRAPH ?g { ?u a nie:InformationElement } } ORDER BY ?g ?u",
+	"SELECT ?u ?p { ?u nie:isPartOf ?p } ORDER BY ?u",
+	NULL
+};
+
+static gchar *
+dump_queries (TrackerDataManager *manager)
+{
+	GString *str;
+	guint i;
+
+	str = g_string_new (NULL);
+
+	for (i = 0; queries[i]; i++) {
+		TrackerDBCursor *cursor;
+		GError *error = NULL;
+
+		cursor = tracker_data_query_sparql_cursor (manager, queries[i], &error);
+		g_assert_no_error (error);
+
+		while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+			guint col, n_cols = tracker_db_cursor_get_n_columns (cursor);
+
+			for (col = 0; col < n_cols; col++) {
+				const gchar *value;
+
+				value = tracker_db_cursor_get_string (cursor, col, NULL);
+				g_string_append_printf (str, "%s\t", value ? value : "(null)");
+			}
+
+			g_string_append_c (str, '\n');
+		}
+
+		g_assert_no_error (error);
+		g_object_unref (cursor);
+		g_string_append_c (str, '\n');
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+static TrackerDataManager *
+create_manager (GFile *data_location,
+                GFile *ontology_location)
+{
+	TrackerDataManager *manager;
+	GError *error = NULL;
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                                    data_location, data_location, ontology_location,
+	                                    TRUE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	return manager;
+}
+
+static void
+run_updates (TrackerDataManager  *manager,
+             const gchar        **sparql)
+{
+	GError *error = NULL;
+	guint i;
+
+	for (i = 0; sparql[i]; i++) {
+		tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+		                            sparql[i], &error);
+		g_assert_no_error (error);
+	}
+}
+
+static void
+test_journal_compaction (TestInfo      *info,
+                         gconstpointer  context)
+{
+	GError *error = NULL;
+	GFile *data_location, *ontology_location;
+	TrackerDataManager *manager;
+	TrackerDataCompaction *compaction;
+	gchar *ontology_path, *path, *before, *after;
+
+	data_location = g_file_new_for_path (info->data_location);
+	ontology_path = g_build_filename (TOP_SRCDIR, "src", "ontologies", "nepomuk", NULL);
+	ontology_location = g_file_new_for_path (ontology_path);
+	g_free (ontology_path);
+
+	manager = create_manager (data_location, ontology_location);
+	run_updates (manager, updates);
+
+	/* The tail is smaller than required */
+	compaction = tracker_data_compaction_begin (manager, G_MAXSIZE, &error);
+	g_assert_no_error (error);
+	g_assert_null (compaction);
+
+	compaction = tracker_data_compaction_begin (manager, 0, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (compaction);
+
+	/* Updates done while the snapshot is written go to the tail */
+	run_updates (manager, tail_updates);
+
+	g_assert_true (tracker_data_compaction_run (compaction, NULL, &error));
+	g_assert_no_error (error);
+	tracker_data_compaction_free (compaction);
+
+	path = g_build_filename (info->data_location, "tracker-store.journal.1.snapshot.gz", NULL);
+	g_assert_true (g_file_test (path, G_FILE_TEST_IS_REGULAR));
+	g_free (path);
+
+	/* The chunk folded into the snapshot is gone */
+	path = g_build_filename (info->data_location, "tracker-store.journal.1", NULL);
+	g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+	g_free (path);
+
+	before = dump_queries (manager);
+	g_object_unref (manager);
+
+	/* Replay snapshot and tail into a fresh database */
+	path = g_build_filename (info->data_location, "meta.db", NULL);
+	g_unlink (path);
+	g_free (path);
+
+	path = g_build_filename (info->data_location, ".meta.isrunning", NULL);
+	g_unlink (path);
+	g_free (path);
+
+	manager = create_manager (data_location, ontology_location);
+	after = dump_queries (manager);
+
+	g_assert_cmpstr (before, ==, after);
+	g_assert_null (strstr (after, "urn:compaction:3"));
+
+	g_free (before);
+	g_free (after);
+
+	g_object_unref (ontology_location);
+	g_object_unref (data_location);
+	g_object_unref (manager);
+}
+
+#endif /* DISABLE_JOURNAL */
+
+static void
+setup (TestInfo      *info,
+       gconstpointer  context)
+{
+	gchar *basename;
+
+	basename = g_strdup_printf ("%d", g_test_rand_int_range (0, G_MAXINT));
+	info->data_location = g_build_path (G_DIR_SEPARATOR_S, tests_data_dir, basename, NULL);
+	g_free (basename);
+}
+
+static void
+teardown (TestInfo      *info,
+          gconstpointer  context)
+{
+	gchar *cleanup_command;
+
+	cleanup_command = g_strdup_printf ("rm -Rf %s/", info->data_location);
+	g_spawn_command_line_sync (cleanup_command, NULL, NULL, NULL, NULL);
+	g_free (cleanup_command);
+
+	g_free (info->data_location);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *current_dir;
+	gint result;
+
+	setlocale (LC_COLLATE, "en_US.utf8");
+
+	current_dir = g_get_current_dir ();
+	tests_data_dir = g_build_path (G_DIR_SEPARATOR_S, current_dir, "journal-compaction-test-data-XXXXXX", NULL);
+	g_free (current_dir);
+
+	g_mkdtemp (tests_data_dir);
+
+	g_test_init (&argc, &argv, NULL);
+#ifndef DISABLE_JOURNAL
+	g_test_add ("/libtracker-data/journal-compaction", TestInfo, NULL, setup, test_journal_compaction, teardown);
+#endif /* DISABLE_JOURNAL */
+
+	result = g_test_run ();
+
+	g_assert_cmpint (g_remove (tests_data_dir), ==, 0);
+	g_free (tests_data_dir);
+
+	return result;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data.h>
+
+static gchar *tests_data_dir = NULL;
+
+typedef struct {
+	gchar *data_location;
+} TestInfo;
+
+static gint
+get_auto_vacuum (TrackerDBInterface *iface)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gint value;
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              &error, "PRAGMA auto_vacuum");
+	g_assert_no_error (error);
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+	g_assert (tracker_db_cursor_iter_next (cursor, NULL, &error));
+	value = tracker_db_cursor_get_int (cursor, 0);
+
+	g_object_unref (cursor);
+	g_object_unref (stmt);
+
+	return value;
+}
+
+static void
+test_maintenance (TestInfo      *info,
+                  gconstpointer  context)
+{
+	GError *error = NULL;
+	GFile *data_location, *ontology_location;
+	TrackerDataManager *manager;
+	TrackerData *data;
+	TrackerDBInterface *iface;
+	gchar *ontology_path;
+	gdouble progress = 0, last_progress = 0;
+	gint n_steps = 0;
+
+	data_location = g_file_new_for_path (info->data_location);
+	ontology_path = g_build_filename (TOP_SRCDIR, "src", "ontologies", "nepomuk", NULL);
+	ontology_location = g_file_new_for_path (ontology_path);
+	g_free (ontology_path);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                                    data_location, data_location, ontology_location,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	data = tracker_data_manager_get_data (manager);
+	tracker_data_update_sparql (data,
+	                            "INSERT { GRAPH <urn:maintenance:graph> { <urn:maintenance:kept> a nie:InformationElement } }",
+	                            &error);
+	g_assert_no_error (error);
+	tracker_data_update_sparql (data,
+	                            "INSERT { <urn:maintenance:stale> a nie:InformationElement }",
+	                            &error);
+	g_assert_no_error (error);
+	tracker_data_update_sparql (data,
+	                            "DELETE { <urn:maintenance:stale> a rdfs:Resource }",
+	                            &error);
+	g_assert_no_error (error);
+
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+	g_assert_cmpint (tracker_data_query_resource_id (manager, iface, "urn:maintenance:stale"), !=, 0);
+
+	/* Use tiny chunks, so the pass takes several steps */
+	while (tracker_data_manager_maintenance_step (manager, 2, 1, &progress, &error)) {
+		g_assert_no_error (error);
+		g_assert_cmpfloat (progress, >=, last_progress);
+		g_assert_cmpfloat (progress, <, 1);
+		last_progress = progress;
+		n_steps++;
+	}
+
+	g_assert_no_error (error);
+	g_assert_cmpint (n_steps, >, 1);
+	g_assert_cmpfloat (progress, ==, 1);
+
+	g_assert_cmpint (tracker_data_query_resource_id (manager, iface, "urn:maintenance:stale"), ==, 0);
+	g_assert_cmpint (tracker_data_query_resource_id (manager, iface, "urn:maintenance:kept"), !=, 0);
+	g_assert_cmpint (tracker_data_query_resource_id (manager, iface, "urn:maintenance:graph"), !=, 0);
+
+	/* Databases from older versions are converted once reopened */
+	g_assert_cmpint (get_auto_vacuum (iface), ==, 2);
+	tracker_db_interface_execute_query (iface, &error, "PRAGMA auto_vacuum = NONE");
+	g_assert_no_error (error);
+	tracker_db_interface_execute_query (iface, &error, "VACUUM");
+	g_assert_no_error (error);
+	g_assert_cmpint (get_auto_vacuum (iface), ==, 0);
+
+	tracker_data_update_sparql (data,
+	                            "INSERT { <urn:maintenance:stale2> a nie:InformationElement }",
+	                            &error);
+	g_assert_no_error (error);
+	tracker_data_update_sparql (data,
+	                            "DELETE { <urn:maintenance:stale2> a rdfs:Resource }",
+	                            &error);
+	g_assert_no_error (error);
+
+	g_object_unref (manager);
+
+	manager = tracker_data_manager_new (0, data_location, data_location, ontology_location,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	/* Opening alone leaves the database as it was */
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+	g_assert_cmpint (get_auto_vacuum (iface), ==, 0);
+
+	while (tracker_data_manager_maintenance_step (manager, 2, 1, &progress, &error))
+		g_assert_no_error (error);
+
+	g_assert_no_error (error);
+	g_assert_cmpint (get_auto_vacuum (iface), ==, 2);
+	g_assert_cmpint (tracker_data_query_resource_id (manager, iface, "urn:maintenance:stale2"), ==, 0);
+	g_assert_cmpint (tracker_data_query_resource_id (manager, iface, "urn:maintenance:kept"), !=, 0);
+
+	g_object_unref (ontology_location);
+	g_object_unref (data_location);
+	g_object_unref (manager);
+}
+
+static void
+setup (TestInfo      *info,
+       gconstpointer  context)
+{
+	gchar *basename;
+
+	basename = g_strdup_printf ("%d", g_test_rand_int_range (0, G_MAXINT));
+	info->data_location = g_build_path (G_DIR_SEPARATOR_S, tests_data_dir, basename, NULL);
+	g_free (basename);
+}
+
+static void
+teardown (TestInfo      *info,
+          gconstpointer  context)
+{
+	gchar *cleanup_command;
+
+	cleanup_command = g_strdup_printf ("rm -Rf %s/", info->data_location);
+	g_spawn_command_line_sync (cleanup_command, NULL, NULL, NULL, NULL);
+	g_free (cleanup_command);
+
+	g_free (info->data_location);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *current_dir;
+	gint result;
+
+	setlocale (LC_COLLATE, "en_US.utf8");
+
+	current_dir = g_get_current_dir ();
+	tests_data_dir = g_build_path (G_DIR_SEPARATOR_S, current_dir, "maintenance-test-data-XXXXXX", NULL);
+	g_free (current_dir);
+
+	g_mkdtemp (tests_data_dir);
+
+	g_test_init (&argc, &argv, NULL);
+	g_test_add ("/libtracker-data/maintenance", TestInfo, NULL, setup, test_maintenance, teardown);
+
+	result = g_test_run ();
+
+	g_assert_cmpint (g_remove (tests_data_dir), ==, 0);
+	g_free (tests_data_dir);
+
+	return result;
+}
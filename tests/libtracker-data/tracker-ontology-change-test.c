@@ -177,6 +177,48 @@ query_helper (TrackerDataManager *manager, const gchar *query_filename, const gc
 	g_free (queries);
 }
 
+/* The counts kept in ClassCount must match the class tables, also
+ * for the classes and properties inserted by ontology changes.
+ */
+static void
+check_class_counts (TrackerDataManager *manager)
+{
+	TrackerDBInterface *iface;
+	TrackerClass **classes;
+	GError *error = NULL;
+	guint i, n_classes;
+
+	g_assert (tracker_data_manager_has_class_counts (manager));
+
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+	classes = tracker_ontologies_get_classes (tracker_data_manager_get_ontologies (manager), &n_classes);
+
+	for (i = 0; i < n_classes; i++) {
+		const gchar *name = tracker_class_get_name (classes[i]);
+		TrackerDBStatement *stmt;
+		TrackerDBCursor *cursor;
+
+		if (g_str_has_prefix (name, "xsd:"))
+			continue;
+
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &error,
+		                                              "SELECT COUNT(1), "
+		                                              "(SELECT Count FROM ClassCount WHERE ID = %d) "
+		                                              "FROM \"%s\"",
+		                                              tracker_class_get_id (classes[i]), name);
+		g_assert_no_error (error);
+		cursor = tracker_db_statement_start_cursor (stmt, &error);
+		g_assert_no_error (error);
+		g_object_unref (stmt);
+
+		g_assert (tracker_db_cursor_iter_next (cursor, NULL, &error));
+		g_assert_no_error (error);
+		g_assert_cmpint (tracker_class_get_count (classes[i]), ==, tracker_db_cursor_get_int (cursor, 0));
+		g_assert_cmpint (tracker_db_cursor_get_int (cursor, 1), ==, tracker_db_cursor_get_int (cursor, 0));
+		g_object_unref (cursor);
+	}
+}
+
 static void
 test_ontology_change (void)
 {
@@ -236,6 +278,8 @@ test_ontology_change (void)
 		g_initable_init (G_INITABLE (manager), NULL, &error);
 		g_assert_no_error (error);
 
+		check_class_counts (manager);
+
 		data = tracker_data_manager_get_data (manager);
 
 		if (g_file_get_contents (update, &queries, NULL, NULL)) {
@@ -253,6 +297,8 @@ test_ontology_change (void)
 		g_free (source);
 		g_object_unref (file1);
 
+		check_class_counts (manager);
+
 
 		if (changes[i].test_name) {
 			gchar *query_filename;
@@ -280,6 +326,8 @@ test_ontology_change (void)
 	g_initable_init (G_INITABLE (manager), NULL, &error);
 	g_assert_no_error (error);
 
+	check_class_counts (manager);
+
 	for (i = 0; change_tests[i].test_name != NULL; i++) {
 		gchar *query_filename;
 		gchar *results_filename;
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data.h>
+
+static gchar *tests_data_dir = NULL;
+
+typedef struct {
+	gchar *data_location;
+} TestInfo;
+
+static const gchar *updates[] = {
+	"INSERT { <urn:refcount:1> a nie:DataObject , nie:InformationElement }",
+	"INSERT { <urn:refcount:2> a nie:DataObject ; nie:interpretedAs <urn:refcount:1> ; nie:isPartOf <urn:refcount:1> }",
+	"INSERT { <urn:refcount:3> a nie:DataObject , nie:InformationElement ; nie:isPartOf <urn:refcount:1> , <urn:refcount:2> }",
+	/* Overwrite a single valued reference */
+	"DELETE { <urn:refcount:2> nie:interpretedAs ?o } WHERE { <urn:refcount:2> nie:interpretedAs ?o } "
+	"INSERT { <urn:refcount:2> nie:interpretedAs <urn:refcount:3> }",
+	/* Multiple values for a single valued property, rolled back */
+	"INSERT { <urn:refcount:4> a nie:DataObject ; nie:interpretedAs <urn:refcount:1> , <urn:refcount:3> }",
+	"DELETE { <urn:refcount:3> nie:isPartOf <urn:refcount:1> }",
+	"DELETE { <urn:refcount:1> a rdfs:Resource }",
+	/* Inserts and deletes cancelling out in the same transaction */
+	"INSERT { <urn:refcount:5> a nie:DataObject ; nie:isPartOf <urn:refcount:3> } "
+	"DELETE { <urn:refcount:5> a rdfs:Resource }",
+	NULL
+};
+
+static void
+count_column (TrackerDBInterface *iface,
+              GHashTable         *counts,
+              const gchar        *table,
+              const gchar        *column)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &error,
+	                                              "SELECT \"%s\" FROM \"%s\" WHERE \"%s\" IS NOT NULL",
+	                                              column, table, column);
+	g_assert_no_error (error);
+
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+	g_object_unref (stmt);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		gpointer id = GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 0));
+
+		g_hash_table_insert (counts, id,
+		                     GINT_TO_POINTER (GPOINTER_TO_INT (g_hash_table_lookup (counts, id)) + 1));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+}
+
+/* Recounts the references the Resource.Refcount triggers keep track
+ * of: every class table row, and every resource valued column.
+ */
+static GHashTable *
+recount_references (TrackerDataManager *manager)
+{
+	TrackerOntologies *ontologies;
+	TrackerDBInterface *iface;
+	TrackerClass **classes;
+	TrackerProperty **properties;
+	GHashTable *counts;
+	guint i, j, n_classes, n_properties;
+
+	counts = g_hash_table_new (NULL, NULL);
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+	ontologies = tracker_data_manager_get_ontologies (manager);
+	classes = tracker_ontologies_get_classes (ontologies, &n_classes);
+	properties = tracker_ontologies_get_properties (ontologies, &n_properties);
+
+	for (i = 0; i < n_classes; i++) {
+		const gchar *class_name = tracker_class_get_name (classes[i]);
+
+		count_column (iface, counts, class_name, "ID");
+
+		for (j = 0; j < n_properties; j++) {
+			const gchar *property_name;
+
+			if (tracker_property_get_domain (properties[j]) != classes[i] ||
+			    tracker_property_get_data_type (properties[j]) != TRACKER_PROPERTY_TYPE_RESOURCE)
+				continue;
+
+			property_name = tracker_property_get_name (properties[j]);
+
+			if (tracker_property_get_multiple_values (properties[j])) {
+				gchar *table_name;
+
+				table_name = g_strdup_printf ("%s_%s", class_name, property_name);
+				count_column (iface, counts, table_name, "ID");
+				count_column (iface, counts, table_name, property_name);
+				g_free (table_name);
+			} else {
+				count_column (iface, counts, class_name, property_name);
+			}
+		}
+	}
+
+	return counts;
+}
+
+static GHashTable *
+get_refcounts (TrackerDataManager *manager)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GHashTable *refcounts;
+	GError *error = NULL;
+
+	refcounts = g_hash_table_new (NULL, NULL);
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &error,
+	                                              "SELECT ID, Refcount FROM Resource");
+	g_assert_no_error (error);
+
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+	g_object_unref (stmt);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		g_hash_table_insert (refcounts,
+		                     GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 0)),
+		                     GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 1)));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return refcounts;
+}
+
+static gint
+lookup_int (GHashTable *table,
+            gint        id)
+{
+	return GPOINTER_TO_INT (g_hash_table_lookup (table, GINT_TO_POINTER (id)));
+}
+
+static gint
+count_triggers (TrackerDataManager *manager,
+                const gchar        *schema)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gint count;
+
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &error,
+	                                              "SELECT COUNT(*) FROM %s.sqlite_master WHERE type = 'trigger'",
+	                                              schema);
+	g_assert_no_error (error);
+
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+	g_object_unref (stmt);
+
+	g_assert (tracker_db_cursor_iter_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	count = tracker_db_cursor_get_int (cursor, 0);
+	g_object_unref (cursor);
+
+	return count;
+}
+
+static TrackerDataManager *
+create_manager (TestInfo               *info,
+                TrackerDBManagerFlags   flags)
+{
+	GError *error = NULL;
+	GFile *data_location, *ontology_location;
+	TrackerDataManager *manager;
+	gchar *ontology_path;
+
+	data_location = g_file_new_for_path (info->data_location);
+	ontology_path = g_build_filename (TOP_SRCDIR, "src", "ontologies", "nepomuk", NULL);
+	ontology_location = g_file_new_for_path (ontology_path);
+	g_free (ontology_path);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (flags,
+	                                    data_location, data_location, ontology_location,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (ontology_location);
+	g_object_unref (data_location);
+
+	return manager;
+}
+
+static void
+check_refcount_updates (TrackerDataManager *manager)
+{
+	GError *error = NULL;
+	GHashTable *refcounts_before, *refcounts_after;
+	GHashTable *references_before, *references_after;
+	GHashTableIter iter;
+	gpointer key;
+	guint i;
+
+	/* The triggers only live in the writable connection */
+	g_assert_cmpint (count_triggers (manager, "main"), ==, 0);
+	g_assert_cmpint (count_triggers (manager, "temp"), >, 0);
+
+	/* Compare changes, so the references added while importing
+	 * the ontology don't need to be accounted for.
+	 */
+	refcounts_before = get_refcounts (manager);
+	references_before = recount_references (manager);
+
+	for (i = 0; updates[i]; i++) {
+		tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+		                            updates[i], &error);
+		g_clear_error (&error);
+	}
+
+	refcounts_after = get_refcounts (manager);
+	references_after = recount_references (manager);
+
+	g_hash_table_iter_init (&iter, refcounts_after);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		gint id = GPOINTER_TO_INT (key);
+
+		g_assert_cmpint (lookup_int (refcounts_after, id) - lookup_int (refcounts_before, id),
+		                 ==,
+		                 lookup_int (references_after, id) - lookup_int (references_before, id));
+	}
+
+	/* Every referenced resource must be in the Resource table */
+	g_hash_table_iter_init (&iter, references_after);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_assert (g_hash_table_contains (refcounts_after, key));
+
+	g_hash_table_unref (refcounts_before);
+	g_hash_table_unref (refcounts_after);
+	g_hash_table_unref (references_before);
+	g_hash_table_unref (references_after);
+}
+
+static void
+test_refcount (TestInfo      *info,
+               gconstpointer  context)
+{
+	TrackerDataManager *manager;
+
+	manager = create_manager (info, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	check_refcount_updates (manager);
+	g_object_unref (manager);
+}
+
+static void
+test_refcount_reopen (TestInfo      *info,
+                      gconstpointer  context)
+{
+	TrackerDataManager *manager;
+
+	manager = create_manager (info, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	g_object_unref (manager);
+
+	/* Triggers must be set up again on an existing database */
+	manager = create_manager (info, 0);
+	check_refcount_updates (manager);
+	g_object_unref (manager);
+}
+
+static void
+setup (TestInfo      *info,
+       gconstpointer  context)
+{
+	gchar *basename;
+
+	basename = g_strdup_printf ("%d", g_test_rand_int_range (0, G_MAXINT));
+	info->data_location = g_build_path (G_DIR_SEPARATOR_S, tests_data_dir, basename, NULL);
+	g_free (basename);
+}
+
+static void
+teardown (TestInfo      *info,
+          gconstpointer  context)
+{
+	gchar *cleanup_command;
+
+	cleanup_command = g_strdup_printf ("rm -Rf %s/", info->data_location);
+	g_spawn_command_line_sync (cleanup_command, NULL, NULL, NULL, NULL);
+	g_free (cleanup_command);
+
+	g_free (info->data_location);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *current_dir;
+	gint result;
+
+	setlocale (LC_COLLATE, "en_US.utf8");
+
+	current_dir = g_get_current_dir ();
+	tests_data_dir = g_build_path (G_DIR_SEPARATOR_S, current_dir, "refcount-test-data-XXXXXX", NULL);
+	g_free (current_dir);
+
+	g_mkdtemp (tests_data_dir);
+
+	g_test_init (&argc, &argv, NULL);
+	g_test_add ("/libtracker-data/refcount", TestInfo, NULL, setup, test_refcount, teardown);
+	g_test_add ("/libtracker-data/refcount/reopen", TestInfo, NULL, setup, test_refcount_reopen, teardown);
+
+	result = g_test_run ();
+
+	g_assert_cmpint (g_remove (tests_data_dir), ==, 0);
+	g_free (tests_data_dir);
+
+	return result;
+}
@@ -352,6 +352,456 @@ test_sparql_query (TestInfo      *test_info,
 	g_object_unref (manager);
 }
 
+/* Opens the database in the test's data location, with the ontology
+ * found at @ontology_path within the source tree.
+ */
+static TrackerDataManager *
+open_data_manager (TestInfo              *test_info,
+                   TrackerDBManagerFlags  flags,
+                   const gchar           *ontology_path)
+{
+	TrackerDataManager *manager;
+	GFile *data_location, *ontology_location;
+	GError *error = NULL;
+	gchar *path;
+
+	path = g_build_filename (TOP_SRCDIR, ontology_path, NULL);
+	ontology_location = g_file_new_for_path (path);
+	g_free (path);
+
+	data_location = g_file_new_for_path (test_info->data_location);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (flags,
+	                                    data_location, data_location, ontology_location,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (ontology_location);
+	g_object_unref (data_location);
+
+	return manager;
+}
+
+static void
+test_sparql_explain (TestInfo      *test_info,
+                     gconstpointer  context)
+{
+	TrackerSparqlQuery *query;
+	TrackerDataManager *manager;
+	GVariant *explanation, *plan;
+	GError *error = NULL;
+	const gchar *sql;
+	gboolean cache_hit;
+	guint64 n_rows;
+	gdouble time;
+	GFile *file;
+	gchar *path;
+	gint i;
+
+	manager = open_data_manager (test_info, TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                             "tests/libtracker-data/ask");
+
+	path = g_build_filename (TOP_SRCDIR, "tests", "libtracker-data", "ask", "data.ttl", NULL);
+	file = g_file_new_for_path (path);
+	g_free (path);
+	tracker_turtle_reader_load (file, tracker_data_manager_get_data (manager), &error);
+	g_assert_no_error (error);
+	g_object_unref (file);
+
+	/* Plain explanation, the query is translated but not run */
+	query = tracker_sparql_query_new (manager, "SELECT ?v { <http://example/x> <http://example/p> ?v }");
+	explanation = tracker_sparql_query_explain (query, FALSE, &error);
+	g_assert_no_error (error);
+	g_object_unref (query);
+
+	g_assert (g_variant_lookup (explanation, "sql", "&s", &sql));
+	g_assert (strstr (sql, "SELECT") != NULL);
+	plan = g_variant_lookup_value (explanation, "plan", G_VARIANT_TYPE ("as"));
+	g_assert (plan != NULL);
+	g_assert_cmpint (g_variant_n_children (plan), >, 0);
+	g_variant_unref (plan);
+	g_assert (g_variant_lookup (explanation, "translate-time", "d", &time));
+	g_assert (!g_variant_lookup (explanation, "rows", "t", &n_rows));
+	g_variant_unref (explanation);
+
+	/* Profiling runs the query, the second time around the
+	 * statement must come from the cache.
+	 */
+	for (i = 0; i < 2; i++) {
+		query = tracker_sparql_query_new (manager, "SELECT ?v { <http://example/x> <http://example/p> ?v }");
+		explanation = tracker_sparql_query_explain (query, TRUE, &error);
+		g_assert_no_error (error);
+		g_object_unref (query);
+
+		g_assert (g_variant_lookup (explanation, "rows", "t", &n_rows));
+		g_assert_cmpint (n_rows, ==, 3);
+		g_assert (g_variant_lookup (explanation, "step-time", "d", &time));
+		g_assert (g_variant_lookup (explanation, "statement-cache-hit", "b", &cache_hit));
+		g_assert (cache_hit == (i > 0));
+		g_variant_unref (explanation);
+	}
+
+	/* Updates can not be explained */
+	query = tracker_sparql_query_new (manager, "INSERT { <http://example/y> a <http://example/A> }");
+	explanation = tracker_sparql_query_explain (query, FALSE, &error);
+	g_assert (explanation == NULL);
+	g_assert (error != NULL);
+	g_clear_error (&error);
+	g_object_unref (query);
+
+	g_object_unref (manager);
+}
+
+static void
+test_sparql_dependencies (TestInfo      *test_info,
+                          gconstpointer  context)
+{
+	TrackerSparqlQuery *query;
+	TrackerDataManager *manager;
+	GError *error = NULL;
+	gchar **classes;
+	gint n_classes;
+
+	manager = open_data_manager (test_info, TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                             "src/ontologies/nepomuk");
+
+	/* Explicitly typed subjects depend on that class */
+	query = tracker_sparql_query_new (manager, "SELECT ?u { ?u a nco:PersonContact }");
+	classes = tracker_sparql_query_get_notify_dependencies (query, &n_classes, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (n_classes, ==, 1);
+	g_assert_cmpstr (classes[0], ==, "http://www.semanticdesktop.org/ontologies/2007/03/22/nco#PersonContact");
+	g_strfreev (classes);
+	g_object_unref (query);
+
+	/* nco:fullname is defined on nco:Contact, which is not notified,
+	 * the rdf:type in the same group narrows it down.
+	 */
+	query = tracker_sparql_query_new (manager, "SELECT ?u ?n { ?u a nco:PersonContact ; nco:fullname ?n }");
+	classes = tracker_sparql_query_get_notify_dependencies (query, &n_classes, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (n_classes, ==, 1);
+	g_assert_cmpstr (classes[0], ==, "http://www.semanticdesktop.org/ontologies/2007/03/22/nco#PersonContact");
+	g_strfreev (classes);
+	g_object_unref (query);
+
+	/* Neither of these can be tracked */
+	query = tracker_sparql_query_new (manager, "SELECT ?n { ?u nco:fullname ?n }");
+	classes = tracker_sparql_query_get_notify_dependencies (query, &n_classes, &error);
+	g_assert_no_error (error);
+	g_assert (classes == NULL);
+	g_object_unref (query);
+
+	query = tracker_sparql_query_new (manager, "SELECT ?p { ?u a nco:PersonContact ; ?p ?o }");
+	classes = tracker_sparql_query_get_notify_dependencies (query, &n_classes, &error);
+	g_assert_no_error (error);
+	g_assert (classes == NULL);
+	g_object_unref (query);
+
+	g_object_unref (manager);
+}
+
+/* Checks the tables in the FROM clause are emitted in the given order,
+ * and whether that order is forced.
+ */
+static gint64
+query_count (TrackerDataManager *manager,
+             const gchar        *sparql)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gint64 count;
+
+	cursor = tracker_data_query_sparql_cursor (manager, sparql, &error);
+	g_assert_no_error (error);
+	g_assert (tracker_db_cursor_iter_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	count = tracker_db_cursor_get_int (cursor, 0);
+	g_object_unref (cursor);
+
+	return count;
+}
+
+static void
+check_join_order (TrackerDataManager *manager,
+                  const gchar        *sparql,
+                  const gchar        *first_table,
+                  const gchar        *second_table,
+                  gboolean            forced,
+                  guint64             expected_rows)
+{
+	TrackerSparqlQuery *query;
+	GVariant *explanation, *plan;
+	GError *error = NULL;
+	const gchar *sql, *from, *step;
+	gchar *first, *second;
+	guint64 n_rows;
+	gsize i;
+
+	query = tracker_sparql_query_new (manager, sparql);
+	explanation = tracker_sparql_query_explain (query, TRUE, &error);
+	g_assert_no_error (error);
+	g_object_unref (query);
+
+	g_assert (g_variant_lookup (explanation, "sql", "&s", &sql));
+	from = strstr (sql, " FROM ");
+	g_assert (from != NULL);
+
+	/* Tables of the block, as opposed to those in subqueries */
+	first = g_strdup_printf ("\"%s\" AS ", first_table);
+	g_assert (strstr (from, first) != NULL);
+	g_assert ((strstr (from, " CROSS JOIN ") != NULL) == forced);
+
+	if (second_table) {
+		second = g_strdup_printf ("\"%s\" AS ", second_table);
+		g_assert (strstr (from, second) != NULL);
+		g_assert (strstr (from, first) < strstr (from, second));
+		g_free (second);
+	} else if (forced) {
+		/* Followed by a subquery, eg. for a variable predicate */
+		g_assert (strstr (from, first) < strstr (from, " CROSS JOIN "));
+	}
+
+	g_free (first);
+
+	if (forced) {
+		/* The outermost loop runs over the first table */
+		plan = g_variant_lookup_value (explanation, "plan", G_VARIANT_TYPE ("as"));
+		g_assert (plan != NULL);
+
+		for (i = 0; i < g_variant_n_children (plan); i++) {
+			g_variant_get_child (plan, i, "&s", &step);
+
+			if (strstr (step, first_table) ||
+			    (second_table && strstr (step, second_table))) {
+				g_assert (strstr (step, first_table) != NULL);
+				break;
+			}
+		}
+
+		g_assert_cmpint (i, <, g_variant_n_children (plan));
+		g_variant_unref (plan);
+	}
+
+	g_assert (g_variant_lookup (explanation, "rows", "t", &n_rows));
+	g_assert_cmpint (n_rows, ==, expected_rows);
+	g_variant_unref (explanation);
+}
+
+static void
+check_join_unforced (TrackerDataManager *manager,
+                     const gchar        *sparql,
+                     guint64             expected_rows)
+{
+	TrackerSparqlQuery *query;
+	GVariant *explanation;
+	GError *error = NULL;
+	const gchar *sql;
+	guint64 n_rows;
+
+	query = tracker_sparql_query_new (manager, sparql);
+	explanation = tracker_sparql_query_explain (query, TRUE, &error);
+	g_assert_no_error (error);
+	g_object_unref (query);
+
+	/* SQLite is left to pick the order */
+	g_assert (g_variant_lookup (explanation, "sql", "&s", &sql));
+	g_assert (strstr (sql, " CROSS JOIN ") == NULL);
+
+	g_assert (g_variant_lookup (explanation, "rows", "t", &n_rows));
+	g_assert_cmpint (n_rows, ==, expected_rows);
+	g_variant_unref (explanation);
+}
+
+static void
+test_sparql_join_order (TestInfo      *test_info,
+                        gconstpointer  context)
+{
+	TrackerDataManager *manager;
+	GError *error = NULL;
+	gdouble n_rows, rows_per_value;
+	gint i;
+
+	manager = open_data_manager (test_info, TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                             "src/ontologies/nepomuk");
+
+	tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+	                            "INSERT {"
+	                            "  <urn:a> a nfo:Document, nfo:FileDataObject ; nie:url 'file:///a' ; nie:title 'foo' ."
+	                            "  <urn:b> a nfo:Document, nfo:FileDataObject ; nie:url 'file:///b' ; nie:title 'bar' ."
+	                            "  <urn:c> a nfo:Document, nfo:FileDataObject ; nie:url 'file:///c' ; nie:title 'baz' ."
+	                            "}", &error);
+	g_assert_no_error (error);
+
+	/* Bound literals on an indexed column come first */
+	check_join_order (manager,
+	                  "SELECT ?u { ?u a nfo:Document ; nie:url 'file:///b' }",
+	                  "nie:DataObject", "nfo:Document",
+	                  TRUE, 1);
+
+#if HAVE_TRACKER_FTS
+	/* Full text matches are the most selective */
+	check_join_order (manager,
+	                  "SELECT ?u ?url { ?u a nfo:Document ; nie:url ?url ; fts:match 'foo' }",
+	                  "fts5", "nfo:Document",
+	                  TRUE, 1);
+#endif
+
+	/* Without restrictions the order of the query is kept, and
+	 * SQLite is left to pick one.
+	 */
+	check_join_order (manager,
+	                  "SELECT ?u ?url { ?u a nfo:Document ; nie:url ?url }",
+	                  "nfo:Document", "nie:DataObject",
+	                  FALSE, 3);
+
+	/* Let estimates come from sqlite_stat1, with enough rows for
+	 * the indexes to tell values apart.
+	 */
+	for (i = 0; i < 100; i++) {
+		gchar *sparql;
+
+		sparql = g_strdup_printf ("INSERT {"
+		                          "  <urn:doc:%d> a nfo:Document, nfo:FileDataObject ;"
+		                          "    nie:url 'file:///doc%d' ; nie:title 'doc%d' ;"
+		                          "    nie:keyword 'all', 'k%d' ."
+		                          "}", i, i, i, i);
+		tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+		                            sparql, &error);
+		g_assert_no_error (error);
+		g_free (sparql);
+	}
+
+	g_assert_false (tracker_data_manager_get_table_estimate (manager, "nfo:Document", "ID",
+	                                                         &n_rows, &rows_per_value));
+
+	while (tracker_data_manager_maintenance_step (manager, 1000, 1000, NULL, &error))
+		g_assert_no_error (error);
+	g_assert_no_error (error);
+
+	g_assert_true (tracker_data_manager_get_table_estimate (manager, "nfo:Document", "ID",
+	                                                        &n_rows, &rows_per_value));
+	g_assert_cmpfloat (n_rows, ==, 103);
+	g_assert_true (tracker_data_manager_get_table_estimate (manager, "nie:InformationElement_nie:keyword", "ID",
+	                                                        &n_rows, &rows_per_value));
+	g_assert_cmpfloat (n_rows, ==, 200);
+	g_assert_cmpfloat (rows_per_value, ==, 2);
+
+	/* Same choices once estimates are measured */
+	check_join_order (manager,
+	                  "SELECT ?u { ?u a nfo:Document ; nie:url 'file:///b' }",
+	                  "nie:DataObject", "nfo:Document",
+	                  TRUE, 1);
+	check_join_unforced (manager,
+	                     "SELECT ?u ?url { ?u a nfo:Document ; nie:url ?url }",
+	                     103);
+
+	/* Multi-valued properties, bound and unrestricted */
+	check_join_order (manager,
+	                  "SELECT ?u { ?u a nfo:Document ; nie:keyword 'k42' }",
+	                  "nie:InformationElement_nie:keyword", "nfo:Document",
+	                  TRUE, 1);
+	check_join_unforced (manager,
+	                     "SELECT ?u ?k { ?u a nfo:Document ; nie:keyword ?k }",
+	                     200);
+
+	/* Variable predicates on a restricted subject */
+	check_join_order (manager,
+	                  "SELECT ?p ?o { ?u nie:url 'file:///doc7' ; ?p ?o }",
+	                  "nie:DataObject", NULL,
+	                  TRUE,
+	                  query_count (manager, "SELECT COUNT(?p) { <urn:doc:7> ?p ?o }"));
+
+	/* OPTIONAL blocks are ordered on their own, and leave the
+	 * outer block alone.
+	 */
+	check_join_order (manager,
+	                  "SELECT ?u ?k { ?u a nfo:Document ; nie:url 'file:///doc7' . "
+	                  "               OPTIONAL { ?u nie:keyword ?k } }",
+	                  "nie:DataObject", "nfo:Document",
+	                  TRUE, 2);
+	check_join_unforced (manager,
+	                     "SELECT ?u ?t { ?u a nfo:Document . "
+	                     "               OPTIONAL { ?u nie:title ?t ; nie:keyword ?k } }",
+	                     203);
+
+	g_object_unref (manager);
+}
+
+static void
+test_sparql_class_counts (TestInfo      *test_info,
+                          gconstpointer  context)
+{
+	TrackerSparqlQuery *query;
+	TrackerDataManager *manager;
+	TrackerClass *document;
+	GVariant *explanation;
+	GError *error = NULL;
+	const gchar *sql;
+	gint i;
+
+	manager = open_data_manager (test_info, TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                             "src/ontologies/nepomuk");
+	g_assert (tracker_data_manager_has_class_counts (manager));
+
+	tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+	                            "INSERT {"
+	                            "  <urn:a> a nfo:Document ."
+	                            "  <urn:b> a nfo:Document ."
+	                            "  <urn:c> a nfo:Document ."
+	                            "}", &error);
+	g_assert_no_error (error);
+	tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+	                            "DELETE { <urn:b> a rdfs:Resource }", &error);
+	g_assert_no_error (error);
+
+	/* Bare counts are answered from the class count table */
+	query = tracker_sparql_query_new (manager, "SELECT COUNT(?u) AS ?c { ?u a nfo:Document }");
+	explanation = tracker_sparql_query_explain (query, FALSE, &error);
+	g_assert_no_error (error);
+	g_object_unref (query);
+
+	g_assert (g_variant_lookup (explanation, "sql", "&s", &sql));
+	g_assert (strstr (sql, "ClassCount") != NULL);
+	g_variant_unref (explanation);
+
+	g_assert_cmpint (query_count (manager, "SELECT COUNT(?u) AS ?c { ?u a nfo:Document }"), ==, 2);
+	g_assert_cmpint (query_count (manager, "SELECT (COUNT(DISTINCT ?u) AS ?c) WHERE { ?u rdf:type nie:InformationElement . }"), ==, 2);
+
+	/* Anything else is counted as usual */
+	query = tracker_sparql_query_new (manager, "SELECT COUNT(?u) { ?u a nfo:Document . FILTER (?u != <urn:a>) }");
+	explanation = tracker_sparql_query_explain (query, FALSE, &error);
+	g_assert_no_error (error);
+	g_object_unref (query);
+
+	g_assert (g_variant_lookup (explanation, "sql", "&s", &sql));
+	g_assert (strstr (sql, "ClassCount") == NULL);
+	g_variant_unref (explanation);
+
+	/* Counts persist across restarts */
+	g_object_unref (manager);
+
+	for (i = 0; i < 2; i++) {
+		manager = open_data_manager (test_info, 0, "src/ontologies/nepomuk");
+
+		document = tracker_ontologies_get_class_by_uri (tracker_data_manager_get_ontologies (manager),
+		                                                "http://www.semanticdesktop.org/ontologies/2007/03/22/nfo#Document");
+		g_assert_cmpint (tracker_class_get_count (document), ==, 2 + i);
+
+		if (i == 0) {
+			tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+			                            "INSERT { <urn:d> a nfo:Document }", &error);
+			g_assert_no_error (error);
+			g_assert_cmpint (query_count (manager, "SELECT COUNT(?u) { ?u a nfo:Document }"), ==, 3);
+		}
+
+		g_object_unref (manager);
+	}
+}
+
 static void
 setup (TestInfo      *info,
        gconstpointer  context)
@@ -420,6 +870,11 @@ main (int argc, char **argv)
 		g_free (testpath);
 	}
 
+	g_test_add ("/libtracker-data/sparql/explain", TestInfo, &tests[0], setup, test_sparql_explain, teardown);
+	g_test_add ("/libtracker-data/sparql/dependencies", TestInfo, &tests[0], setup, test_sparql_dependencies, teardown);
+	g_test_add ("/libtracker-data/sparql/join-order", TestInfo, &tests[0], setup, test_sparql_join_order, teardown);
+	g_test_add ("/libtracker-data/sparql/class-counts", TestInfo, &tests[0], setup, test_sparql_class_counts, teardown);
+
 	/* run tests */
 	result = g_test_run ();
 
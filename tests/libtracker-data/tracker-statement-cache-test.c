@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libtracker-data/tracker-data.h>
+
+/* Lookups an interface counts before calling its statement hook */
+#define STATEMENT_USES_BATCH 64
+
+typedef struct {
+	gchar *db_path;
+	TrackerDBInterface *iface;
+} TestInfo;
+
+static void
+run_query (TrackerDBInterface *iface,
+           gint                n)
+{
+	TrackerDBStatement *stmt;
+	GError *error = NULL;
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                              &error, "SELECT %d", n);
+	g_assert_no_error (error);
+	g_object_unref (stmt);
+}
+
+static void
+test_statement_cache_stats (TestInfo      *info,
+                            gconstpointer  context)
+{
+	TrackerDBStatementCacheStats stats;
+	gint i, round;
+
+	/* Cycling through 5 queries thrashes a 4 statement cache */
+	for (round = 0; round < 3; round++) {
+		for (i = 0; i < 5; i++)
+			run_query (info->iface, i);
+	}
+
+	tracker_db_interface_get_stmt_cache_stats (info->iface,
+	                                           TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                           &stats);
+
+	/* Two evictions in, the cache grows to fit all of them */
+	g_assert_cmpuint (stats.misses, ==, 7);
+	g_assert_cmpuint (stats.hits, ==, 8);
+	g_assert_cmpuint (stats.evictions, ==, 2);
+	g_assert_cmpuint (stats.size, ==, 5);
+	g_assert_cmpuint (stats.max_size, >, 4);
+	g_assert_cmpuint (stats.max_size, <=, 16);
+
+	/* The update cache is left untouched */
+	tracker_db_interface_get_stmt_cache_stats (info->iface,
+	                                           TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                           &stats);
+	g_assert_cmpuint (stats.hits + stats.misses + stats.evictions, ==, 0);
+
+	/* Lowering the size evicts on the next insertion */
+	tracker_db_interface_set_max_stmt_cache_size (info->iface,
+	                                              TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                              3);
+	run_query (info->iface, 5);
+
+	tracker_db_interface_get_stmt_cache_stats (info->iface,
+	                                           TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                           &stats);
+	g_assert_cmpuint (stats.size, ==, 3);
+	g_assert_cmpuint (stats.evictions, ==, 5);
+}
+
+static void
+test_statement_cache_prepare (TestInfo      *info,
+                              gconstpointer  context)
+{
+	TrackerDBStatementCacheStats stats;
+	GError *error = NULL;
+
+	g_assert (tracker_db_interface_sqlite_prepare_cached (info->iface, "SELECT 42", &error));
+	g_assert_no_error (error);
+	g_assert (tracker_db_interface_has_cached_statement (info->iface, "SELECT 42"));
+
+	/* Preparing ahead doesn't count as a lookup */
+	tracker_db_interface_get_stmt_cache_stats (info->iface,
+	                                           TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                           &stats);
+	g_assert_cmpuint (stats.hits + stats.misses, ==, 0);
+	g_assert_cmpuint (stats.size, ==, 1);
+
+	run_query (info->iface, 42);
+
+	tracker_db_interface_get_stmt_cache_stats (info->iface,
+	                                           TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                           &stats);
+	g_assert_cmpuint (stats.hits, ==, 1);
+	g_assert_cmpuint (stats.misses, ==, 0);
+
+	g_assert (!tracker_db_interface_sqlite_prepare_cached (info->iface, "SELECT FROM", &error));
+	g_assert_error (error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_QUERY_ERROR);
+	g_clear_error (&error);
+}
+
+static void
+statements_used_cb (TrackerDBInterface *iface,
+                    GHashTable         *uses,
+                    gpointer            user_data)
+{
+	GHashTable *counts = user_data;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint count;
+
+	g_hash_table_iter_init (&iter, uses);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (counts, key));
+		g_hash_table_insert (counts, g_strdup (key),
+		                     GUINT_TO_POINTER (count + *(guint *) value));
+	}
+}
+
+static void
+test_statement_cache_hook (TestInfo      *info,
+                           gconstpointer  context)
+{
+	GHashTable *counts;
+	gint i;
+
+	counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	tracker_db_interface_sqlite_statement_hook (info->iface, statements_used_cb, counts);
+
+	/* Lookups are only reported once a batch is full */
+	for (i = 0; i < STATEMENT_USES_BATCH - 1; i++)
+		run_query (info->iface, i % 2);
+
+	g_assert_cmpuint (g_hash_table_size (counts), ==, 0);
+
+	run_query (info->iface, 1);
+
+	g_assert_cmpuint (g_hash_table_size (counts), ==, 2);
+	g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (counts, "SELECT 0")), ==,
+	                  STATEMENT_USES_BATCH / 2);
+	g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (counts, "SELECT 1")), ==,
+	                  STATEMENT_USES_BATCH / 2);
+
+	/* The next batch starts from scratch */
+	for (i = 0; i < STATEMENT_USES_BATCH; i++)
+		run_query (info->iface, 2);
+
+	g_assert_cmpuint (g_hash_table_size (counts), ==, 3);
+	g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (counts, "SELECT 0")), ==,
+	                  STATEMENT_USES_BATCH / 2);
+	g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (counts, "SELECT 2")), ==,
+	                  STATEMENT_USES_BATCH);
+
+	tracker_db_interface_sqlite_statement_hook (info->iface, NULL, NULL);
+	g_hash_table_unref (counts);
+}
+
+static TrackerDBCursor *
+start_cursor (TrackerDBInterface *iface)
+{
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+
+	/* Uncached, so it isn't counted as a lookup */
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              &error, "SELECT 0");
+	g_assert_no_error (error);
+
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+	g_object_unref (stmt);
+
+	return cursor;
+}
+
+static void
+test_statement_cache_warm_up (void)
+{
+	TrackerDataManager *manager;
+	TrackerDBManager *db_manager;
+	TrackerDBInterface *iface, *busy[3];
+	TrackerDBCursor *cursors[3];
+	GFile *data_location, *ontology_location;
+	GError *error = NULL;
+	gchar *data_path, *ontology_path, *command;
+	guint i, j;
+
+	data_path = g_dir_make_tmp ("statement-cache-test-XXXXXX", &error);
+	g_assert_no_error (error);
+	data_location = g_file_new_for_path (data_path);
+	ontology_path = g_build_filename (TOP_SRCDIR, "src", "ontologies", "nepomuk", NULL);
+	ontology_location = g_file_new_for_path (ontology_path);
+	g_free (ontology_path);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	/* Pooled interfaces have room for 3 SELECT statements */
+	manager = tracker_data_manager_new (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                                    data_location, data_location, ontology_location,
+	                                    FALSE, FALSE, 3, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (ontology_location);
+	g_object_unref (data_location);
+
+	db_manager = tracker_data_manager_get_db_manager (manager);
+	iface = tracker_db_manager_get_db_interface (db_manager);
+
+	/* SELECT 1-3 are hot, SELECT 4 is not, all batches get reported */
+	for (i = 0; i < 20 * STATEMENT_USES_BATCH; i++) {
+		run_query (iface, 1 + i % 3);
+
+		if (i % 20 == 0)
+			run_query (iface, 4);
+	}
+
+	/* While the pooled interfaces are busy, new ones are handed out,
+	 * created either on demand or by the pool grower. Either way they
+	 * come with the hottest statements already prepared.
+	 */
+	for (i = 0; i < G_N_ELEMENTS (busy); i++) {
+		busy[i] = iface;
+		cursors[i] = start_cursor (iface);
+
+		iface = tracker_db_manager_get_db_interface (db_manager);
+
+		for (j = 0; j <= i; j++)
+			g_assert (iface != busy[j]);
+
+		g_assert (tracker_db_interface_has_cached_statement (iface, "SELECT 1"));
+		g_assert (tracker_db_interface_has_cached_statement (iface, "SELECT 2"));
+		g_assert (tracker_db_interface_has_cached_statement (iface, "SELECT 3"));
+		g_assert (!tracker_db_interface_has_cached_statement (iface, "SELECT 4"));
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (cursors); i++)
+		g_object_unref (cursors[i]);
+
+	/* Also waits for the pool grower */
+	g_object_unref (manager);
+
+	command = g_strdup_printf ("rm -rf %s", data_path);
+	g_assert (g_spawn_command_line_sync (command, NULL, NULL, NULL, NULL));
+	g_free (command);
+	g_free (data_path);
+}
+
+static void
+setup (TestInfo      *info,
+       gconstpointer  context)
+{
+	GError *error = NULL;
+	gint fd;
+
+	fd = g_file_open_tmp ("statement-cache-test-XXXXXX.db", &info->db_path, &error);
+	g_assert_no_error (error);
+	g_close (fd, NULL);
+
+	info->iface = tracker_db_interface_sqlite_new (info->db_path, 0, &error);
+	g_assert_no_error (error);
+
+	tracker_db_interface_set_max_stmt_cache_size (info->iface,
+	                                              TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT,
+	                                              4);
+}
+
+static void
+teardown (TestInfo      *info,
+          gconstpointer  context)
+{
+	g_object_unref (info->iface);
+	g_unlink (info->db_path);
+	g_free (info->db_path);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/libtracker-data/statement-cache/stats", TestInfo, NULL,
+	            setup, test_statement_cache_stats, teardown);
+	g_test_add ("/libtracker-data/statement-cache/prepare", TestInfo, NULL,
+	            setup, test_statement_cache_prepare, teardown);
+	g_test_add ("/libtracker-data/statement-cache/hook", TestInfo, NULL,
+	            setup, test_statement_cache_hook, teardown);
+	g_test_add_func ("/libtracker-data/statement-cache/warm-up",
+	                 test_statement_cache_warm_up);
+
+	return g_test_run ();
+}
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data.h>
+#include <libtracker-sparql/tracker-sparql.h>
+
+static gchar *tests_data_dir = NULL;
+
+typedef struct {
+	gchar *data_location;
+	TrackerDataManager *manager;
+} TestInfo;
+
+typedef struct {
+	guint n_calls;
+	gdouble progress;
+} ProgressData;
+
+static GFile *
+write_turtle_file (TestInfo    *info,
+                   guint        n_resources,
+                   const gchar *trailer)
+{
+	GString *str;
+	GError *error = NULL;
+	gchar *path;
+	GFile *file;
+	guint i;
+
+	str = g_string_new ("@prefix nie: <http://www.semanticdesktop.org/ontologies/2007/01/19/nie#> .\n");
+
+	for (i = 0; i < n_resources; i++) {
+		g_string_append_printf (str,
+		                        "<urn:import:%u> a nie:InformationElement ;\n"
+		                        "\tnie:title \"title%u\" ;\n"
+		                        "\tnie:keyword \"a\" , \"b\" ;\n"
+		                        "\tnie:isPartOf <urn:import:%u> .\n",
+		                        i, i, i / 2);
+	}
+
+	if (trailer)
+		g_string_append (str, trailer);
+
+	path = g_build_filename (info->data_location, "import.ttl", NULL);
+	g_file_set_contents (path, str->str, str->len, &error);
+	g_assert_no_error (error);
+
+	file = g_file_new_for_path (path);
+	g_string_free (str, TRUE);
+	g_free (path);
+
+	return file;
+}
+
+static gint64
+query_count (TrackerDataManager *manager,
+             const gchar        *query)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gint64 count;
+
+	cursor = tracker_data_query_sparql_cursor (manager, query, &error);
+	g_assert_no_error (error);
+
+	g_assert_true (tracker_db_cursor_iter_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	count = tracker_db_cursor_get_int (cursor, 0);
+	g_object_unref (cursor);
+
+	return count;
+}
+
+static void
+progress_cb (const gchar *status,
+             gdouble      progress,
+             gpointer     user_data)
+{
+	ProgressData *data = user_data;
+
+	g_assert_cmpfloat (progress, >=, data->progress);
+	data->progress = progress;
+	data->n_calls++;
+}
+
+static void
+test_turtle_import (TestInfo      *info,
+                    gconstpointer  context)
+{
+	ProgressData progress = { 0, };
+	GError *error = NULL;
+	GFile *file;
+
+	file = write_turtle_file (info, 3000, NULL);
+
+	tracker_data_import_turtle_file (tracker_data_manager_get_data (info->manager),
+	                                 file, 500, 0, TRUE, NULL,
+	                                 progress_cb, &progress, &error);
+	g_assert_no_error (error);
+
+	/* Intermediate commits report progress, then the end */
+	g_assert_cmpuint (progress.n_calls, >, 1);
+	g_assert_cmpfloat (progress.progress, ==, 1);
+
+	g_assert_cmpint (query_count (info->manager,
+	                              "SELECT COUNT(?u) { ?u a nie:InformationElement }"),
+	                 ==, 3000);
+	g_assert_cmpint (query_count (info->manager,
+	                              "SELECT COUNT(?k) { ?u nie:keyword ?k }"),
+	                 ==, 6000);
+	g_assert_cmpint (query_count (info->manager,
+	                              "SELECT COUNT(?p) { <urn:import:2999> nie:isPartOf ?p }"),
+	                 ==, 1);
+
+#if HAVE_TRACKER_FTS
+	/* The deferred full text index was rebuilt */
+	g_assert_cmpint (query_count (info->manager,
+	                              "SELECT COUNT(?u) { ?u fts:match \"title2718\" }"),
+	                 ==, 1);
+#endif
+
+	g_object_unref (file);
+}
+
+static void
+test_turtle_import_error (TestInfo      *info,
+                          gconstpointer  context)
+{
+	GError *error = NULL;
+	gint64 count;
+	GFile *file;
+
+	/* The last, partial batch holds the error */
+	file = write_turtle_file (info, 3001, "<urn:import:broken> a .\n");
+
+	tracker_data_import_turtle_file (tracker_data_manager_get_data (info->manager),
+	                                 file, 1000, 0, FALSE, NULL,
+	                                 NULL, NULL, &error);
+	g_assert_error (error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_PARSE);
+	g_clear_error (&error);
+
+	/* Chunks committed before the error are kept, the last one isn't */
+	count = query_count (info->manager,
+	                     "SELECT COUNT(?u) { ?u a nie:InformationElement }");
+	g_assert_cmpint (count, >, 0);
+	g_assert_cmpint (count, <, 3001);
+
+	/* Plain loads are atomic */
+	tracker_data_load_turtle_file (tracker_data_manager_get_data (info->manager),
+	                               file, &error);
+	g_assert_error (error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_PARSE);
+	g_clear_error (&error);
+
+	g_assert_cmpint (query_count (info->manager,
+	                              "SELECT COUNT(?u) { ?u a nie:InformationElement }"),
+	                 ==, count);
+
+	g_object_unref (file);
+}
+
+#if HAVE_TRACKER_FTS
+static void
+test_turtle_import_interrupted (TestInfo      *info,
+                                gconstpointer  context)
+{
+	TrackerData *data;
+	GError *error = NULL;
+	gchar *marker;
+
+	marker = g_build_filename (info->data_location, "fts-rebuild-pending", NULL);
+	data = tracker_data_manager_get_data (info->manager);
+
+	/* Committed while deferred, then stopped before the rebuild */
+	tracker_data_set_fts_deferred (data, TRUE);
+	g_assert_true (g_file_test (marker, G_FILE_TEST_EXISTS));
+
+	tracker_data_update_sparql (data,
+	                            "INSERT { <urn:import:interrupted> a nie:InformationElement ;"
+	                            "                                  nie:title \"interrupted\" }",
+	                            &error);
+	g_assert_no_error (error);
+
+	g_assert_cmpint (query_count (info->manager,
+	                              "SELECT COUNT(?u) { ?u fts:match \"interrupted\" }"),
+	                 ==, 0);
+
+	g_clear_object (&info->manager);
+	open_manager (info, 0);
+
+	/* The next startup caught up */
+	g_assert_false (g_file_test (marker, G_FILE_TEST_EXISTS));
+	g_assert_cmpint (query_count (info->manager,
+	                              "SELECT COUNT(?u) { ?u fts:match \"interrupted\" }"),
+	                 ==, 1);
+
+	g_free (marker);
+}
+#endif
+
+static void
+test_turtle_import_benchmark (TestInfo      *info,
+                              gconstpointer  context)
+{
+	const guint n_resources = 1000000;
+	GError *error = NULL;
+	gdouble elapsed;
+	GFile *file;
+
+	/* 5 statements per resource */
+	file = write_turtle_file (info, n_resources, NULL);
+
+	g_test_timer_start ();
+
+	tracker_data_import_turtle_file (tracker_data_manager_get_data (info->manager),
+	                                 file, 50000, 8 * 1024 * 1024, TRUE, NULL,
+	                                 NULL, NULL, &error);
+	g_assert_no_error (error);
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "Imported %u statements in %.3fs",
+	                         n_resources * 5, elapsed);
+
+	g_object_unref (file);
+}
+
+static void
+open_manager (TestInfo              *info,
+              TrackerDBManagerFlags  flags)
+{
+	GFile *data_location, *ontology_location;
+	GError *error = NULL;
+	gchar *ontology_path;
+
+	data_location = g_file_new_for_path (info->data_location);
+	ontology_path = g_build_filename (TOP_SRCDIR, "src", "ontologies", "nepomuk", NULL);
+	ontology_location = g_file_new_for_path (ontology_path);
+	g_free (ontology_path);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	info->manager = tracker_data_manager_new (flags,
+	                                          data_location, data_location, ontology_location,
+	                                          FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (info->manager), NULL, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (ontology_location);
+	g_object_unref (data_location);
+}
+
+static void
+setup (TestInfo      *info,
+       gconstpointer  context)
+{
+	gchar *basename;
+
+	basename = g_strdup_printf ("%d", g_test_rand_int_range (0, G_MAXINT));
+	info->data_location = g_build_path (G_DIR_SEPARATOR_S, tests_data_dir, basename, NULL);
+	g_free (basename);
+
+	g_mkdir_with_parents (info->data_location, 0700);
+
+	open_manager (info, TRACKER_DB_MANAGER_FORCE_REINDEX);
+}
+
+static void
+teardown (TestInfo      *info,
+          gconstpointer  context)
+{
+	gchar *cleanup_command;
+
+	g_object_unref (info->manager);
+
+	cleanup_command = g_strdup_printf ("rm -Rf %s/", info->data_location);
+	g_spawn_command_line_sync (cleanup_command, NULL, NULL, NULL, NULL);
+	g_free (cleanup_command);
+
+	g_free (info->data_location);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *current_dir;
+	gint result;
+
+	setlocale (LC_COLLATE, "en_US.utf8");
+
+	current_dir = g_get_current_dir ();
+	tests_data_dir = g_build_path (G_DIR_SEPARATOR_S, current_dir, "turtle-import-test-data-XXXXXX", NULL);
+	g_free (current_dir);
+
+	g_mkdtemp (tests_data_dir);
+
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/libtracker-data/turtle-import", TestInfo, NULL, setup, test_turtle_import, teardown);
+	g_test_add ("/libtracker-data/turtle-import/error", TestInfo, NULL, setup, test_turtle_import_error, teardown);
+#if HAVE_TRACKER_FTS
+	g_test_add ("/libtracker-data/turtle-import/interrupted", TestInfo, NULL, setup, test_turtle_import_interrupted, teardown);
+#endif
+
+	if (g_test_perf ()) {
+		g_test_add ("/libtracker-data/turtle-import/benchmark", TestInfo, NULL,
+		            setup, test_turtle_import_benchmark, teardown);
+	}
+
+	result = g_test_run ();
+
+	g_assert_cmpint (g_remove (tests_data_dir), ==, 0);
+	g_free (tests_data_dir);
+
+	return result;
+}
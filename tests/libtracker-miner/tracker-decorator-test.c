@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+#include <glib.h>
+#include <libtracker-miner/tracker-miner.h>
+
+#define DATA_SOURCE "urn:decorator-test:data-source"
+
+typedef struct {
+	TrackerDecorator parent_instance;
+} TestDecorator;
+
+typedef struct {
+	TrackerDecoratorClass parent_class;
+} TestDecoratorClass;
+
+typedef struct {
+	TrackerSparqlConnection *connection;
+	TrackerDecorator *decorator;
+	gchar *test_root_path;
+	GMainLoop *loop;
+} TrackerDecoratorTestFixture;
+
+G_DEFINE_TYPE (TestDecorator, test_decorator, TRACKER_TYPE_DECORATOR)
+
+#define ADD_TEST(name, func) \
+	g_test_add ("/libtracker-miner/tracker-decorator/" name, \
+	            TrackerDecoratorTestFixture, NULL, \
+	            fixture_setup, func, fixture_teardown)
+
+static void
+test_decorator_class_init (TestDecoratorClass *klass)
+{
+}
+
+static void
+test_decorator_init (TestDecorator *decorator)
+{
+}
+
+static void
+fixture_setup (TrackerDecoratorTestFixture *fixture,
+               gconstpointer                data)
+{
+	const gchar *class_names[] = { "nfo:Document", NULL };
+	GError *error = NULL;
+	GFile *root, *file, *ontology;
+	gchar *path;
+
+	path = g_build_filename (g_get_tmp_dir (), "tracker-decorator-test-XXXXXX", NULL);
+	fixture->test_root_path = g_mkdtemp_full (path, 0700);
+
+	root = g_file_new_for_path (fixture->test_root_path);
+	file = g_file_get_child (root, ".db");
+	ontology = g_file_new_for_path (TEST_ONTOLOGIES_DIR);
+	fixture->connection = tracker_sparql_connection_local_new (0, file, file, ontology, NULL, &error);
+	g_assert_no_error (error);
+	g_object_unref (ontology);
+	g_object_unref (file);
+	g_object_unref (root);
+
+	/* The decorator warns about the notifier, it needs the store
+	 * over D-Bus, which isn't needed here.
+	 */
+	g_log_set_always_fatal (G_LOG_FATAL_MASK | G_LOG_LEVEL_CRITICAL);
+
+	fixture->decorator = g_initable_new (test_decorator_get_type (),
+	                                     NULL, &error,
+	                                     "connection", fixture->connection,
+	                                     "data-source", DATA_SOURCE,
+	                                     "class-names", class_names,
+	                                     NULL);
+	g_assert_no_error (error);
+
+	fixture->loop = g_main_loop_new (NULL, FALSE);
+}
+
+static void
+fixture_teardown (TrackerDecoratorTestFixture *fixture,
+                  gconstpointer                data)
+{
+	gchar *command;
+
+	g_object_unref (fixture->decorator);
+	g_object_unref (fixture->connection);
+	g_main_loop_unref (fixture->loop);
+
+	command = g_strdup_printf ("rm -rf %s", fixture->test_root_path);
+	g_assert (g_spawn_command_line_sync (command, NULL, NULL, NULL, NULL));
+	g_free (command);
+	g_free (fixture->test_root_path);
+}
+
+static gint
+insert_document (TrackerDecoratorTestFixture *fixture,
+                 guint                        n)
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	gchar *sparql;
+	gint id;
+
+	sparql = g_strdup_printf ("INSERT { <urn:decorator-test:%u> a nfo:Document ; "
+	                          "nie:url \"file:///decorator-test/%u\" ; "
+	                          "tracker:available true }", n, n);
+	tracker_sparql_connection_update (fixture->connection, sparql,
+	                                  G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+	g_free (sparql);
+
+	sparql = g_strdup_printf ("SELECT tracker:id(<urn:decorator-test:%u>) {}", n);
+	cursor = tracker_sparql_connection_query (fixture->connection, sparql, NULL, &error);
+	g_assert_no_error (error);
+	g_free (sparql);
+
+	g_assert (tracker_sparql_cursor_next (cursor, NULL, &error));
+	id = tracker_sparql_cursor_get_integer (cursor, 0);
+	g_object_unref (cursor);
+
+	return id;
+}
+
+static void
+items_available_cb (TrackerDecorator            *decorator,
+                    TrackerDecoratorTestFixture *fixture)
+{
+	g_main_loop_quit (fixture->loop);
+}
+
+static void
+test_decorator_remaining_blacklisted (TrackerDecoratorTestFixture *fixture,
+                                      gconstpointer                data)
+{
+	gint id;
+
+	insert_document (fixture, 1);
+	insert_document (fixture, 2);
+	id = insert_document (fixture, 3);
+
+	/* One blacklisted item still matches, the other is long gone */
+	tracker_decorator_delete_id (fixture->decorator, id);
+	tracker_decorator_delete_id (fixture->decorator, G_MAXINT);
+
+	g_signal_connect (fixture->decorator, "items-available",
+	                  G_CALLBACK (items_available_cb), fixture);
+	tracker_miner_start (TRACKER_MINER (fixture->decorator));
+	g_main_loop_run (fixture->loop);
+
+	g_assert_cmpuint (tracker_decorator_get_n_items (fixture->decorator), ==, 2);
+}
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	/* Don't autostart or reach a store on the session bus */
+	g_setenv ("DBUS_SESSION_BUS_ADDRESS", "disabled:", TRUE);
+
+	ADD_TEST ("remaining-blacklisted", test_decorator_remaining_blacklisted);
+
+	return g_test_run ();
+}
@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
  * 02110-1301, USA.
  */
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -231,6 +232,154 @@ test_file_system_properties (TestCommonContext *fixture,
 	g_assert (ret_value == NULL);
 }
 
+static void
+test_file_system_large_directory (TestCommonContext *fixture,
+                                  gconstpointer      data)
+{
+	GFile *file, *parent, *other;
+	GPtrArray *children;
+	gchar *uri;
+	guint i;
+
+	file = g_file_new_for_uri ("file:///aaa/");
+	parent = tracker_file_system_get_file (fixture->file_system, file,
+					       G_FILE_TYPE_DIRECTORY, NULL);
+	g_object_unref (file);
+
+	/* Many siblings, lookups must find the right one */
+	children = g_ptr_array_new ();
+
+	for (i = 0; i < 500; i++) {
+		uri = g_strdup_printf ("file:///aaa/child%d", i);
+		file = g_file_new_for_uri (uri);
+		g_ptr_array_add (children,
+		                 tracker_file_system_get_file (fixture->file_system, file,
+		                                               G_FILE_TYPE_REGULAR, parent));
+		g_object_unref (file);
+		g_free (uri);
+	}
+
+	for (i = 0; i < children->len; i++) {
+		uri = g_strdup_printf ("file:///aaa/child%d", i);
+		file = g_file_new_for_uri (uri);
+		other = tracker_file_system_peek_file (fixture->file_system, file);
+		g_assert (other == g_ptr_array_index (children, i));
+		g_object_unref (file);
+		g_free (uri);
+	}
+
+	/* Similarly named files must not match */
+	file = g_file_new_for_uri ("file:///aaa/child1x");
+	other = tracker_file_system_peek_file (fixture->file_system, file);
+	g_assert (other == NULL);
+	g_object_unref (file);
+
+	/* Drop a child, and check it's gone */
+	g_object_unref (g_ptr_array_index (children, 42));
+
+	file = g_file_new_for_uri ("file:///aaa/child42");
+	other = tracker_file_system_peek_file (fixture->file_system, file);
+	g_assert (other == NULL);
+	g_object_unref (file);
+
+	/* Children under an interned sibling, file:///aaa/child43 */
+	file = g_file_new_for_uri ("file:///aaa/child43/ccc");
+	other = tracker_file_system_get_file (fixture->file_system, file,
+					      G_FILE_TYPE_REGULAR, NULL);
+	g_assert (other != NULL);
+	g_object_unref (file);
+
+	file = g_file_new_for_uri ("file:///aaa/child43/ccc");
+	g_assert (tracker_file_system_peek_file (fixture->file_system, file) == other);
+	g_object_unref (file);
+
+	file = g_file_new_for_uri ("file:///aaa/child44");
+	g_assert (tracker_file_system_peek_file (fixture->file_system, file) ==
+	          g_ptr_array_index (children, 44));
+	g_object_unref (file);
+
+	g_ptr_array_unref (children);
+}
+
+static gsize
+get_rss_kb (void)
+{
+	gchar *contents = NULL;
+	gulong size = 0, rss = 0;
+
+	if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+		sscanf (contents, "%lu %lu", &size, &rss);
+
+	g_free (contents);
+
+	return rss * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static void
+test_file_system_memory_benchmark (TestCommonContext *fixture,
+                                   gconstpointer      data)
+{
+	const guint n_dirs = 5000, n_files = 1000;
+	GFile *file, *root, *dir;
+	gsize rss_start, rss_end;
+	gdouble elapsed;
+	gchar *uri;
+	guint i, j;
+
+	rss_start = get_rss_kb ();
+	g_test_timer_start ();
+
+	file = g_file_new_for_uri ("file:///benchmark");
+	root = tracker_file_system_get_file (fixture->file_system, file,
+	                                     G_FILE_TYPE_DIRECTORY, NULL);
+	g_object_unref (file);
+
+	/* Files are interned the way the crawler does, and their
+	 * reference is handed to the file system.
+	 */
+	for (i = 0; i < n_dirs; i++) {
+		uri = g_strdup_printf ("file:///benchmark/dir%d", i);
+		file = g_file_new_for_uri (uri);
+		dir = tracker_file_system_get_file (fixture->file_system, file,
+		                                    G_FILE_TYPE_DIRECTORY, root);
+		g_object_unref (file);
+		g_free (uri);
+
+		for (j = 0; j < n_files; j++) {
+			uri = g_strdup_printf ("file:///benchmark/dir%d/file%d.txt", i, j);
+			file = g_file_new_for_uri (uri);
+			tracker_file_system_get_file (fixture->file_system, file,
+			                              G_FILE_TYPE_REGULAR, dir);
+			g_object_unref (file);
+			g_free (uri);
+		}
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	rss_end = get_rss_kb ();
+
+	g_test_minimized_result (elapsed, "Inserted %u nodes in %.2fs",
+	                         n_dirs * n_files, elapsed);
+	g_test_minimized_result ((gdouble) (rss_end - rss_start),
+	                         "RSS growth %" G_GSIZE_FORMAT " KiB (%.1f bytes/node)",
+	                         rss_end - rss_start,
+	                         (rss_end - rss_start) * 1024.0 / (n_dirs * n_files));
+
+	/* Lookups on the populated tree */
+	g_test_timer_start ();
+
+	for (i = 0; i < n_dirs; i++) {
+		uri = g_strdup_printf ("file:///benchmark/dir%d/file%d.txt", i, n_files - 1);
+		file = g_file_new_for_uri (uri);
+		g_assert (tracker_file_system_peek_file (fixture->file_system, file) != NULL);
+		g_object_unref (file);
+		g_free (uri);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "%u lookups in %.3fs", n_dirs, elapsed);
+}
+
 gint
 main (gint    argc,
       gchar **argv)
@@ -249,6 +398,13 @@ main (gint    argc,
 		  test_file_system_reparenting);
 	test_add ("/libtracker-miner/file-system/file-properties",
 	          test_file_system_properties);
+	test_add ("/libtracker-miner/file-system/large-directory",
+	          test_file_system_large_directory);
+
+	if (g_test_perf ()) {
+		test_add ("/libtracker-miner/file-system/memory-benchmark",
+		          test_file_system_memory_benchmark);
+	}
 
 	return g_test_run ();
 }
@@ -943,6 +943,203 @@ test_indexing_tree_030 (TestCommonContext *fixture,
 	ASSERT_INDEXABLE (fixture, TEST_DIRECTORY_ABA);
 }
 
+static const gchar *filter_globs[] = {
+	"*.o", "*.la", "*.lo", "*~", "*.tmp", "*.part",
+	"core", "Thumbs.db", ".DS_Store",
+	"#*#", ".#*", "lost+found*",
+	"*.??~", "*cache*", "backup-*.tar.*", "?", "a?c*d",
+	"caf\xc3\xa9*", "*\xc3\xa9?", "x**y", "**",
+	"/A/B",
+	NULL
+};
+
+static const gchar *filter_names[] = {
+	"foo.o", "foo.c", ".o", "o", "foo.la", "foo.lo", "foo.l",
+	"notes.txt~", "notes.txt", "a.tmp", "a.tmpx", "video.part",
+	"core", "core.1", "Thumbs.db", "thumbs.db", ".DS_Store",
+	"#draft#", "#draft", ".#lock", "lost+found", "lost+found.1",
+	"file.ab~", "file.a~", "file.abc~", "mycache", "cache", "cach",
+	"backup-1.tar.gz", "backup-1.tar", "x", "xy", "\xc3\xa9",
+	"abcd", "aXcYYd", "acd", "a\xc3\xa9" "cd",
+	"caf\xc3\xa9", "caf\xc3\xa9s", "cafe", "r\xc3\xa9s", "r\xc3\xa9", "\xc3\xa9\xc3\xa9",
+	"xy", "x123y", "y", "B", "\xff.o", "\xff\xfe",
+	NULL
+};
+
+static gboolean
+reference_match (const gchar *name,
+                 guint        n_globs)
+{
+	guint i;
+
+	for (i = 0; i < n_globs && filter_globs[i]; i++) {
+		if (g_pattern_match_simple (filter_globs[i], name))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+check_filter_names (TrackerIndexingTree *tree,
+                    guint                n_globs)
+{
+	guint i;
+
+	for (i = 0; filter_names[i]; i++) {
+		gchar *path;
+		GFile *file;
+
+		path = g_build_filename ("/filter-test", filter_names[i], NULL);
+		file = g_file_new_for_path (path);
+
+		g_assert_cmpint (tracker_indexing_tree_file_matches_filter (tree, TRACKER_FILTER_FILE, file),
+		                 ==,
+		                 reference_match (filter_names[i], n_globs));
+
+		g_assert_false (tracker_indexing_tree_file_matches_filter (tree, TRACKER_FILTER_DIRECTORY, file));
+
+		g_object_unref (file);
+		g_free (path);
+	}
+}
+
+/* Compiled filters must match exactly what GPatternSpec does */
+static void
+test_indexing_tree_filters (TestCommonContext *fixture,
+                            gconstpointer      data)
+{
+	guint i;
+
+	/* Matchers get rebuilt as filters are added */
+	for (i = 0; filter_globs[i]; i++) {
+		check_filter_names (fixture->tree, i);
+
+		tracker_indexing_tree_add_filter (fixture->tree,
+		                                  TRACKER_FILTER_FILE,
+		                                  filter_globs[i]);
+	}
+
+	check_filter_names (fixture->tree, i);
+
+	/* Absolute paths filter everything below */
+	g_assert_true (tracker_indexing_tree_file_matches_filter (fixture->tree,
+	                                                          TRACKER_FILTER_FILE,
+	                                                          fixture->test_dir[TEST_DIRECTORY_ABA]));
+
+	tracker_indexing_tree_clear_filters (fixture->tree, TRACKER_FILTER_FILE);
+
+	for (i = 0; filter_names[i]; i++) {
+		gchar *path;
+		GFile *file;
+
+		path = g_build_filename ("/filter-test", filter_names[i], NULL);
+		file = g_file_new_for_path (path);
+		g_assert_false (tracker_indexing_tree_file_matches_filter (fixture->tree,
+		                                                           TRACKER_FILTER_FILE,
+		                                                           file));
+		g_object_unref (file);
+		g_free (path);
+	}
+}
+
+static void
+test_indexing_tree_filters_benchmark (TestCommonContext *fixture,
+                                      gconstpointer      data)
+{
+	const guint n_files = 1000, n_rounds = 1000;
+	static const gchar *extensions[] = {
+		"txt", "jpg", "png", "c", "h", "o", "ext4", "ext40", "pdf", "tmp"
+	};
+	GPtrArray *files, *patterns;
+	gdouble elapsed;
+	guint i, j, n_matches = 0, n_reference = 0;
+	GRand *rand;
+
+	files = g_ptr_array_new_with_free_func (g_object_unref);
+	patterns = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+	rand = g_rand_new_with_seed (42);
+
+	/* ~200 globs, in the shapes found in miner configurations */
+	for (i = 0; i < 200; i++) {
+		gchar *glob;
+
+		switch (i % 4) {
+		case 0:
+			glob = g_strdup_printf ("*.ext%u", i);
+			break;
+		case 1:
+			glob = g_strdup_printf ("name-%u", i);
+			break;
+		case 2:
+			glob = g_strdup_printf ("prefix%u-*", i);
+			break;
+		default:
+			glob = g_strdup_printf ("*cache%u?*", i);
+			break;
+		}
+
+		tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, glob);
+		g_ptr_array_add (patterns, g_pattern_spec_new (glob));
+		g_free (glob);
+	}
+
+	for (i = 0; i < n_files; i++) {
+		gchar *path;
+
+		path = g_strdup_printf ("/benchmark/file-%u-%u.%s", i,
+		                        g_rand_int (rand),
+		                        extensions[i % G_N_ELEMENTS (extensions)]);
+		g_ptr_array_add (files, g_file_new_for_path (path));
+		g_free (path);
+	}
+
+	g_test_timer_start ();
+
+	for (i = 0; i < n_rounds; i++) {
+		for (j = 0; j < files->len; j++) {
+			if (tracker_indexing_tree_file_matches_filter (fixture->tree,
+			                                               TRACKER_FILTER_FILE,
+			                                               g_ptr_array_index (files, j)))
+				n_matches++;
+		}
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "Matched %u basenames against %u globs in %.3fs",
+	                         n_files * n_rounds, patterns->len, elapsed);
+
+	/* Same workload on GPatternSpec, for comparison */
+	g_test_timer_start ();
+
+	for (i = 0; i < n_rounds; i++) {
+		for (j = 0; j < files->len; j++) {
+			gchar *basename;
+			guint k;
+
+			basename = g_file_get_basename (g_ptr_array_index (files, j));
+
+			for (k = 0; k < patterns->len; k++) {
+				if (g_pattern_match_string (g_ptr_array_index (patterns, k), basename)) {
+					n_reference++;
+					break;
+				}
+			}
+
+			g_free (basename);
+		}
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_message ("GPatternSpec list took %.3fs", elapsed);
+
+	g_assert_cmpuint (n_matches, ==, n_reference);
+
+	g_rand_free (rand);
+	g_ptr_array_unref (patterns);
+	g_ptr_array_unref (files);
+}
+
 gint
 main (gint    argc,
       gchar **argv)
@@ -981,6 +1178,12 @@ main (gint    argc,
 	test_add ("/libtracker-miner/indexing-tree/028", test_indexing_tree_028);
 	test_add ("/libtracker-miner/indexing-tree/029", test_indexing_tree_029);
 	test_add ("/libtracker-miner/indexing-tree/030", test_indexing_tree_030);
+	test_add ("/libtracker-miner/indexing-tree/filters", test_indexing_tree_filters);
+
+	if (g_test_perf ()) {
+		test_add ("/libtracker-miner/indexing-tree/filters-benchmark",
+		          test_indexing_tree_filters_benchmark);
+	}
 
 	return g_test_run ();
 }
@@ -25,6 +25,7 @@
 
 /* Special case, the monitor header is not normally exported */
 #include <libtracker-miner/tracker-monitor.h>
+#include <libtracker-miner/tracker-monitor-inotify.h>
 
 /* -------------- COMMON FOR ALL FILE EVENT TESTS ----------------- */
 
@@ -1358,6 +1359,318 @@ test_monitor_directory_event_moved_from_not_monitored (TrackerMonitorTestFixture
 	g_free (dest_path);
 }
 
+/* ----------------------------- INOTIFY BACKEND TESTS --------------------------------- */
+
+#ifdef __linux__
+
+typedef struct {
+	GFileMonitorEvent event_type;
+	GFile *file;
+	GFile *other_file;
+} InotifyEvent;
+
+typedef struct {
+	TrackerMonitorInotify *inotify;
+	GArray *events;
+	gchar *path;
+} InotifyTestFixture;
+
+static void
+inotify_event_clear (InotifyEvent *event)
+{
+	g_object_unref (event->file);
+	g_clear_object (&event->other_file);
+}
+
+static void
+inotify_event_cb (GFile             *file,
+                  GFile             *other_file,
+                  GFileMonitorEvent  event_type,
+                  gboolean           is_directory,
+                  gpointer           user_data)
+{
+	InotifyTestFixture *fixture = user_data;
+	InotifyEvent event;
+
+	event.event_type = event_type;
+	event.file = g_object_ref (file);
+	event.other_file = other_file ? g_object_ref (other_file) : NULL;
+	g_array_append_val (fixture->events, event);
+}
+
+static void
+test_inotify_setup (InotifyTestFixture *fixture,
+                    gconstpointer       data)
+{
+	GError *error = NULL;
+	gchar *basename;
+
+	fixture->events = g_array_new (FALSE, FALSE, sizeof (InotifyEvent));
+	g_array_set_clear_func (fixture->events, (GDestroyNotify) inotify_event_clear);
+
+	basename = g_strdup_printf ("monitor-inotify-test-%d", getpid ());
+	fixture->path = g_build_path (G_DIR_SEPARATOR_S, g_get_tmp_dir (), basename, NULL);
+	g_assert_cmpint (g_mkdir_with_parents (fixture->path, 00755), ==, 0);
+	g_free (basename);
+
+	fixture->inotify = tracker_monitor_inotify_new (GPOINTER_TO_UINT (data),
+	                                                inotify_event_cb,
+	                                                fixture,
+	                                                &error);
+	g_assert_no_error (error);
+	g_assert (fixture->inotify != NULL);
+}
+
+static void
+test_inotify_teardown (InotifyTestFixture *fixture,
+                       gconstpointer       data)
+{
+	gchar *command;
+
+	tracker_monitor_inotify_free (fixture->inotify);
+
+	command = g_strdup_printf ("rm -rf %s", fixture->path);
+	g_assert (g_spawn_command_line_sync (command, NULL, NULL, NULL, NULL));
+	g_free (command);
+
+	g_array_unref (fixture->events);
+	g_free (fixture->path);
+}
+
+static GFile *
+inotify_test_file (InotifyTestFixture *fixture,
+                   const gchar        *relative_path)
+{
+	GFile *file;
+	gchar *path;
+
+	path = g_build_filename (fixture->path, relative_path, NULL);
+	file = g_file_new_for_path (path);
+	g_free (path);
+
+	return file;
+}
+
+static TrackerInotifyWatch *
+inotify_test_add_directory (InotifyTestFixture *fixture,
+                            const gchar        *name)
+{
+	TrackerInotifyWatch *watch;
+	GFile *file;
+
+	file = inotify_test_file (fixture, name);
+	g_assert (g_file_make_directory (file, NULL, NULL));
+	watch = tracker_monitor_inotify_add (fixture->inotify, file);
+	g_object_unref (file);
+
+	return watch;
+}
+
+static void
+inotify_test_rename (InotifyTestFixture *fixture,
+                     const gchar        *from,
+                     const gchar        *to)
+{
+	gchar *from_path, *to_path;
+
+	from_path = g_build_filename (fixture->path, from, NULL);
+	to_path = g_build_filename (fixture->path, to, NULL);
+	g_assert_cmpint (g_rename (from_path, to_path), ==, 0);
+	g_free (from_path);
+	g_free (to_path);
+}
+
+static gboolean
+inotify_timeout_cb (gpointer user_data)
+{
+	gboolean *timed_out = user_data;
+
+	*timed_out = TRUE;
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Runs the main loop until @event_type is received on @relative_path,
+ * returns the event or %NULL if it didn't arrive within @seconds.
+ */
+static InotifyEvent *
+inotify_test_wait (InotifyTestFixture *fixture,
+                   const gchar        *relative_path,
+                   GFileMonitorEvent   event_type,
+                   guint               seconds)
+{
+	InotifyEvent *found = NULL;
+	gboolean timed_out = FALSE;
+	GSource *source;
+	GFile *file;
+	guint i;
+
+	file = inotify_test_file (fixture, relative_path);
+
+	source = g_timeout_source_new_seconds (seconds);
+	g_source_set_callback (source, inotify_timeout_cb, &timed_out, NULL);
+	g_source_attach (source, NULL);
+
+	while (!found && !timed_out) {
+		for (i = 0; i < fixture->events->len; i++) {
+			InotifyEvent *event = &g_array_index (fixture->events, InotifyEvent, i);
+
+			if (event->event_type == event_type &&
+			    g_file_equal (event->file, file)) {
+				found = event;
+				break;
+			}
+		}
+
+		if (!found)
+			g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_source_destroy (source);
+	g_source_unref (source);
+	g_object_unref (file);
+
+	return found;
+}
+
+/* Lets the main loop run for @msec, eg. so polled directories
+ * get their baseline rescan.
+ */
+static void
+inotify_test_idle (guint msec)
+{
+	gboolean timed_out = FALSE;
+	GSource *source;
+
+	source = g_timeout_source_new (msec);
+	g_source_set_callback (source, inotify_timeout_cb, &timed_out, NULL);
+	g_source_attach (source, NULL);
+
+	while (!timed_out)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_source_unref (source);
+}
+
+static void
+test_monitor_inotify_moves (InotifyTestFixture *fixture,
+                            gconstpointer       data)
+{
+	TrackerInotifyWatch *a, *b;
+	InotifyEvent *event;
+	GFile *file;
+
+	a = inotify_test_add_directory (fixture, "a");
+	b = inotify_test_add_directory (fixture, "b");
+	g_assert_cmpuint (tracker_monitor_inotify_get_n_polled (fixture->inotify), ==, 0);
+
+	set_file_contents (fixture->path, "a/x", "foo", NULL);
+	set_file_contents (fixture->path, "a/z", "foo", NULL);
+	set_file_contents (fixture->path, "w", "foo", NULL);
+	g_assert (inotify_test_wait (fixture, "a/z", G_FILE_MONITOR_EVENT_CREATED, TEST_TIMEOUT));
+
+	/* Both ends monitored, paired through the cookie */
+	inotify_test_rename (fixture, "a/x", "b/y");
+	event = inotify_test_wait (fixture, "a/x", G_FILE_MONITOR_EVENT_RENAMED, TEST_TIMEOUT);
+	g_assert (event != NULL);
+	file = inotify_test_file (fixture, "b/y");
+	g_assert (event->other_file != NULL);
+	g_assert (g_file_equal (event->other_file, file));
+	g_object_unref (file);
+
+	/* Moved somewhere not monitored, reported once pairing times out */
+	inotify_test_rename (fixture, "a/z", "z");
+	event = inotify_test_wait (fixture, "a/z", G_FILE_MONITOR_EVENT_MOVED_OUT, TEST_TIMEOUT);
+	g_assert (event != NULL);
+	g_assert (event->other_file == NULL);
+
+	/* Moved in from somewhere not monitored */
+	inotify_test_rename (fixture, "w", "a/w");
+	event = inotify_test_wait (fixture, "a/w", G_FILE_MONITOR_EVENT_MOVED_IN, TEST_TIMEOUT);
+	g_assert (event != NULL);
+	g_assert (event->other_file == NULL);
+
+	g_assert (!inotify_test_wait (fixture, "b/y", G_FILE_MONITOR_EVENT_CREATED, 1));
+
+	tracker_inotify_watch_free (a);
+	tracker_inotify_watch_free (b);
+}
+
+static void
+test_monitor_inotify_budget (InotifyTestFixture *fixture,
+                             gconstpointer       data)
+{
+	TrackerInotifyWatch *a, *b, *c, *d;
+
+	/* The budget is 2 directories */
+	a = inotify_test_add_directory (fixture, "a");
+	b = inotify_test_add_directory (fixture, "b");
+	g_assert_cmpuint (tracker_monitor_inotify_get_n_polled (fixture->inotify), ==, 0);
+
+	c = inotify_test_add_directory (fixture, "c");
+	g_assert_cmpuint (tracker_monitor_inotify_get_n_polled (fixture->inotify), ==, 1);
+
+	/* Activity on b makes c the least recently active */
+	set_file_contents (fixture->path, "b/x", "foo", NULL);
+	g_assert (inotify_test_wait (fixture, "b/x", G_FILE_MONITOR_EVENT_CREATED, TEST_TIMEOUT));
+
+	d = inotify_test_add_directory (fixture, "d");
+	g_assert_cmpuint (tracker_monitor_inotify_get_n_polled (fixture->inotify), ==, 2);
+
+	/* b and d kept their kernel watch */
+	set_file_contents (fixture->path, "b/y", "foo", NULL);
+	g_assert (inotify_test_wait (fixture, "b/y", G_FILE_MONITOR_EVENT_CREATED, TEST_TIMEOUT));
+	set_file_contents (fixture->path, "d/x", "foo", NULL);
+	g_assert (inotify_test_wait (fixture, "d/x", G_FILE_MONITOR_EVENT_CREATED, TEST_TIMEOUT));
+
+	tracker_inotify_watch_free (a);
+	tracker_inotify_watch_free (b);
+	tracker_inotify_watch_free (c);
+	tracker_inotify_watch_free (d);
+	g_assert_cmpuint (tracker_monitor_inotify_get_n_polled (fixture->inotify), ==, 0);
+}
+
+static void
+test_monitor_inotify_rescan (InotifyTestFixture *fixture,
+                             gconstpointer       data)
+{
+	TrackerInotifyWatch *a, *b;
+
+	a = inotify_test_add_directory (fixture, "a");
+	set_file_contents (fixture->path, "a/changed", "foo", NULL);
+	set_file_contents (fixture->path, "a/deleted", "foo", NULL);
+
+	/* The budget is 1 directory, a gets polled */
+	b = inotify_test_add_directory (fixture, "b");
+	g_assert_cmpuint (tracker_monitor_inotify_get_n_polled (fixture->inotify), ==, 1);
+
+	/* Let it take the baseline, mtimes have sub-second resolution */
+	inotify_test_idle (500);
+
+	set_file_contents (fixture->path, "a/created", "foo", NULL);
+	set_file_contents (fixture->path, "a/changed", "foo", NULL);
+	inotify_test_rename (fixture, "a/deleted", "deleted");
+
+	/* Rescan shortly instead of in 15s. Not set any earlier, so all
+	 * changes are seen by the same rescan.
+	 */
+	tracker_monitor_inotify_set_rescan_interval (fixture->inotify, 100);
+
+	g_assert (inotify_test_wait (fixture, "a/created", G_FILE_MONITOR_EVENT_CREATED, TEST_TIMEOUT));
+	g_assert (inotify_test_wait (fixture, "a/changed", G_FILE_MONITOR_EVENT_CHANGED, TEST_TIMEOUT));
+	g_assert (inotify_test_wait (fixture, "a/deleted", G_FILE_MONITOR_EVENT_DELETED, TEST_TIMEOUT));
+
+	/* Changes promote it back to a kernel watch, evicting b */
+	g_assert_cmpuint (tracker_monitor_inotify_get_n_polled (fixture->inotify), ==, 1);
+	set_file_contents (fixture->path, "a/promoted", "foo", NULL);
+	g_assert (inotify_test_wait (fixture, "a/promoted", G_FILE_MONITOR_EVENT_CREATED, TEST_TIMEOUT));
+
+	tracker_inotify_watch_free (a);
+	tracker_inotify_watch_free (b);
+}
+
+#endif /* __linux__ */
+
 /* ----------------------------- BASIC API TESTS --------------------------------- */
 
 static void
@@ -1538,5 +1851,27 @@ main (gint    argc,
 		    test_monitor_directory_event_moved_from_not_monitored,
 	            test_monitor_common_teardown);
 
+#ifdef __linux__
+	/* Inotify backend tests */
+	g_test_add ("/libtracker-miner/tracker-monitor/inotify/moves",
+	            InotifyTestFixture,
+	            GUINT_TO_POINTER (10),
+	            test_inotify_setup,
+	            test_monitor_inotify_moves,
+	            test_inotify_teardown);
+	g_test_add ("/libtracker-miner/tracker-monitor/inotify/budget",
+	            InotifyTestFixture,
+	            GUINT_TO_POINTER (2),
+	            test_inotify_setup,
+	            test_monitor_inotify_budget,
+	            test_inotify_teardown);
+	g_test_add ("/libtracker-miner/tracker-monitor/inotify/rescan",
+	            InotifyTestFixture,
+	            GUINT_TO_POINTER (1),
+	            test_inotify_setup,
+	            test_monitor_inotify_rescan,
+	            test_inotify_teardown);
+#endif
+
 	return g_test_run ();
 }
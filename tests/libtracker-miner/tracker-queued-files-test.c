@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <gio/gio.h>
+
+/* NOTE: We're not including tracker-miner.h here because this is private. */
+#include <libtracker-miner/tracker-priority-queue.h>
+#include <libtracker-miner/tracker-queued-files.h>
+
+#define N_BENCHMARK_DIRS     1000
+#define N_BENCHMARK_FILES    100
+#define N_BENCHMARK_REMOVALS 100
+
+static void
+test_queued_files_contains (void)
+{
+	TrackerQueuedFiles *queued_files;
+	GFile *root, *dir, *file, *other;
+
+	queued_files = tracker_queued_files_new ();
+	root = g_file_new_for_path ("/queued-files");
+	dir = g_file_new_for_path ("/queued-files/dir");
+	file = g_file_new_for_path ("/queued-files/dir/file");
+	other = g_file_new_for_path ("/queued-files/other");
+
+	g_assert (!tracker_queued_files_contains (queued_files, file, TRUE));
+
+	tracker_queued_files_add (queued_files, file);
+
+	/* The file itself only counts if asked for */
+	g_assert (tracker_queued_files_contains (queued_files, file, TRUE));
+	g_assert (!tracker_queued_files_contains (queued_files, file, FALSE));
+
+	/* All its parents have something queued below */
+	g_assert (tracker_queued_files_contains (queued_files, dir, FALSE));
+	g_assert (tracker_queued_files_contains (queued_files, root, FALSE));
+
+	/* Siblings don't */
+	g_assert (!tracker_queued_files_contains (queued_files, other, TRUE));
+
+	/* Events are counted, not files */
+	tracker_queued_files_add (queued_files, file);
+	tracker_queued_files_remove (queued_files, file);
+	g_assert (tracker_queued_files_contains (queued_files, file, TRUE));
+	g_assert (tracker_queued_files_contains (queued_files, root, FALSE));
+
+	/* A queued directory is not a descendant of itself */
+	tracker_queued_files_add (queued_files, dir);
+	tracker_queued_files_remove (queued_files, file);
+	g_assert (!tracker_queued_files_contains (queued_files, file, TRUE));
+	g_assert (tracker_queued_files_contains (queued_files, dir, TRUE));
+	g_assert (!tracker_queued_files_contains (queued_files, dir, FALSE));
+	g_assert (tracker_queued_files_contains (queued_files, root, FALSE));
+
+	tracker_queued_files_remove (queued_files, dir);
+	g_assert (!tracker_queued_files_contains (queued_files, dir, TRUE));
+	g_assert (!tracker_queued_files_contains (queued_files, root, TRUE));
+
+	g_object_unref (root);
+	g_object_unref (dir);
+	g_object_unref (file);
+	g_object_unref (other);
+	tracker_queued_files_free (queued_files);
+}
+
+static gboolean
+file_is_equal_or_descendant (GFile *file,
+                             GFile *prefix)
+{
+	return (g_file_equal (file, prefix) ||
+	        g_file_has_prefix (file, prefix));
+}
+
+static void
+test_queued_files_benchmark (void)
+{
+	TrackerQueuedFiles *queued_files;
+	TrackerPriorityQueue *queue;
+	GPtrArray *removed;
+	gdouble elapsed;
+	guint i, j, n_removed = 0;
+	gchar *path;
+	GFile *file;
+
+	/* Fill the queue the way the miner does after crawling
+	 * a large tree, with one event per file.
+	 */
+	queue = tracker_priority_queue_new ();
+	queued_files = tracker_queued_files_new ();
+
+	for (i = 0; i < N_BENCHMARK_DIRS; i++) {
+		for (j = 0; j < N_BENCHMARK_FILES; j++) {
+			path = g_strdup_printf ("/benchmark/dir%u/file%u", i, j);
+			tracker_priority_queue_add (queue, g_file_new_for_path (path),
+			                            G_PRIORITY_DEFAULT);
+			g_free (path);
+		}
+	}
+
+	/* Cost of keeping the counts up to date as events are queued */
+	g_test_timer_start ();
+
+	for (i = 0; i < N_BENCHMARK_DIRS; i++) {
+		for (j = 0; j < N_BENCHMARK_FILES; j++) {
+			path = g_strdup_printf ("/benchmark/dir%u/file%u", i, j);
+			file = g_file_new_for_path (path);
+			tracker_queued_files_add (queued_files, file);
+			g_object_unref (file);
+			g_free (path);
+		}
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "Counted %u queued files in %.3fs",
+	                         N_BENCHMARK_DIRS * N_BENCHMARK_FILES, elapsed);
+
+	/* DELETED/MOVED events on files that have nothing queued at or
+	 * below them, this used to walk the whole queue every time.
+	 */
+	removed = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (i = 0; i < N_BENCHMARK_REMOVALS; i++) {
+		path = g_strdup_printf ("/benchmark/dir%u/deleted", i);
+		g_ptr_array_add (removed, g_file_new_for_path (path));
+		g_free (path);
+	}
+
+	g_test_timer_start ();
+
+	for (i = 0; i < removed->len; i++) {
+		n_removed += tracker_priority_queue_foreach_remove (queue,
+		                                                    (GEqualFunc) file_is_equal_or_descendant,
+		                                                    g_ptr_array_index (removed, i),
+		                                                    g_object_unref);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_message ("Without counts: %u removals in %.3fs", removed->len, elapsed);
+
+	g_test_timer_start ();
+
+	for (i = 0; i < removed->len; i++) {
+		file = g_ptr_array_index (removed, i);
+
+		if (!tracker_queued_files_contains (queued_files, file, TRUE))
+			continue;
+
+		n_removed += tracker_priority_queue_foreach_remove (queue,
+		                                                    (GEqualFunc) file_is_equal_or_descendant,
+		                                                    file,
+		                                                    g_object_unref);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "With counts: %u removals in %.3fs",
+	                         removed->len, elapsed);
+
+	g_assert_cmpint (n_removed, ==, 0);
+	g_assert_cmpint (tracker_priority_queue_get_length (queue), ==,
+	                 N_BENCHMARK_DIRS * N_BENCHMARK_FILES);
+
+	/* Checking whether a root still has queued descendants,
+	 * the last directory queued is the worst case for the walk.
+	 */
+	path = g_strdup_printf ("/benchmark/dir%u", N_BENCHMARK_DIRS - 1);
+	file = g_file_new_for_path (path);
+	g_free (path);
+
+	g_test_timer_start ();
+	g_assert (tracker_priority_queue_find (queue, NULL,
+	                                       (GEqualFunc) g_file_has_prefix,
+	                                       file) != NULL);
+	elapsed = g_test_timer_elapsed ();
+	g_test_message ("Without counts: root check in %.6fs", elapsed);
+
+	g_test_timer_start ();
+	g_assert (tracker_queued_files_contains (queued_files, file, FALSE));
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "With counts: root check in %.6fs", elapsed);
+
+	g_object_unref (file);
+
+	while ((file = tracker_priority_queue_pop (queue, NULL)) != NULL) {
+		tracker_queued_files_remove (queued_files, file);
+		g_object_unref (file);
+	}
+
+	g_ptr_array_unref (removed);
+	tracker_priority_queue_unref (queue);
+	tracker_queued_files_free (queued_files);
+}
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/libtracker-miner/tracker-queued-files/contains",
+	                 test_queued_files_contains);
+
+	if (g_test_perf ()) {
+		g_test_add_func ("/libtracker-miner/tracker-queued-files/benchmark",
+		                 test_queued_files_benchmark);
+	}
+
+	return g_test_run ();
+}
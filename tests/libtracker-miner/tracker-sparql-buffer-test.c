@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+#include <glib.h>
+
+/* NOTE: We're not including tracker-miner.h here because this is private. */
+#include <libtracker-miner/tracker-sparql-buffer.h>
+
+#define N_BENCHMARK_TASKS 20000
+
+typedef struct {
+	TrackerSparqlConnection *connection;
+	gchar *test_root_path;
+} TrackerSparqlBufferTestFixture;
+
+typedef struct {
+	guint n_pending;
+	guint n_errors;
+	GFile *failed_file;
+} PushData;
+
+#define ADD_TEST(name, func) \
+	g_test_add ("/libtracker-miner/tracker-sparql-buffer/" name, \
+	            TrackerSparqlBufferTestFixture, NULL, \
+	            fixture_setup, func, fixture_teardown)
+
+static void
+fixture_setup (TrackerSparqlBufferTestFixture *fixture,
+               gconstpointer                   data)
+{
+	GError *error = NULL;
+	GFile *root, *file, *ontology;
+	gchar *path;
+
+	path = g_build_filename (g_get_tmp_dir (), "tracker-sparql-buffer-test-XXXXXX", NULL);
+	fixture->test_root_path = g_mkdtemp_full (path, 0700);
+
+	root = g_file_new_for_path (fixture->test_root_path);
+	file = g_file_get_child (root, ".db");
+	ontology = g_file_new_for_path (TEST_ONTOLOGIES_DIR);
+	fixture->connection = tracker_sparql_connection_local_new (0, file, file, ontology, NULL, &error);
+	g_assert_no_error (error);
+	g_object_unref (ontology);
+	g_object_unref (file);
+	g_object_unref (root);
+}
+
+static void
+fixture_teardown (TrackerSparqlBufferTestFixture *fixture,
+                  gconstpointer                   data)
+{
+	gchar *command;
+
+	g_object_unref (fixture->connection);
+
+	command = g_strdup_printf ("rm -rf %s", fixture->test_root_path);
+	g_assert (g_spawn_command_line_sync (command, NULL, NULL, NULL, NULL));
+	g_free (command);
+	g_free (fixture->test_root_path);
+}
+
+static gchar *
+create_insert (guint n)
+{
+	return g_strdup_printf ("INSERT { <urn:sparql-buffer-test:%u> a nfo:Document ; "
+	                        "nie:title \"Document %u\" }", n, n);
+}
+
+static void
+push_cb (GObject      *object,
+         GAsyncResult *res,
+         gpointer      user_data)
+{
+	PushData *data = user_data;
+	TrackerTask *task;
+	GError *error = NULL;
+
+	task = tracker_sparql_buffer_push_finish (TRACKER_SPARQL_BUFFER (object),
+	                                          res, &error);
+	g_assert (task != NULL);
+
+	if (error) {
+		g_clear_object (&data->failed_file);
+		data->failed_file = g_object_ref (tracker_task_get_file (task));
+		data->n_errors++;
+		g_error_free (error);
+	}
+
+	data->n_pending--;
+}
+
+static void
+push_task (TrackerSparqlBuffer *buffer,
+           PushData            *data,
+           guint                n,
+           gchar               *sparql)
+{
+	TrackerTask *task;
+	GFile *file;
+	gchar *uri;
+
+	uri = g_strdup_printf ("file:///sparql-buffer-test/%u", n);
+	file = g_file_new_for_uri (uri);
+	task = tracker_sparql_task_new_take_sparql_str (file, sparql);
+
+	data->n_pending++;
+	tracker_sparql_buffer_push (buffer, task, G_PRIORITY_DEFAULT,
+	                            push_cb, data);
+
+	tracker_task_unref (task);
+	g_object_unref (file);
+	g_free (uri);
+}
+
+static void
+wait_for_pending (PushData *data)
+{
+	while (data->n_pending > 0)
+		g_main_context_iteration (NULL, TRUE);
+}
+
+static gint
+count_documents (TrackerSparqlBufferTestFixture *fixture)
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	gint count;
+
+	cursor = tracker_sparql_connection_query (fixture->connection,
+	                                          "SELECT COUNT(?u) { ?u a nfo:Document }",
+	                                          NULL, &error);
+	g_assert_no_error (error);
+	g_assert (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	count = tracker_sparql_cursor_get_integer (cursor, 0);
+	g_object_unref (cursor);
+
+	return count;
+}
+
+static void
+test_sparql_buffer_push (TrackerSparqlBufferTestFixture *fixture,
+                         gconstpointer                   user_data)
+{
+	TrackerSparqlBuffer *buffer;
+	PushData data = { 0 };
+	guint i;
+
+	buffer = tracker_sparql_buffer_new (fixture->connection, 100);
+
+	for (i = 0; i < 10; i++)
+		push_task (buffer, &data, i, create_insert (i));
+
+	tracker_sparql_buffer_flush (buffer, "test");
+	wait_for_pending (&data);
+
+	g_assert_cmpint (data.n_errors, ==, 0);
+	g_assert_cmpint (count_documents (fixture), ==, 10);
+
+	g_object_unref (buffer);
+}
+
+static void
+test_sparql_buffer_error (TrackerSparqlBufferTestFixture *fixture,
+                          gconstpointer                   user_data)
+{
+	TrackerSparqlBuffer *buffer;
+	PushData data = { 0 };
+	gchar *uri;
+	guint i;
+
+	buffer = tracker_sparql_buffer_new (fixture->connection, 100);
+
+	for (i = 0; i < 10; i++) {
+		if (i == 5)
+			push_task (buffer, &data, i, g_strdup ("INSERT { <urn:x> a nfo:Bogus }"));
+		else
+			push_task (buffer, &data, i, create_insert (i));
+	}
+
+	g_test_expect_message ("Tracker", G_LOG_LEVEL_CRITICAL,
+	                       "*Error in task 5*");
+	tracker_sparql_buffer_flush (buffer, "test");
+	wait_for_pending (&data);
+	g_test_assert_expected_messages ();
+
+	/* The error must be reported on the task that caused it,
+	 * and the rest of the batch must still be applied.
+	 */
+	g_assert_cmpint (data.n_errors, ==, 1);
+	uri = g_file_get_uri (data.failed_file);
+	g_assert_cmpstr (uri, ==, "file:///sparql-buffer-test/5");
+	g_assert_cmpint (count_documents (fixture), ==, 9);
+
+	g_free (uri);
+	g_object_unref (data.failed_file);
+	g_object_unref (buffer);
+}
+
+static void
+test_sparql_buffer_benchmark (TrackerSparqlBufferTestFixture *fixture,
+                              gconstpointer                   user_data)
+{
+	TrackerSparqlBuffer *buffer;
+	PushData data = { 0 };
+	GError *error = NULL;
+	gdouble buffer_elapsed, direct_elapsed;
+	gchar *sparql;
+	guint i;
+
+	/* Throughput of the buffer, fed the way TrackerMinerFS does:
+	 * tasks are pushed until the pool limit is reached, then the
+	 * main loop runs until there is room again.
+	 */
+	buffer = tracker_sparql_buffer_new (fixture->connection, 100);
+
+	g_test_timer_start ();
+
+	for (i = 0; i < N_BENCHMARK_TASKS; i++) {
+		while (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (buffer)))
+			g_main_context_iteration (NULL, TRUE);
+
+		push_task (buffer, &data, i, create_insert (i));
+	}
+
+	tracker_sparql_buffer_flush (buffer, "benchmark");
+	wait_for_pending (&data);
+
+	buffer_elapsed = g_test_timer_elapsed ();
+	g_assert_cmpint (data.n_errors, ==, 0);
+	g_object_unref (buffer);
+
+	/* Baseline: the same updates issued one by one on the connection */
+	g_test_timer_start ();
+
+	for (i = 0; i < N_BENCHMARK_TASKS; i++) {
+		sparql = create_insert (N_BENCHMARK_TASKS + i);
+		tracker_sparql_connection_update (fixture->connection, sparql,
+		                                  G_PRIORITY_DEFAULT, NULL, &error);
+		g_assert_no_error (error);
+		g_free (sparql);
+	}
+
+	direct_elapsed = g_test_timer_elapsed ();
+
+	g_test_message ("Buffered: %u updates in %f seconds (%.0f updates/s)",
+	                N_BENCHMARK_TASKS, buffer_elapsed,
+	                N_BENCHMARK_TASKS / buffer_elapsed);
+	g_test_message ("Direct: %u updates in %f seconds (%.0f updates/s)",
+	                N_BENCHMARK_TASKS, direct_elapsed,
+	                N_BENCHMARK_TASKS / direct_elapsed);
+	g_test_maximized_result (N_BENCHMARK_TASKS / buffer_elapsed,
+	                         "Buffered updates per second");
+}
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_message ("Testing SPARQL buffer");
+
+	ADD_TEST ("push", test_sparql_buffer_push);
+	ADD_TEST ("error", test_sparql_buffer_error);
+
+	if (g_test_perf ())
+		ADD_TEST ("benchmark", test_sparql_buffer_benchmark);
+
+	return g_test_run ();
+}
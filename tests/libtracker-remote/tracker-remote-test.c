@@ -0,0 +1,531 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <libtracker-sparql/tracker-sparql.h>
+
+#include "tracker-remote.h"
+
+#define XSD_NS "http://www.w3.org/2001/XMLSchema#"
+#define XML_HEADER "<?xml version=\"1.0\"?>\n<sparql xmlns=\"http://www.w3.org/2005/sparql-results#\">"
+
+/* Large enough for rows to straddle the cursor read buffers */
+#define N_LARGE_ROWS 5000
+#define LARGE_VALUE_SIZE (200 * 1024)
+
+typedef enum {
+	FORMAT_JSON,
+	FORMAT_XML,
+} Format;
+
+typedef struct {
+	Format format;
+	const gchar *document;
+} Document;
+
+/* Its header is still to be read */
+static TrackerSparqlCursor *
+create_uninitialized_cursor (Format       format,
+                             const gchar *document)
+{
+	GInputStream *stream;
+	TrackerSparqlCursor *cursor;
+
+	stream = g_memory_input_stream_new_from_data (g_strdup (document), -1, g_free);
+
+	if (format == FORMAT_JSON)
+		cursor = (TrackerSparqlCursor *) tracker_remote_json_cursor_new (stream);
+	else
+		cursor = (TrackerSparqlCursor *) tracker_remote_xml_cursor_new (stream);
+
+	g_object_unref (stream);
+
+	return cursor;
+}
+
+static TrackerSparqlCursor *
+create_cursor (Format        format,
+               const gchar  *document,
+               GError      **error)
+{
+	TrackerSparqlCursor *cursor;
+
+	cursor = create_uninitialized_cursor (format, document);
+
+	if (!g_initable_init (G_INITABLE (cursor), NULL, error))
+		g_clear_object (&cursor);
+
+	return cursor;
+}
+
+static void
+assert_value (TrackerSparqlCursor    *cursor,
+              gint                    column,
+              TrackerSparqlValueType  type,
+              const gchar            *value)
+{
+	g_assert_cmpint (tracker_sparql_cursor_get_value_type (cursor, column), ==, type);
+	g_assert_cmpstr (tracker_sparql_cursor_get_string (cursor, column, NULL), ==, value);
+}
+
+static const Document typed_documents[] = {
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"u\", \"b\", \"i\", \"d\", \"t\", \"s\", \"o\"]},"
+	  " \"results\": {\"bindings\": [{"
+	  "  \"u\": {\"type\": \"uri\", \"value\": \"http://example.com/a\"},"
+	  "  \"b\": {\"type\": \"bnode\", \"value\": \"b0\"},"
+	  "  \"i\": {\"type\": \"literal\", \"datatype\": \"" XSD_NS "integer\", \"value\": \"42\"},"
+	  "  \"d\": {\"type\": \"typed-literal\", \"datatype\": \"" XSD_NS "double\", \"value\": \"1.5\"},"
+	  "  \"t\": {\"type\": \"literal\", \"datatype\": \"" XSD_NS "dateTime\", \"value\": \"2018-01-01T00:00:00Z\"},"
+	  "  \"s\": {\"type\": \"literal\", \"xml:lang\": \"en\", \"value\": \"text\"},"
+	  "  \"o\": {\"value\": \"true\", \"datatype\": \"" XSD_NS "boolean\", \"type\": \"literal\"}"
+	  "}]}}" },
+	{ FORMAT_XML,
+	  XML_HEADER
+	  "<head><variable name=\"u\"/><variable name=\"b\"/><variable name=\"i\"/><variable name=\"d\"/>"
+	  "<variable name=\"t\"/><variable name=\"s\"/><variable name=\"o\"/></head>"
+	  "<results><result>"
+	  "<binding name=\"u\"><uri>http://example.com/a</uri></binding>"
+	  "<binding name=\"b\"><bnode>b0</bnode></binding>"
+	  "<binding name=\"i\"><literal datatype=\"" XSD_NS "integer\">42</literal></binding>"
+	  "<binding name=\"d\"><literal datatype=\"" XSD_NS "double\">1.5</literal></binding>"
+	  "<binding name=\"t\"><literal datatype=\"" XSD_NS "dateTime\">2018-01-01T00:00:00Z</literal></binding>"
+	  "<binding name=\"s\"><literal xml:lang=\"en\">text</literal></binding>"
+	  "<binding name=\"o\"><literal datatype=\"" XSD_NS "boolean\">true</literal></binding>"
+	  "</result></results></sparql>" },
+};
+
+static void
+test_remote_cursor_typed (gconstpointer data)
+{
+	const Document *document = data;
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+
+	cursor = create_cursor (document->format, document->document, &error);
+	g_assert_no_error (error);
+
+	g_assert_cmpint (tracker_sparql_cursor_get_n_columns (cursor), ==, 7);
+	g_assert_cmpstr (tracker_sparql_cursor_get_variable_name (cursor, 0), ==, "u");
+	g_assert_cmpstr (tracker_sparql_cursor_get_variable_name (cursor, 6), ==, "o");
+
+	g_assert_true (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	assert_value (cursor, 0, TRACKER_SPARQL_VALUE_TYPE_URI, "http://example.com/a");
+	assert_value (cursor, 1, TRACKER_SPARQL_VALUE_TYPE_BLANK_NODE, "b0");
+	assert_value (cursor, 2, TRACKER_SPARQL_VALUE_TYPE_INTEGER, "42");
+	assert_value (cursor, 3, TRACKER_SPARQL_VALUE_TYPE_DOUBLE, "1.5");
+	assert_value (cursor, 4, TRACKER_SPARQL_VALUE_TYPE_DATETIME, "2018-01-01T00:00:00Z");
+	assert_value (cursor, 5, TRACKER_SPARQL_VALUE_TYPE_STRING, "text");
+	assert_value (cursor, 6, TRACKER_SPARQL_VALUE_TYPE_BOOLEAN, "true");
+
+	g_assert_false (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+}
+
+static const Document unbound_documents[] = {
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"a\", \"b\"], \"link\": []},"
+	  " \"results\": {\"distinct\": false, \"bindings\": ["
+	  "  {\"a\": {\"type\": \"literal\", \"value\": \"x\"}, \"c\": {\"type\": \"literal\", \"value\": \"z\"}},"
+	  "  {},"
+	  "  {\"b\": {\"type\": \"literal\", \"value\": \"\"}}"
+	  "]}}" },
+	{ FORMAT_XML,
+	  XML_HEADER
+	  "<head><variable name=\"a\"/><variable name=\"b\"/><link href=\"x\"/></head>"
+	  "<results>"
+	  "<result><binding name=\"a\"><literal>x</literal></binding>"
+	  "<binding name=\"c\"><literal>z</literal></binding></result>"
+	  "<result/>"
+	  "<result><binding name=\"b\"><literal/></binding></result>"
+	  "</results></sparql>" },
+};
+
+static void
+test_remote_cursor_unbound (gconstpointer data)
+{
+	const Document *document = data;
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+
+	cursor = create_cursor (document->format, document->document, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (tracker_sparql_cursor_get_n_columns (cursor), ==, 2);
+
+	/* Bindings for unknown variables are ignored */
+	g_assert_true (tracker_sparql_cursor_next (cursor, NULL, &error));
+	assert_value (cursor, 0, TRACKER_SPARQL_VALUE_TYPE_STRING, "x");
+	assert_value (cursor, 1, TRACKER_SPARQL_VALUE_TYPE_UNBOUND, NULL);
+
+	g_assert_true (tracker_sparql_cursor_next (cursor, NULL, &error));
+	assert_value (cursor, 0, TRACKER_SPARQL_VALUE_TYPE_UNBOUND, NULL);
+	assert_value (cursor, 1, TRACKER_SPARQL_VALUE_TYPE_UNBOUND, NULL);
+
+	/* Empty strings are not unbound */
+	g_assert_true (tracker_sparql_cursor_next (cursor, NULL, &error));
+	assert_value (cursor, 0, TRACKER_SPARQL_VALUE_TYPE_UNBOUND, NULL);
+	assert_value (cursor, 1, TRACKER_SPARQL_VALUE_TYPE_STRING, "");
+
+	g_assert_false (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+}
+
+static const Document escape_documents[] = {
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"a\"]}, \"results\": {\"bindings\": ["
+	  "  {\"a\": {\"type\": \"literal\", \"value\": \"q\\\"b\\\\s\\/n\\nt\\t\\u00e9\\ud83d\\ude00<&\"}}"
+	  "]}}" },
+	{ FORMAT_XML,
+	  XML_HEADER
+	  "<head><variable name=\"a\"/></head><results>"
+	  "<result><binding name=\"a\"><literal>q&quot;b\\s/n&#10;t&#9;&#xe9;&#x1F600;&lt;&amp;</literal></binding></result>"
+	  "</results></sparql>" },
+};
+
+static void
+test_remote_cursor_escapes (gconstpointer data)
+{
+	const Document *document = data;
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+
+	cursor = create_cursor (document->format, document->document, &error);
+	g_assert_no_error (error);
+
+	g_assert_true (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	assert_value (cursor, 0, TRACKER_SPARQL_VALUE_TYPE_STRING,
+	              "q\"b\\s/n\nt\t\xc3\xa9\xf0\x9f\x98\x80<&");
+
+	g_object_unref (cursor);
+}
+
+/* The error may come from the constructor or from any row */
+static const Document invalid_documents[] = {
+	/* Truncated in the middle of a row */
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"a\"]}, \"results\": {\"bindings\": ["
+	  "  {\"a\": {\"type\": \"literal\", \"value\": \"x\"}},"
+	  "  {\"a\": {\"type\": \"lit" },
+	/* Truncated before the head */
+	{ FORMAT_JSON, "{\"head\": {\"vars\": [" },
+	{ FORMAT_JSON, "" },
+	{ FORMAT_JSON, "{]" },
+	{ FORMAT_JSON, "{\"results\": {\"bindings\": []}}" },
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"a\"]}, \"results\": {\"bindings\": ["
+	  "  {\"a\": ]}}" },
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"a\"]}, \"results\": {\"bindings\": ["
+	  "  {\"a\": {\"type\": \"literal\", \"value\": \"\\ud83d\"}}]}}" },
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"a\"]}, \"results\": {\"bindings\": ["
+	  "  {\"a\": {\"type\": \"literal\", \"value\": \"\\u00zz\"}}]}}" },
+	{ FORMAT_JSON,
+	  "{\"head\": {\"vars\": [\"a\"]}, \"results\": {\"bindings\": ["
+	  "  {\"a\": {\"type\": \"literal\", \"value\": \"\\x\"}}]}}" },
+	{ FORMAT_JSON, "{\"head\": {}, \"boolean\": maybe}" },
+	{ FORMAT_XML,
+	  XML_HEADER
+	  "<head><variable name=\"a\"/></head><results>"
+	  "<result><binding name=\"a\"><literal>x</literal></binding></result>"
+	  "<result><binding name=\"a\"><lit" },
+	{ FORMAT_XML,
+	  XML_HEADER
+	  "<head><variable name=\"a\"/></head><results>"
+	  "<result></binding></result></results></sparql>" },
+	{ FORMAT_XML, XML_HEADER "<head/><boolean>maybe</boolean></sparql>" },
+};
+
+static void
+test_remote_cursor_invalid (gconstpointer data)
+{
+	const Document *document = data;
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+
+	cursor = create_cursor (document->format, document->document, &error);
+
+	if (cursor) {
+		g_assert_no_error (error);
+
+		while (tracker_sparql_cursor_next (cursor, NULL, &error))
+			;
+
+		g_object_unref (cursor);
+	}
+
+	g_assert_error (error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_INTERNAL);
+	g_error_free (error);
+}
+
+static const Document ask_documents[] = {
+	{ FORMAT_JSON, "{\"head\": {}, \"boolean\": true}" },
+	{ FORMAT_JSON, "{\"boolean\" : false, \"head\" : { \"link\": [] } }" },
+	{ FORMAT_XML, XML_HEADER "<head/><boolean>true</boolean></sparql>" },
+	{ FORMAT_XML, XML_HEADER "<head></head><boolean>false</boolean></sparql>" },
+};
+
+static void
+test_remote_cursor_ask (gconstpointer data)
+{
+	const Document *document = data;
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	const gchar *expected;
+
+	expected = strstr (document->document, "true") ? "true" : "false";
+
+	cursor = create_cursor (document->format, document->document, &error);
+	g_assert_no_error (error);
+
+	/* Same as ASK queries on local connections */
+	g_assert_cmpint (tracker_sparql_cursor_get_n_columns (cursor), ==, 1);
+	g_assert_cmpstr (tracker_sparql_cursor_get_variable_name (cursor, 0), ==, "result");
+
+	g_assert_true (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	assert_value (cursor, 0, TRACKER_SPARQL_VALUE_TYPE_BOOLEAN, expected);
+
+	g_assert_false (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+}
+
+static gchar *
+create_large_value (void)
+{
+	gchar *value;
+
+	value = g_malloc (LARGE_VALUE_SIZE + 1);
+	memset (value, 'v', LARGE_VALUE_SIZE);
+	value[LARGE_VALUE_SIZE] = '\0';
+
+	return value;
+}
+
+/* Many rows with multibyte characters, and one row larger than the
+ * cursor read buffers half way.
+ */
+static gchar *
+create_large_document (Format format)
+{
+	GString *str;
+	gchar *large_value;
+	gint i;
+
+	large_value = create_large_value ();
+	str = g_string_new (NULL);
+
+	if (format == FORMAT_JSON)
+		g_string_append (str, "{\"head\": {\"vars\": [\"n\", \"s\"]}, \"results\": {\"bindings\": [");
+	else
+		g_string_append (str, XML_HEADER "<head><variable name=\"n\"/><variable name=\"s\"/></head><results>");
+
+	for (i = 0; i < N_LARGE_ROWS; i++) {
+		const gchar *value = (i == N_LARGE_ROWS / 2) ? large_value : "\xc3\xa9t\xc3\xa9";
+
+		if (format == FORMAT_JSON) {
+			g_string_append_printf (str,
+			                        "%s{\"n\": {\"type\": \"literal\", \"datatype\": \"" XSD_NS "integer\", \"value\": \"%d\"},"
+			                        " \"s\": {\"type\": \"literal\", \"value\": \"%s\\u00e9\"}}\n",
+			                        i > 0 ? "," : "", i, value);
+		} else {
+			g_string_append_printf (str,
+			                        "<result><binding name=\"n\"><literal datatype=\"" XSD_NS "integer\">%d</literal></binding>"
+			                        "<binding name=\"s\"><literal>%s&#xe9;</literal></binding></result>\n",
+			                        i, value);
+		}
+	}
+
+	if (format == FORMAT_JSON)
+		g_string_append (str, "]}}");
+	else
+		g_string_append (str, "</results></sparql>");
+
+	g_free (large_value);
+
+	return g_string_free (str, FALSE);
+}
+
+static void
+check_large_row (TrackerSparqlCursor *cursor,
+                 gint                 row)
+{
+	const gchar *value;
+	gchar *expected;
+
+	g_assert_cmpint (tracker_sparql_cursor_get_integer (cursor, 0), ==, row);
+
+	value = tracker_sparql_cursor_get_string (cursor, 1, NULL);
+
+	if (row == N_LARGE_ROWS / 2) {
+		gchar *large_value = create_large_value ();
+		expected = g_strconcat (large_value, "\xc3\xa9", NULL);
+		g_free (large_value);
+	} else {
+		expected = g_strdup ("\xc3\xa9t\xc3\xa9\xc3\xa9");
+	}
+
+	g_assert_cmpstr (value, ==, expected);
+	g_free (expected);
+}
+
+static void
+test_remote_cursor_large (gconstpointer data)
+{
+	Format format = GPOINTER_TO_INT (data);
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	gchar *document;
+	gint n_rows = 0;
+
+	document = create_large_document (format);
+	cursor = create_cursor (format, document, &error);
+	g_assert_no_error (error);
+
+	while (tracker_sparql_cursor_next (cursor, NULL, &error)) {
+		check_large_row (cursor, n_rows);
+		n_rows++;
+	}
+
+	g_assert_no_error (error);
+	g_assert_cmpint (n_rows, ==, N_LARGE_ROWS);
+
+	g_object_unref (cursor);
+	g_free (document);
+}
+
+typedef struct {
+	GMainLoop *main_loop;
+	gint n_rows;
+	GError *error;
+} AsyncData;
+
+static void
+next_async_cb (GObject      *source,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+	TrackerSparqlCursor *cursor = TRACKER_SPARQL_CURSOR (source);
+	AsyncData *data = user_data;
+
+	if (tracker_sparql_cursor_next_finish (cursor, result, &data->error)) {
+		check_large_row (cursor, data->n_rows);
+		data->n_rows++;
+		tracker_sparql_cursor_next_async (cursor, NULL, next_async_cb, data);
+	} else {
+		g_main_loop_quit (data->main_loop);
+	}
+}
+
+static void
+init_async_cb (GObject      *source,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+	TrackerSparqlCursor *cursor = TRACKER_SPARQL_CURSOR (source);
+	AsyncData *data = user_data;
+
+	if (g_async_initable_init_finish (G_ASYNC_INITABLE (cursor), result, &data->error))
+		tracker_sparql_cursor_next_async (cursor, NULL, next_async_cb, data);
+	else
+		g_main_loop_quit (data->main_loop);
+}
+
+static void
+test_remote_cursor_large_async (gconstpointer user_data)
+{
+	Format format = GPOINTER_TO_INT (user_data);
+	TrackerSparqlCursor *cursor;
+	AsyncData data = { 0 };
+	gchar *document;
+
+	document = create_large_document (format);
+	cursor = create_uninitialized_cursor (format, document);
+
+	data.main_loop = g_main_loop_new (NULL, FALSE);
+	g_async_initable_init_async (G_ASYNC_INITABLE (cursor), G_PRIORITY_DEFAULT,
+	                             NULL, init_async_cb, &data);
+	g_main_loop_run (data.main_loop);
+
+	g_assert_no_error (data.error);
+	g_assert_cmpint (data.n_rows, ==, N_LARGE_ROWS);
+
+	g_main_loop_unref (data.main_loop);
+	g_object_unref (cursor);
+	g_free (document);
+}
+
+static void
+add_document_tests (const gchar      *name,
+                    const Document   *documents,
+                    guint             n_documents,
+                    GTestDataFunc     func)
+{
+	guint i;
+
+	for (i = 0; i < n_documents; i++) {
+		gchar *path;
+
+		path = g_strdup_printf ("/libtracker-remote/cursor/%s/%s/%u", name,
+		                        documents[i].format == FORMAT_JSON ? "json" : "xml", i);
+		g_test_add_data_func (path, &documents[i], func);
+		g_free (path);
+	}
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	add_document_tests ("typed", typed_documents,
+	                    G_N_ELEMENTS (typed_documents), test_remote_cursor_typed);
+	add_document_tests ("unbound", unbound_documents,
+	                    G_N_ELEMENTS (unbound_documents), test_remote_cursor_unbound);
+	add_document_tests ("escapes", escape_documents,
+	                    G_N_ELEMENTS (escape_documents), test_remote_cursor_escapes);
+	add_document_tests ("invalid", invalid_documents,
+	                    G_N_ELEMENTS (invalid_documents), test_remote_cursor_invalid);
+	add_document_tests ("ask", ask_documents,
+	                    G_N_ELEMENTS (ask_documents), test_remote_cursor_ask);
+
+	g_test_add_data_func ("/libtracker-remote/cursor/large/json",
+	                      GINT_TO_POINTER (FORMAT_JSON), test_remote_cursor_large);
+	g_test_add_data_func ("/libtracker-remote/cursor/large/xml",
+	                      GINT_TO_POINTER (FORMAT_XML), test_remote_cursor_large);
+	g_test_add_data_func ("/libtracker-remote/cursor/large-async/json",
+	                      GINT_TO_POINTER (FORMAT_JSON), test_remote_cursor_large_async);
+	g_test_add_data_func ("/libtracker-remote/cursor/large-async/xml",
+	                      GINT_TO_POINTER (FORMAT_XML), test_remote_cursor_large_async);
+
+	return g_test_run ();
+}
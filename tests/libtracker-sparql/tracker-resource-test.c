@@ -20,8 +20,10 @@
 #include "config.h"
 
 #include <locale.h>
+#include <string.h>
 
 #include <libtracker-sparql/tracker-resource.h>
+#include <libtracker-sparql/tracker-ontologies.h>
 
 static void
 test_resource_get_empty (void)
@@ -145,6 +147,438 @@ test_resource_get_set_pointer_validation (void)
 	g_test_trap_assert_stderr ("*tracker_resource_set_string: NULL is not a valid value.*");
 }
 
+static void
+test_resource_serialize_statements (void)
+{
+	TrackerResource *resource, *contact;
+	const gchar *op_str, *subject, *predicate, *object;
+	GVariantIter iter;
+	GVariant *statements;
+	gboolean seen_insert = FALSE, seen_resource = FALSE;
+	gboolean first_insert = TRUE, first_resource_insert = TRUE;
+	gchar *contact_id;
+	guint n_deletes = 0, n_keywords = 0;
+	guchar op;
+
+	resource = tracker_resource_new ("http://example.com/resource");
+	tracker_resource_set_uri (resource, "rdf:type", "nfo:Document");
+	tracker_resource_set_string (resource, "nie:title", "Title");
+	tracker_resource_add_string (resource, "nie:keyword", "a");
+	tracker_resource_add_string (resource, "nie:keyword", "b");
+	tracker_resource_set_boolean (resource, "http://example.com/flag", TRUE);
+
+	contact = tracker_resource_new (NULL);
+	tracker_resource_set_uri (contact, "rdf:type", "nco:Contact");
+	tracker_resource_set_string (contact, "nco:fullname", "Someone");
+	tracker_resource_set_relation (resource, "nco:creator", contact);
+	contact_id = g_strdup (tracker_resource_get_identifier (contact));
+	g_object_unref (contact);
+
+	statements = g_variant_ref_sink (tracker_resource_serialize_statements (resource, NULL));
+	g_assert_true (g_variant_is_of_type (statements, G_VARIANT_TYPE ("a(ysss)")));
+
+	g_variant_iter_init (&iter, statements);
+
+	while (g_variant_iter_next (&iter, "(y&s&s&s)", &op, &subject, &predicate, &object)) {
+		op_str = (op == TRACKER_RESOURCE_STATEMENT_DELETE_ALL) ? "d" :
+			(op == TRACKER_RESOURCE_STATEMENT_INSERT_URI) ? "i" : "l";
+
+		/* Compact URIs are expanded, blank nodes left alone */
+		g_assert_true (g_str_has_prefix (predicate, "http://"));
+
+		if (op == TRACKER_RESOURCE_STATEMENT_DELETE_ALL) {
+			g_assert_false (seen_insert);
+			g_assert_cmpstr (subject, ==, "http://example.com/resource");
+			g_assert_cmpstr (object, ==, "");
+			n_deletes++;
+			continue;
+		}
+
+		seen_insert = TRUE;
+
+		if (first_insert) {
+			/* The related resource goes first, its type ahead */
+			g_assert_cmpstr (op_str, ==, "i");
+			g_assert_cmpstr (subject, ==, contact_id);
+			g_assert_cmpstr (predicate, ==, TRACKER_PREFIX_RDF "type");
+			g_assert_cmpstr (object, ==, TRACKER_PREFIX_NCO "Contact");
+			first_insert = FALSE;
+		}
+
+		if (strcmp (subject, contact_id) == 0) {
+			g_assert_false (seen_resource);
+			continue;
+		}
+
+		seen_resource = TRUE;
+		g_assert_cmpstr (subject, ==, "http://example.com/resource");
+
+		if (first_resource_insert) {
+			g_assert_cmpstr (predicate, ==, TRACKER_PREFIX_RDF "type");
+			g_assert_cmpstr (object, ==, TRACKER_PREFIX_NFO "Document");
+			first_resource_insert = FALSE;
+		} else if (strcmp (predicate, TRACKER_PREFIX_NIE "keyword") == 0) {
+			g_assert_cmpstr (op_str, ==, "l");
+			n_keywords++;
+		} else if (strcmp (predicate, "http://example.com/flag") == 0) {
+			g_assert_cmpstr (op_str, ==, "l");
+			g_assert_cmpstr (object, ==, "true");
+		} else if (strcmp (predicate, TRACKER_PREFIX_NCO "creator") == 0) {
+			g_assert_cmpstr (op_str, ==, "i");
+			g_assert_cmpstr (object, ==, contact_id);
+		}
+	}
+
+	/* rdf:type, nie:title, flag and nco:creator were set, not added */
+	g_assert_cmpuint (n_deletes, ==, 4);
+	g_assert_cmpuint (n_keywords, ==, 2);
+	g_assert_true (seen_resource);
+
+	g_variant_unref (statements);
+	g_free (contact_id);
+	g_object_unref (resource);
+}
+
+static TrackerResource *
+create_resource_graph (guint n_children)
+{
+	TrackerResource *root;
+	guint i;
+
+	root = tracker_resource_new ("http://example.com/root");
+	tracker_resource_set_uri (root, "rdf:type", "nie:InformationElement");
+	tracker_resource_set_string (root, "nie:title", "root");
+
+	for (i = 0; i < n_children; i++) {
+		TrackerResource *child;
+		gchar *uri, *title;
+
+		uri = g_strdup_printf ("http://example.com/child/%u", i);
+		title = g_strdup_printf ("A child resource with a longish title, number %u", i);
+
+		child = tracker_resource_new (uri);
+		tracker_resource_set_uri (child, "rdf:type", "nie:InformationElement");
+		tracker_resource_set_string (child, "nie:title", title);
+		tracker_resource_add_int (child, "http://example.com/index", i);
+
+		/* Cyclic relation back to the top-level resource */
+		if (i == 0)
+			tracker_resource_set_relation (child, "nie:isPartOf", root);
+
+		tracker_resource_add_relation (root, "nie:hasPart", child);
+		g_object_unref (child);
+		g_free (title);
+		g_free (uri);
+	}
+
+	return root;
+}
+
+static gchar *
+steal_stream_data (GOutputStream *stream)
+{
+	GMemoryOutputStream *memory = G_MEMORY_OUTPUT_STREAM (stream);
+	gchar *str;
+
+	g_assert_true (g_output_stream_close (stream, NULL, NULL));
+	str = g_strndup (g_memory_output_stream_get_data (memory),
+	                 g_memory_output_stream_get_data_size (memory));
+	g_object_unref (stream);
+
+	return str;
+}
+
+static guint
+count_occurrences (const gchar *str,
+                   const gchar *needle)
+{
+	guint count = 0;
+
+	while ((str = strstr (str, needle)) != NULL) {
+		count++;
+		str += strlen (needle);
+	}
+
+	return count;
+}
+
+static void
+test_resource_write_streams (void)
+{
+	TrackerResource *resource;
+	GOutputStream *stream;
+	GError *error = NULL;
+	gchar *printed, *written;
+
+	/* Big enough to be written in several chunks */
+	resource = create_resource_graph (500);
+
+	stream = g_memory_output_stream_new_resizable ();
+	g_assert_true (tracker_resource_write_turtle (resource, NULL, stream, NULL, &error));
+	g_assert_no_error (error);
+	written = steal_stream_data (stream);
+	printed = tracker_resource_print_turtle (resource, NULL);
+	g_assert_cmpstr (written, ==, printed);
+	g_assert_cmpuint (strlen (written), >, 16384);
+	/* Each resource is described once, despite the cycle */
+	g_assert_cmpuint (count_occurrences (written, "\"root\""), ==, 1);
+	g_assert_cmpuint (count_occurrences (written, "number 0\""), ==, 1);
+	g_free (written);
+	g_free (printed);
+
+	stream = g_memory_output_stream_new_resizable ();
+	g_assert_true (tracker_resource_write_sparql_update (resource, NULL, "urn:graph", stream, NULL, &error));
+	g_assert_no_error (error);
+	written = steal_stream_data (stream);
+	printed = tracker_resource_print_sparql_update (resource, NULL, "urn:graph");
+	g_assert_cmpstr (written, ==, printed);
+	g_assert_cmpuint (count_occurrences (written, "\"root\""), ==, 1);
+	g_free (written);
+	g_free (printed);
+
+	stream = g_memory_output_stream_new_resizable ();
+	g_assert_true (tracker_resource_write_jsonld (resource, NULL, stream, NULL, &error));
+	g_assert_no_error (error);
+	written = steal_stream_data (stream);
+	printed = tracker_resource_print_jsonld (resource, NULL);
+	g_assert_cmpstr (written, ==, printed);
+	g_assert_cmpuint (count_occurrences (written, "\"root\""), ==, 1);
+	g_assert_cmpuint (count_occurrences (written, "\"@context\""), ==, 1);
+	g_free (written);
+	g_free (printed);
+
+	g_object_unref (resource);
+}
+
+/* Serializers write properties in hash table order, so the resources
+ * used for comparing against literal output have one property each.
+ */
+static TrackerResource *
+create_golden_graph (void)
+{
+	TrackerResource *root, *child;
+
+	root = tracker_resource_new ("http://example.com/root");
+
+	child = tracker_resource_new ("http://example.com/child/1");
+	tracker_resource_set_string (child, "nie:title", "Child \"1\"\n");
+	tracker_resource_add_relation (root, "nie:hasPart", child);
+	g_object_unref (child);
+
+	child = tracker_resource_new ("http://example.com/child/2");
+	tracker_resource_set_relation (child, "nie:isPartOf", root);
+	tracker_resource_add_relation (root, "nie:hasPart", child);
+	g_object_unref (child);
+
+	return root;
+}
+
+static void
+check_turtle (TrackerResource *resource,
+              const gchar     *expected)
+{
+	GOutputStream *stream;
+	GError *error = NULL;
+	gchar *str;
+
+	str = tracker_resource_print_turtle (resource, NULL);
+	g_assert_cmpstr (str, ==, expected);
+	g_free (str);
+
+	stream = g_memory_output_stream_new_resizable ();
+	g_assert_true (tracker_resource_write_turtle (resource, NULL, stream, NULL, &error));
+	g_assert_no_error (error);
+	str = steal_stream_data (stream);
+	g_assert_cmpstr (str, ==, expected);
+	g_free (str);
+}
+
+static void
+check_sparql_update (TrackerResource *resource,
+                     const gchar     *graph,
+                     const gchar     *expected)
+{
+	GOutputStream *stream;
+	GError *error = NULL;
+	gchar *str;
+
+	str = tracker_resource_print_sparql_update (resource, NULL, graph);
+	g_assert_cmpstr (str, ==, expected);
+	g_free (str);
+
+	stream = g_memory_output_stream_new_resizable ();
+	g_assert_true (tracker_resource_write_sparql_update (resource, NULL, graph, stream, NULL, &error));
+	g_assert_no_error (error);
+	str = steal_stream_data (stream);
+	g_assert_cmpstr (str, ==, expected);
+	g_free (str);
+}
+
+static void
+check_jsonld (TrackerResource *resource,
+              const gchar     *expected)
+{
+	GOutputStream *stream;
+	GError *error = NULL;
+	gchar *str;
+
+	str = tracker_resource_print_jsonld (resource, NULL);
+	g_assert_cmpstr (str, ==, expected);
+	g_free (str);
+
+	stream = g_memory_output_stream_new_resizable ();
+	g_assert_true (tracker_resource_write_jsonld (resource, NULL, stream, NULL, &error));
+	g_assert_no_error (error);
+	str = steal_stream_data (stream);
+	g_assert_cmpstr (str, ==, expected);
+	g_free (str);
+}
+
+static void
+test_resource_golden_turtle (void)
+{
+	TrackerResource *resource;
+
+	resource = create_golden_graph ();
+
+	/* Related resources first, the cycle back to the root
+	 * doesn't describe it twice.
+	 */
+	check_turtle (resource,
+	              "@prefix nie: <" TRACKER_PREFIX_NIE "> .\n"
+	              "\n"
+	              "<http://example.com/child/1> nie:title \"Child \\\"1\\\"\\n\" .\n"
+	              "\n"
+	              "<http://example.com/child/2> nie:isPartOf <http://example.com/root> .\n"
+	              "\n"
+	              "<http://example.com/root> nie:hasPart <http://example.com/child/1> , <http://example.com/child/2> .\n");
+
+	g_object_unref (resource);
+}
+
+static void
+test_resource_golden_sparql_update (void)
+{
+	TrackerResource *resource;
+
+	resource = create_golden_graph ();
+
+	/* Only properties that were set, not added, are deleted first */
+	check_sparql_update (resource, NULL,
+	                     "DELETE WHERE {\n"
+	                     "  <http://example.com/child/1> nie:title ?nie_title };\n"
+	                     "DELETE WHERE {\n"
+	                     "  <http://example.com/child/2> nie:isPartOf ?nie_isPartOf };\n"
+	                     "INSERT {\n"
+	                     "<http://example.com/child/1> nie:title \"Child \\\"1\\\"\\n\" .\n"
+	                     "<http://example.com/child/2> nie:isPartOf <http://example.com/root> .\n"
+	                     "<http://example.com/root> nie:hasPart <http://example.com/child/1> , <http://example.com/child/2> .\n"
+	                     "};\n");
+
+	check_sparql_update (resource, "urn:graph",
+	                     "DELETE WHERE {\n"
+	                     "GRAPH <urn:graph> {\n"
+	                     "  <http://example.com/child/1> nie:title ?nie_title } };\n"
+	                     "DELETE WHERE {\n"
+	                     "GRAPH <urn:graph> {\n"
+	                     "  <http://example.com/child/2> nie:isPartOf ?nie_isPartOf } };\n"
+	                     "INSERT {\n"
+	                     "GRAPH <urn:graph> {\n"
+	                     "<http://example.com/child/1> nie:title \"Child \\\"1\\\"\\n\" .\n"
+	                     "<http://example.com/child/2> nie:isPartOf <http://example.com/root> .\n"
+	                     "<http://example.com/root> nie:hasPart <http://example.com/child/1> , <http://example.com/child/2> .\n"
+	                     "}\n"
+	                     "};\n");
+
+	g_object_unref (resource);
+}
+
+static void
+test_resource_golden_jsonld (void)
+{
+	TrackerResource *resource, *blank;
+
+	resource = create_golden_graph ();
+
+	/* Related resources are nested where first referenced,
+	 * and referred to by their identifier afterwards.
+	 */
+	check_jsonld (resource,
+	              "{\n"
+	              "  \"@id\" : \"http://example.com/root\",\n"
+	              "  \"nie:hasPart\" : [\n"
+	              "    {\n"
+	              "      \"@id\" : \"http://example.com/child/1\",\n"
+	              "      \"nie:title\" : \"Child \\\"1\\\"\\n\"\n"
+	              "    },\n"
+	              "    {\n"
+	              "      \"@id\" : \"http://example.com/child/2\",\n"
+	              "      \"nie:isPartOf\" : \"http://example.com/root\"\n"
+	              "    }\n"
+	              "  ],\n"
+	              "  \"@context\" : {\n"
+	              "    \"nie\" : \"" TRACKER_PREFIX_NIE "\"\n"
+	              "  }\n"
+	              "}");
+
+	g_object_unref (resource);
+
+	/* Value types, string escapes, and blank nodes without @id */
+	resource = tracker_resource_new ("http://example.com/resource");
+	tracker_resource_add_int (resource, "http://example.com/value", 42);
+	tracker_resource_add_int64 (resource, "http://example.com/value", G_GINT64_CONSTANT (-1234567890123));
+	tracker_resource_add_boolean (resource, "http://example.com/value", TRUE);
+	tracker_resource_add_double (resource, "http://example.com/value", 0.5);
+	tracker_resource_add_string (resource, "http://example.com/value", "Tab\tand \\ \x01");
+	tracker_resource_add_uri (resource, "http://example.com/value", "nie:DataObject");
+
+	blank = tracker_resource_new (NULL);
+	tracker_resource_set_uri (blank, "rdf:type", "nie:InformationElement");
+	tracker_resource_add_relation (resource, "http://example.com/value", blank);
+	g_object_unref (blank);
+
+	check_jsonld (resource,
+	              "{\n"
+	              "  \"@id\" : \"http://example.com/resource\",\n"
+	              "  \"http://example.com/value\" : [\n"
+	              "    42,\n"
+	              "    -1234567890123,\n"
+	              "    true,\n"
+	              "    0.5,\n"
+	              "    \"Tab\\tand \\\\ \\u0001\",\n"
+	              "    \"nie:DataObject\",\n"
+	              "    {\n"
+	              "      \"@type\" : \"nie:InformationElement\"\n"
+	              "    }\n"
+	              "  ],\n"
+	              "  \"@context\" : {\n"
+	              "    \"nie\" : \"" TRACKER_PREFIX_NIE "\"\n"
+	              "  }\n"
+	              "}");
+
+	g_object_unref (resource);
+}
+
+static void
+test_resource_write_error (void)
+{
+	TrackerResource *resource;
+	GOutputStream *stream;
+	GError *error = NULL;
+
+	resource = create_resource_graph (10);
+
+	stream = g_memory_output_stream_new_resizable ();
+	g_output_stream_close (stream, NULL, NULL);
+
+	g_assert_false (tracker_resource_write_turtle (resource, NULL, stream, NULL, &error));
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CLOSED);
+	g_clear_error (&error);
+
+	g_object_unref (stream);
+	g_object_unref (resource);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -163,6 +597,18 @@ main (int    argc,
 	                 test_resource_get_set_many);
 	g_test_add_func ("/libtracker-sparql/tracker-resource/get_set_pointer_validation",
 	                 test_resource_get_set_pointer_validation);
+	g_test_add_func ("/libtracker-sparql/tracker-resource/serialize_statements",
+	                 test_resource_serialize_statements);
+	g_test_add_func ("/libtracker-sparql/tracker-resource/write_streams",
+	                 test_resource_write_streams);
+	g_test_add_func ("/libtracker-sparql/tracker-resource/golden_turtle",
+	                 test_resource_golden_turtle);
+	g_test_add_func ("/libtracker-sparql/tracker-resource/golden_sparql_update",
+	                 test_resource_golden_sparql_update);
+	g_test_add_func ("/libtracker-sparql/tracker-resource/golden_jsonld",
+	                 test_resource_golden_jsonld);
+	g_test_add_func ("/libtracker-sparql/tracker-resource/write_error",
+	                 test_resource_write_error);
 
 	return g_test_run ();
 }
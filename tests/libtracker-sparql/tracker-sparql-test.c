@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <locale.h>
+#include <string.h>
 
 #include <glib-object.h>
 
@@ -353,6 +354,162 @@ test_tracker_sparql_connection_interleaved (void)
 	g_object_unref(cursor1);
 }
 
+static TrackerSparqlConnection *
+create_local_connection (const gchar *root_path,
+                         const gchar *name)
+{
+	TrackerSparqlConnection *conn;
+	GFile *store, *ontology;
+	GError *error = NULL;
+	gchar *path;
+
+	path = g_build_filename (root_path, name, NULL);
+	store = g_file_new_for_path (path);
+	ontology = g_file_new_for_path (TEST_ONTOLOGIES_DIR);
+
+	conn = tracker_sparql_connection_local_new (0, store, store, ontology, NULL, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (ontology);
+	g_object_unref (store);
+	g_free (path);
+
+	return conn;
+}
+
+static gchar *
+dump_test_resources (TrackerSparqlConnection *conn)
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	GString *str;
+
+	/* tracker:added and friends differ between stores, leave them out */
+	cursor = tracker_sparql_connection_query (conn,
+	                                          "SELECT ?g ?s ?p ?o { "
+	                                          "  { ?s ?p ?o } UNION { GRAPH ?g { ?s ?p ?o } } "
+	                                          "  FILTER (?s IN (<urn:test:1>, <urn:test:2>, <urn:test:3>) && "
+	                                          "          ?p IN (rdf:type, nie:title, nie:keyword)) "
+	                                          "} ORDER BY ?g ?s ?p ?o",
+	                                          NULL, &error);
+	g_assert_no_error (error);
+
+	str = g_string_new (NULL);
+
+	while (tracker_sparql_cursor_next (cursor, NULL, &error)) {
+		const gchar *graph;
+
+		graph = tracker_sparql_cursor_get_string (cursor, 0, NULL);
+		g_string_append_printf (str, "%s %s %s %s\n",
+		                        graph ? graph : "-",
+		                        tracker_sparql_cursor_get_string (cursor, 1, NULL),
+		                        tracker_sparql_cursor_get_string (cursor, 2, NULL),
+		                        tracker_sparql_cursor_get_string (cursor, 3, NULL));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return g_string_free (str, FALSE);
+}
+
+static void
+apply_resources (TrackerSparqlConnection  *sparql_conn,
+                 TrackerSparqlConnection  *statements_conn,
+                 TrackerResource         **resources,
+                 gint                      n_resources,
+                 const gchar              *graph)
+{
+	GError *error = NULL;
+	gint i;
+
+	for (i = 0; i < n_resources; i++) {
+		gchar *sparql;
+
+		sparql = tracker_resource_print_sparql_update (resources[i], NULL, graph);
+		tracker_sparql_connection_update (sparql_conn, sparql, G_PRIORITY_DEFAULT, NULL, &error);
+		g_assert_no_error (error);
+		g_free (sparql);
+	}
+
+	tracker_sparql_connection_update_resources (statements_conn, resources, n_resources,
+	                                            graph, G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+}
+
+static void
+test_tracker_sparql_update_resources (void)
+{
+	TrackerSparqlConnection *sparql_conn, *statements_conn;
+	TrackerResource *resources[3];
+	GError *error = NULL;
+	gchar *path, *command, *sparql_dump, *statements_dump;
+	gint i;
+
+	path = g_build_filename (g_get_tmp_dir (), "tracker-sparql-test-XXXXXX", NULL);
+	g_mkdtemp_full (path, 0700);
+
+	sparql_conn = create_local_connection (path, "sparql");
+	statements_conn = create_local_connection (path, "statements");
+
+	/* <urn:test:2> is not in the domain of nie:title yet, and
+	 * <urn:test:3> has keywords in two different graphs.
+	 */
+	for (i = 0; i < 2; i++) {
+		tracker_sparql_connection_update (i == 0 ? sparql_conn : statements_conn,
+		                                  "INSERT { <urn:test:1> a nie:InformationElement ; "
+		                                  "                      nie:title 'Old' ; nie:keyword 'x' . "
+		                                  "         <urn:test:2> a rdfs:Resource . "
+		                                  "         <urn:test:3> a nie:InformationElement ; "
+		                                  "                      nie:keyword 'default' } "
+		                                  "INSERT { GRAPH <urn:test:graph> { "
+		                                  "           <urn:test:3> nie:title 'In graph' ; "
+		                                  "                        nie:keyword 'g' } }",
+		                                  G_PRIORITY_DEFAULT, NULL, &error);
+		g_assert_no_error (error);
+	}
+
+	resources[0] = tracker_resource_new ("urn:test:1");
+	tracker_resource_set_string (resources[0], "nie:title", "New");
+	tracker_resource_set_string (resources[0], "nie:keyword", "a");
+	tracker_resource_add_string (resources[0], "nie:keyword", "b");
+
+	resources[1] = tracker_resource_new ("urn:test:2");
+	tracker_resource_add_uri (resources[1], "rdf:type", "nie:InformationElement");
+	tracker_resource_set_string (resources[1], "nie:title", "Added");
+
+	resources[2] = tracker_resource_new ("urn:test:3");
+	tracker_resource_set_string (resources[2], "nie:keyword", "new");
+
+	apply_resources (sparql_conn, statements_conn, resources, 2, NULL);
+	apply_resources (sparql_conn, statements_conn, &resources[2], 1, "urn:test:graph");
+
+	sparql_dump = dump_test_resources (sparql_conn);
+	statements_dump = dump_test_resources (statements_conn);
+
+	g_assert_cmpstr (statements_dump, ==, sparql_dump);
+
+	/* Only the keyword in the update graph was replaced */
+	g_assert_nonnull (strstr (sparql_dump, "urn:test:3 http://www.semanticdesktop.org/ontologies/2007/01/19/nie#keyword default\n"));
+	g_assert_nonnull (strstr (sparql_dump, "urn:test:3 http://www.semanticdesktop.org/ontologies/2007/01/19/nie#keyword new\n"));
+	g_assert_null (strstr (sparql_dump, "keyword g\n"));
+	g_assert_nonnull (strstr (sparql_dump, "urn:test:2 http://www.semanticdesktop.org/ontologies/2007/01/19/nie#title Added\n"));
+	g_assert_null (strstr (sparql_dump, "Old"));
+
+	for (i = 0; i < G_N_ELEMENTS (resources); i++)
+		g_object_unref (resources[i]);
+
+	g_free (sparql_dump);
+	g_free (statements_dump);
+	g_object_unref (sparql_conn);
+	g_object_unref (statements_conn);
+
+	command = g_strdup_printf ("rm -rf %s", path);
+	g_assert (g_spawn_command_line_sync (command, NULL, NULL, NULL, NULL));
+	g_free (command);
+	g_free (path);
+}
+
 gint
 main (gint argc, gchar **argv)
 {
@@ -387,6 +544,8 @@ main (gint argc, gchar **argv)
 	                 test_tracker_sparql_connection_locking_sync);
 	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_connection_locking_async",
 	                 test_tracker_sparql_connection_locking_async);
+	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_connection_update_resources",
+	                 test_tracker_sparql_update_resources);
 
 #if HAVE_TRACKER_FTS
 	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_cursor_next_async",
@@ -388,6 +388,74 @@ test_tracker_sparql_update_array_async (DataFixture   *fixture,
 
 }
 
+static void
+async_update_array_bisect_callback (GObject      *source_object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+	GError *error = NULL;
+	AsyncData *data = user_data;
+	GPtrArray *errors;
+	guint i;
+
+	errors = tracker_sparql_connection_update_array_finish (connection, result, &error);
+	g_assert_no_error (error);
+
+	g_assert_cmpint (errors->len, ==, 40);
+
+	for (i = 0; i < errors->len; i++) {
+		if (i == 0 || i == 17 || i == 18 || i == 39)
+			g_assert (g_ptr_array_index (errors, i) != NULL);
+		else
+			g_assert (g_ptr_array_index (errors, i) == NULL);
+	}
+
+	g_ptr_array_unref (errors);
+
+	g_main_loop_quit (data->main_loop);
+}
+
+static void
+test_tracker_sparql_update_array_async_bisect (DataFixture   *fixture,
+                                               gconstpointer  user_data)
+{
+	GMainLoop *main_loop;
+	AsyncData *data;
+	gchar *queries[40];
+	guint i;
+
+	/* Several failing queries in a larger batch, their errors
+	 * must be reported at the same positions.
+	 */
+	for (i = 0; i < G_N_ELEMENTS (queries); i++) {
+		if (i == 0 || i == 17 || i == 18 || i == 39)
+			queries[i] = g_strdup_printf ("INSERT { _:a%u syntax error a nmo:Message }", i);
+		else
+			queries[i] = g_strdup_printf ("INSERT { _:a%u a nmo:Message }", i);
+	}
+
+	main_loop = g_main_loop_new (NULL, FALSE);
+
+	data = g_slice_new (AsyncData);
+	data->main_loop = main_loop;
+
+	tracker_sparql_connection_update_array_async (connection,
+	                                              queries,
+	                                              G_N_ELEMENTS (queries),
+	                                              0,
+	                                              NULL,
+	                                              async_update_array_bisect_callback,
+	                                              data);
+
+	g_main_loop_run (main_loop);
+
+	for (i = 0; i < G_N_ELEMENTS (queries); i++)
+		g_free (queries[i]);
+
+	g_slice_free (AsyncData, data);
+	g_main_loop_unref (main_loop);
+}
+
 static void
 test_tracker_sparql_update_fast_error (DataFixture  *fixture,
                                        gconstpointer user_data)
@@ -764,6 +832,8 @@ main (gint argc, gchar **argv)
 			test_tracker_sparql_update_blank_async, delete_test_data);
 	g_test_add ("/steroids/tracker/tracker_sparql_update_array_async", DataFixture, NULL, insert_test_data,
 			test_tracker_sparql_update_array_async, delete_test_data);
+	g_test_add ("/steroids/tracker/tracker_sparql_update_array_async_bisect", DataFixture, NULL, insert_test_data,
+			test_tracker_sparql_update_array_async_bisect, delete_test_data);
 
 	return g_test_run ();
 }
@@ -27,6 +27,9 @@ import convert_data
 
 DIRNAME = os.path.dirname(__file__)
 
+# Reference date for generated dates, see tools.setReferenceDate()
+today = datetime.datetime.today()
+
 gender_options=('Male','Female')
 company_type = ('LawFirm', 'Generic', 'Short')
 card_types = ('mastercard', 'visa', 'discover', 'amex')
@@ -121,11 +124,11 @@ def create_date(numeric=True, past=False, max_years_future=10, max_years_past=10
     If it's not, then it can't be any older than max_years_past
     """
     if past:
-        start = datetime.datetime.today() - datetime.timedelta(days=max_years_past * 365)
+        start = today - datetime.timedelta(days=max_years_past * 365)
         #Anywhere between 1980 and today plus max_ears
         num_days = (max_years_future * 365) + start.day
     else:
-        start = datetime.datetime.today()
+        start = today
         num_days = max_years_future * 365
 
     random_days = random.randint(1, num_days)
@@ -133,7 +136,7 @@ def create_date(numeric=True, past=False, max_years_future=10, max_years_past=10
     return(random_date)
 
 def create_birthday(age=random.randint (16, 80)):
-    start = datetime.date.today() - datetime.timedelta(days=random.randint(0, 365))
+    start = today.date() - datetime.timedelta(days=random.randint(0, 365))
     return start - datetime.timedelta(days=age*365)
 
 def create_email(tld=None, name=create_name()):
@@ -6,12 +6,18 @@ import datetime
 import os
 
 import ontology_prefixes
+import gen_data
 
 output_filenames = {}
 last_uris = {}
 result = {}
 now = datetime.datetime.today().strftime('%Y-%m-%dT%H:%M:%SZ')
 
+def setReferenceDate(date):
+  global now
+  now = date.strftime('%Y-%m-%dT%H:%M:%SZ')
+  gen_data.today = date
+
 ####################################################################################
 def addType(name, order):
   output   = '%03d-' % order + name.replace( '#', '_') + '.ttl'
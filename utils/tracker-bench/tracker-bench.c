@@ -0,0 +1,1016 @@
+/*
+ * Copyright (C) 2018, Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libtracker-sparql/tracker-sparql.h>
+#include <libtracker-data/tracker-data.h>
+
+/* All generated data goes in this graph, so it can be told apart
+ * (and cleaned up) when running against the session store.
+ */
+#define BENCH_GRAPH "urn:tracker-bench:graph"
+#define BENCH_URL_PREFIX "file:///tracker-bench"
+
+#define ITEMS_PER_FOLDER 100
+#define N_ARTISTS 50
+#define N_ALBUMS 200
+#define N_LOOKUPS 1000
+#define NOTIFIER_TIMEOUT_S 60
+
+typedef struct {
+	gchar *name;
+	const gchar *backend;
+	gdouble value;
+	const gchar *unit;
+} BenchResult;
+
+typedef struct {
+	GArray *results;
+	GRand *rand;
+	GPtrArray *inserts;
+	gchar **lookup_urls;
+	guint n_folders;
+} BenchContext;
+
+static gint n_items = 5000;
+static gint batch_size = 100;
+static gint seed = 1;
+static gint n_notifiers = 4;
+static gint reader_mmap_size = -1;
+static gchar *ontology_path;
+static gchar *ttl_path;
+static gchar *output_path;
+static gboolean use_bus;
+
+static GOptionEntry entries[] = {
+	{ "items", 'n', 0, G_OPTION_ARG_INT, &n_items,
+	  "Number of file resources to generate",
+	  "5000" },
+	{ "batch-size", 'b', 0, G_OPTION_ARG_INT, &batch_size,
+	  "Number of updates per update_array() batch",
+	  "100" },
+	{ "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+	  "Seed for the data generator",
+	  "1" },
+	{ "ontology", 'o', 0, G_OPTION_ARG_FILENAME, &ontology_path,
+	  "Ontology directory used for the temporary store",
+	  "DIR" },
+	{ "ttl-dir", 't', 0, G_OPTION_ARG_FILENAME, &ttl_path,
+	  "Also load the Turtle files in this directory (e.g. the output of utils/data-generators/cc/generate)",
+	  "DIR" },
+	{ "bus", 0, 0, G_OPTION_ARG_NONE, &use_bus,
+	  "Also run the benchmarks against the session tracker-store",
+	  NULL },
+	{ "notifiers", 0, 0, G_OPTION_ARG_INT, &n_notifiers,
+	  "Number of TrackerNotifiers listening when measuring notifier fan-out",
+	  "4" },
+	{ "reader-mmap-size", 0, 0, G_OPTION_ARG_INT, &reader_mmap_size,
+	  "Memory mapped I/O size of the direct reader connections in MB, 0 disables it",
+	  "MB" },
+	{ "output", 0, 0, G_OPTION_ARG_FILENAME, &output_path,
+	  "Write the JSON results to this file instead of stdout",
+	  "FILE" },
+	{ NULL }
+};
+
+static const gchar *words[] = {
+	"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+	"hotel", "india", "juliet", "kilo", "lima", "mike", "november",
+	"oscar", "papa", "quebec", "romeo", "sierra", "tango", "uniform",
+	"victor", "whiskey", "xray", "yankee", "zulu", "lorem", "ipsum",
+	"dolor", "amet", "consectetur", "adipiscing", "elit", "sed",
+	"tempor", "incididunt", "labore", "dolore", "magna", "aliqua"
+};
+
+static void
+add_result (BenchContext *ctx,
+            const gchar  *backend,
+            const gchar  *name,
+            gdouble       value,
+            const gchar  *unit)
+{
+	BenchResult result;
+
+	result.name = g_strdup (name);
+	result.backend = backend;
+	result.value = value;
+	result.unit = unit;
+	g_array_append_val (ctx->results, result);
+
+	g_printerr ("%-8s %-24s %12.2f %s\n", backend, name, value, unit);
+}
+
+/* Data generation */
+
+static void
+append_words (BenchContext *ctx,
+              GString      *str,
+              guint         n_words)
+{
+	guint i;
+
+	for (i = 0; i < n_words; i++) {
+		if (i > 0)
+			g_string_append_c (str, ' ');
+		g_string_append (str, words[g_rand_int_range (ctx->rand, 0, G_N_ELEMENTS (words))]);
+	}
+}
+
+static gchar *
+create_folder (guint n)
+{
+	return g_strdup_printf ("INSERT { GRAPH <" BENCH_GRAPH "> {"
+	                        " <urn:tracker-bench:folder:%u> a nfo:Folder, nfo:FileDataObject ;"
+	                        " nie:url \"" BENCH_URL_PREFIX "/%u\" ;"
+	                        " nfo:fileName \"%u\" ;"
+	                        " nfo:fileLastModified \"2018-01-01T00:00:00Z\" } }",
+	                        n, n, n);
+}
+
+static gchar *
+create_music_piece (BenchContext *ctx,
+                    guint         n,
+                    guint         folder,
+                    const gchar  *mtime)
+{
+	GString *str;
+	guint album, size, track, duration;
+
+	/* Argument evaluation order is unspecified, draw the random
+	 * values beforehand so all compilers generate the same data.
+	 */
+	album = g_rand_int_range (ctx->rand, 0, N_ALBUMS);
+	size = g_rand_int_range (ctx->rand, 1000000, 10000000);
+	track = g_rand_int_range (ctx->rand, 1, 20);
+	duration = g_rand_int_range (ctx->rand, 60, 600);
+	str = g_string_new ("INSERT { GRAPH <" BENCH_GRAPH "> {");
+	g_string_append_printf (str,
+	                        " <urn:tracker-bench:artist:%u> a nmm:Artist ;"
+	                        " nmm:artistName \"Artist %u\" ."
+	                        " <urn:tracker-bench:album:%u> a nmm:MusicAlbum ;"
+	                        " nmm:albumTitle \"Album %u\" .",
+	                        album % N_ARTISTS, album % N_ARTISTS,
+	                        album, album);
+	g_string_append_printf (str,
+	                        " <urn:tracker-bench:item:%u> a nfo:FileDataObject, nmm:MusicPiece ;"
+	                        " nie:url \"" BENCH_URL_PREFIX "/%u/%u.mp3\" ;"
+	                        " nfo:fileName \"%u.mp3\" ;"
+	                        " nfo:fileSize %u ;"
+	                        " nfo:fileLastModified \"%s\" ;"
+	                        " nfo:belongsToContainer <urn:tracker-bench:folder:%u> ;"
+	                        " nmm:performer <urn:tracker-bench:artist:%u> ;"
+	                        " nmm:musicAlbum <urn:tracker-bench:album:%u> ;"
+	                        " nmm:trackNumber %u ;"
+	                        " nfo:duration %u ;"
+	                        " nie:title \"",
+	                        n, folder, n, n, size, mtime, folder,
+	                        album % N_ARTISTS, album, track, duration);
+	append_words (ctx, str, 3);
+	g_string_append (str, "\" } }");
+
+	return g_string_free (str, FALSE);
+}
+
+static gchar *
+create_photo (BenchContext *ctx,
+              guint         n,
+              guint         folder,
+              const gchar  *mtime)
+{
+	guint size, width, height;
+
+	size = g_rand_int_range (ctx->rand, 100000, 5000000);
+	width = g_rand_int_range (ctx->rand, 640, 4000);
+	height = g_rand_int_range (ctx->rand, 480, 3000);
+
+	return g_strdup_printf ("INSERT { GRAPH <" BENCH_GRAPH "> {"
+	                        " <urn:tracker-bench:item:%u> a nfo:FileDataObject, nmm:Photo ;"
+	                        " nie:url \"" BENCH_URL_PREFIX "/%u/%u.jpg\" ;"
+	                        " nfo:fileName \"%u.jpg\" ;"
+	                        " nfo:fileSize %u ;"
+	                        " nfo:fileLastModified \"%s\" ;"
+	                        " nfo:belongsToContainer <urn:tracker-bench:folder:%u> ;"
+	                        " nfo:width %u ; nfo:height %u } }",
+	                        n, folder, n, n, size, mtime, folder,
+	                        width, height);
+}
+
+static gchar *
+create_email (BenchContext *ctx,
+              guint         n,
+              guint         folder,
+              const gchar  *mtime)
+{
+	GString *str;
+
+	str = g_string_new ("INSERT { GRAPH <" BENCH_GRAPH "> {");
+	g_string_append_printf (str,
+	                        " <urn:tracker-bench:item:%u> a nfo:FileDataObject, nmo:Email ;"
+	                        " nie:url \"" BENCH_URL_PREFIX "/%u/%u.eml\" ;"
+	                        " nfo:fileName \"%u.eml\" ;"
+	                        " nfo:fileSize %u ;"
+	                        " nfo:fileLastModified \"%s\" ;"
+	                        " nfo:belongsToContainer <urn:tracker-bench:folder:%u> ;"
+	                        " nmo:receivedDate \"%s\" ;"
+	                        " nmo:messageSubject \"",
+	                        n, folder, n, n,
+	                        g_rand_int_range (ctx->rand, 1000, 100000),
+	                        mtime, folder, mtime);
+	append_words (ctx, str, 5);
+	g_string_append (str, "\" ; nie:plainTextContent \"");
+	append_words (ctx, str, 60);
+	g_string_append (str, "\" } }");
+
+	return g_string_free (str, FALSE);
+}
+
+static gchar *
+create_document (BenchContext *ctx,
+                 guint         n,
+                 guint         folder,
+                 const gchar  *mtime)
+{
+	GString *str;
+
+	str = g_string_new ("INSERT { GRAPH <" BENCH_GRAPH "> {");
+	g_string_append_printf (str,
+	                        " <urn:tracker-bench:item:%u> a nfo:FileDataObject, nfo:PlainTextDocument ;"
+	                        " nie:url \"" BENCH_URL_PREFIX "/%u/%u.txt\" ;"
+	                        " nfo:fileName \"%u.txt\" ;"
+	                        " nfo:fileSize %u ;"
+	                        " nfo:fileLastModified \"%s\" ;"
+	                        " nfo:belongsToContainer <urn:tracker-bench:folder:%u> ;"
+	                        " nie:title \"",
+	                        n, folder, n, n,
+	                        g_rand_int_range (ctx->rand, 100, 100000),
+	                        mtime, folder);
+	append_words (ctx, str, 4);
+	g_string_append (str, "\" ; nie:plainTextContent \"");
+	append_words (ctx, str, 200);
+	g_string_append (str, "\" } }");
+
+	return g_string_free (str, FALSE);
+}
+
+/* Generates the same dataset for the same seed and number of items:
+ * folders first, then a mix of music, photos, emails and documents
+ * spread across them, like a typical home directory crawl.
+ */
+static void
+generate_dataset (BenchContext *ctx)
+{
+	guint i, folder, month, day, hour, minute;
+	gchar *mtime, *url;
+
+	ctx->n_folders = (n_items + ITEMS_PER_FOLDER - 1) / ITEMS_PER_FOLDER;
+	ctx->inserts = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; i < ctx->n_folders; i++)
+		g_ptr_array_add (ctx->inserts, create_folder (i));
+
+	for (i = 0; i < (guint) n_items; i++) {
+		folder = i / ITEMS_PER_FOLDER;
+		month = g_rand_int_range (ctx->rand, 1, 13);
+		day = g_rand_int_range (ctx->rand, 1, 29);
+		hour = g_rand_int_range (ctx->rand, 0, 24);
+		minute = g_rand_int_range (ctx->rand, 0, 60);
+		mtime = g_strdup_printf ("2018-%.2u-%.2uT%.2u:%.2u:00Z",
+		                         month, day, hour, minute);
+
+		switch (i % 4) {
+		case 0:
+			g_ptr_array_add (ctx->inserts, create_music_piece (ctx, i, folder, mtime));
+			break;
+		case 1:
+			g_ptr_array_add (ctx->inserts, create_photo (ctx, i, folder, mtime));
+			break;
+		case 2:
+			g_ptr_array_add (ctx->inserts, create_email (ctx, i, folder, mtime));
+			break;
+		default:
+			g_ptr_array_add (ctx->inserts, create_document (ctx, i, folder, mtime));
+			break;
+		}
+
+		g_free (mtime);
+	}
+
+	ctx->lookup_urls = g_new0 (gchar *, N_LOOKUPS + 1);
+
+	for (i = 0; i < N_LOOKUPS; i++) {
+		const gchar *ext[] = { "mp3", "jpg", "eml", "txt" };
+		guint n;
+
+		n = g_rand_int_range (ctx->rand, 0, n_items);
+		url = g_strdup_printf (BENCH_URL_PREFIX "/%u/%u.%s",
+		                       n / ITEMS_PER_FOLDER, n, ext[n % 4]);
+		ctx->lookup_urls[i] = url;
+	}
+}
+
+/* Helpers */
+
+typedef struct {
+	GMainLoop *loop;
+	GPtrArray *errors;
+	GError *error;
+} UpdateArrayData;
+
+static void
+update_array_cb (GObject      *object,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+	UpdateArrayData *data = user_data;
+
+	data->errors = tracker_sparql_connection_update_array_finish (TRACKER_SPARQL_CONNECTION (object),
+	                                                              res, &data->error);
+	g_main_loop_quit (data->loop);
+}
+
+static gboolean
+run_update_array (TrackerSparqlConnection  *conn,
+                  gchar                   **updates,
+                  guint                     n_updates,
+                  GError                  **error)
+{
+	UpdateArrayData data = { 0 };
+	guint i;
+
+	data.loop = g_main_loop_new (NULL, FALSE);
+	tracker_sparql_connection_update_array_async (conn, updates, n_updates,
+	                                              G_PRIORITY_DEFAULT, NULL,
+	                                              update_array_cb, &data);
+	g_main_loop_run (data.loop);
+	g_main_loop_unref (data.loop);
+
+	if (data.error) {
+		g_propagate_error (error, data.error);
+		return FALSE;
+	}
+
+	for (i = 0; i < data.errors->len; i++) {
+		GError *update_error = g_ptr_array_index (data.errors, i);
+
+		if (update_error) {
+			g_propagate_error (error, g_error_copy (update_error));
+			g_ptr_array_unref (data.errors);
+			return FALSE;
+		}
+	}
+
+	g_ptr_array_unref (data.errors);
+
+	return TRUE;
+}
+
+static gboolean
+run_query (TrackerSparqlConnection  *conn,
+           const gchar              *sparql,
+           guint                    *n_rows,
+           GError                  **error)
+{
+	TrackerSparqlCursor *cursor;
+	guint rows = 0;
+
+	cursor = tracker_sparql_connection_query (conn, sparql, NULL, error);
+	if (!cursor)
+		return FALSE;
+
+	while (tracker_sparql_cursor_next (cursor, NULL, error)) {
+		gint i;
+
+		/* Fetch all columns, as a client would */
+		for (i = 0; i < tracker_sparql_cursor_get_n_columns (cursor); i++)
+			tracker_sparql_cursor_get_string (cursor, i, NULL);
+
+		rows++;
+	}
+
+	g_object_unref (cursor);
+
+	if (n_rows)
+		*n_rows = rows;
+
+	return (error == NULL || *error == NULL);
+}
+
+static void
+remove_dir_recursively (const gchar *path)
+{
+	const gchar *name;
+	GDir *dir;
+
+	dir = g_dir_open (path, 0, NULL);
+
+	if (dir) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *child;
+
+			child = g_build_filename (path, name, NULL);
+
+			if (g_file_test (child, G_FILE_TEST_IS_DIR))
+				remove_dir_recursively (child);
+			else
+				g_unlink (child);
+
+			g_free (child);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_rmdir (path);
+}
+
+/* Benchmarks */
+
+static gboolean
+bench_insert (BenchContext             *ctx,
+              TrackerSparqlConnection  *conn,
+              const gchar              *backend,
+              GError                  **error)
+{
+	GTimer *timer;
+	guint i, n;
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < ctx->inserts->len; i += n) {
+		n = MIN ((guint) batch_size, ctx->inserts->len - i);
+
+		if (!run_update_array (conn, (gchar **) &ctx->inserts->pdata[i], n, error)) {
+			g_timer_destroy (timer);
+			return FALSE;
+		}
+	}
+
+	add_result (ctx, backend, "insert",
+	            ctx->inserts->len / g_timer_elapsed (timer, NULL),
+	            "resources/s");
+	g_timer_destroy (timer);
+
+	return TRUE;
+}
+
+static gint
+compare_filenames (gconstpointer a,
+                   gconstpointer b)
+{
+	return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gboolean
+bench_load_ttl (BenchContext             *ctx,
+                TrackerSparqlConnection  *conn,
+                const gchar              *backend,
+                GError                  **error)
+{
+	const gchar *name;
+	GPtrArray *files;
+	GTimer *timer;
+	GDir *dir;
+	guint i;
+
+	dir = g_dir_open (ttl_path, 0, error);
+	if (!dir)
+		return FALSE;
+
+	files = g_ptr_array_new_with_free_func (g_free);
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		if (g_str_has_suffix (name, ".ttl"))
+			g_ptr_array_add (files, g_build_filename (ttl_path, name, NULL));
+	}
+
+	g_dir_close (dir);
+
+	/* The generator prefixes files so dependencies load first */
+	g_ptr_array_sort (files, compare_filenames);
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < files->len; i++) {
+		GFile *file;
+
+		file = g_file_new_for_path (g_ptr_array_index (files, i));
+		tracker_sparql_connection_load (conn, file, NULL, error);
+		g_object_unref (file);
+
+		if (error && *error) {
+			g_timer_destroy (timer);
+			g_ptr_array_unref (files);
+			return FALSE;
+		}
+	}
+
+	add_result (ctx, backend, "ttl-load",
+	            g_timer_elapsed (timer, NULL), "s");
+	g_timer_destroy (timer);
+	g_ptr_array_unref (files);
+
+	return TRUE;
+}
+
+/* The queries below are those issued most often by the miners and
+ * by the typical applications built on top of them.
+ */
+static gboolean
+bench_queries (BenchContext             *ctx,
+               TrackerSparqlConnection  *conn,
+               const gchar              *backend,
+               GError                  **error)
+{
+	GTimer *timer;
+	gchar *sparql;
+	guint i, n_rows;
+
+	/* TrackerMinerFS: URN lookups by URL */
+	timer = g_timer_new ();
+
+	for (i = 0; ctx->lookup_urls[i]; i++) {
+		sparql = g_strdup_printf ("SELECT ?u { GRAPH <" BENCH_GRAPH "> { ?u nie:url \"%s\" } }",
+		                          ctx->lookup_urls[i]);
+		run_query (conn, sparql, NULL, error);
+		g_free (sparql);
+
+		if (error && *error)
+			goto out;
+	}
+
+	add_result (ctx, backend, "query-url-lookup",
+	            i / g_timer_elapsed (timer, NULL), "queries/s");
+
+	/* TrackerFileNotifier: folder contents and mtimes for the crawler */
+	g_timer_start (timer);
+
+	for (i = 0; i < ctx->n_folders; i++) {
+		sparql = g_strdup_printf ("SELECT ?url ?mtime { GRAPH <" BENCH_GRAPH "> {"
+		                          " ?u nfo:belongsToContainer ?f ;"
+		                          " nie:url ?url ;"
+		                          " nfo:fileLastModified ?mtime ."
+		                          " ?f nie:url \"" BENCH_URL_PREFIX "/%u\" } }",
+		                          i);
+		run_query (conn, sparql, NULL, error);
+		g_free (sparql);
+
+		if (error && *error)
+			goto out;
+	}
+
+	add_result (ctx, backend, "query-folder-contents",
+	            i / g_timer_elapsed (timer, NULL), "queries/s");
+
+	/* Music players: full listing with artist and album */
+	g_timer_start (timer);
+
+	if (!run_query (conn,
+	                "SELECT ?title ?artist ?album { GRAPH <" BENCH_GRAPH "> {"
+	                " ?s a nmm:MusicPiece ; nie:title ?title ;"
+	                " nmm:performer [ nmm:artistName ?artist ] ;"
+	                " nmm:musicAlbum [ nmm:albumTitle ?album ] } }"
+	                " ORDER BY ?artist ?album ?title",
+	                &n_rows, error))
+		goto out;
+
+	add_result (ctx, backend, "query-music-listing",
+	            g_timer_elapsed (timer, NULL) * 1000, "ms");
+
+#if HAVE_TRACKER_FTS
+	/* Search: full text matches, ranked */
+	g_timer_start (timer);
+
+	for (i = 0; i < G_N_ELEMENTS (words); i++) {
+		sparql = g_strdup_printf ("SELECT ?u fts:rank(?u) { GRAPH <" BENCH_GRAPH "> {"
+		                          " ?u fts:match \"%s\" } }"
+		                          " ORDER BY DESC (fts:rank(?u)) LIMIT 50",
+		                          words[i]);
+		run_query (conn, sparql, NULL, error);
+		g_free (sparql);
+
+		if (error && *error)
+			goto out;
+	}
+
+	add_result (ctx, backend, "query-fts",
+	            i / g_timer_elapsed (timer, NULL), "queries/s");
+#endif
+
+out:
+	g_timer_destroy (timer);
+
+	return (error == NULL || *error == NULL);
+}
+
+/* Over the bus backend, this measures the FD passing cursor */
+static gboolean
+bench_cursor (BenchContext             *ctx,
+              TrackerSparqlConnection  *conn,
+              const gchar              *backend,
+              GError                  **error)
+{
+	GTimer *timer;
+	guint n_rows;
+
+	timer = g_timer_new ();
+
+	if (run_query (conn,
+	               "SELECT ?u ?url ?name ?size ?mtime { GRAPH <" BENCH_GRAPH "> {"
+	               " ?u a nfo:FileDataObject ; nie:url ?url ; nfo:fileName ?name ;"
+	               " nfo:fileLastModified ?mtime ."
+	               " OPTIONAL { ?u nfo:fileSize ?size } } }",
+	               &n_rows, error)) {
+		add_result (ctx, backend, "cursor",
+		            n_rows / g_timer_elapsed (timer, NULL), "rows/s");
+	}
+
+	g_timer_destroy (timer);
+
+	return (error == NULL || *error == NULL);
+}
+
+#ifndef DISABLE_JOURNAL
+/* Rebuilds the database from the journal written while inserting,
+ * then rebuilds the FTS tokens on the resulting database.
+ */
+static gboolean
+bench_journal_replay (BenchContext  *ctx,
+                      GFile         *store,
+                      GFile         *journal,
+                      GFile         *ontology,
+                      GError       **error)
+{
+	TrackerDataManager *data_manager;
+	GTimer *timer;
+	gchar *path;
+
+	path = g_file_get_path (store);
+	remove_dir_recursively (path);
+	g_free (path);
+
+	timer = g_timer_new ();
+
+	data_manager = tracker_data_manager_new (0, store, journal, ontology,
+	                                         TRUE, FALSE, 100, 100);
+
+	if (!g_initable_init (G_INITABLE (data_manager), NULL, error)) {
+		g_object_unref (data_manager);
+		g_timer_destroy (timer);
+		return FALSE;
+	}
+
+	add_result (ctx, "direct", "journal-replay",
+	            g_timer_elapsed (timer, NULL), "s");
+
+#if HAVE_TRACKER_FTS
+	g_timer_start (timer);
+	tracker_db_interface_sqlite_fts_rebuild_tokens (tracker_data_manager_get_writable_db_interface (data_manager));
+	add_result (ctx, "direct", "fts-rebuild",
+	            g_timer_elapsed (timer, NULL), "s");
+#endif
+
+	g_timer_destroy (timer);
+	g_object_unref (data_manager);
+
+	return TRUE;
+}
+#endif /* DISABLE_JOURNAL */
+
+static gboolean
+run_direct (BenchContext  *ctx,
+            GError       **error)
+{
+	TrackerSparqlConnection *conn;
+	GFile *root, *store, *journal, *ontology;
+	gchar *path;
+	gboolean success = FALSE;
+
+	path = g_build_filename (g_get_tmp_dir (), "tracker-bench-XXXXXX", NULL);
+
+	if (!g_mkdtemp_full (path, 0700)) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+		             "Could not create temporary directory '%s'", path);
+		g_free (path);
+		return FALSE;
+	}
+
+	root = g_file_new_for_path (path);
+	store = g_file_get_child (root, "cache");
+	journal = g_file_get_child (root, "data");
+	ontology = g_file_new_for_commandline_arg (ontology_path);
+
+	conn = tracker_sparql_connection_local_new (0, store, journal, ontology, NULL, error);
+	if (!conn)
+		goto out;
+
+	if (!bench_insert (ctx, conn, "direct", error) ||
+	    (ttl_path && !bench_load_ttl (ctx, conn, "direct", error)) ||
+	    !bench_queries (ctx, conn, "direct", error) ||
+	    !bench_cursor (ctx, conn, "direct", error)) {
+		g_object_unref (conn);
+		goto out;
+	}
+
+	g_object_unref (conn);
+
+#ifndef DISABLE_JOURNAL
+	if (!bench_journal_replay (ctx, store, journal, ontology, error))
+		goto out;
+#endif
+
+	success = TRUE;
+
+out:
+	remove_dir_recursively (path);
+	g_object_unref (ontology);
+	g_object_unref (journal);
+	g_object_unref (store);
+	g_object_unref (root);
+	g_free (path);
+
+	return success;
+}
+
+/* Notifier fan-out */
+
+static void
+notifier_events_cb (TrackerNotifier *notifier,
+                    GPtrArray       *events,
+                    gpointer         user_data)
+{
+	guint *n_events = user_data;
+	guint i;
+
+	for (i = 0; i < events->len; i++) {
+		TrackerNotifierEvent *event = g_ptr_array_index (events, i);
+
+		if (tracker_notifier_event_get_event_type (event) == TRACKER_NOTIFIER_EVENT_CREATE)
+			(*n_events)++;
+	}
+}
+
+static gboolean
+notifier_timeout_cb (gpointer user_data)
+{
+	gboolean *timed_out = user_data;
+
+	*timed_out = TRUE;
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+bench_notifier (BenchContext             *ctx,
+                TrackerSparqlConnection  *conn,
+                GError                  **error)
+{
+	const gchar *classes[] = { "nfo:Document", NULL };
+	TrackerNotifier **notifiers;
+	GPtrArray *inserts;
+	guint *n_events;
+	gboolean timed_out = FALSE, done = FALSE;
+	GTimer *timer;
+	guint i, n, timeout_id;
+
+	notifiers = g_new0 (TrackerNotifier *, n_notifiers);
+	n_events = g_new0 (guint, n_notifiers);
+
+	for (i = 0; i < (guint) n_notifiers; i++) {
+		notifiers[i] = tracker_notifier_new (classes,
+		                                     TRACKER_NOTIFIER_FLAG_NOTIFY_UNEXTRACTED,
+		                                     NULL, error);
+		if (!notifiers[i])
+			goto out;
+
+		g_signal_connect (notifiers[i], "events",
+		                  G_CALLBACK (notifier_events_cb), &n_events[i]);
+	}
+
+	inserts = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < N_LOOKUPS; i++) {
+		g_ptr_array_add (inserts,
+		                 g_strdup_printf ("INSERT { GRAPH <" BENCH_GRAPH "> {"
+		                                  " <urn:tracker-bench:notify:%u> a nfo:Document ;"
+		                                  " nie:title \"Notify %u\" } }",
+		                                  i, i));
+	}
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < inserts->len; i += n) {
+		n = MIN ((guint) batch_size, inserts->len - i);
+
+		if (!run_update_array (conn, (gchar **) &inserts->pdata[i], n, error))
+			break;
+	}
+
+	g_ptr_array_unref (inserts);
+
+	timeout_id = g_timeout_add_seconds (NOTIFIER_TIMEOUT_S, notifier_timeout_cb, &timed_out);
+
+	while (!done && !timed_out && (error == NULL || *error == NULL)) {
+		g_main_context_iteration (NULL, TRUE);
+
+		done = TRUE;
+		for (i = 0; i < (guint) n_notifiers; i++) {
+			if (n_events[i] < N_LOOKUPS)
+				done = FALSE;
+		}
+	}
+
+	if (!timed_out)
+		g_source_remove (timeout_id);
+
+	if (done) {
+		add_result (ctx, "bus", "notifier-fan-out",
+		            (N_LOOKUPS * n_notifiers) / g_timer_elapsed (timer, NULL),
+		            "events/s");
+	} else if (timed_out) {
+		g_printerr ("Notifiers timed out after %d seconds\n", NOTIFIER_TIMEOUT_S);
+	}
+
+	g_timer_destroy (timer);
+
+out:
+	for (i = 0; i < (guint) n_notifiers; i++)
+		g_clear_object (&notifiers[i]);
+
+	g_free (notifiers);
+	g_free (n_events);
+
+	return (error == NULL || *error == NULL);
+}
+
+static gboolean
+run_bus (BenchContext  *ctx,
+         GError       **error)
+{
+	TrackerSparqlConnection *conn;
+	const gchar *cleanup =
+		"DELETE { ?u a rdfs:Resource } WHERE {"
+		" GRAPH <" BENCH_GRAPH "> { ?u a rdfs:Resource } }";
+	gboolean success;
+
+	g_setenv ("TRACKER_SPARQL_BACKEND", "bus", TRUE);
+
+	conn = tracker_sparql_connection_get (NULL, error);
+	if (!conn)
+		return FALSE;
+
+	/* Leftovers from an interrupted run */
+	tracker_sparql_connection_update (conn, cleanup, G_PRIORITY_DEFAULT, NULL, error);
+	if (error && *error) {
+		g_object_unref (conn);
+		return FALSE;
+	}
+
+	success = (bench_insert (ctx, conn, "bus", error) &&
+	           bench_queries (ctx, conn, "bus", error) &&
+	           bench_cursor (ctx, conn, "bus", error) &&
+	           bench_notifier (ctx, conn, error));
+
+	tracker_sparql_connection_update (conn, cleanup, G_PRIORITY_DEFAULT, NULL,
+	                                  success ? error : NULL);
+	g_object_unref (conn);
+
+	return success && (error == NULL || *error == NULL);
+}
+
+/* Output */
+
+static void
+print_json (BenchContext *ctx,
+            GString      *str)
+{
+	guint i;
+
+	g_string_append (str, "{\n");
+	g_string_append_printf (str, "  \"seed\": %d,\n", seed);
+	g_string_append_printf (str, "  \"items\": %d,\n", n_items);
+	g_string_append_printf (str, "  \"batch-size\": %d,\n", batch_size);
+	if (reader_mmap_size >= 0)
+		g_string_append_printf (str, "  \"reader-mmap-size\": %d,\n", reader_mmap_size);
+	g_string_append (str, "  \"results\": [\n");
+
+	for (i = 0; i < ctx->results->len; i++) {
+		BenchResult *result = &g_array_index (ctx->results, BenchResult, i);
+		gchar value[G_ASCII_DTOSTR_BUF_SIZE];
+
+		g_ascii_formatd (value, sizeof (value), "%.3f", result->value);
+		g_string_append_printf (str,
+		                        "    { \"name\": \"%s\", \"backend\": \"%s\", "
+		                        "\"value\": %s, \"unit\": \"%s\" }%s\n",
+		                        result->name, result->backend,
+		                        value, result->unit,
+		                        i < ctx->results->len - 1 ? "," : "");
+	}
+
+	g_string_append (str, "  ]\n}\n");
+}
+
+static void
+clear_result (gpointer data)
+{
+	BenchResult *result = data;
+
+	g_free (result->name);
+}
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	BenchContext ctx = { 0 };
+	GError *error = NULL;
+	GString *json;
+	gint retval = EXIT_SUCCESS;
+
+	setlocale (LC_ALL, "");
+
+	context = g_option_context_new ("- Measure tracker performance on a generated dataset");
+	g_option_context_add_main_entries (context, entries, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+
+	g_option_context_free (context);
+
+	if (n_items <= 0 || batch_size <= 0 || n_notifiers <= 0) {
+		g_printerr ("--items, --batch-size and --notifiers must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+	if (reader_mmap_size >= 0) {
+		tracker_db_manager_set_role_params (TRACKER_DB_ROLE_READER, 0,
+		                                    (gint64) reader_mmap_size * 1024 * 1024);
+	}
+
+	if (!ontology_path)
+		ontology_path = g_build_filename (SHAREDIR, "tracker", "ontologies", "nepomuk", NULL);
+
+	ctx.results = g_array_new (FALSE, FALSE, sizeof (BenchResult));
+	g_array_set_clear_func (ctx.results, clear_result);
+	ctx.rand = g_rand_new_with_seed (seed);
+
+	generate_dataset (&ctx);
+
+	if (!run_direct (&ctx, &error) ||
+	    (use_bus && !run_bus (&ctx, &error))) {
+		g_printerr ("Benchmark failed: %s\n", error ? error->message : "unknown error");
+		g_clear_error (&error);
+		retval = EXIT_FAILURE;
+	}
+
+	json = g_string_new (NULL);
+	print_json (&ctx, json);
+
+	if (output_path) {
+		if (!g_file_set_contents (output_path, json->str, json->len, &error)) {
+			g_printerr ("Could not write results: %s\n", error->message);
+			g_error_free (error);
+			retval = EXIT_FAILURE;
+		}
+	} else {
+		g_print ("%s", json->str);
+	}
+
+	g_string_free (json, TRUE);
+	g_array_unref (ctx.results);
+	g_ptr_array_unref (ctx.inserts);
+	g_strfreev (ctx.lookup_urls);
+	g_rand_free (ctx.rand);
+	g_free (ontology_path);
+	g_free (ttl_path);
+	g_free (output_path);
+
+	return retval;
+}